@@ -5,7 +5,7 @@
 
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 @vertex
 fn vs_main(in: VertexInput) -> VertexOutput {
@@ -17,7 +17,7 @@ let instance_data : RenderMeshData = mesh_data.data[in.instance_id];
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(in.color, 1.0);
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
     return out;
 }
 
@@ -0,0 +1,67 @@
+// Reverse-Z: each texel keeps the farthest (smallest) depth of the area it covers
+
+#ifdef COPY_DEPTH
+@group(0) @binding(0) var source_depth: texture_depth_2d;
+#endif
+
+#ifdef COPY_DEPTH_MULTISAMPLED
+@group(0) @binding(0) var source_depth: texture_depth_multisampled_2d;
+#endif
+
+#ifdef DOWNSAMPLE
+@group(0) @binding(0) var previous_level: texture_2d<f32>;
+#endif
+
+@group(0) @binding(1) var next_level: texture_storage_2d<r32float, write>;
+
+@compute @workgroup_size(8, 8)
+fn compute(@builtin(global_invocation_id) id: vec3<u32>) {
+
+    let dim : vec2u = textureDimensions(next_level).xy;
+
+    if (any(id.xy >= dim)) {
+        return;
+    }
+
+#ifdef COPY_DEPTH
+    let depth : f32 = textureLoad(source_depth, id.xy, 0);
+    textureStore(next_level, id.xy, vec4f(depth, 0.0, 0.0, 1.0));
+#endif
+
+#ifdef COPY_DEPTH_MULTISAMPLED
+    var depth : f32 = 1.0;
+
+    for (var i = 0u; i < textureNumSamples(source_depth); i++) {
+        depth = min(depth, textureLoad(source_depth, id.xy, i));
+    }
+
+    textureStore(next_level, id.xy, vec4f(depth, 0.0, 0.0, 1.0));
+#endif
+
+#ifdef DOWNSAMPLE
+    let previous_dim : vec2u = textureDimensions(previous_level, 0).xy;
+    let last_texel : vec2u = previous_dim - 1u;
+    let source : vec2u = id.xy * 2u;
+
+    // With odd sizes the last row/column also covers the texel left out by the division
+    var footprint : vec2u = vec2u(2u);
+
+    if ((previous_dim.x & 1u) == 1u && id.x == dim.x - 1u) {
+        footprint.x = 3u;
+    }
+
+    if ((previous_dim.y & 1u) == 1u && id.y == dim.y - 1u) {
+        footprint.y = 3u;
+    }
+
+    var depth : f32 = 1.0;
+
+    for (var y = 0u; y < footprint.y; y++) {
+        for (var x = 0u; x < footprint.x; x++) {
+            depth = min(depth, textureLoad(previous_level, min(source + vec2u(x, y), last_texel), 0).r);
+        }
+    }
+
+    textureStore(next_level, id.xy, vec4f(depth, 0.0, 0.0, 1.0));
+#endif
+}
@@ -0,0 +1,110 @@
+struct CullInstance {
+    model : mat4x4f,
+    aabb_center : vec4f, // w: draw batch index (bitcast)
+    aabb_extent : vec4f  // w: 1.0 when the instance is never culled
+};
+
+struct CullData {
+    planes : array<vec4f, 6>,
+    occlusion_view_projection : mat4x4f, // camera that rendered the Hi-Z depth
+    hiz_size : vec2f,
+    hiz_mip_count : u32,
+    instance_count : u32,
+    occlusion_enabled : u32,
+    pad0 : u32,
+    pad1 : u32,
+    pad2 : u32
+};
+
+@group(0) @binding(0) var<storage, read> instances : array<CullInstance>;
+@group(0) @binding(1) var<storage, read> batch_first_instance : array<u32>;
+@group(0) @binding(2) var<storage, read_write> draw_args : array<atomic<u32>>;
+@group(0) @binding(3) var<storage, read_write> out_instances : array<mat4x4f>;
+@group(0) @binding(4) var<uniform> cull_data : CullData;
+@group(0) @binding(5) var hiz_texture : texture_2d<f32>;
+
+override WORKGROUP_SIZE: u32 = 64;
+
+// Indexed and non indexed indirect arguments are both padded to 5 words, instance count is always the second one
+const DRAW_ARGS_STRIDE : u32 = 5u;
+
+// Reverse-Z Hi-Z test, the box is hidden if its nearest depth is farther than the farthest depth under its screen rect
+fn is_occluded(center : vec3f, extent : vec3f) -> bool
+{
+    var uv_min = vec2f(1.0);
+    var uv_max = vec2f(0.0);
+    var nearest_depth = 0.0;
+
+    for (var i = 0u; i < 8u; i++) {
+        let corner_sign = vec3f(f32(i & 1u), f32((i >> 1u) & 1u), f32((i >> 2u) & 1u)) * 2.0 - 1.0;
+        let clip = cull_data.occlusion_view_projection * vec4f(center + extent * corner_sign, 1.0);
+
+        // Crossing the near plane, can not be tested
+        if (clip.w <= 0.0) {
+            return false;
+        }
+
+        let ndc = clip.xyz / clip.w;
+        let uv = vec2f(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+
+        uv_min = min(uv_min, uv);
+        uv_max = max(uv_max, uv);
+        nearest_depth = max(nearest_depth, ndc.z);
+    }
+
+    let size = vec2u(cull_data.hiz_size);
+    let pixel_min = min(vec2u(clamp(uv_min, vec2f(0.0), vec2f(1.0)) * cull_data.hiz_size), size - 1u);
+    let pixel_max = min(vec2u(clamp(uv_max, vec2f(0.0), vec2f(1.0)) * cull_data.hiz_size), size - 1u);
+
+    // Level where the rect spans at most 2x2 texels
+    let rect_size = max(pixel_max.x - pixel_min.x, pixel_max.y - pixel_min.y);
+    let level = min(select(0u, firstLeadingBit(rect_size) + 1u, rect_size > 0u), cull_data.hiz_mip_count - 1u);
+
+    let level_last_texel = vec2u(textureDimensions(hiz_texture, level)) - 1u;
+    let texel_min = min(pixel_min >> vec2u(level), level_last_texel);
+    let texel_max = min(pixel_max >> vec2u(level), level_last_texel);
+
+    var farthest_depth = 1.0;
+
+    for (var y = texel_min.y; y <= texel_max.y; y++) {
+        for (var x = texel_min.x; x <= texel_max.x; x++) {
+            farthest_depth = min(farthest_depth, textureLoad(hiz_texture, vec2u(x, y), level).r);
+        }
+    }
+
+    return nearest_depth < farthest_depth;
+}
+
+@compute @workgroup_size(WORKGROUP_SIZE, 1, 1)
+fn compute(@builtin(global_invocation_id) id: vec3<u32>, @builtin(num_workgroups) w_dim: vec3<u32>)
+{
+    let index = id.x + id.y * w_dim.x * WORKGROUP_SIZE;
+
+    if (index >= cull_data.instance_count) {
+        return;
+    }
+
+    let instance = instances[index];
+
+    if (instance.aabb_extent.w == 0.0) {
+        for (var i = 0u; i < 6u; i++) {
+            let plane = cull_data.planes[i];
+            let distance = dot(plane.xyz, instance.aabb_center.xyz) + plane.w;
+            let radius = dot(abs(plane.xyz), instance.aabb_extent.xyz);
+
+            if (distance + radius < 0.0) {
+                return;
+            }
+        }
+
+        if (cull_data.occlusion_enabled == 1u && is_occluded(instance.aabb_center.xyz, instance.aabb_extent.xyz)) {
+            return;
+        }
+    }
+
+    // Append to the batch, the draw reads the compacted range
+    let batch = bitcast<u32>(instance.aabb_center.w);
+    let slot = atomicAdd(&draw_args[batch * DRAW_ARGS_STRIDE + 1u], 1u);
+
+    out_instances[batch_first_instance[batch] + slot] = instance.model;
+}
@@ -0,0 +1,134 @@
+const LIGHT_DIRECTIONAL = 1;
+
+// Must match Light in pbr_light.wgsl
+struct Light
+{
+    view_proj : mat4x4f,
+
+    position : vec3f,
+    ltype : u32,
+
+    color : vec3f,
+    intensity : f32,
+
+    direction : vec3f,
+    range : f32,
+
+    shadow_bias : f32,
+    cast_shadows : i32,
+    inner_cone_cos : f32,
+    outer_cone_cos : f32
+};
+
+// Must match LightClusterData in pbr_light.wgsl
+struct LightClusterData {
+    view : mat4x4f,
+    view_projection : mat4x4f,
+    inverse_projection : mat4x4f,
+    grid_size : vec3u,
+    max_cluster_lights : u32,
+    z_near : f32,
+    z_far : f32,
+    slice_scale : f32,
+    slice_bias : f32,
+    light_count : u32,
+    pad0 : u32,
+    pad1 : u32,
+    pad2 : u32
+};
+
+// Must match sOverflowStats in light_cluster_kernel.h
+struct OverflowStats {
+    clusters : atomic<u32>,
+    dropped_lights : atomic<u32>
+};
+
+// Same bindings as the lighting bind group of the forward pass
+@group(0) @binding(3) var<storage, read> lights : array<Light>;
+@group(0) @binding(4) var<uniform> cluster_data : LightClusterData;
+@group(0) @binding(7) var<storage, read_write> cluster_lights : array<u32>;
+// Only in the kernel, read back by the renderer to report the lights over the cap
+@group(0) @binding(8) var<storage, read_write> overflow_stats : OverflowStats;
+
+override WORKGROUP_SIZE: u32 = 64;
+
+// Point of the pixel ray at a view depth, two unprojected points work for perspective and orthographic projections
+fn get_view_position(ndc : vec2f, view_depth : f32) -> vec3f
+{
+    let p0 : vec4f = cluster_data.inverse_projection * vec4f(ndc, 0.25, 1.0);
+    let p1 : vec4f = cluster_data.inverse_projection * vec4f(ndc, 0.75, 1.0);
+
+    let a : vec3f = p0.xyz / p0.w;
+    let b : vec3f = p1.xyz / p1.w;
+
+    return mix(a, b, (-view_depth - a.z) / (b.z - a.z));
+}
+
+// One invocation per cluster, each one tests all the lights against its view space bounds
+@compute @workgroup_size(WORKGROUP_SIZE)
+fn compute(@builtin(global_invocation_id) id: vec3<u32>) {
+
+    let grid : vec3u = cluster_data.grid_size;
+    let cluster_index : u32 = id.x;
+
+    if (cluster_index >= grid.x * grid.y * grid.z) {
+        return;
+    }
+
+    let cluster : vec3u = vec3u(cluster_index % grid.x, (cluster_index / grid.x) % grid.y, cluster_index / (grid.x * grid.y));
+
+    // Exponential slices, the same distribution get_light_cluster_offset inverts
+    let depth_ratio : f32 = cluster_data.z_far / cluster_data.z_near;
+    let slice_near : f32 = cluster_data.z_near * pow(depth_ratio, f32(cluster.z) / f32(grid.z));
+    let slice_far : f32 = cluster_data.z_near * pow(depth_ratio, f32(cluster.z + 1u) / f32(grid.z));
+
+    // Tiles start at the top left of the screen, NDC y points up
+    let tile_size : vec2f = 2.0 / vec2f(grid.xy);
+    let ndc_min : vec2f = vec2f(-1.0 + f32(cluster.x) * tile_size.x, 1.0 - f32(cluster.y + 1u) * tile_size.y);
+    let ndc_max : vec2f = ndc_min + tile_size;
+
+    var aabb_min : vec3f = vec3f(3.402823e38);
+    var aabb_max : vec3f = vec3f(-3.402823e38);
+
+    for (var i = 0u; i < 8u; i++) {
+        let ndc : vec2f = select(ndc_min, ndc_max, vec2<bool>((i & 1u) != 0u, (i & 2u) != 0u));
+        let corner : vec3f = get_view_position(ndc, select(slice_near, slice_far, (i & 4u) != 0u));
+
+        aabb_min = min(aabb_min, corner);
+        aabb_max = max(aabb_max, corner);
+    }
+
+    let max_lights : u32 = cluster_data.max_cluster_lights;
+    let base : u32 = cluster_index * (max_lights + 1u);
+
+    var count : u32 = 0u;
+
+    // Every light is tested so the ones over the cap can be counted
+    for (var light_idx = 0u; light_idx < cluster_data.light_count; light_idx++) {
+        let light : Light = lights[light_idx];
+
+        // Directional and unlimited range lights reach every cluster, spots are bounded by their range sphere
+        var reaches_cluster : bool = true;
+
+        if (light.ltype != LIGHT_DIRECTIONAL && light.range >= 0.0) {
+            let center : vec3f = (cluster_data.view * vec4f(light.position, 1.0)).xyz;
+            let delta : vec3f = clamp(center, aabb_min, aabb_max) - center;
+            reaches_cluster = dot(delta, delta) <= light.range * light.range;
+        }
+
+        if (reaches_cluster) {
+            if (count < max_lights) {
+                cluster_lights[base + 1u + count] = light_idx;
+            }
+
+            count++;
+        }
+    }
+
+    if (count > max_lights) {
+        atomicAdd(&overflow_stats.clusters, 1u);
+        atomicAdd(&overflow_stats.dropped_lights, count - max_lights);
+    }
+
+    cluster_lights[base] = min(count, max_lights);
+}
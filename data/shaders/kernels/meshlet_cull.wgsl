@@ -0,0 +1,191 @@
+struct Meshlet {
+    center : vec3f,
+    radius : f32,
+    cone_axis : vec3f,
+    cone_cutoff : f32,
+    first_index : u32, // absolute, in the geometry arena index buffer
+    index_count : u32,
+    pad0 : u32,
+    pad1 : u32
+};
+
+struct MeshletDraw {
+    model : mat4x4f,
+    first_meshlet : u32,
+    meshlet_count : u32,
+    first_work : u32,  // meshlets of the previous draws
+    output_first_index : u32
+};
+
+struct CullData {
+    planes : array<vec4f, 6>,
+    occlusion_view_projection : mat4x4f, // camera that rendered the Hi-Z depth
+    eye : vec3f,
+    work_count : u32,
+    hiz_size : vec2f,
+    hiz_mip_count : u32,
+    draw_count : u32,
+    occlusion_enabled : u32,
+    cone_culling_enabled : u32,
+    // Work and draws of this dispatch, the bases are the first elements of the bound buffer ranges
+    first_work : u32,
+    first_draw : u32,
+    meshlet_base : u32,
+    index_base : u32,
+    output_base : u32,
+    pad0 : u32
+};
+
+@group(0) @binding(0) var<storage, read> draws : array<MeshletDraw>;
+@group(0) @binding(1) var<storage, read> meshlets : array<Meshlet>;
+@group(0) @binding(2) var<storage, read> indices : array<u32>;
+@group(0) @binding(3) var<storage, read_write> out_indices : array<u32>;
+@group(0) @binding(4) var<storage, read_write> draw_args : array<atomic<u32>>;
+@group(0) @binding(5) var<uniform> cull_data : CullData;
+@group(0) @binding(6) var hiz_texture : texture_2d<f32>;
+
+override WORKGROUP_SIZE: u32 = 64;
+
+// Same layout as the instance cull arguments
+const DRAW_ARGS_STRIDE : u32 = 5u;
+
+var<workgroup> copy_source : u32;
+var<workgroup> copy_destination : u32;
+var<workgroup> copy_count : u32;
+
+// Reverse-Z Hi-Z test, the box is hidden if its nearest depth is farther than the farthest depth under its screen rect
+fn is_occluded(center : vec3f, extent : vec3f) -> bool
+{
+    var uv_min = vec2f(1.0);
+    var uv_max = vec2f(0.0);
+    var nearest_depth = 0.0;
+
+    for (var i = 0u; i < 8u; i++) {
+        let corner_sign = vec3f(f32(i & 1u), f32((i >> 1u) & 1u), f32((i >> 2u) & 1u)) * 2.0 - 1.0;
+        let clip = cull_data.occlusion_view_projection * vec4f(center + extent * corner_sign, 1.0);
+
+        // Crossing the near plane, can not be tested
+        if (clip.w <= 0.0) {
+            return false;
+        }
+
+        let ndc = clip.xyz / clip.w;
+        let uv = vec2f(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+
+        uv_min = min(uv_min, uv);
+        uv_max = max(uv_max, uv);
+        nearest_depth = max(nearest_depth, ndc.z);
+    }
+
+    let size = vec2u(cull_data.hiz_size);
+    let pixel_min = min(vec2u(clamp(uv_min, vec2f(0.0), vec2f(1.0)) * cull_data.hiz_size), size - 1u);
+    let pixel_max = min(vec2u(clamp(uv_max, vec2f(0.0), vec2f(1.0)) * cull_data.hiz_size), size - 1u);
+
+    // Level where the rect spans at most 2x2 texels
+    let rect_size = max(pixel_max.x - pixel_min.x, pixel_max.y - pixel_min.y);
+    let level = min(select(0u, firstLeadingBit(rect_size) + 1u, rect_size > 0u), cull_data.hiz_mip_count - 1u);
+
+    let level_last_texel = vec2u(textureDimensions(hiz_texture, level)) - 1u;
+    let texel_min = min(pixel_min >> vec2u(level), level_last_texel);
+    let texel_max = min(pixel_max >> vec2u(level), level_last_texel);
+
+    var farthest_depth = 1.0;
+
+    for (var y = texel_min.y; y <= texel_max.y; y++) {
+        for (var x = texel_min.x; x <= texel_max.x; x++) {
+            farthest_depth = min(farthest_depth, textureLoad(hiz_texture, vec2u(x, y), level).r);
+        }
+    }
+
+    return nearest_depth < farthest_depth;
+}
+
+// Last draw of the dispatch whose first work item is not past the given one
+fn find_draw(work_index : u32) -> u32
+{
+    var low = cull_data.first_draw;
+    var high = cull_data.first_draw + cull_data.draw_count - 1u;
+
+    while (low < high) {
+        let middle = (low + high + 1u) / 2u;
+
+        if (draws[middle].first_work <= work_index) {
+            low = middle;
+        } else {
+            high = middle - 1u;
+        }
+    }
+
+    return low;
+}
+
+fn is_meshlet_visible(draw : MeshletDraw, meshlet : Meshlet) -> bool
+{
+    let axis_x = draw.model[0].xyz;
+    let axis_y = draw.model[1].xyz;
+    let axis_z = draw.model[2].xyz;
+
+    let scale_squared = vec3f(dot(axis_x, axis_x), dot(axis_y, axis_y), dot(axis_z, axis_z));
+    let max_scale = sqrt(max(scale_squared.x, max(scale_squared.y, scale_squared.z)));
+    let min_scale = sqrt(min(scale_squared.x, min(scale_squared.y, scale_squared.z)));
+
+    let center = (draw.model * vec4f(meshlet.center, 1.0)).xyz;
+    let radius = meshlet.radius * max_scale;
+
+    for (var i = 0u; i < 6u; i++) {
+        let plane = cull_data.planes[i];
+
+        if (dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    // Non uniform scales bend the normals, the cone would not be conservative
+    if (cull_data.cone_culling_enabled == 1u && meshlet.cone_cutoff < 1.0 && max_scale - min_scale <= max_scale * 0.01) {
+        let cone_axis = normalize((draw.model * vec4f(meshlet.cone_axis, 0.0)).xyz);
+        let view = center - cull_data.eye;
+
+        if (dot(view, cone_axis) >= meshlet.cone_cutoff * length(view) + radius) {
+            return false;
+        }
+    }
+
+    if (cull_data.occlusion_enabled == 1u && is_occluded(center, vec3f(radius))) {
+        return false;
+    }
+
+    return true;
+}
+
+// One workgroup per meshlet: the first invocation culls it and reserves its range, then the whole
+// workgroup copies the indices to the compacted buffer of the draw
+@compute @workgroup_size(WORKGROUP_SIZE, 1, 1)
+fn compute(@builtin(local_invocation_index) local_index : u32, @builtin(workgroup_id) group_id : vec3<u32>, @builtin(num_workgroups) w_dim : vec3<u32>)
+{
+    let local_work_index = group_id.x + group_id.y * w_dim.x;
+
+    if (local_index == 0u) {
+        copy_count = 0u;
+
+        if (local_work_index < cull_data.work_count) {
+            let work_index = cull_data.first_work + local_work_index;
+            let draw_index = find_draw(work_index);
+            let draw = draws[draw_index];
+            let meshlet = meshlets[draw.first_meshlet + work_index - draw.first_work - cull_data.meshlet_base];
+
+            if (is_meshlet_visible(draw, meshlet)) {
+                let offset = atomicAdd(&draw_args[draw_index * DRAW_ARGS_STRIDE], meshlet.index_count);
+
+                copy_source = meshlet.first_index - cull_data.index_base;
+                copy_destination = draw.output_first_index + offset - cull_data.output_base;
+                copy_count = meshlet.index_count;
+            }
+        }
+    }
+
+    let count = workgroupUniformLoad(&copy_count);
+
+    for (var i = local_index; i < count; i += WORKGROUP_SIZE) {
+        out_indices[copy_destination + i] = indices[copy_source + i];
+    }
+}
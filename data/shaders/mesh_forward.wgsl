@@ -12,7 +12,7 @@
 @group(2) @binding(0) var albedo_texture: texture_2d<f32>;
 #endif
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> material_params : MaterialParams;
 
 #ifdef USE_SAMPLER
 @group(2) @binding(7) var sampler_2d : sampler;
@@ -23,10 +23,6 @@
 
 #endif // USE_SAMPLER
 
-#ifdef ALPHA_MASK
-@group(2) @binding(9) var<uniform> alpha_cutoff: f32;
-#endif
-
 #ifdef USE_SKINNING
 @group(2) @binding(10) var<storage, read> animated_matrices: array<mat4x4f>;
 @group(2) @binding(11) var<storage, read> inv_bind_matrices: array<mat4x4f>;
@@ -38,25 +34,19 @@
 @group(2) @binding(2) var metallic_roughness_texture: texture_2d<f32>;
 #endif
 
-@group(2) @binding(3) var<uniform> occlusion_roughness_metallic: vec3f;
-
 #ifdef NORMAL_TEXTURE
 @group(2) @binding(4) var normal_texture: texture_2d<f32>;
-@group(2) @binding(5) var<uniform> normal_scale: f32;
 #endif
 
 #ifdef EMISSIVE_TEXTURE
 @group(2) @binding(6) var emissive_texture: texture_2d<f32>;
 #endif
 
-@group(2) @binding(8) var<uniform> emissive: vec3f;
-
 #ifdef OCLUSSION_TEXTURE
 @group(2) @binding(13) var oclussion_texture: texture_2d<f32>;
 #endif
 
 #ifdef CLEARCOAT_MATERIAL
-@group(2) @binding(14) var<uniform> clearcoat_data: vec2f;
 
 #ifdef CLEARCOAT_TEXTURE
 @group(2) @binding(15) var clearcoat_texture: texture_2d<f32>;
@@ -73,7 +63,6 @@
 #endif // CLEARCOAT_MATERIAL
 
 #ifdef IRIDESCENCE_MATERIAL
-@group(2) @binding(18) var<uniform> iridescence_data: vec4f;
 
 #ifdef IRIDESCENCE_TEXTURE
 @group(2) @binding(19) var iridescence_texture: texture_2d<f32>;
@@ -86,7 +75,6 @@
 #endif // IRIDESCENCE_MATERIAL
 
 #ifdef ANISOTROPY_MATERIAL
-@group(2) @binding(21) var<uniform> anisotropy_data: vec3f;
 
 #ifdef ANISOTROPY_TEXTURE
 @group(2) @binding(22) var anisotropy_texture: texture_2d<f32>;
@@ -102,15 +90,14 @@
 #include pbr_iridescence.wgsl
 #endif
 
-#define MAX_LIGHTS
-
 @group(3) @binding(0) var irradiance_texture: texture_cube<f32>;
 @group(3) @binding(1) var brdf_lut_texture: texture_2d<f32>;
 @group(3) @binding(2) var sampler_clamp: sampler;
-@group(3) @binding(3) var<uniform> lights : array<Light, MAX_LIGHTS>;
-@group(3) @binding(4) var<uniform> num_lights : u32;
+@group(3) @binding(3) var<storage, read> lights : array<Light>;
+@group(3) @binding(4) var<uniform> light_cluster_data : LightClusterData;
 // @group(3) @binding(5) var lights_shadow_maps: texture_depth_2d_array;
 // @group(3) @binding(6) var shadow_sampler: sampler_comparison;
+@group(3) @binding(7) var<storage, read> cluster_lights : array<u32>;
 
 #endif // UNLIT_MATERIAL
 
@@ -120,13 +107,13 @@
 fn vs_main(in: VertexInput) -> VertexOutput {
 
     var position = vec4f(in.position, 1.0);
-    var normals = vec4f(in.normal, 0.0);
+    var normals = vec4f(get_vertex_normal(in), 0.0);
 
 #ifdef USE_SKINNING
-    var skin : mat4x4f = (animated_matrices[u32(in.joints.x)] * inv_bind_matrices[u32(in.joints.x)]) * in.weights.x;
-    skin += (animated_matrices[u32(in.joints.y)] * inv_bind_matrices[u32(in.joints.y)]) * in.weights.y;
-    skin += (animated_matrices[u32(in.joints.z)] * inv_bind_matrices[u32(in.joints.z)]) * in.weights.z;
-    skin += (animated_matrices[u32(in.joints.w)] * inv_bind_matrices[u32(in.joints.w)]) * in.weights.w;
+    var skin : mat4x4f = (animated_matrices[in.joints.x] * inv_bind_matrices[in.joints.x]) * in.weights.x;
+    skin += (animated_matrices[in.joints.y] * inv_bind_matrices[in.joints.y]) * in.weights.y;
+    skin += (animated_matrices[in.joints.z] * inv_bind_matrices[in.joints.z]) * in.weights.z;
+    skin += (animated_matrices[in.joints.w] * inv_bind_matrices[in.joints.w]) * in.weights.w;
     position = skin * position;
     normals = skin * normals;
 #endif
@@ -138,16 +125,16 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.world_position = world_position.xyz;
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
-    out.color = vec4f(in.color, 1.0) * albedo;
+    out.color = vec4f(in.color, 1.0) * material_params.color;
 
     // incorrect with scaling/non-uniform scaling
     //out.normal = normalize((instance_data.model * normals).xyz);
     out.normal = normalize(adjoint(instance_data.model) * normals.xyz);
 
 #ifdef HAS_TANGENTS
-    let tangent : vec3f = normalize(in.tangent.xyz);
-    out.tangent = normalize((instance_data.model * vec4f(tangent, 0.0)).xyz);
-    out.bitangent = normalize(cross(out.normal, out.tangent) * in.tangent.w);
+    let vertex_tangent : vec4f = get_vertex_tangent(in);
+    out.tangent = normalize((instance_data.model * vec4f(vertex_tangent.xyz, 0.0)).xyz);
+    out.bitangent = normalize(cross(out.normal, out.tangent) * vertex_tangent.w);
 
 #ifdef HAS_NORMAL_UV_TRANSFORM
     out.tangent = normalize((uv_transform_data[NORMAL_UV_TRANSFORM] * vec4f(out.tangent, 0.0)).xyz);
@@ -183,7 +170,7 @@ fn fs_main(in: VertexOutput, @builtin(front_facing) is_front_facing: bool) -> Fr
 #endif // ALBEDO_TEXTURE
 
 #ifdef ALPHA_MASK
-    if (alpha < alpha_cutoff) {
+    if (alpha < material_params.alpha_cutoff) {
         discard;
     }
 #endif
@@ -205,24 +192,24 @@ fn fs_main(in: VertexOutput, @builtin(front_facing) is_front_facing: bool) -> Fr
 #ifdef METALLIC_ROUGHNESS_TEXTURE
     let metallic_roughness_uv : vec2f = get_metallic_roughness_uv(in.uv);
     var metal_rough : vec3f = textureSample(metallic_roughness_texture, sampler_2d, metallic_roughness_uv).rgb;
-    m.roughness = metal_rough.g * occlusion_roughness_metallic.g;
-    m.metallic = metal_rough.b * occlusion_roughness_metallic.b;
+    m.roughness = metal_rough.g * material_params.occlusion_roughness_metallic.g;
+    m.metallic = metal_rough.b * material_params.occlusion_roughness_metallic.b;
 #else
-    m.roughness = occlusion_roughness_metallic.g;
-    m.metallic = occlusion_roughness_metallic.b;
+    m.roughness = material_params.occlusion_roughness_metallic.g;
+    m.metallic = material_params.occlusion_roughness_metallic.b;
 #endif
 
 #ifdef EMISSIVE_TEXTURE
     let emissive_uv : vec2f = get_emissive_uv(in.uv);
-    m.emissive = textureSample(emissive_texture, sampler_2d, emissive_uv).rgb * emissive;
+    m.emissive = textureSample(emissive_texture, sampler_2d, emissive_uv).rgb * material_params.emissive;
 #else
-    m.emissive = emissive;
+    m.emissive = material_params.emissive;
 #endif
 
 #ifdef OCLUSSION_TEXTURE
     let occlusion_uv : vec2f = get_occlusion_uv(in.uv);
     m.ao = textureSample(oclussion_texture, sampler_2d, occlusion_uv).r;
-    m.ao = m.ao * occlusion_roughness_metallic.r;
+    m.ao = m.ao * material_params.occlusion_roughness_metallic.r;
 #else
     m.ao = 1.0;
 #endif // OCLUSSION_TEXTURE
@@ -4,7 +4,7 @@
 
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 const MAJOR_GRID_DIVISIONS : f32 = 10.0;
 
@@ -18,7 +18,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.world_position = world_position.xyz;
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
 
     let div : f32 = max(2.0, round(MAJOR_GRID_DIVISIONS));
 
@@ -2,14 +2,35 @@
 struct VertexInput {
     @builtin(instance_index) instance_id : u32,
     @location(0) position: vec3f,
-#unique vertex @location(1) uv: vec2f,
-#unique vertex @location(2) normal: vec3f,
-#unique vertex @location(3) tangent: vec4f,
-#unique vertex @location(4) color: vec3f,
-#unique vertex @location(5) weights: vec4f,
-#unique vertex @location(6) joints: vec4i
+#unique vertex:float16x2 @location(1) uv: vec2f,
+#unique vertex:snorm16x2 @location(2) normal: vec2f,
+#unique vertex:snorm8x4 @location(3) tangent: vec4f,
+#unique vertex:unorm8x4 @location(4) color: vec3f,
+#unique vertex:unorm8x4 @location(5) weights: vec4f,
+#unique vertex:uint16x4 @location(6) joints: vec4u
 };
 
+// Normals and tangents are stored octahedral encoded (see sInterleavedData in surface.h)
+fn decode_octahedral(e : vec2f) -> vec3f
+{
+    var n : vec3f = vec3f(e, 1.0 - abs(e.x) - abs(e.y));
+    let t : f32 = max(-n.z, 0.0);
+    n.x += select(t, -t, n.x >= 0.0);
+    n.y += select(t, -t, n.y >= 0.0);
+    return normalize(n);
+}
+
+fn get_vertex_normal(in : VertexInput) -> vec3f
+{
+    return decode_octahedral(in.normal);
+}
+
+// Handedness is stored in z
+fn get_vertex_tangent(in : VertexInput) -> vec4f
+{
+    return vec4f(decode_octahedral(in.tangent.xy), select(-1.0, 1.0, in.tangent.z >= 0.0));
+}
+
 struct VertexOutput {
     @builtin(position) position: vec4f,
     @location(0) uv: vec2f,
@@ -38,4 +59,19 @@ struct CameraData {
     ibl_intensity : f32,
     screen_size : vec2f,
     dummy : vec2f,
-};
\ No newline at end of file
+};
+
+// One slot per material in a shared buffer, bound with a dynamic offset. Color goes first
+// so shaders that only need it can bind it as a plain vec4f
+struct MaterialParams {
+    color : vec4f,
+    emissive : vec3f,
+    normal_scale : f32,
+    occlusion_roughness_metallic : vec3f,
+    alpha_cutoff : f32,
+    iridescence : vec4f,    // factor, ior, thickness min, thickness max
+    anisotropy : vec3f,     // cos(rotation), sin(rotation), factor
+    pad0 : f32,
+    clearcoat : vec2f,      // factor, roughness
+    pad1 : vec2f
+};
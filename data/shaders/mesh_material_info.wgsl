@@ -43,7 +43,7 @@ fn get_normal_info( m : ptr<function, PbrMaterial>, in : VertexOutput, is_front_
 #ifdef NORMAL_TEXTURE
     let normal_uv : vec2f = get_normal_uv(in.uv);
     var normal_color = textureSample(normal_texture, sampler_2d, normal_uv).rgb * 2.0 - 1.0;
-    normal_color *= vec3f(normal_scale, normal_scale, 1.0);
+    normal_color *= vec3f(material_params.normal_scale, material_params.normal_scale, 1.0);
 
 #ifdef HAS_TANGENTS
     let TBN : mat3x3f = mat3x3f(in.tangent, in.bitangent, m.normal_g);
@@ -122,8 +122,8 @@ fn get_clearcoat_normal_uv( in_uv: vec2f ) -> vec2f {
 
 fn get_clearcoat_info( m : ptr<function, PbrMaterial>, in : VertexOutput )
 {
-    m.clearcoat_factor = clearcoat_data.x;
-    m.clearcoat_roughness = clearcoat_data.y;
+    m.clearcoat_factor = material_params.clearcoat.x;
+    m.clearcoat_roughness = material_params.clearcoat.y;
     m.clearcoat_f0 = vec3f(pow((m.ior - 1.0) / (m.ior + 1.0), 2.0));
     m.clearcoat_f90 = vec3f(1.0);
 
@@ -182,9 +182,9 @@ fn get_iridescence_thickness_uv( in_uv: vec2f ) -> vec2f {
 
 fn get_iridescence_info( m : ptr<function, PbrMaterial>, in : VertexOutput )
 {
-    m.iridescence_factor = iridescence_data.x;
-    m.iridescence_ior = iridescence_data.y;
-    m.iridescence_thickness = iridescence_data.w;
+    m.iridescence_factor = material_params.iridescence.x;
+    m.iridescence_ior = material_params.iridescence.y;
+    m.iridescence_thickness = material_params.iridescence.w;
 
 #ifdef IRIDESCENCE_TEXTURE
     let iridescence_uv : vec2f = get_iridescence_uv(in.uv);
@@ -194,7 +194,7 @@ fn get_iridescence_info( m : ptr<function, PbrMaterial>, in : VertexOutput )
 #ifdef IRIDESCENCE_THICKNESS_TEXTURE
     let iridescence_thickness_uv : vec2f = get_iridescence_thickness_uv(in.uv);
     let thickness_sampled : f32 = textureSample(iridescence_thickness_texture, sampler_2d, iridescence_thickness_uv).g;
-    m.iridescence_thickness = mix(iridescence_data.z, iridescence_data.w, thickness_sampled);
+    m.iridescence_thickness = mix(material_params.iridescence.z, material_params.iridescence.w, thickness_sampled);
 #endif
 }
 
@@ -224,13 +224,13 @@ fn get_anisotropy_info( m : ptr<function, PbrMaterial>, in : VertexOutput )
     anisotropy_factor = anisotropy_sample.z;
 #endif
 
-    let direction_rotation : vec2f = anisotropy_data.xy; // cos(theta), sin(theta)
+    let direction_rotation : vec2f = material_params.anisotropy.xy; // cos(theta), sin(theta)
     let rotation_matrix : mat2x2f = mat2x2f(direction_rotation.x, direction_rotation.y, -direction_rotation.y, direction_rotation.x);
     direction = rotation_matrix * direction.xy;
 
     m.anisotropy_tangent = mat3x3f(in.tangent, in.bitangent, m.normal) * normalize(vec3f(direction, 0.0));
     m.anisotropy_bitangent = cross(m.normal_g, m.anisotropy_tangent);
-    m.anisotropy_factor = clamp(anisotropy_data.z * anisotropy_factor, 0.0, 1.0);
+    m.anisotropy_factor = clamp(material_params.anisotropy.z * anisotropy_factor, 0.0, 1.0);
 }
 
 #endif // ANISOTROPY_MATERIAL
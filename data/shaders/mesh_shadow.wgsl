@@ -4,8 +4,8 @@ struct ShadowVertexInput {
     @builtin(instance_index) instance_id : u32,
     @location(0) position: vec3f,
 #ifdef USE_SKINNING
-#unique vertex @location(5) weights: vec4f,
-#unique vertex @location(6) joints: vec4i
+#unique vertex:unorm8x4 @location(5) weights: vec4f,
+#unique vertex:uint16x4 @location(6) joints: vec4u
 #endif
 };
 
@@ -8,7 +8,7 @@
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
 @group(2) @binding(0) var irradiance_texture: texture_cube<f32>;
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 @group(2) @binding(7) var sampler_clamp : sampler;
 
 struct SkyboxVertexOutput {
@@ -6,7 +6,7 @@
 
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 @vertex
 fn vs_main(in: VertexInput) -> VertexOutput {
@@ -16,7 +16,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     var out: VertexOutput;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(in.color, 1.0) * albedo;
-    out.normal = (instance_data.model * vec4f(in.normal, 0.0)).xyz;
+    out.normal = (instance_data.model * vec4f(get_vertex_normal(in), 0.0)).xyz;
 
     var world_position = instance_data.model * vec4f(in.position, 1.0);
     out.world_position = world_position.xyz;
@@ -23,6 +23,41 @@ struct Light
     outer_cone_cos : f32
 };
 
+// View space froxel grid built by kernels/light_cluster.wgsl, must match LightClusterData there
+struct LightClusterData {
+    view : mat4x4f,
+    view_projection : mat4x4f,
+    inverse_projection : mat4x4f,
+    grid_size : vec3u,
+    max_cluster_lights : u32,
+    z_near : f32,
+    z_far : f32,
+    slice_scale : f32,
+    slice_bias : f32,
+    light_count : u32,
+    pad0 : u32,
+    pad1 : u32,
+    pad2 : u32
+};
+
+// Offset in cluster_lights of the cluster containing a world position: its light count, then the indices
+fn get_light_cluster_offset(position : vec3f) -> u32
+{
+    let grid : vec3u = light_cluster_data.grid_size;
+
+    // Projected with the clustering camera, the rendering eye may differ (XR)
+    let clip : vec4f = light_cluster_data.view_projection * vec4f(position, 1.0);
+    let uv : vec2f = clip.xy / max(clip.w, 1e-5) * vec2f(0.5, -0.5) + vec2f(0.5);
+    let tile : vec2u = vec2u(clamp(uv * vec2f(grid.xy), vec2f(0.0), vec2f(grid.xy) - 1.0));
+
+    let view_depth : f32 = max(-(light_cluster_data.view * vec4f(position, 1.0)).z, 1e-5);
+    let slice : u32 = u32(clamp(log(view_depth) * light_cluster_data.slice_scale - light_cluster_data.slice_bias, 0.0, f32(grid.z - 1u)));
+
+    let cluster_index : u32 = tile.x + tile.y * grid.x + slice * grid.x * grid.y;
+
+    return cluster_index * (light_cluster_data.max_cluster_lights + 1u);
+}
+
 // https://github.com/KhronosGroup/glTF/blob/master/extensions/2.0/Khronos/KHR_lights_punctual/README.md#range-property
 fn get_range_attenuation(range : f32, dist : f32) -> f32
 {
@@ -85,10 +120,13 @@ fn get_direct_light( m : ptr<function, PbrMaterial> ) -> vec3f
     var n : vec3f = m.normal;
     var v : vec3f = m.view_dir;
 
-    let num_lights_clamped : u32 = clamp(num_lights, 0u, MAX_LIGHTS);
+    // Only the lights binned to this fragment cluster
+    let cluster_offset : u32 = get_light_cluster_offset(m.pos);
+    let cluster_light_count : u32 = cluster_lights[cluster_offset];
 
-    for (var light_idx : u32 = 0; light_idx < num_lights_clamped; light_idx++)
+    for (var cluster_light_idx : u32 = 0; cluster_light_idx < cluster_light_count; cluster_light_idx++)
     {
+        let light_idx : u32 = cluster_lights[cluster_offset + 1u + cluster_light_idx];
         var light : Light = lights[light_idx];
 
         var point_to_light : vec3f;
@@ -7,7 +7,7 @@
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
 @group(2) @binding(0) var texture: texture_2d<f32>;
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 @group(2) @binding(7) var texture_sampler : sampler;
 
 @vertex
@@ -21,7 +21,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(in.color, 1.0) * albedo;
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
     return out;
 }
 
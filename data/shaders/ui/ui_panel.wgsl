@@ -11,7 +11,7 @@
 @group(2) @binding(0) var albedo_texture: texture_2d<f32>;
 #endif
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 #ifdef USE_SAMPLER
 @group(2) @binding(7) var texture_sampler : sampler;
@@ -30,7 +30,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(in.color, 1.0) * albedo;
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
     return out;
 }
 
@@ -6,7 +6,7 @@
 
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 @vertex
 fn vs_main(in: VertexInput) -> VertexOutput {
@@ -19,7 +19,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(vec3f(abs(in.position.z)), 1.0) * albedo;
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
     return out;
 }
 
@@ -7,7 +7,7 @@
 
 #dynamic @group(1) @binding(0) var<uniform> camera_data : CameraData;
 
-@group(2) @binding(1) var<uniform> albedo: vec4f;
+#dynamic @group(2) @binding(1) var<uniform> albedo: vec4f;
 
 @group(3) @binding(0) var<uniform> ui_data : UIData;
 
@@ -22,7 +22,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
     out.position = camera_data.view_projection * world_position;
     out.uv = in.uv; // forward to the fragment shader
     out.color = vec4(in.color, 1.0) * albedo;
-    out.normal = in.normal;
+    out.normal = get_vertex_normal(in);
     return out;
 }
 
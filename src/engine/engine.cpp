@@ -5,6 +5,7 @@
 #include "framework/parsers/parse_scene.h"
 #include "framework/parsers/parser.h"
 #include "framework/ui/io.h"
+#include "framework/utils/cpu_profiler.h"
 #include "framework/utils/file_watcher.h"
 #include "framework/utils/tinyfiledialogs.h"
 
@@ -138,6 +139,8 @@ int Engine::initialize(Renderer* renderer, const sEngineConfiguration& configura
     spdlog::set_pattern("[%^%l%$] %v");
     spdlog::set_level(spdlog::level::debug);
 
+    PROFILE_THREAD_NAME("main");
+
     engine_post_initialize = configuration.engine_post_initialize ? configuration.engine_post_initialize : dummy_engine_post_initialize;
     engine_pre_update = configuration.engine_pre_update ? configuration.engine_pre_update : dummy_engine_pre_update;
     engine_post_update = configuration.engine_post_update ? configuration.engine_post_update : dummy_engine_post_update;
@@ -506,8 +509,20 @@ void Engine::get_scene_ray(glm::vec3& ray_origin, glm::vec3& ray_direction)
     }
 }
 
+MeshInstance3D* Engine::ray_cast_scene(float* distance)
+{
+    glm::vec3 ray_origin;
+    glm::vec3 ray_direction;
+
+    get_scene_ray(ray_origin, ray_direction);
+
+    return renderer->ray_cast_instances(ray_origin, ray_direction, distance);
+}
+
 void Engine::on_frame()
 {
+    PROFILE_FRAME();
+
     renderer->process_events();
 
     // Update stuff
@@ -557,6 +572,8 @@ void Engine::on_frame()
 
 void Engine::update(float delta_time)
 {
+    PROFILE_ZONE("Engine::update");
+
     engine_pre_update(delta_time);
 
 #ifndef NDEBUG
@@ -577,6 +594,8 @@ void Engine::update(float delta_time)
 
 void Engine::render()
 {
+    PROFILE_ZONE("Engine::render");
+
     engine_render();
 
 #ifdef __EMSCRIPTEN__
@@ -753,6 +772,25 @@ void Engine::render_default_gui()
                 Renderer::instance->set_frustum_camera_paused(pause_frustum_culling_camera);
             }
 
+            bool gpu_culling_enabled = Renderer::instance->get_gpu_culling_enabled();
+
+            if (ImGui::Checkbox("GPU frustum culling", &gpu_culling_enabled)) {
+                Renderer::instance->set_gpu_culling_enabled(gpu_culling_enabled);
+            }
+
+            bool software_occlusion_enabled = Renderer::instance->get_software_occlusion_enabled();
+
+            if (ImGui::Checkbox("Software occlusion culling", &software_occlusion_enabled)) {
+                Renderer::instance->set_software_occlusion_enabled(software_occlusion_enabled);
+            }
+
+            int occlusion_culling_mode = Renderer::instance->get_occlusion_culling_mode();
+
+            // GPU occlusion is done in the GPU culling pass
+            if (ImGui::Combo("Occlusion culling", &occlusion_culling_mode, "Disabled\0GPU Hi-Z\0CPU Hi-Z readback\0")) {
+                Renderer::instance->set_occlusion_culling_mode(static_cast<eOcclusionCullingMode>(occlusion_culling_mode));
+            }
+
             ImGui::EndTabItem();
         }
         ImGui::EndTabBar();
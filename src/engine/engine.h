@@ -8,6 +8,7 @@ class FileWatcher;
 class Renderer;
 class Scene;
 class Node;
+class MeshInstance3D;
 class Engine;
 
 class Engine {
@@ -74,6 +75,9 @@ public:
     float get_delta_time() { return delta_time; }
     void get_scene_ray(glm::vec3& ray_origin, glm::vec3& ray_direction);
 
+    // Closest mesh instance hit by the scene ray, uses the renderer instances hierarchy
+    MeshInstance3D* ray_cast_scene(float* distance = nullptr);
+
     void set_main_scene(Scene* scene);
     virtual void set_main_scene(const std::string& scene_path);
 
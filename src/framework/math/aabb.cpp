@@ -33,38 +33,11 @@ bool AABB::initialized() const
 
 AABB AABB::transform(const glm::mat4& mat) const
 {
-    float av, bv;
-    int   i, j;
-
-    glm::vec3 translation = mat[3];
-
-    glm::vec3 out_aabb_min = { translation.x, translation.y, translation.z };
-    glm::vec3 out_aabb_max = { translation.x, translation.y, translation.z };
-
-    glm::vec3 in_aabb_min = center - half_size;
-    glm::vec3 in_aabb_max = center + half_size;
-
-    for (i = 0; i < 3; i++)
-    {
-        for (j = 0; j < 3; j++)
-        {
-            av = mat[j][i] * in_aabb_min[j];
-            bv = mat[j][i] * in_aabb_max[j];
-
-            if (av < bv) {
-                out_aabb_min[i] += av;
-                out_aabb_max[i] += bv;
-            }
-            else
-            {
-                out_aabb_min[i] += bv;
-                out_aabb_max[i] += av;
-            }
-        }
-    }
+    // Center/extent form: the new half size is the original one projected on the absolute rotation-scale axes
+    glm::vec3 extent = glm::abs(half_size);
 
-    glm::vec3 aabb_half_size = (out_aabb_max - out_aabb_min) * 0.5f;
-    glm::vec3 aabb_center = out_aabb_min + aabb_half_size;
+    glm::vec3 aabb_center = glm::vec3(mat[3]) + glm::vec3(mat[0]) * center.x + glm::vec3(mat[1]) * center.y + glm::vec3(mat[2]) * center.z;
+    glm::vec3 aabb_half_size = glm::abs(glm::vec3(mat[0])) * extent.x + glm::abs(glm::vec3(mat[1])) * extent.y + glm::abs(glm::vec3(mat[2])) * extent.z;
 
     return { aabb_center, aabb_half_size };
 }
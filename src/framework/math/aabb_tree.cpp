@@ -0,0 +1,310 @@
+#include "aabb_tree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "glm/vector_relational.hpp"
+
+AABBTree::AABBTree(float margin) : margin(margin)
+{
+
+}
+
+int32_t AABBTree::allocate_node()
+{
+    if (free_list == NULL_NODE) {
+        nodes.emplace_back();
+        return static_cast<int32_t>(nodes.size() - 1);
+    }
+
+    int32_t node = free_list;
+    free_list = nodes[node].parent;
+    nodes[node] = {};
+
+    return node;
+}
+
+void AABBTree::free_node(int32_t node)
+{
+    nodes[node].parent = free_list;
+    nodes[node].height = -1;
+    free_list = node;
+}
+
+float AABBTree::surface_area(const glm::vec3& min, const glm::vec3& max)
+{
+    const glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+int32_t AABBTree::insert(const AABB& aabb, uint32_t user_data)
+{
+    int32_t leaf = allocate_node();
+
+    sNode& node = nodes[leaf];
+    node.min = aabb.center - aabb.half_size - glm::vec3(margin);
+    node.max = aabb.center + aabb.half_size + glm::vec3(margin);
+    node.user_data = user_data;
+    node.height = 0;
+
+    insert_leaf(leaf);
+
+    leaf_count++;
+
+    return leaf;
+}
+
+void AABBTree::remove(int32_t leaf)
+{
+    assert(leaf >= 0 && leaf < static_cast<int32_t>(nodes.size()) && nodes[leaf].is_leaf());
+
+    remove_leaf(leaf);
+    free_node(leaf);
+
+    leaf_count--;
+}
+
+bool AABBTree::move(int32_t leaf, const AABB& aabb)
+{
+    assert(leaf >= 0 && leaf < static_cast<int32_t>(nodes.size()) && nodes[leaf].is_leaf());
+
+    const glm::vec3 min = aabb.center - aabb.half_size;
+    const glm::vec3 max = aabb.center + aabb.half_size;
+
+    sNode& node = nodes[leaf];
+
+    // Still contained in the fat box
+    if (glm::all(glm::lessThanEqual(node.min, min)) && glm::all(glm::greaterThanEqual(node.max, max))) {
+        return false;
+    }
+
+    remove_leaf(leaf);
+
+    nodes[leaf].min = min - glm::vec3(margin);
+    nodes[leaf].max = max + glm::vec3(margin);
+
+    insert_leaf(leaf);
+
+    reinserts_since_rebuild++;
+
+    return true;
+}
+
+void AABBTree::insert_leaf(int32_t leaf)
+{
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    const glm::vec3 leaf_min = nodes[leaf].min;
+    const glm::vec3 leaf_max = nodes[leaf].max;
+
+    // Descend choosing the child with the lowest surface area increase
+    int32_t index = root;
+
+    while (!nodes[index].is_leaf()) {
+        const sNode& node = nodes[index];
+
+        float area = surface_area(node.min, node.max);
+        float combined_area = surface_area(glm::min(node.min, leaf_min), glm::max(node.max, leaf_max));
+
+        // Cost of creating a new parent here and the increase pushed to the children
+        float cost = 2.0f * combined_area;
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto child_cost = [&](int32_t child) {
+            const sNode& child_node = nodes[child];
+            float new_area = surface_area(glm::min(child_node.min, leaf_min), glm::max(child_node.max, leaf_max));
+
+            if (child_node.is_leaf()) {
+                return new_area + inheritance_cost;
+            }
+
+            return (new_area - surface_area(child_node.min, child_node.max)) + inheritance_cost;
+        };
+
+        float cost_1 = child_cost(node.child_1);
+        float cost_2 = child_cost(node.child_2);
+
+        if (cost < cost_1 && cost < cost_2) {
+            break;
+        }
+
+        index = cost_1 < cost_2 ? node.child_1 : node.child_2;
+    }
+
+    int32_t sibling = index;
+
+    // Create a new parent for the sibling and the leaf
+    int32_t old_parent = nodes[sibling].parent;
+    int32_t new_parent = allocate_node();
+
+    sNode& parent_node = nodes[new_parent];
+    parent_node.parent = old_parent;
+    parent_node.min = glm::min(nodes[sibling].min, leaf_min);
+    parent_node.max = glm::max(nodes[sibling].max, leaf_max);
+    parent_node.height = nodes[sibling].height + 1;
+    parent_node.child_1 = sibling;
+    parent_node.child_2 = leaf;
+
+    if (old_parent != NULL_NODE) {
+        if (nodes[old_parent].child_1 == sibling) {
+            nodes[old_parent].child_1 = new_parent;
+        } else {
+            nodes[old_parent].child_2 = new_parent;
+        }
+    } else {
+        root = new_parent;
+    }
+
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    refit_ancestors(old_parent);
+}
+
+void AABBTree::remove_leaf(int32_t leaf)
+{
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    int32_t parent = nodes[leaf].parent;
+    int32_t grand_parent = nodes[parent].parent;
+    int32_t sibling = nodes[parent].child_1 == leaf ? nodes[parent].child_2 : nodes[parent].child_1;
+
+    // The sibling takes the place of the parent
+    if (grand_parent != NULL_NODE) {
+        if (nodes[grand_parent].child_1 == parent) {
+            nodes[grand_parent].child_1 = sibling;
+        } else {
+            nodes[grand_parent].child_2 = sibling;
+        }
+
+        nodes[sibling].parent = grand_parent;
+        free_node(parent);
+
+        refit_ancestors(grand_parent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        free_node(parent);
+    }
+
+    nodes[leaf].parent = NULL_NODE;
+}
+
+void AABBTree::refit_ancestors(int32_t node)
+{
+    while (node != NULL_NODE) {
+        sNode& current = nodes[node];
+        const sNode& child_1 = nodes[current.child_1];
+        const sNode& child_2 = nodes[current.child_2];
+
+        current.min = glm::min(child_1.min, child_2.min);
+        current.max = glm::max(child_1.max, child_2.max);
+        current.height = 1 + std::max(child_1.height, child_2.height);
+
+        node = current.parent;
+    }
+}
+
+bool AABBTree::needs_rebuild() const
+{
+    if (leaf_count < 2) {
+        return false;
+    }
+
+    // A balanced tree has about log2(n) levels
+    uint32_t balanced_height = static_cast<uint32_t>(std::ceil(std::log2(static_cast<float>(leaf_count))));
+
+    return get_height() > balanced_height * 2 + 4 || reinserts_since_rebuild > leaf_count;
+}
+
+void AABBTree::rebuild()
+{
+    reinserts_since_rebuild = 0;
+
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    // Keep the leaves (their ids are referenced from outside), release the internal nodes
+    std::vector<int32_t> leaves;
+    leaves.reserve(leaf_count);
+
+    for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i) {
+        sNode& node = nodes[i];
+
+        if (node.height < 0) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            node.parent = NULL_NODE;
+            leaves.push_back(i);
+        } else {
+            free_node(i);
+        }
+    }
+
+    root = build_top_down(leaves.data(), static_cast<uint32_t>(leaves.size()));
+    nodes[root].parent = NULL_NODE;
+}
+
+int32_t AABBTree::build_top_down(int32_t* leaves, uint32_t count)
+{
+    if (count == 1) {
+        return leaves[0];
+    }
+
+    // Split at the median of the longest axis of the leaf centers
+    glm::vec3 centers_min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 centers_max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const glm::vec3 center = (nodes[leaves[i]].min + nodes[leaves[i]].max) * 0.5f;
+        centers_min = glm::min(centers_min, center);
+        centers_max = glm::max(centers_max, center);
+    }
+
+    const glm::vec3 size = centers_max - centers_min;
+    int axis = (size.x > size.y) ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+    uint32_t half = count / 2;
+
+    std::nth_element(leaves, leaves + half, leaves + count, [&](int32_t lhs, int32_t rhs) {
+        return (nodes[lhs].min[axis] + nodes[lhs].max[axis]) < (nodes[rhs].min[axis] + nodes[rhs].max[axis]);
+    });
+
+    int32_t child_1 = build_top_down(leaves, half);
+    int32_t child_2 = build_top_down(leaves + half, count - half);
+
+    int32_t parent = allocate_node();
+
+    sNode& parent_node = nodes[parent];
+    parent_node.child_1 = child_1;
+    parent_node.child_2 = child_2;
+    parent_node.min = glm::min(nodes[child_1].min, nodes[child_2].min);
+    parent_node.max = glm::max(nodes[child_1].max, nodes[child_2].max);
+    parent_node.height = 1 + std::max(nodes[child_1].height, nodes[child_2].height);
+
+    nodes[child_1].parent = parent;
+    nodes[child_2].parent = parent;
+
+    return parent;
+}
+
+void AABBTree::clear()
+{
+    nodes.clear();
+    root = NULL_NODE;
+    free_list = NULL_NODE;
+    leaf_count = 0;
+    reinserts_since_rebuild = 0;
+}
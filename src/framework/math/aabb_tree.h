@@ -0,0 +1,218 @@
+#pragma once
+
+#include "framework/math/aabb.h"
+#include "framework/math/frustum_cull.h"
+
+#include "glm/common.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Dynamic bounding volume hierarchy. Leaves store enlarged ("fat") boxes so small
+// movements don't touch the tree, and a full rebuild can be requested when the tree degrades.
+// Leaf ids are stable until removed, even across rebuilds.
+class AABBTree {
+
+public:
+
+    static constexpr int32_t NULL_NODE = -1;
+
+    AABBTree(float margin = 0.1f);
+
+    int32_t insert(const AABB& aabb, uint32_t user_data);
+    void remove(int32_t leaf);
+
+    // Returns true if the leaf had to be reinserted
+    bool move(int32_t leaf, const AABB& aabb);
+
+    // Top-down rebuild of all the internal nodes
+    void rebuild();
+
+    // True if the tree got too deep or too many leaves were reinserted since the last rebuild
+    bool needs_rebuild() const;
+
+    void clear();
+
+    uint32_t get_user_data(int32_t leaf) const { return nodes[leaf].user_data; }
+    uint32_t get_leaf_count() const { return leaf_count; }
+    uint32_t get_height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+    // Calls callback(user_data, fully_inside) for leaves whose box touches the frustum.
+    // When fully_inside is true the caller can skip its own visibility test
+    template<typename Callback>
+    void query_frustum(const Frustum& frustum, Callback&& callback) const;
+
+    // Calls callback(user_data) for leaves overlapping the box
+    template<typename Callback>
+    void query_aabb(const AABB& aabb, Callback&& callback) const;
+
+    // Calls callback(user_data, max_distance) for leaves hit by the ray before max_distance.
+    // The callback may shorten max_distance to find the closest hit
+    template<typename Callback>
+    void query_ray(const glm::vec3& ray_origin, const glm::vec3& ray_direction, float max_distance, Callback&& callback) const;
+
+private:
+
+    struct sNode {
+        glm::vec3 min = {};
+        glm::vec3 max = {};
+
+        // Next free node when not in use
+        int32_t parent = NULL_NODE;
+        int32_t child_1 = NULL_NODE;
+        int32_t child_2 = NULL_NODE;
+
+        // Leaf = 0, free node = -1
+        int32_t height = -1;
+
+        uint32_t user_data = 0;
+
+        bool is_leaf() const { return child_1 == NULL_NODE; }
+    };
+
+    int32_t allocate_node();
+    void free_node(int32_t node);
+
+    void insert_leaf(int32_t leaf);
+    void remove_leaf(int32_t leaf);
+    void refit_ancestors(int32_t node);
+
+    int32_t build_top_down(int32_t* leaves, uint32_t count);
+
+    static float surface_area(const glm::vec3& min, const glm::vec3& max);
+
+    std::vector<sNode> nodes;
+    int32_t root = NULL_NODE;
+    int32_t free_list = NULL_NODE;
+
+    uint32_t leaf_count = 0;
+    uint32_t reinserts_since_rebuild = 0;
+
+    float margin = 0.1f;
+
+    // Traversal stack reused between queries
+    mutable std::vector<int32_t> stack;
+};
+
+template<typename Callback>
+void AABBTree::query_frustum(const Frustum& frustum, Callback&& callback) const
+{
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    // Sign bit marks subtrees already known to be inside
+    constexpr uint32_t INSIDE_BIT = 0x80000000u;
+
+    stack.clear();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        uint32_t entry = static_cast<uint32_t>(stack.back());
+        stack.pop_back();
+
+        const sNode& node = nodes[entry & ~INSIDE_BIT];
+        bool inside = entry & INSIDE_BIT;
+
+        if (!inside) {
+            const glm::vec3 extent = (node.max - node.min) * 0.5f;
+            eFrustumTestResult result = frustum.classify_box(node.min + extent, extent);
+
+            if (result == FRUSTUM_OUTSIDE) {
+                continue;
+            }
+
+            inside = result == FRUSTUM_INSIDE;
+        }
+
+        if (node.is_leaf()) {
+            callback(node.user_data, inside);
+            continue;
+        }
+
+        uint32_t flag = inside ? INSIDE_BIT : 0u;
+        stack.push_back(static_cast<int32_t>(node.child_1 | flag));
+        stack.push_back(static_cast<int32_t>(node.child_2 | flag));
+    }
+}
+
+template<typename Callback>
+void AABBTree::query_aabb(const AABB& aabb, Callback&& callback) const
+{
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    const glm::vec3 query_min = aabb.center - aabb.half_size;
+    const glm::vec3 query_max = aabb.center + aabb.half_size;
+
+    stack.clear();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        const sNode& node = nodes[stack.back()];
+        stack.pop_back();
+
+        if (node.min.x > query_max.x || node.max.x < query_min.x ||
+            node.min.y > query_max.y || node.max.y < query_min.y ||
+            node.min.z > query_max.z || node.max.z < query_min.z) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            callback(node.user_data);
+        } else {
+            stack.push_back(node.child_1);
+            stack.push_back(node.child_2);
+        }
+    }
+}
+
+template<typename Callback>
+void AABBTree::query_ray(const glm::vec3& ray_origin, const glm::vec3& ray_direction, float max_distance, Callback&& callback) const
+{
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    const glm::vec3 inv_ray_dir = 1.0f / ray_direction;
+
+    stack.clear();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        const sNode& node = nodes[stack.back()];
+        stack.pop_back();
+
+        // Slabs method. Axes parallel to the ray only check that the origin is inside the slab, the
+        // division would give 0 * inf = NaN when the origin lies on one of its planes
+        float t_enter = -std::numeric_limits<float>::max();
+        float t_exit = std::numeric_limits<float>::max();
+        bool outside_slab = false;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (ray_direction[axis] == 0.0f) {
+                outside_slab |= ray_origin[axis] < node.min[axis] || ray_origin[axis] > node.max[axis];
+                continue;
+            }
+
+            const float t1 = (node.min[axis] - ray_origin[axis]) * inv_ray_dir[axis];
+            const float t2 = (node.max[axis] - ray_origin[axis]) * inv_ray_dir[axis];
+            t_enter = glm::max(t_enter, glm::min(t1, t2));
+            t_exit = glm::min(t_exit, glm::max(t1, t2));
+        }
+
+        if (outside_slab || t_exit < 0.0f || t_enter > t_exit || t_enter > max_distance) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            callback(node.user_data, max_distance);
+        } else {
+            stack.push_back(node.child_1);
+            stack.push_back(node.child_2);
+        }
+    }
+}
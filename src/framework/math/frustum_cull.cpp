@@ -1,5 +1,15 @@
 #include "frustum_cull.h"
 
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULL_SSE
+#endif
+
 inline Frustum::Frustum(const glm::mat4& view_projection)
 {
     set_view_projection(view_projection);
@@ -41,6 +51,14 @@ void Frustum::set_view_projection(const glm::mat4& view_projection)
     m_points[5] = intersection<Left, Top, Far>(crosses);
     m_points[6] = intersection<Right, Bottom, Far>(crosses);
     m_points[7] = intersection<Right, Top, Far>(crosses);
+
+    m_points_min = m_points[0];
+    m_points_max = m_points[0];
+
+    for (int i = 1; i < 8; i++) {
+        m_points_min = glm::min(m_points_min, m_points[i]);
+        m_points_max = glm::max(m_points_max, m_points[i]);
+    }
 }
 
 bool Frustum::is_box_visible(const glm::vec3& minp, const glm::vec3& maxp) const
@@ -73,6 +91,151 @@ bool Frustum::is_box_visible(const glm::vec3& minp, const glm::vec3& maxp) const
 	return true;
 }
 
+bool Frustum::test_box_scalar(const glm::vec3& center, const glm::vec3& extent) const
+{
+    // Equivalent to testing the corner farthest along each plane normal
+    for (int i = 0; i < Count; i++) {
+        const glm::vec3 normal = glm::vec3(m_planes[i]);
+        if (glm::dot(normal, center) + m_planes[i].w + glm::dot(glm::abs(normal), extent) < 0.0f) {
+            return false;
+        }
+    }
+
+    const glm::vec3 minp = center - extent;
+    const glm::vec3 maxp = center + extent;
+
+    if (m_points_min.x > maxp.x || m_points_max.x < minp.x ||
+        m_points_min.y > maxp.y || m_points_max.y < minp.y ||
+        m_points_min.z > maxp.z || m_points_max.z < minp.z) {
+        return false;
+    }
+
+    return true;
+}
+
+eFrustumTestResult Frustum::classify_box(const glm::vec3& center, const glm::vec3& extent) const
+{
+    eFrustumTestResult result = FRUSTUM_INSIDE;
+
+    for (int i = 0; i < Count; i++) {
+        const glm::vec3 normal = glm::vec3(m_planes[i]);
+        float distance = glm::dot(normal, center) + m_planes[i].w;
+        float radius = glm::dot(glm::abs(normal), extent);
+
+        if (distance + radius < 0.0f) {
+            return FRUSTUM_OUTSIDE;
+        }
+
+        if (distance - radius < 0.0f) {
+            result = FRUSTUM_INTERSECTS;
+        }
+    }
+
+    if (result == FRUSTUM_INTERSECTS && !test_box_scalar(center, extent)) {
+        return FRUSTUM_OUTSIDE;
+    }
+
+    return result;
+}
+
+void Frustum::test_boxes(const float* center_x, const float* center_y, const float* center_z,
+                         const float* extent_x, const float* extent_y, const float* extent_z,
+                         uint32_t count, uint32_t* visibility_mask) const
+{
+    memset(visibility_mask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+
+    uint32_t i = 0;
+
+#if defined(FRUSTUM_CULL_AVX)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(center_x + i);
+        const __m256 cy = _mm256_loadu_ps(center_y + i);
+        const __m256 cz = _mm256_loadu_ps(center_z + i);
+        const __m256 ex = _mm256_loadu_ps(extent_x + i);
+        const __m256 ey = _mm256_loadu_ps(extent_y + i);
+        const __m256 ez = _mm256_loadu_ps(extent_z + i);
+
+        __m256 outside = zero;
+
+        for (int p = 0; p < Count; p++) {
+            const __m256 nx = _mm256_set1_ps(m_planes[p].x);
+            const __m256 ny = _mm256_set1_ps(m_planes[p].y);
+            const __m256 nz = _mm256_set1_ps(m_planes[p].z);
+
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_set1_ps(m_planes[p].w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(ny, cy));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(nz, cz));
+
+            __m256 radius = _mm256_mul_ps(_mm256_and_ps(nx, abs_mask), ex);
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_and_ps(ny, abs_mask), ey));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_and_ps(nz, abs_mask), ez));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+        }
+
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_min.x), _mm256_add_ps(cx, ex), _CMP_GT_OQ));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_max.x), _mm256_sub_ps(cx, ex), _CMP_LT_OQ));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_min.y), _mm256_add_ps(cy, ey), _CMP_GT_OQ));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_max.y), _mm256_sub_ps(cy, ey), _CMP_LT_OQ));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_min.z), _mm256_add_ps(cz, ez), _CMP_GT_OQ));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(m_points_max.z), _mm256_sub_ps(cz, ez), _CMP_LT_OQ));
+
+        uint32_t visible = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+        visibility_mask[i / 32] |= visible << (i % 32);
+    }
+#elif defined(FRUSTUM_CULL_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 cx = _mm_loadu_ps(center_x + i);
+        const __m128 cy = _mm_loadu_ps(center_y + i);
+        const __m128 cz = _mm_loadu_ps(center_z + i);
+        const __m128 ex = _mm_loadu_ps(extent_x + i);
+        const __m128 ey = _mm_loadu_ps(extent_y + i);
+        const __m128 ez = _mm_loadu_ps(extent_z + i);
+
+        __m128 outside = zero;
+
+        for (int p = 0; p < Count; p++) {
+            const __m128 nx = _mm_set1_ps(m_planes[p].x);
+            const __m128 ny = _mm_set1_ps(m_planes[p].y);
+            const __m128 nz = _mm_set1_ps(m_planes[p].z);
+
+            __m128 distance = _mm_add_ps(_mm_mul_ps(nx, cx), _mm_set1_ps(m_planes[p].w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(ny, cy));
+            distance = _mm_add_ps(distance, _mm_mul_ps(nz, cz));
+
+            __m128 radius = _mm_mul_ps(_mm_and_ps(nx, abs_mask), ex);
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_and_ps(ny, abs_mask), ey));
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_and_ps(nz, abs_mask), ez));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(m_points_min.x), _mm_add_ps(cx, ex)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(m_points_max.x), _mm_sub_ps(cx, ex)));
+        outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(m_points_min.y), _mm_add_ps(cy, ey)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(m_points_max.y), _mm_sub_ps(cy, ey)));
+        outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(m_points_min.z), _mm_add_ps(cz, ez)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(m_points_max.z), _mm_sub_ps(cz, ez)));
+
+        uint32_t visible = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu;
+        visibility_mask[i / 32] |= visible << (i % 32);
+    }
+#endif
+
+    // Scalar fallback and remaining boxes
+    for (; i < count; i++) {
+        if (test_box_scalar({ center_x[i], center_y[i], center_z[i] }, { extent_x[i], extent_y[i], extent_z[i] })) {
+            visibility_mask[i / 32] |= 1u << (i % 32);
+        }
+    }
+}
+
 template<Frustum::Planes a, Frustum::Planes b, Frustum::Planes c>
 glm::vec3 Frustum::intersection(const glm::vec3* crosses) const
 {
@@ -1,5 +1,15 @@
+#pragma once
+
 #include <glm/matrix.hpp>
 
+#include <cstdint>
+
+enum eFrustumTestResult {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
 // from: https://gist.github.com/podgorskiy/e698d18879588ada9014768e3e82a644
 class Frustum
 {
@@ -14,6 +24,19 @@ public:
 	// http://iquilezles.org/www/articles/frustumcorrect/frustumcorrect.htm
 	bool is_box_visible(const glm::vec3& minp, const glm::vec3& maxp) const;
 
+    // Left, right, bottom, top, near, far (not normalized, pointing inwards)
+    const glm::vec4* get_planes() const { return m_planes; }
+
+    // Box given by center and half extents, also reports if it is fully inside to skip testing its contents
+    eFrustumTestResult classify_box(const glm::vec3& center, const glm::vec3& extent) const;
+
+    // Same test for a batch of boxes stored as structure of arrays (centers and half extents).
+    // Bit i of visibility_mask is set if box i is visible, it must hold (count + 31) / 32 words.
+    // Uses AVX or SSE when available, 8 or 4 boxes per iteration
+    void test_boxes(const float* center_x, const float* center_y, const float* center_z,
+                    const float* extent_x, const float* extent_y, const float* extent_z,
+                    uint32_t count, uint32_t* visibility_mask) const;
+
 private:
 	enum Planes
 	{
@@ -36,6 +59,12 @@ private:
 	template<Planes a, Planes b, Planes c>
 	glm::vec3 intersection(const glm::vec3* crosses) const;
 	
+    bool test_box_scalar(const glm::vec3& center, const glm::vec3& extent) const;
+
     glm::vec4   m_planes[Count] = {};
     glm::vec3   m_points[8] = {};
+
+    // Bounds of the frustum corners, used to discard boxes that fully contain a frustum side
+    glm::vec3   m_points_min = {};
+    glm::vec3   m_points_max = {};
 };
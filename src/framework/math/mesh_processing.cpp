@@ -0,0 +1,900 @@
+#include "mesh_processing.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+sVertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size)
+{
+    sVertexCacheStats stats;
+
+    if (index_count < 3 || vertex_count == 0) {
+        return stats;
+    }
+
+    // A vertex is in the FIFO while less than cache_size misses happened after its own
+    std::vector<uint32_t> miss_timestamps(vertex_count, 0);
+    uint32_t timestamp = cache_size + 1;
+
+    for (uint32_t i = 0; i < index_count; ++i) {
+        uint32_t vertex = indices[i];
+        assert(vertex < vertex_count);
+
+        if (timestamp - miss_timestamps[vertex] > cache_size) {
+            miss_timestamps[vertex] = timestamp++;
+            stats.vertices_transformed++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(index_count / 3);
+    stats.atvr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(vertex_count);
+
+    return stats;
+}
+
+namespace {
+
+    constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+
+    float get_forsyth_vertex_score(int32_t cache_position, uint32_t live_triangles)
+    {
+        // Not used by the remaining triangles
+        if (live_triangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+
+        if (cache_position >= 0) {
+            // The last triangle vertices get a fixed score so the next triangle doesn't just reuse its edge
+            if (cache_position < 3) {
+                score = 0.75f;
+            } else {
+                const float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, 1.5f);
+            }
+        }
+
+        // Boost the vertices with few triangles left, to finish them and avoid holes
+        score += 2.0f / std::sqrt(static_cast<float>(live_triangles));
+
+        return score;
+    }
+
+    // Bit exact comparison of the vertex streams
+    void hash_vertex(const sVertexStream* streams, uint32_t stream_count, uint32_t vertex, uint64_t& hash)
+    {
+        for (uint32_t s = 0; s < stream_count; ++s) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(streams[s].data) + vertex * streams[s].size;
+            for (size_t i = 0; i < streams[s].size; ++i) {
+                hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+            }
+        }
+    }
+
+    bool vertex_equal(const sVertexStream* streams, uint32_t stream_count, uint32_t a, uint32_t b)
+    {
+        for (uint32_t s = 0; s < stream_count; ++s) {
+            const uint8_t* data = static_cast<const uint8_t*>(streams[s].data);
+            if (std::memcmp(data + a * streams[s].size, data + b * streams[s].size, streams[s].size) != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+uint32_t generate_vertex_remap(const sVertexStream* streams, uint32_t stream_count, uint32_t vertex_count, std::vector<uint32_t>& remap)
+{
+    std::unordered_multimap<uint64_t, uint32_t> unique_vertices;
+    unique_vertices.reserve(vertex_count);
+
+    remap.resize(vertex_count);
+    uint32_t unique_count = 0;
+
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hash_vertex(streams, stream_count, i, hash);
+
+        uint32_t welded = UINT32_MAX;
+
+        auto range = unique_vertices.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (vertex_equal(streams, stream_count, it->second, i)) {
+                welded = remap[it->second];
+                break;
+            }
+        }
+
+        if (welded == UINT32_MAX) {
+            welded = unique_count++;
+            unique_vertices.emplace(hash, i);
+        }
+
+        remap[i] = welded;
+    }
+
+    return unique_count;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+    if (triangle_count == 0 || vertex_count == 0) {
+        return;
+    }
+
+    // Triangles of each vertex, the live ones are kept at the start of each list
+    std::vector<uint32_t> live_triangles(vertex_count, 0);
+
+    for (uint32_t index : indices) {
+        live_triangles[index]++;
+    }
+
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill_counts(vertex_count, 0);
+
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = indices[t * 3 + k];
+            adjacency[adjacency_offsets[v] + fill_counts[v]++] = t;
+        }
+    }
+
+    std::vector<int32_t> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        vertex_scores[v] = get_forsyth_vertex_score(-1, live_triangles[v]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+
+    uint32_t best_triangle = 0;
+    float best_score = -1.0f;
+
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+
+        if (triangle_scores[t] > best_score) {
+            best_score = triangle_scores[t];
+            best_triangle = t;
+        }
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> optimized_indices;
+    optimized_indices.reserve(indices.size());
+
+    uint32_t input_cursor = 0;
+
+    for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+
+        // No candidate in the cache, take the next triangle in input order
+        if (best_triangle == UINT32_MAX) {
+            while (emitted[input_cursor]) {
+                input_cursor++;
+            }
+
+            best_triangle = input_cursor;
+        }
+
+        const uint32_t* triangle = &indices[best_triangle * 3];
+
+        emitted[best_triangle] = true;
+        optimized_indices.insert(optimized_indices.end(), triangle, triangle + 3);
+
+        // The triangle is no longer live for its vertices
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = triangle[k];
+            uint32_t* list = &adjacency[adjacency_offsets[v]];
+
+            for (uint32_t i = 0; i < live_triangles[v]; ++i) {
+                if (list[i] == best_triangle) {
+                    std::swap(list[i], list[live_triangles[v] - 1]);
+                    break;
+                }
+            }
+
+            live_triangles[v]--;
+        }
+
+        // The emitted vertices move to the front of the LRU cache
+        new_cache.assign(triangle, triangle + 3);
+
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache.push_back(v);
+            }
+        }
+
+        // Update the scores of the vertices that moved, including the ones pushed out of the cache
+        for (uint32_t i = 0; i < new_cache.size(); ++i) {
+            uint32_t v = new_cache[i];
+
+            cache_positions[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+
+            float score = get_forsyth_vertex_score(cache_positions[v], live_triangles[v]);
+            float delta = score - vertex_scores[v];
+            vertex_scores[v] = score;
+
+            const uint32_t* list = &adjacency[adjacency_offsets[v]];
+            for (uint32_t j = 0; j < live_triangles[v]; ++j) {
+                triangle_scores[list[j]] += delta;
+            }
+        }
+
+        new_cache.resize(std::min<size_t>(new_cache.size(), FORSYTH_CACHE_SIZE));
+        std::swap(cache, new_cache);
+
+        // The best candidate is always adjacent to a cached vertex
+        best_triangle = UINT32_MAX;
+        best_score = -1.0f;
+
+        for (uint32_t v : cache) {
+            const uint32_t* list = &adjacency[adjacency_offsets[v]];
+            for (uint32_t j = 0; j < live_triangles[v]; ++j) {
+                if (triangle_scores[list[j]] > best_score) {
+                    best_score = triangle_scores[list[j]];
+                    best_triangle = list[j];
+                }
+            }
+        }
+    }
+
+    indices = std::move(optimized_indices);
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+    if (triangle_count < 2 || vertex_count == 0) {
+        return;
+    }
+
+    // A new cluster starts at each triangle with its three vertices out of the cache
+    constexpr uint32_t CACHE_SIZE = 16;
+
+    std::vector<uint32_t> miss_timestamps(vertex_count, 0);
+    uint32_t timestamp = CACHE_SIZE + 1;
+
+    std::vector<uint32_t> cluster_starts;
+
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        uint32_t misses = 0;
+
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = indices[t * 3 + k];
+
+            if (timestamp - miss_timestamps[v] > CACHE_SIZE) {
+                miss_timestamps[v] = timestamp++;
+                misses++;
+            }
+        }
+
+        if (t == 0 || misses == 3) {
+            cluster_starts.push_back(t);
+        }
+    }
+
+    const uint32_t cluster_count = static_cast<uint32_t>(cluster_starts.size());
+
+    if (cluster_count < 2) {
+        return;
+    }
+
+    cluster_starts.push_back(triangle_count);
+
+    glm::vec3 mesh_centroid = glm::vec3(0.0f);
+    float mesh_area = 0.0f;
+
+    std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+
+    for (uint32_t c = 0; c < cluster_count; ++c) {
+        float cluster_area = 0.0f;
+
+        for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t) {
+            const glm::vec3& p0 = positions[indices[t * 3]];
+            const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+            const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+
+            // Length is twice the area, both sums are area weighted
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            glm::vec3 centroid = (p0 + p1 + p2) * (1.0f / 3.0f);
+
+            cluster_centroids[c] += centroid * area;
+            cluster_normals[c] += normal;
+            cluster_area += area;
+        }
+
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_area;
+
+        cluster_centroids[c] = cluster_area > 0.0f ? cluster_centroids[c] / cluster_area : positions[indices[cluster_starts[c] * 3]];
+
+        float normal_length = glm::length(cluster_normals[c]);
+        cluster_normals[c] = normal_length > 0.0f ? cluster_normals[c] / normal_length : glm::vec3(0.0f);
+    }
+
+    if (mesh_area <= 0.0f) {
+        return;
+    }
+
+    mesh_centroid /= mesh_area;
+
+    // Clusters facing away from the center occlude the inner ones, draw them first
+    std::vector<float> occlusion_potential(cluster_count);
+    for (uint32_t c = 0; c < cluster_count; ++c) {
+        occlusion_potential[c] = glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c]);
+    }
+
+    std::vector<uint32_t> cluster_order(cluster_count);
+    std::iota(cluster_order.begin(), cluster_order.end(), 0u);
+
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b) {
+        return occlusion_potential[a] > occlusion_potential[b];
+    });
+
+    std::vector<uint32_t> sorted_indices;
+    sorted_indices.reserve(indices.size());
+
+    for (uint32_t c : cluster_order) {
+        sorted_indices.insert(sorted_indices.end(), indices.begin() + cluster_starts[c] * 3, indices.begin() + cluster_starts[c + 1] * 3);
+    }
+
+    indices = std::move(sorted_indices);
+}
+
+uint32_t optimize_vertex_fetch_remap(std::vector<uint32_t>& indices, uint32_t vertex_count, std::vector<uint32_t>& remap)
+{
+    remap.assign(vertex_count, UINT32_MAX);
+
+    uint32_t next_vertex = 0;
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = next_vertex++;
+        }
+
+        index = remap[index];
+    }
+
+    return next_vertex;
+}
+
+namespace {
+
+    // Area weighted sum of plane quadrics, evaluate() is the mean squared distance to the planes
+    struct sQuadric {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        void add_plane(const glm::vec3& normal, float distance, float plane_weight)
+        {
+            const double a = normal.x, b = normal.y, c = normal.z, d = distance, w = plane_weight;
+
+            a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+            a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+            a22 += w * c * c; a23 += w * c * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        void add(const sQuadric& other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+            weight += other.weight;
+        }
+
+        double evaluate(const glm::vec3& p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+
+            double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+                a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+                a22 * z * z + 2.0 * a23 * z +
+                a33;
+
+            return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct sCollapse {
+        uint32_t source;
+        uint32_t target;
+        double error;
+    };
+}
+
+std::vector<uint32_t> simplify_indices(const std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count,
+    uint32_t target_index_count, float target_error, float* result_error)
+{
+    std::vector<uint32_t> result = indices;
+
+    if (result_error) {
+        *result_error = 0.0f;
+    }
+
+    if (result.size() <= target_index_count || result.size() % 3 != 0 || vertex_count == 0) {
+        return result;
+    }
+
+    // Errors are relative to the mesh extent
+    glm::vec3 min_position = positions[result[0]];
+    glm::vec3 max_position = positions[result[0]];
+
+    for (uint32_t index : result) {
+        const glm::vec3& p = positions[index];
+        min_position = { std::min(min_position.x, p.x), std::min(min_position.y, p.y), std::min(min_position.z, p.z) };
+        max_position = { std::max(max_position.x, p.x), std::max(max_position.y, p.y), std::max(max_position.z, p.z) };
+    }
+
+    const glm::vec3 size = max_position - min_position;
+    const float extent = std::max({ size.x, size.y, size.z });
+
+    if (extent <= 0.0f) {
+        return result;
+    }
+
+    const double max_error = static_cast<double>(target_error) * extent * static_cast<double>(target_error) * extent;
+
+    std::vector<sQuadric> quadrics(vertex_count);
+
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& p0 = positions[result[i]];
+        const glm::vec3& p1 = positions[result[i + 1]];
+        const glm::vec3& p2 = positions[result[i + 2]];
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+
+        if (area <= 0.0f) {
+            continue;
+        }
+
+        normal /= area;
+
+        for (uint32_t k = 0; k < 3; ++k) {
+            quadrics[result[i + k]].add_plane(normal, -glm::dot(normal, p0), area);
+        }
+    }
+
+    // Edges used by other than two triangles are borders or seams (split vertices), their vertices don't move
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+
+    auto edge_key = [](uint32_t a, uint32_t b) {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    };
+
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            edges.push_back(edge_key(result[i + k], result[i + (k + 1) % 3]));
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<bool> locked(vertex_count, false);
+
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            j++;
+        }
+
+        if (j - i != 2) {
+            locked[edges[i] >> 32] = true;
+            locked[edges[i] & 0xFFFFFFFFull] = true;
+        }
+
+        i = j;
+    }
+
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+    std::vector<uint32_t> vertex_triangles;
+    std::vector<sCollapse> collapses;
+
+    double current_error = 0.0;
+
+    while (result.size() > target_index_count) {
+
+        // Triangles of each vertex for the flip test
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0u);
+
+        for (uint32_t index : result) {
+            triangle_offsets[index + 1]++;
+        }
+
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            triangle_offsets[v + 1] += triangle_offsets[v];
+        }
+
+        vertex_triangles.resize(result.size());
+        {
+            std::vector<uint32_t> fill = triangle_offsets;
+            for (size_t i = 0; i < result.size(); ++i) {
+                vertex_triangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Cheapest direction of every edge, in a stable order
+        edges.clear();
+
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                edges.push_back(edge_key(result[i + k], result[i + (k + 1) % 3]));
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+
+        for (uint64_t edge : edges) {
+            uint32_t a = static_cast<uint32_t>(edge >> 32);
+            uint32_t b = static_cast<uint32_t>(edge & 0xFFFFFFFFull);
+
+            if (locked[a] && locked[b]) {
+                continue;
+            }
+
+            sQuadric combined = quadrics[a];
+            combined.add(quadrics[b]);
+
+            double error_ab = locked[a] ? DBL_MAX : combined.evaluate(positions[b]);
+            double error_ba = locked[b] ? DBL_MAX : combined.evaluate(positions[a]);
+
+            if (error_ab <= error_ba) {
+                collapses.push_back({ a, b, error_ab });
+            } else {
+                collapses.push_back({ b, a, error_ba });
+            }
+        }
+
+        std::stable_sort(collapses.begin(), collapses.end(), [](const sCollapse& lhs, const sCollapse& rhs) {
+            return lhs.error < rhs.error;
+        });
+
+        // Each collapse removes about two triangles
+        const uint32_t triangles_to_remove = static_cast<uint32_t>((result.size() - target_index_count) / 3);
+        const uint32_t max_collapses = std::max(triangles_to_remove / 2, 1u);
+
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), false);
+
+        uint32_t collapse_count = 0;
+        bool error_limit_reached = false;
+
+        for (const sCollapse& collapse : collapses) {
+            if (collapse_count >= max_collapses) {
+                break;
+            }
+
+            if (collapse.error > max_error) {
+                error_limit_reached = true;
+                break;
+            }
+
+            if (touched[collapse.source] || touched[collapse.target]) {
+                continue;
+            }
+
+            // Moving the source must not flip any of the triangles that survive
+            bool flips = false;
+
+            const glm::vec3& target_position = positions[collapse.target];
+
+            for (uint32_t t = triangle_offsets[collapse.source]; t < triangle_offsets[collapse.source + 1] && !flips; ++t) {
+                const uint32_t* triangle = &result[vertex_triangles[t] * 3];
+
+                if (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target) {
+                    continue;
+                }
+
+                glm::vec3 p[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+                glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                for (uint32_t k = 0; k < 3; ++k) {
+                    if (triangle[k] == collapse.source) {
+                        p[k] = target_position;
+                    }
+                }
+
+                glm::vec3 new_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                flips = glm::dot(normal, new_normal) <= 0.0f;
+            }
+
+            if (flips) {
+                continue;
+            }
+
+            remap[collapse.source] = collapse.target;
+            quadrics[collapse.target].add(quadrics[collapse.source]);
+
+            // The one ring is frozen for this pass, its flip tests would be outdated
+            for (uint32_t t = triangle_offsets[collapse.source]; t < triangle_offsets[collapse.source + 1]; ++t) {
+                const uint32_t* triangle = &result[vertex_triangles[t] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+
+            current_error = std::max(current_error, collapse.error);
+            collapse_count++;
+        }
+
+        if (collapse_count == 0) {
+            break;
+        }
+
+        // Collapsed triangles are dropped
+        size_t write = 0;
+
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t v0 = remap[result[i]];
+            uint32_t v1 = remap[result[i + 1]];
+            uint32_t v2 = remap[result[i + 2]];
+
+            if (v0 != v1 && v1 != v2 && v0 != v2) {
+                result[write++] = v0;
+                result[write++] = v1;
+                result[write++] = v2;
+            }
+        }
+
+        result.resize(write);
+
+        if (error_limit_reached) {
+            break;
+        }
+    }
+
+    if (result_error) {
+        *result_error = static_cast<float>(std::sqrt(current_error)) / extent;
+    }
+
+    return result;
+}
+
+std::vector<sMeshlet> build_meshlets(std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count,
+    uint32_t max_vertices, uint32_t max_triangles)
+{
+    std::vector<sMeshlet> meshlets;
+
+    const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+    if (triangle_count == 0 || vertex_count == 0) {
+        return meshlets;
+    }
+
+    assert(max_vertices >= 3 && max_triangles > 0);
+
+    // Triangles of each vertex
+    std::vector<uint32_t> vertex_triangle_offsets(vertex_count + 1, 0);
+
+    for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+        vertex_triangle_offsets[indices[i] + 1]++;
+    }
+
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        vertex_triangle_offsets[v + 1] += vertex_triangle_offsets[v];
+    }
+
+    std::vector<uint32_t> vertex_triangles(triangle_count * 3);
+    std::vector<uint32_t> live_triangle_counts(vertex_count, 0);
+
+    for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+        uint32_t v = indices[i];
+        vertex_triangles[vertex_triangle_offsets[v] + live_triangle_counts[v]++] = i / 3;
+    }
+
+    std::vector<glm::vec3> triangle_centroids(triangle_count);
+
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        triangle_centroids[t] = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) * (1.0f / 3.0f);
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    // Last meshlet that used each vertex
+    std::vector<uint32_t> vertex_meshlets(vertex_count, UINT32_MAX);
+
+    std::vector<uint32_t> meshlet_vertices;
+    meshlet_vertices.reserve(max_vertices);
+
+    std::vector<uint32_t> sorted_indices;
+    sorted_indices.reserve(triangle_count * 3);
+
+    uint32_t scan_cursor = 0;
+    uint32_t seed = 0;
+
+    while (seed != UINT32_MAX) {
+        const uint32_t meshlet_index = static_cast<uint32_t>(meshlets.size());
+
+        sMeshlet meshlet;
+        meshlet.first_index = static_cast<uint32_t>(sorted_indices.size());
+
+        meshlet_vertices.clear();
+
+        glm::vec3 centroid_sum = glm::vec3(0.0f);
+        uint32_t meshlet_triangle_count = 0;
+
+        uint32_t triangle = seed;
+
+        while (triangle != UINT32_MAX) {
+            emitted[triangle] = true;
+
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[triangle * 3 + k];
+
+                if (vertex_meshlets[v] != meshlet_index) {
+                    vertex_meshlets[v] = meshlet_index;
+                    meshlet_vertices.push_back(v);
+                }
+
+                live_triangle_counts[v]--;
+                sorted_indices.push_back(v);
+            }
+
+            centroid_sum += triangle_centroids[triangle];
+            meshlet_triangle_count++;
+
+            if (meshlet_triangle_count == max_triangles) {
+                break;
+            }
+
+            // Next, the adjacent triangle adding less vertices and then the closest to the center, so the
+            // meshlet grows round. Only vertices with triangles left are visited, that is the boundary
+            const glm::vec3 centroid = centroid_sum / static_cast<float>(meshlet_triangle_count);
+
+            triangle = UINT32_MAX;
+            uint32_t best_new_vertices = 3;
+            float best_distance = FLT_MAX;
+
+            for (uint32_t v : meshlet_vertices) {
+                if (live_triangle_counts[v] == 0) {
+                    continue;
+                }
+
+                for (uint32_t i = vertex_triangle_offsets[v]; i < vertex_triangle_offsets[v + 1]; ++i) {
+                    uint32_t candidate = vertex_triangles[i];
+
+                    if (emitted[candidate]) {
+                        continue;
+                    }
+
+                    uint32_t new_vertices = 0;
+                    for (uint32_t k = 0; k < 3; ++k) {
+                        new_vertices += vertex_meshlets[indices[candidate * 3 + k]] != meshlet_index ? 1 : 0;
+                    }
+
+                    if (meshlet_vertices.size() + new_vertices > max_vertices) {
+                        continue;
+                    }
+
+                    glm::vec3 offset = triangle_centroids[candidate] - centroid;
+                    float distance = glm::dot(offset, offset);
+
+                    if (new_vertices < best_new_vertices || (new_vertices == best_new_vertices && distance < best_distance)) {
+                        triangle = candidate;
+                        best_new_vertices = new_vertices;
+                        best_distance = distance;
+                    }
+                }
+            }
+        }
+
+        meshlet.index_count = meshlet_triangle_count * 3;
+
+        // Bounding sphere around the box of the vertices
+        glm::vec3 min_position = glm::vec3(FLT_MAX);
+        glm::vec3 max_position = glm::vec3(-FLT_MAX);
+
+        for (uint32_t v : meshlet_vertices) {
+            min_position = glm::min(min_position, positions[v]);
+            max_position = glm::max(max_position, positions[v]);
+        }
+
+        meshlet.center = (min_position + max_position) * 0.5f;
+
+        for (uint32_t v : meshlet_vertices) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+        }
+
+        // Normal cone from the unit normals, degenerate triangles face nowhere
+        glm::vec3 normal_sum = glm::vec3(0.0f);
+
+        for (uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i += 3) {
+            glm::vec3 normal = glm::cross(positions[sorted_indices[i + 1]] - positions[sorted_indices[i]], positions[sorted_indices[i + 2]] - positions[sorted_indices[i]]);
+            float normal_length = glm::length(normal);
+
+            if (normal_length > 0.0f) {
+                normal_sum += normal / normal_length;
+            }
+        }
+
+        float axis_length = glm::length(normal_sum);
+
+        if (axis_length > 0.0f) {
+            meshlet.cone_axis = normal_sum / axis_length;
+
+            float min_dot = 1.0f;
+
+            for (uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i += 3) {
+                glm::vec3 normal = glm::cross(positions[sorted_indices[i + 1]] - positions[sorted_indices[i]], positions[sorted_indices[i + 2]] - positions[sorted_indices[i]]);
+                float normal_length = glm::length(normal);
+
+                if (normal_length > 0.0f) {
+                    min_dot = std::min(min_dot, glm::dot(normal / normal_length, meshlet.cone_axis));
+                }
+            }
+
+            // Wider than a half space can not be culled
+            meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+        }
+
+        meshlets.push_back(meshlet);
+
+        // The next meshlet starts next to this one, or at the first triangle left
+        seed = UINT32_MAX;
+
+        for (uint32_t v : meshlet_vertices) {
+            if (live_triangle_counts[v] == 0) {
+                continue;
+            }
+
+            for (uint32_t i = vertex_triangle_offsets[v]; i < vertex_triangle_offsets[v + 1] && seed == UINT32_MAX; ++i) {
+                if (!emitted[vertex_triangles[i]]) {
+                    seed = vertex_triangles[i];
+                }
+            }
+
+            if (seed != UINT32_MAX) {
+                break;
+            }
+        }
+
+        while (seed == UINT32_MAX && scan_cursor < triangle_count) {
+            if (!emitted[scan_cursor]) {
+                seed = scan_cursor;
+            }
+
+            scan_cursor++;
+        }
+    }
+
+    indices = std::move(sorted_indices);
+
+    return meshlets;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index and position algorithms of the mesh optimizer, GPU free. The sSurfaceData passes built on
+// them are in graphics/mesh_optimizer.h
+
+struct sVertexCacheStats {
+    uint32_t vertices_transformed = 0;
+    // Transformed vertices per triangle, 3 is the worst and ~0.5 the best for large regular meshes
+    float acmr = 0.0f;
+    // Transformed vertices per vertex, 1 is the best
+    float atvr = 0.0f;
+};
+
+// Tightly packed per vertex attribute, size bytes per vertex
+struct sVertexStream {
+    const void* data = nullptr;
+    size_t size = 0;
+};
+
+// Vertices equal in every stream (bit exact) are welded to the first one, new indices follow the first
+// occurrences. remap[old_vertex] is the new index, returns the new vertex count
+uint32_t generate_vertex_remap(const sVertexStream* streams, uint32_t stream_count, uint32_t vertex_count, std::vector<uint32_t>& remap);
+
+// Simulates a FIFO post-transform vertex cache over a triangle list
+sVertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = 16);
+
+// Reorders the triangles for post-transform cache hits (Forsyth's linear-speed algorithm)
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count);
+
+// Splits a cache optimized triangle list in clusters where the cache is cold and draws the outward
+// facing clusters first, so they occlude the rest. Splitting only there keeps the cache efficiency
+void optimize_overdraw(std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count);
+
+// Reorders the vertices in first use order for fetch locality, returns the new vertex count.
+// Unreferenced vertices are dropped. remap[old_vertex] is the new index or UINT32_MAX
+uint32_t optimize_vertex_fetch_remap(std::vector<uint32_t>& indices, uint32_t vertex_count, std::vector<uint32_t>& remap);
+
+// Quadric error edge collapse (Garland-Heckbert) onto existing vertices, so every attribute stays valid.
+// Open borders, attribute seams and non manifold edges are locked. Stops at target_index_count or when
+// the next collapse moves the surface further than target_error (relative to the mesh extent), which
+// is returned in result_error. Same input, same output
+std::vector<uint32_t> simplify_indices(const std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count,
+    uint32_t target_index_count, float target_error, float* result_error = nullptr);
+
+// Cluster of adjacent triangles, culled as a whole on the GPU. The layout matches the meshlet
+// buffer of the geometry arena, first_index is relative to the surface indices
+struct sMeshlet {
+    glm::vec3 center = {};
+    float radius = 0.0f;
+    // Normal cone, all the triangles face away from a viewer inside the negative cone
+    glm::vec3 cone_axis = {};
+    // Sine of the cone half angle, 1 when the cone is too wide to ever cull
+    float cone_cutoff = 1.0f;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    uint32_t padding[2] = {};
+};
+
+static constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+static constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Grows spatially compact clusters over the triangle adjacency and reorders the triangle list so each
+// meshlet is a contiguous range of it. Same input, same output
+std::vector<sMeshlet> build_meshlets(std::vector<uint32_t>& indices, const glm::vec3* positions, uint32_t vertex_count,
+    uint32_t max_vertices = MESHLET_MAX_VERTICES, uint32_t max_triangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,332 @@
+#include "software_occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// SOFTWARE_OCCLUSION_NO_SIMD forces the scalar path, the tests build both and compare them
+#if !defined(SOFTWARE_OCCLUSION_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE
+#endif
+
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height)
+{
+    resize(width, height);
+}
+
+void SoftwareOcclusionCuller::resize(uint32_t width, uint32_t height)
+{
+    // Rows are processed in groups of 4 pixels
+    this->width = std::max((width + 3u) & ~3u, 4u);
+    this->height = std::max(height, 1u);
+
+    depth.assign(this->width * this->height, 0.0f);
+}
+
+void SoftwareOcclusionCuller::clear(const glm::mat4x4& view_projection)
+{
+    this->view_projection = view_projection;
+
+    std::fill(depth.begin(), depth.end(), 0.0f);
+
+    occluder_triangles = 0;
+}
+
+void SoftwareOcclusionCuller::rasterize(const glm::vec3* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, const glm::mat4x4& model)
+{
+    const glm::mat4x4 model_view_projection = view_projection * model;
+
+    clip_vertices.resize(vertex_count);
+
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        clip_vertices[i] = model_view_projection * glm::vec4(vertices[i], 1.0f);
+    }
+
+    const uint32_t triangle_vertex_count = indices ? index_count : vertex_count;
+    const uint32_t triangle_count = triangle_vertex_count / 3;
+
+    auto get_index = [&](uint32_t i) { return indices ? indices[i] : i; };
+
+    screen_vertices.resize(vertex_count);
+
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        const glm::vec4& clip = clip_vertices[i];
+
+        // Only used by triangles in front of the near plane
+        if (clip.w > 1e-5f) {
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen_vertices[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height, ndc.z);
+        }
+    }
+
+    // Not clipped, triangles crossing the near plane are skipped (less occlusion, never wrong)
+    auto is_clipped = [&](uint32_t triangle) {
+        return clip_vertices[get_index(triangle * 3)].w <= 1e-5f || clip_vertices[get_index(triangle * 3 + 1)].w <= 1e-5f ||
+            clip_vertices[get_index(triangle * 3 + 2)].w <= 1e-5f;
+    };
+
+    // Edges shared by two triangles lying on both sides of it on screen are inside the occluder silhouette,
+    // they are not shrunk so the inner conservative coverage does not leave gaps along them
+    edges.clear();
+    interior_edges.assign(triangle_count, 0);
+
+    if (indices) {
+        for (uint32_t t = 0; t < triangle_count; ++t) {
+            if (is_clipped(t)) {
+                continue;
+            }
+
+            for (uint32_t e = 0; e < 3; ++e) {
+                const uint32_t a = indices[t * 3 + (e + 1) % 3];
+                const uint32_t b = indices[t * 3 + (e + 2) % 3];
+                edges.push_back({ (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b), t, e });
+            }
+        }
+
+        std::sort(edges.begin(), edges.end(), [](const sEdge& a, const sEdge& b) {
+            return a.key < b.key || (a.key == b.key && a.triangle < b.triangle);
+        });
+
+        for (size_t i = 0; i + 1 < edges.size(); ++i) {
+            const sEdge& first = edges[i];
+            const sEdge& second = edges[i + 1];
+
+            // Non manifold edges are kept as silhouettes
+            if (first.key != second.key || (i + 2 < edges.size() && edges[i + 2].key == first.key) || (i > 0 && edges[i - 1].key == first.key)) {
+                continue;
+            }
+
+            const glm::vec3& a = screen_vertices[first.key >> 32];
+            const glm::vec3& b = screen_vertices[first.key & 0xFFFFFFFF];
+            const glm::vec3& first_opposite = screen_vertices[indices[first.triangle * 3 + first.edge]];
+            const glm::vec3& second_opposite = screen_vertices[indices[second.triangle * 3 + second.edge]];
+
+            const float first_side = (b.x - a.x) * (first_opposite.y - a.y) - (b.y - a.y) * (first_opposite.x - a.x);
+            const float second_side = (b.x - a.x) * (second_opposite.y - a.y) - (b.y - a.y) * (second_opposite.x - a.x);
+
+            if (first_side * second_side < 0.0f) {
+                interior_edges[first.triangle] |= 1 << first.edge;
+                interior_edges[second.triangle] |= 1 << second.edge;
+            }
+        }
+    }
+
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        if (is_clipped(t)) {
+            continue;
+        }
+
+        rasterize_triangle(screen_vertices[get_index(t * 3)], screen_vertices[get_index(t * 3 + 1)], screen_vertices[get_index(t * 3 + 2)], interior_edges[t]);
+    }
+}
+
+void SoftwareOcclusionCuller::rasterize_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t interior_edges)
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+    if (std::abs(area) < 1e-6f) {
+        return;
+    }
+
+    // Both windings are rasterized, occluders may be double sided
+    const glm::vec3& p0 = v0;
+    const glm::vec3& p1 = area > 0.0f ? v1 : v2;
+    const glm::vec3& p2 = area > 0.0f ? v2 : v1;
+
+    // Edge i is the one opposite to vertex i, swapping p1 and p2 swaps edges 1 and 2
+    if (area < 0.0f) {
+        interior_edges = (interior_edges & 1) | ((interior_edges & 2) << 1) | ((interior_edges & 4) >> 1);
+    }
+
+    area = std::abs(area);
+
+    const float min_x = std::min({ p0.x, p1.x, p2.x });
+    const float max_x = std::max({ p0.x, p1.x, p2.x });
+    const float min_y = std::min({ p0.y, p1.y, p2.y });
+    const float max_y = std::max({ p0.y, p1.y, p2.y });
+
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= static_cast<float>(width) || min_y >= static_cast<float>(height)) {
+        return;
+    }
+
+    const int32_t x0 = std::max(static_cast<int32_t>(std::floor(min_x)), 0);
+    const int32_t x1 = std::min(static_cast<int32_t>(std::floor(max_x)), static_cast<int32_t>(width) - 1);
+    const int32_t y0 = std::max(static_cast<int32_t>(std::floor(min_y)), 0);
+    const int32_t y1 = std::min(static_cast<int32_t>(std::floor(max_y)), static_cast<int32_t>(height) - 1);
+
+    // Edge functions e(x, y) = a * x + b * y + c, positive inside. Computed from the edge vertices in a fixed
+    // order and negated, so the two triangles sharing an edge get exactly opposite values at every pixel center
+    auto edge = [](const glm::vec3& a, const glm::vec3& b, float& ea, float& eb, float& ec) {
+        const bool swap = b.x < a.x || (b.x == a.x && b.y < a.y);
+        const glm::vec3& s = swap ? b : a;
+        const glm::vec3& t = swap ? a : b;
+
+        ea = s.y - t.y;
+        eb = t.x - s.x;
+        ec = -(ea * s.x + eb * s.y);
+
+        if (swap) {
+            ea = -ea;
+            eb = -eb;
+            ec = -ec;
+        }
+    };
+
+    float a0, b0, c0, a1, b1, c1, a2, b2, c2;
+    edge(p1, p2, a0, b0, c0);
+    edge(p2, p0, a1, b1, c1);
+    edge(p0, p1, a2, b2, c2);
+
+    // Depth is affine in screen space
+    const float inv_area = 1.0f / area;
+    const float z_dx = (a0 * p0.z + a1 * p1.z + a2 * p2.z) * inv_area;
+    const float z_dy = (b0 * p0.z + b1 * p1.z + b2 * p2.z) * inv_area;
+    float z_c = (c0 * p0.z + c1 * p1.z + c2 * p2.z) * inv_area;
+
+    // Inner conservative: a pixel is covered only if its whole square is inside the silhouette edges, and it gets
+    // the farthest depth of the triangle plane over that square. Tested boxes cover every pixel they touch, so
+    // partially covered pixels at the occluder silhouettes never hide them. Interior edges sample the pixel
+    // centers, the neighbour triangle covers the rest of the square (exact for planar faces, approximate on creases)
+    if (!(interior_edges & 1)) {
+        c0 -= 0.5f * (std::abs(a0) + std::abs(b0));
+    }
+
+    if (!(interior_edges & 2)) {
+        c1 -= 0.5f * (std::abs(a1) + std::abs(b1));
+    }
+
+    if (!(interior_edges & 4)) {
+        c2 -= 0.5f * (std::abs(a2) + std::abs(b2));
+    }
+
+    z_c -= 0.5f * (std::abs(z_dx) + std::abs(z_dy));
+
+    for (int32_t y = y0; y <= y1; ++y) {
+        const float py = static_cast<float>(y) + 0.5f;
+
+        const float row_e0 = b0 * py + c0;
+        const float row_e1 = b1 * py + c1;
+        const float row_e2 = b2 * py + c2;
+        const float row_z = z_dy * py + z_c;
+
+        float* row = &depth[y * width];
+
+#if defined(SOFTWARE_OCCLUSION_SSE)
+        const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+
+        // Start at groups of 4, width is a multiple of 4 so the last group never overflows
+        for (int32_t x = x0 & ~3; x <= x1; x += 4) {
+            const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets);
+
+            const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(row_e0));
+            const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(row_e1));
+            const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(row_e2));
+
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(z_dx), px), _mm_set1_ps(row_z));
+            const __m128 current = _mm_loadu_ps(row + x);
+            const __m128 nearest = _mm_max_ps(current, z);
+
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+#else
+        for (int32_t x = x0; x <= x1; ++x) {
+            const float px = static_cast<float>(x) + 0.5f;
+
+            if (a0 * px + row_e0 < 0.0f || a1 * px + row_e1 < 0.0f || a2 * px + row_e2 < 0.0f) {
+                continue;
+            }
+
+            row[x] = std::max(row[x], z_dx * px + row_z);
+        }
+#endif
+    }
+
+    occluder_triangles++;
+}
+
+bool SoftwareOcclusionCuller::is_visible(const AABB& world_aabb) const
+{
+    if (occluder_triangles == 0) {
+        return true;
+    }
+
+    const glm::vec3 box_min = world_aabb.center - world_aabb.half_size;
+    const glm::vec3 box_max = world_aabb.center + world_aabb.half_size;
+
+    glm::vec2 screen_min = glm::vec2(std::numeric_limits<float>::max());
+    glm::vec2 screen_max = glm::vec2(std::numeric_limits<float>::lowest());
+    float nearest_depth = 0.0f;
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        const glm::vec3 corner = {
+            (i & 1) ? box_max.x : box_min.x,
+            (i & 2) ? box_max.y : box_min.y,
+            (i & 4) ? box_max.z : box_min.z
+        };
+
+        const glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+
+        // Crossing the near plane, can not be rejected
+        if (clip.w <= 1e-5f) {
+            return true;
+        }
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        const glm::vec2 screen = { (ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height };
+
+        screen_min = glm::min(screen_min, screen);
+        screen_max = glm::max(screen_max, screen);
+        nearest_depth = std::max(nearest_depth, ndc.z);
+    }
+
+    // Out of the buffer, the frustum test decides
+    if (screen_max.x < 0.0f || screen_max.y < 0.0f || screen_min.x >= static_cast<float>(width) || screen_min.y >= static_cast<float>(height)) {
+        return true;
+    }
+
+    const int32_t x0 = std::max(static_cast<int32_t>(std::floor(screen_min.x)), 0);
+    const int32_t x1 = std::min(static_cast<int32_t>(std::floor(screen_max.x)), static_cast<int32_t>(width) - 1);
+    const int32_t y0 = std::max(static_cast<int32_t>(std::floor(screen_min.y)), 0);
+    const int32_t y1 = std::min(static_cast<int32_t>(std::floor(screen_max.y)), static_cast<int32_t>(height) - 1);
+
+    // Visible as soon as a pixel under the rect has no occluder in front of the box
+    for (int32_t y = y0; y <= y1; ++y) {
+        const float* row = &depth[y * width];
+
+#if defined(SOFTWARE_OCCLUSION_SSE)
+        const __m128 box_depth = _mm_set1_ps(nearest_depth);
+        const __m128i lane_index = _mm_setr_epi32(0, 1, 2, 3);
+
+        for (int32_t x = x0 & ~3; x <= x1; x += 4) {
+            const __m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), lane_index);
+
+            // Lanes inside [x0, x1]
+            const __m128 in_rect = _mm_castsi128_ps(_mm_andnot_si128(
+                _mm_or_si128(_mm_cmplt_epi32(lanes, _mm_set1_epi32(x0)), _mm_cmpgt_epi32(lanes, _mm_set1_epi32(x1))),
+                _mm_set1_epi32(-1)));
+
+            const __m128 not_occluded = _mm_cmple_ps(_mm_loadu_ps(row + x), box_depth);
+
+            if (_mm_movemask_ps(_mm_and_ps(not_occluded, in_rect)) != 0) {
+                return true;
+            }
+        }
+#else
+        for (int32_t x = x0; x <= x1; ++x) {
+            if (row[x] <= nearest_depth) {
+                return true;
+            }
+        }
+#endif
+    }
+
+    return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "framework/math/aabb.h"
+
+#include <glm/matrix.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Low resolution depth buffer filled on the CPU with a few large occluders, used to reject
+// boxes hidden behind them before they reach the render lists. Reverse-Z: 0 is far, 1 is near.
+// Rasterization and tests process 4 pixels at a time with SSE when available
+class SoftwareOcclusionCuller {
+
+public:
+
+    SoftwareOcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+
+    void resize(uint32_t width, uint32_t height);
+
+    // Starts a new frame, all the occluders and tests use this view projection
+    void clear(const glm::mat4x4& view_projection);
+
+    // Triangle list, indices can be null to use the vertices in order
+    void rasterize(const glm::vec3* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, const glm::mat4x4& model);
+
+    // Thread safe once all the occluders are rasterized
+    bool is_visible(const AABB& world_aabb) const;
+
+    bool has_occluders() const { return occluder_triangles > 0; }
+
+    uint32_t get_width() const { return width; }
+    uint32_t get_height() const { return height; }
+    const float* get_depth() const { return depth.data(); }
+
+private:
+
+    // Bit i set when the edge opposite to vertex i is inside the occluder silhouette
+    void rasterize_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t interior_edges);
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    glm::mat4x4 view_projection = glm::mat4x4(1.0f);
+
+    std::vector<float> depth;
+
+    // Clip and screen space vertices of the occluder being rasterized
+    std::vector<glm::vec4> clip_vertices;
+    std::vector<glm::vec3> screen_vertices;
+
+    // Edges of the occluder being rasterized, sorted to find the ones shared by two triangles
+    struct sEdge {
+        uint64_t key;
+        uint32_t triangle;
+        uint32_t edge;
+    };
+
+    std::vector<sEdge> edges;
+    std::vector<uint8_t> interior_edges;
+
+    uint32_t occluder_triangles = 0;
+};
@@ -5,6 +5,7 @@
 #include "framework/input.h"
 #include "framework/nodes/node_factory.h"
 #include "framework/nodes/skeleton_instance_3d.h"
+#include "framework/utils/cpu_profiler.h"
 
 #include "spdlog/spdlog.h"
 
@@ -163,6 +164,8 @@ void AnimationPlayer::stop(bool keep_state)
 
 void AnimationPlayer::update(float delta_time)
 {
+    PROFILE_ZONE("AnimationPlayer::update");
+
     Animation* current_animation = blender.get_current_animation();
     if (current_animation == nullptr) {
         return;
@@ -1,5 +1,6 @@
 #include "gs_node.h"
 
+#include "graphics/debug/gpu_profiler.h"
 #include "graphics/renderer.h"
 #include "graphics/renderer_storage.h"
 
@@ -117,21 +118,42 @@ void GSNode::render()
     webgpu_context->update_buffer(std::get<WGPUBuffer>(model_uniform.data), 0, &get_global_model()[0], sizeof(glm::mat4x4));
 
     WGPUCommandEncoder command_encoder = Renderer::instance->get_global_command_encoder();
+    GPUProfiler* gpu_profiler = Renderer::instance->get_gpu_profiler();
 
-    WGPUComputePassDescriptor compute_pass_desc = {};
-    compute_pass_desc.timestampWrites = nullptr;
+    gpu_profiler->begin_scope("gaussian_splatting");
 
-    WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
+    // The sort has its own pass so it is timed apart
+    {
+        WGPUPassTimestampWrites timestamp_writes;
+        WGPUComputePassDescriptor compute_pass_desc = { .label = { "gs_basis_pass", WGPU_STRLEN } };
+        compute_pass_desc.timestampWrites = gpu_profiler->get_pass_timestamp_writes("gs_basis", timestamp_writes);
+
+        WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
+
+        if (!covariance_calculated) {
+            calculate_covariance(compute_pass);
+        }
 
-    if (!covariance_calculated) {
-        calculate_covariance(compute_pass);
+        calculate_basis(compute_pass);
+
+        wgpuComputePassEncoderEnd(compute_pass);
+        wgpuComputePassEncoderRelease(compute_pass);
     }
 
-    calculate_basis(compute_pass);
-    sort(compute_pass);
+    {
+        WGPUPassTimestampWrites timestamp_writes;
+        WGPUComputePassDescriptor compute_pass_desc = { .label = { "gs_radix_sort_pass", WGPU_STRLEN } };
+        compute_pass_desc.timestampWrites = gpu_profiler->get_pass_timestamp_writes("gs_radix_sort", timestamp_writes);
+
+        WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
+
+        sort(compute_pass);
+
+        wgpuComputePassEncoderEnd(compute_pass);
+        wgpuComputePassEncoderRelease(compute_pass);
+    }
 
-    wgpuComputePassEncoderEnd(compute_pass);
-    wgpuComputePassEncoderRelease(compute_pass);
+    gpu_profiler->end_scope();
 
     Renderer::instance->add_splat_scene(this);
 }
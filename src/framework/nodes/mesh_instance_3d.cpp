@@ -14,7 +14,9 @@ MeshInstance3D::MeshInstance3D() : Node3D()
 
 MeshInstance3D::~MeshInstance3D()
 {
-
+    if (Renderer::instance) {
+        Renderer::instance->remove_render_proxy(render_proxy_id);
+    }
 }
 
 void MeshInstance3D::set_aabb(const AABB& new_aabb)
@@ -37,7 +39,11 @@ void MeshInstance3D::update_aabb()
 void MeshInstance3D::render()
 {
     if (mesh) {
-        Renderer::instance->add_renderable(mesh, get_global_transform().get_model());
+        if (render_proxy_id == Renderer::INVALID_RENDER_PROXY) {
+            render_proxy_id = Renderer::instance->register_render_proxy(mesh, this);
+        }
+
+        Renderer::instance->submit_render_proxy(render_proxy_id, get_global_transform().get_model());
     }
 
     Node3D::render();
@@ -68,6 +74,11 @@ void MeshInstance3D::set_receive_shadows(bool new_receive_shadows)
 
 void MeshInstance3D::set_mesh(Mesh* new_mesh)
 {
+    if (render_proxy_id != Renderer::INVALID_RENDER_PROXY) {
+        Renderer::instance->remove_render_proxy(render_proxy_id);
+        render_proxy_id = Renderer::INVALID_RENDER_PROXY;
+    }
+
     mesh = new_mesh;
     mesh->set_node_ref(this);
 }
@@ -2,12 +2,16 @@
 
 #include "node_3d.h"
 #include "graphics/mesh.h"
+#include "graphics/renderer.h"
 
 class MeshInstance3D : public Node3D {
 
 protected:
     Mesh* mesh = nullptr;
 
+    // Retained render state in the Renderer, created on first render
+    uint32_t render_proxy_id = Renderer::INVALID_RENDER_PROXY;
+
 public:
 
     bool is_skinned = false;
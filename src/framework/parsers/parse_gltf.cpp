@@ -31,6 +31,7 @@
 #include "graphics/texture.h"
 #include "graphics/shader.h"
 #include "graphics/renderer_storage.h"
+#include "graphics/mesh_optimizer.h"
 
 #include "engine/scene.h"
 
@@ -230,7 +231,7 @@ void read_texture_uv_transform_ext(Material* material, const tinygltf::Value& ex
     custom_defines.push_back("HAS_" + texture_name + "_UV_TRANSFORM");
 }
 
-void read_mesh(const tinygltf::Model& model, const tinygltf::Node& node, Node3D* entity, std::map<uint32_t, Texture*>& texture_cache, std::map<size_t, Surface*>& mesh_cache, bool fill_surface_data, bool async_load)
+void read_mesh(const tinygltf::Model& model, const tinygltf::Node& node, Node3D* entity, std::map<uint32_t, Texture*>& texture_cache, std::map<size_t, Surface*>& mesh_cache, bool fill_surface_data, sMeshOptimizationStats* optimization_stats, bool generate_lods, bool generate_meshlets, bool async_load)
 {
     const tinygltf::Mesh& mesh = model.meshes[node.mesh];
     uint32_t joints_count = 0;
@@ -601,6 +602,11 @@ void read_mesh(const tinygltf::Model& model, const tinygltf::Node& node, Node3D*
             tangents_generated = surface->generate_tangents(&vertices);
         }
 
+        // Null when the optimization is disabled
+        if (optimization_stats && primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+            optimization_stats->merge(optimize_surface_data(vertices));
+        }
+
         std::vector<std::string> custom_defines;
 
         if (primitive.material >= 0) {
@@ -950,6 +956,10 @@ void read_mesh(const tinygltf::Model& model, const tinygltf::Node& node, Node3D*
 
         surface->set_material(material);
 
+        if (generate_meshlets && primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+            surface->generate_meshlets(vertices);
+        }
+
         if (!async_load) {
             surface->create_surface_data(vertices, fill_surface_data);
 
@@ -964,6 +974,12 @@ void read_mesh(const tinygltf::Model& model, const tinygltf::Node& node, Node3D*
         }
 
         surface->set_name("Surface_" + material->get_name());
+
+        // Async surfaces are uploaded with their LODs when the parse finishes
+        if (generate_lods && primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+            surface->generate_lods(vertices, !async_load);
+        }
+
         entity_mesh->add_surface(surface);
     }
 
@@ -1140,7 +1156,7 @@ void process_node_hierarchy(const tinygltf::Model& model, int parent_id, uint32_
 }
 
 void parse_model_nodes(tinygltf::Model& model, int parent_id, uint32_t node_id, Node3D* parent_node, Node3D* entity, std::map<std::string, Node3D*>& loaded_nodes, std::map<std::string, uint32_t>& name_repeats,
-    std::map<uint32_t, Texture*>& texture_cache, std::map<size_t, Surface*>& mesh_cache, std::map<int, int>& hierarchy, std::vector<SkeletonInstance3D*>& skeleton_instances, bool fill_surface_data, bool async_load)
+    std::map<uint32_t, Texture*>& texture_cache, std::map<size_t, Surface*>& mesh_cache, std::map<int, int>& hierarchy, std::vector<SkeletonInstance3D*>& skeleton_instances, bool fill_surface_data, sMeshOptimizationStats* optimization_stats, bool generate_lods, bool generate_meshlets, bool async_load)
 {
     tinygltf::Node& node = model.nodes[node_id];
 
@@ -1164,7 +1180,7 @@ void parse_model_nodes(tinygltf::Model& model, int parent_id, uint32_t node_id,
     }
 
     if (node.mesh >= 0 && node.mesh < model.meshes.size()) {
-        read_mesh(model, node, entity, texture_cache, mesh_cache, fill_surface_data, async_load);
+        read_mesh(model, node, entity, texture_cache, mesh_cache, fill_surface_data, optimization_stats, generate_lods, generate_meshlets, async_load);
         AABB parent_aabb = merge_aabbs(entity->get_aabb(), parent_node->get_aabb());
         parent_node->set_aabb(parent_aabb);
     }
@@ -1180,7 +1196,7 @@ void parse_model_nodes(tinygltf::Model& model, int parent_id, uint32_t node_id,
 
         process_node_hierarchy(model, node_id, child_id, entity, child_node, hierarchy);
 
-        parse_model_nodes(model, node_id, child_id, entity, child_node, loaded_nodes, name_repeats, texture_cache, mesh_cache, hierarchy, skeleton_instances, fill_surface_data, async_load);
+        parse_model_nodes(model, node_id, child_id, entity, child_node, loaded_nodes, name_repeats, texture_cache, mesh_cache, hierarchy, skeleton_instances, fill_surface_data, optimization_stats, generate_lods, generate_meshlets, async_load);
     }
 };
 
@@ -1768,6 +1784,12 @@ bool GltfParser::parse_model(tinygltf::Model* model, std::vector<Node*>& entitie
 
     bool fill_surface_data = (flags & PARSE_GLTF_FILL_SURFACE_DATA);
 
+    sMeshOptimizationStats optimization_stats;
+    sMeshOptimizationStats* optimization_stats_ptr = (flags & PARSE_OPTIMIZE_MESHES) ? &optimization_stats : nullptr;
+
+    bool generate_lods = (flags & PARSE_GENERATE_LODS);
+    bool generate_meshlets = (flags & PARSE_GENERATE_MESHLETS);
+
     std::string path_filename = gltf_scene->name;
 
     Node3D* scene_root = root ? root : new Node3D();
@@ -1786,7 +1808,11 @@ bool GltfParser::parse_model(tinygltf::Model* model, std::vector<Node*>& entitie
 
         process_node_hierarchy(*model, -1, node_id, scene_root, entity, hierarchy);
 
-        parse_model_nodes(*model, -1, node_id, scene_root, entity, loaded_nodes, name_repeats, texture_cache, mesh_cache, hierarchy, skeleton_instances, fill_surface_data, async_future.valid());
+        parse_model_nodes(*model, -1, node_id, scene_root, entity, loaded_nodes, name_repeats, texture_cache, mesh_cache, hierarchy, skeleton_instances, fill_surface_data, optimization_stats_ptr, generate_lods, generate_meshlets, async_future.valid());
+    }
+
+    if (optimization_stats_ptr) {
+        optimization_stats.log(path_filename);
     }
 
     if (model->skins.size()) {
@@ -1844,6 +1870,7 @@ void GltfParser::on_async_finished()
         Material* material = mesh.second->get_material();
 
         mesh.second->create_surface_data(surface_data, false);
+        mesh.second->create_lods_surface_data();
 
         if (!surface_data.tangents.empty()) {
             material->set_use_tangents(true);
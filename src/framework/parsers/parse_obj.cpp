@@ -6,6 +6,7 @@
 #include "graphics/texture.h"
 #include "graphics/shader.h"
 #include "graphics/renderer_storage.h"
+#include "graphics/mesh_optimizer.h"
 
 #include "framework/nodes/mesh_instance_3d.h"
 
@@ -15,7 +16,7 @@
 
 #include "spdlog/spdlog.h"
 
-void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool create_aabb)
+void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool create_aabb, bool optimize_meshes)
 {
     if (!entity_mesh) {
         return;
@@ -43,6 +44,8 @@ void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool cr
 
     entity_mesh->set_name(obj_path_fs.stem().string());
 
+    sMeshOptimizationStats optimization_stats;
+
     // Loop over shapes
     for (size_t s = 0; s < shapes.size(); s++) {
 
@@ -132,9 +135,17 @@ void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool cr
             new_surface->set_aabb(aabb);
         }
 
+        if (optimize_meshes) {
+            optimization_stats.merge(optimize_surface_data(vertices));
+        }
+
         new_surface->create_surface_data(vertices);
     }
 
+    if (optimize_meshes) {
+        optimization_stats.log(entity_mesh->get_name());
+    }
+
     AABB entity_aabb;
     for (const Surface* surface : entity_mesh->get_surfaces()) {
         const AABB& surface_aabb = surface->get_aabb();
@@ -145,11 +156,11 @@ void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool cr
     entity_mesh->set_aabb(entity_aabb);
 }
 
-MeshInstance3D* parse_obj(const std::string& obj_path, bool create_aabb)
+MeshInstance3D* parse_obj(const std::string& obj_path, bool create_aabb, bool optimize_meshes)
 {
     MeshInstance3D* new_entity = new MeshInstance3D();
 
-    parse_obj(obj_path, new_entity, create_aabb);
+    parse_obj(obj_path, new_entity, create_aabb, optimize_meshes);
 
     return new_entity;
 }
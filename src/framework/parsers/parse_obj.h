@@ -4,5 +4,6 @@
 
 class MeshInstance3D;
 
-void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool create_aabb = true);
-MeshInstance3D* parse_obj(const std::string& obj_path, bool create_aabb = true);
+// OBJ faces come unwelded, optimize_meshes welds and reorders them (see mesh_optimizer.h)
+void parse_obj(const std::string& obj_path, MeshInstance3D* entity_mesh, bool create_aabb = true, bool optimize_meshes = false);
+MeshInstance3D* parse_obj(const std::string& obj_path, bool create_aabb = true, bool optimize_meshes = false);
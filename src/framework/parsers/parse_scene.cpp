@@ -9,7 +9,7 @@
 
 #include "spdlog/spdlog.h"
 
-bool parse_scene(const char* scene_path, std::vector<Node*>& entities, bool fill_surface_data, Node3D* root)
+bool parse_scene(const char* scene_path, std::vector<Node*>& entities, bool fill_surface_data, Node3D* root, bool optimize_meshes)
 {
     std::string scene_path_str = std::string(scene_path);
     std::string extension = scene_path_str.substr(scene_path_str.find_last_of(".") + 1);
@@ -17,7 +17,7 @@ bool parse_scene(const char* scene_path, std::vector<Node*>& entities, bool fill
     spdlog::info("Parsing scene: {}", scene_path);
 
     if (extension == "obj") {
-        entities.push_back(parse_obj(scene_path));
+        entities.push_back(parse_obj(scene_path, true, optimize_meshes));
         return true;
     }
 
@@ -31,6 +31,9 @@ bool parse_scene(const char* scene_path, std::vector<Node*>& entities, bool fill
         if (fill_surface_data) {
             flags |= PARSE_GLTF_FILL_SURFACE_DATA;
         }
+        if (optimize_meshes) {
+            flags |= PARSE_OPTIMIZE_MESHES;
+        }
     }
     else if (extension == "vdb") {
         spdlog::info("Parsing a VDB file (WIP)");
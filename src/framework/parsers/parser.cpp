@@ -1,5 +1,7 @@
 #include "parser.h"
 
+#include "framework/utils/cpu_profiler.h"
+
 #include <chrono>
 #include <functional>
 
@@ -7,6 +9,8 @@ std::vector<Parser*> Parser::async_parsers;
 
 void Parser::poll_async_parsers()
 {
+    PROFILE_ZONE("Parser::poll_async_parsers");
+
     std::vector<Parser*>::iterator it = async_parsers.begin();
     while (it != async_parsers.end())
     {
@@ -12,6 +12,9 @@ enum eParseFlags {
      PARSE_NO_FLAGS = 0,
      PARSE_GLTF_CLEAR_CACHE = 1 << 0,
      PARSE_GLTF_FILL_SURFACE_DATA = 1 << 1,
+     PARSE_OPTIMIZE_MESHES = 1 << 2, // weld and reorder triangle meshes for the vertex cache, overdraw and fetch
+     PARSE_GENERATE_LODS = 1 << 3, // simplified triangle mesh levels, picked by projected size when rendering
+     PARSE_GENERATE_MESHLETS = 1 << 4, // triangle meshes split in clusters, culled one by one on the GPU
      PARSE_DEFAULT = PARSE_GLTF_CLEAR_CACHE
 };
 
@@ -0,0 +1,269 @@
+#include "cpu_profiler.h"
+
+#ifdef WGPUENGINE_PROFILING
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+    enum eEventType : uint8_t {
+        EVENT_ZONE,
+        EVENT_COUNTER,
+        EVENT_FRAME
+    };
+
+    struct sEvent {
+        const char* name = nullptr;
+        uint64_t time = 0;
+        // End of a zone or value of a counter
+        int64_t data = 0;
+        eEventType type = EVENT_ZONE;
+    };
+
+    // Only written by its thread. Readers copy a range and drop what the writer may have overwritten meanwhile
+    struct sThreadBuffer {
+        uint32_t thread_index = 0;
+        std::string name;
+        std::atomic<uint64_t> head = 0;
+        sEvent events[CPUProfiler::THREAD_EVENT_CAPACITY];
+
+        void push(const sEvent& event)
+        {
+            uint64_t index = head.load(std::memory_order_relaxed);
+            events[index % CPUProfiler::THREAD_EVENT_CAPACITY] = event;
+            head.store(index + 1, std::memory_order_release);
+        }
+
+        void copy_events(std::vector<sEvent>& output) const
+        {
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = end > CPUProfiler::THREAD_EVENT_CAPACITY ? end - CPUProfiler::THREAD_EVENT_CAPACITY : 0;
+
+            size_t first_output = output.size();
+
+            for (uint64_t i = begin; i < end; ++i) {
+                output.push_back(events[i % CPUProfiler::THREAD_EVENT_CAPACITY]);
+            }
+
+            uint64_t new_head = head.load(std::memory_order_acquire);
+            uint64_t overwritten = new_head > CPUProfiler::THREAD_EVENT_CAPACITY ? new_head - CPUProfiler::THREAD_EVENT_CAPACITY : 0;
+
+            if (overwritten > begin) {
+                uint64_t drop_count = std::min(overwritten, end) - begin;
+                output.erase(output.begin() + first_output, output.begin() + first_output + drop_count);
+            }
+        }
+    };
+
+    struct sProfilerState {
+        std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+        // Registration only, recording does not lock
+        std::mutex mutex;
+        std::vector<std::unique_ptr<sThreadBuffer>> thread_buffers;
+        std::deque<CPUProfiler::sCounter> counters;
+
+        // Main thread only
+        std::string capture_path;
+        uint32_t capture_frames_left = 0;
+        uint64_t capture_begin = 0;
+        bool capture_started = false;
+    };
+
+    sProfilerState& get_state()
+    {
+        static sProfilerState state;
+        return state;
+    }
+
+    sThreadBuffer* get_thread_buffer()
+    {
+        thread_local sThreadBuffer* thread_buffer = nullptr;
+
+        if (!thread_buffer) {
+            sProfilerState& state = get_state();
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            state.thread_buffers.push_back(std::make_unique<sThreadBuffer>());
+            thread_buffer = state.thread_buffers.back().get();
+            thread_buffer->thread_index = static_cast<uint32_t>(state.thread_buffers.size()) - 1;
+            thread_buffer->name = "thread " + std::to_string(thread_buffer->thread_index);
+        }
+
+        return thread_buffer;
+    }
+
+    void write_json_string(std::ofstream& file, const char* value)
+    {
+        file << '"';
+
+        for (const char* c = value; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                file << '\\';
+            }
+            file << *c;
+        }
+
+        file << '"';
+    }
+}
+
+uint64_t CPUProfiler::get_time()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - get_state().start_time).count();
+}
+
+void CPUProfiler::record_zone(const char* name, uint64_t begin, uint64_t end)
+{
+    get_thread_buffer()->push({ name, begin, static_cast<int64_t>(end), EVENT_ZONE });
+}
+
+CPUProfiler::sCounter* CPUProfiler::get_counter(const char* name, bool reset_each_frame)
+{
+    sProfilerState& state = get_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    for (sCounter& counter : state.counters) {
+        if (strcmp(counter.name, name) == 0) {
+            return &counter;
+        }
+    }
+
+    sCounter& counter = state.counters.emplace_back();
+    counter.name = name;
+    counter.reset_each_frame = reset_each_frame;
+
+    return &counter;
+}
+
+void CPUProfiler::set_thread_name(const char* name)
+{
+    sThreadBuffer* thread_buffer = get_thread_buffer();
+
+    sProfilerState& state = get_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    thread_buffer->name = name;
+}
+
+void CPUProfiler::frame_marker()
+{
+    sProfilerState& state = get_state();
+    sThreadBuffer* thread_buffer = get_thread_buffer();
+
+    uint64_t time = get_time();
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        for (sCounter& counter : state.counters) {
+            int64_t value = counter.reset_each_frame ? counter.value.exchange(0, std::memory_order_relaxed) : counter.value.load(std::memory_order_relaxed);
+            thread_buffer->push({ counter.name, time, value, EVENT_COUNTER });
+        }
+    }
+
+    thread_buffer->push({ "frame", time, 0, EVENT_FRAME });
+
+    if (state.capture_frames_left == 0) {
+        return;
+    }
+
+    if (!state.capture_started) {
+        state.capture_started = true;
+        state.capture_begin = time;
+        return;
+    }
+
+    if (--state.capture_frames_left == 0) {
+        state.capture_started = false;
+        write_trace(state.capture_path, state.capture_begin, time);
+    }
+}
+
+void CPUProfiler::capture_frames(uint32_t frame_count, const std::string& path)
+{
+    sProfilerState& state = get_state();
+
+    state.capture_path = path;
+    state.capture_frames_left = std::max(frame_count, 1u);
+    state.capture_started = false;
+}
+
+bool CPUProfiler::export_trace(const std::string& path)
+{
+    return write_trace(path, 0, UINT64_MAX);
+}
+
+bool CPUProfiler::write_trace(const std::string& path, uint64_t begin, uint64_t end)
+{
+    std::ofstream trace_file(path, std::ios::out);
+
+    if (!trace_file.is_open()) {
+        spdlog::error("Could not open CPU trace file {}", path);
+        return false;
+    }
+
+    sProfilerState& state = get_state();
+
+    std::vector<sEvent> events;
+
+    trace_file << "{\"traceEvents\":[\n";
+    trace_file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}}";
+
+    uint32_t event_count = 0;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    for (const std::unique_ptr<sThreadBuffer>& thread_buffer : state.thread_buffers) {
+        events.clear();
+        thread_buffer->copy_events(events);
+
+        trace_file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread_buffer->thread_index << ",\"args\":{\"name\":";
+        write_json_string(trace_file, thread_buffer->name.c_str());
+        trace_file << "}}";
+
+        for (const sEvent& event : events) {
+            if (event.time < begin || event.time > end) {
+                continue;
+            }
+
+            // Microseconds
+            double time = static_cast<double>(event.time) * 1e-3;
+
+            trace_file << ",\n{\"name\":";
+            write_json_string(trace_file, event.name);
+            trace_file << ",\"pid\":0,\"tid\":" << thread_buffer->thread_index << ",\"ts\":" << std::fixed << time;
+
+            switch (event.type) {
+            case EVENT_ZONE:
+                trace_file << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.data - static_cast<int64_t>(event.time)) * 1e-3 << "}";
+                break;
+            case EVENT_COUNTER:
+                trace_file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.data << "}}";
+                break;
+            case EVENT_FRAME:
+                trace_file << ",\"ph\":\"i\",\"s\":\"g\"}";
+                break;
+            }
+
+            event_count++;
+        }
+    }
+
+    trace_file << "\n]}\n";
+
+    spdlog::info("CPU trace with {} events written to {}", event_count, path);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+// CPU instrumentation, only compiled with WGPUENGINE_PROFILING (CMake option WGPUENGINE_ENABLE_PROFILING).
+// Without it every macro is empty and nothing of this file is built
+//
+//  PROFILE_ZONE("name")                  scoped zone, the name must be a string literal
+//  PROFILE_FUNCTION()                    zone named after the enclosing function
+//  PROFILE_COUNTER_ADD("name", amount)   added up during the frame, reset at each frame marker
+//  PROFILE_COUNTER_SET("name", amount)   last value set, kept between frames
+//  PROFILE_FRAME()                       frame marker, once per frame from the main thread
+//  PROFILE_THREAD_NAME("name")           name of the calling thread in the traces
+
+#ifdef WGPUENGINE_PROFILING
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class CPUProfiler {
+
+public:
+
+    // Events kept per thread, the oldest are overwritten
+    static constexpr uint32_t THREAD_EVENT_CAPACITY = 1 << 15;
+
+    struct sCounter {
+        const char* name = nullptr;
+        std::atomic<int64_t> value = 0;
+        bool reset_each_frame = false;
+    };
+
+    // Scoped zone, recorded in the thread buffer when it ends
+    struct sZone {
+        const char* name;
+        uint64_t begin;
+
+        sZone(const char* name) : name(name), begin(get_time()) {}
+        ~sZone() { record_zone(name, begin, get_time()); }
+    };
+
+    // Nanoseconds since the profiler started
+    static uint64_t get_time();
+
+    static void record_zone(const char* name, uint64_t begin, uint64_t end);
+
+    // Registers the counter the first time a name is seen, the pointer stays valid
+    static sCounter* get_counter(const char* name, bool reset_each_frame);
+
+    static void set_thread_name(const char* name);
+
+    // Writes the counters and handles the trace captures, call from the main thread
+    static void frame_marker();
+
+    // Writes a trace of the next frame_count frames once they have ended
+    static void capture_frames(uint32_t frame_count, const std::string& path);
+
+    // Everything still in the thread buffers, in the Chrome trace event format (chrome://tracing, Perfetto)
+    static bool export_trace(const std::string& path);
+
+private:
+
+    static bool write_trace(const std::string& path, uint64_t begin, uint64_t end);
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_ZONE(name) CPUProfiler::sZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+#define PROFILE_COUNTER_ADD(name, amount)                                                                   \
+    do {                                                                                                    \
+        static CPUProfiler::sCounter* profile_counter = CPUProfiler::get_counter(name, true);               \
+        profile_counter->value.fetch_add(static_cast<int64_t>(amount), std::memory_order_relaxed);          \
+    } while (0)
+
+#define PROFILE_COUNTER_SET(name, amount)                                                                   \
+    do {                                                                                                    \
+        static CPUProfiler::sCounter* profile_counter = CPUProfiler::get_counter(name, false);              \
+        profile_counter->value.store(static_cast<int64_t>(amount), std::memory_order_relaxed);              \
+    } while (0)
+
+#define PROFILE_FRAME() CPUProfiler::frame_marker()
+#define PROFILE_THREAD_NAME(name) CPUProfiler::set_thread_name(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_COUNTER_ADD(name, amount) do {} while (0)
+#define PROFILE_COUNTER_SET(name, amount) do {} while (0)
+#define PROFILE_FRAME() do {} while (0)
+#define PROFILE_THREAD_NAME(name) do {} while (0)
+
+#endif
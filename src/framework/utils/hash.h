@@ -2,6 +2,7 @@
 
 #include "graphics/material.h"
 #include "graphics/pipeline.h"
+#include "graphics/uniforms_structs.h"
 
 #include "glm/gtx/hash.hpp"
 
@@ -56,3 +57,102 @@ struct std::hash<RenderPipelineKey>
         return seed;
     }
 };
+
+struct TextureViewKey {
+    WGPUTexture texture;
+    WGPUTextureViewDimension dimension;
+    uint32_t base_mip_level;
+    uint32_t mip_level_count;
+    uint32_t base_array_layer;
+    uint32_t array_layer_count;
+
+    bool operator==(const TextureViewKey& other) const = default;
+};
+
+template <>
+struct std::hash<TextureViewKey>
+{
+    std::size_t operator()(const TextureViewKey& k) const
+    {
+        std::size_t seed = 0;
+        hash_combine(seed, std::hash<const void*>()(k.texture), std::hash<uint32_t>()(static_cast<uint32_t>(k.dimension)),
+            std::hash<uint32_t>()(k.base_mip_level), std::hash<uint32_t>()(k.mip_level_count),
+            std::hash<uint32_t>()(k.base_array_layer), std::hash<uint32_t>()(k.array_layer_count));
+        return seed;
+    }
+};
+
+struct SamplerKey {
+    WGPUAddressMode wrap_u;
+    WGPUAddressMode wrap_v;
+    WGPUAddressMode wrap_w;
+    WGPUFilterMode mag_filter;
+    WGPUFilterMode min_filter;
+    WGPUMipmapFilterMode mipmap_filter;
+    float lod_max_clamp;
+    uint16_t max_anisotropy;
+    WGPUCompareFunction compare_function;
+
+    bool operator==(const SamplerKey& other) const = default;
+};
+
+template <>
+struct std::hash<SamplerKey>
+{
+    std::size_t operator()(const SamplerKey& k) const
+    {
+        std::size_t seed = 0;
+        hash_combine(seed, std::hash<uint32_t>()(static_cast<uint32_t>(k.wrap_u)), std::hash<uint32_t>()(static_cast<uint32_t>(k.wrap_v)),
+            std::hash<uint32_t>()(static_cast<uint32_t>(k.wrap_w)), std::hash<uint32_t>()(static_cast<uint32_t>(k.mag_filter)),
+            std::hash<uint32_t>()(static_cast<uint32_t>(k.min_filter)), std::hash<uint32_t>()(static_cast<uint32_t>(k.mipmap_filter)),
+            std::hash<float>()(k.lod_max_clamp), std::hash<uint16_t>()(k.max_anisotropy),
+            std::hash<uint32_t>()(static_cast<uint32_t>(k.compare_function)));
+        return seed;
+    }
+};
+
+// Every resource of a bind group: the handle of the buffer, view or sampler and the bound range
+struct BindGroupKey {
+    struct sEntry {
+        uint32_t binding;
+        const void* resource;
+        uint64_t offset;
+        uint64_t size;
+
+        bool operator==(const sEntry& other) const = default;
+    };
+
+    WGPUBindGroupLayout layout;
+    std::vector<sEntry> entries;
+
+    bool operator==(const BindGroupKey& other) const = default;
+};
+
+template <>
+struct std::hash<BindGroupKey>
+{
+    std::size_t operator()(const BindGroupKey& k) const
+    {
+        std::size_t seed = std::hash<const void*>()(k.layout);
+
+        for (const BindGroupKey::sEntry& entry : k.entries) {
+            hash_combine(seed, std::hash<uint32_t>()(entry.binding), std::hash<const void*>()(entry.resource),
+                std::hash<uint64_t>()(entry.offset), std::hash<uint64_t>()(entry.size));
+        }
+
+        return seed;
+    }
+};
+
+template <>
+struct std::hash<sMaterialParams>
+{
+    std::size_t operator()(const sMaterialParams& k) const
+    {
+        std::size_t seed = 0;
+        hash_combine(seed, std::hash<glm::vec4>()(k.color), std::hash<glm::vec3>()(k.emissive), std::hash<float>()(k.normal_scale),
+            std::hash<glm::vec3>()(k.occlusion_roughness_metallic), std::hash<float>()(k.alpha_cutoff),
+            std::hash<glm::vec4>()(k.iridescence), std::hash<glm::vec3>()(k.anisotropy), std::hash<glm::vec2>()(k.clearcoat));
+        return seed;
+    }
+};
@@ -0,0 +1,138 @@
+#include "job_system.h"
+
+#include "framework/utils/cpu_profiler.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t worker_count)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    worker_count = 0;
+#else
+    if (worker_count == 0) {
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+#endif
+
+    workers.reserve(worker_count);
+
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&JobSystem::worker_loop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    work_available.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t min_chunk_size, const ChunkJob& chunk_job)
+{
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t thread_count = get_thread_count();
+
+    min_chunk_size = std::max(min_chunk_size, 1u);
+
+    // Not worth waking up the workers
+    if (thread_count == 1 || count <= min_chunk_size) {
+        chunk_job(0, 0, count);
+        return;
+    }
+
+    // A few chunks per thread to balance uneven workloads
+    uint32_t chunk_size = std::max(min_chunk_size, count / (thread_count * 4));
+    uint32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Late workers from the previous dispatch must leave before reusing the shared state
+        work_done.wait(lock, [&] { return active_workers == 0; });
+
+        job = &chunk_job;
+        job_count = count;
+        job_chunk_size = chunk_size;
+        job_chunk_count = chunk_count;
+        next_chunk.store(0, std::memory_order_relaxed);
+        generation++;
+    }
+
+    work_available.notify_all();
+
+    run_chunks(0, &chunk_job, count, chunk_size, chunk_count);
+
+    // Every chunk has been taken, wait for the ones still running in the workers
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [&] { return active_workers == 0; });
+    job = nullptr;
+}
+
+void JobSystem::worker_loop(uint32_t thread_index)
+{
+    PROFILE_THREAD_NAME("job worker");
+
+    uint64_t last_generation = 0;
+
+    while (true) {
+        const ChunkJob* chunk_job;
+        uint32_t count, chunk_size, chunk_count;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [&] { return stopping || generation != last_generation; });
+
+            if (stopping) {
+                return;
+            }
+
+            last_generation = generation;
+            active_workers++;
+
+            chunk_job = job;
+            count = job_count;
+            chunk_size = job_chunk_size;
+            chunk_count = job_chunk_count;
+        }
+
+        if (chunk_job) {
+            run_chunks(thread_index, chunk_job, count, chunk_size, chunk_count);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active_workers--;
+        }
+
+        work_done.notify_all();
+    }
+}
+
+void JobSystem::run_chunks(uint32_t thread_index, const ChunkJob* chunk_job, uint32_t count, uint32_t chunk_size, uint32_t chunk_count)
+{
+    uint32_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+
+    while (chunk < chunk_count) {
+        uint32_t begin = chunk * chunk_size;
+        uint32_t end = std::min(begin + chunk_size, count);
+
+        {
+            PROFILE_ZONE("JobSystem::chunk");
+            (*chunk_job)(thread_index, begin, end);
+        }
+
+        chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+    }
+}
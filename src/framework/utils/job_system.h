@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small pool of persistent worker threads used to split per-frame loops in chunks.
+// The calling thread always takes part in the work, so thread index 0 is the caller.
+// Falls back to serial execution on web builds without pthreads.
+class JobSystem {
+
+public:
+
+    using ChunkJob = std::function<void(uint32_t thread_index, uint32_t begin, uint32_t end)>;
+
+    // worker_count = 0 uses all the available hardware threads
+    JobSystem(uint32_t worker_count = 0);
+    ~JobSystem();
+
+    // Number of different thread indices passed to the jobs
+    uint32_t get_thread_count() const { return static_cast<uint32_t>(workers.size()) + 1u; }
+
+    // Splits [0, count) in chunks of at least min_chunk_size elements and blocks until all are processed.
+    // Only meant to be called from the main thread
+    void parallel_for(uint32_t count, uint32_t min_chunk_size, const ChunkJob& job);
+
+private:
+
+    void worker_loop(uint32_t thread_index);
+    void run_chunks(uint32_t thread_index, const ChunkJob* chunk_job, uint32_t count, uint32_t chunk_size, uint32_t chunk_count);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+
+    // Current dispatch, protected by mutex
+    const ChunkJob* job = nullptr;
+    uint32_t job_count = 0;
+    uint32_t job_chunk_size = 0;
+    uint32_t job_chunk_count = 0;
+    uint64_t generation = 0;
+    uint32_t active_workers = 0;
+    bool stopping = false;
+
+    std::atomic<uint32_t> next_chunk = 0;
+};
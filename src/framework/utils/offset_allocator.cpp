@@ -0,0 +1,133 @@
+#include "offset_allocator.h"
+
+#include <cassert>
+
+OffsetAllocator::OffsetAllocator(uint32_t capacity)
+{
+    grow(capacity);
+}
+
+void OffsetAllocator::grow(uint32_t new_capacity)
+{
+    if (new_capacity <= capacity) {
+        return;
+    }
+
+    uint32_t old_capacity = capacity;
+    capacity = new_capacity;
+
+    // Merged with a free range at the end, if any
+    insert_free_range(old_capacity, new_capacity - old_capacity);
+}
+
+uint32_t OffsetAllocator::allocate(uint32_t size)
+{
+    if (size == 0) {
+        return INVALID_OFFSET;
+    }
+
+    auto best_fit = free_ranges_by_size.lower_bound(size);
+
+    if (best_fit == free_ranges_by_size.end()) {
+        return INVALID_OFFSET;
+    }
+
+    uint32_t offset = best_fit->second;
+    uint32_t range_size = best_fit->first;
+
+    erase_free_range(free_ranges.find(offset));
+
+    // The remainder stays free
+    if (range_size > size) {
+        insert_free_range(offset + size, range_size - size);
+    }
+
+    allocations[offset] = size;
+    used += size;
+
+    return offset;
+}
+
+void OffsetAllocator::release(uint32_t offset)
+{
+    auto it = allocations.find(offset);
+
+    if (it == allocations.end()) {
+        assert(false);
+        return;
+    }
+
+    uint32_t size = it->second;
+
+    allocations.erase(it);
+    used -= size;
+
+    insert_free_range(offset, size);
+}
+
+uint32_t OffsetAllocator::get_allocation_size(uint32_t offset) const
+{
+    auto it = allocations.find(offset);
+    return it != allocations.end() ? it->second : 0;
+}
+
+OffsetAllocator::sStats OffsetAllocator::get_stats() const
+{
+    sStats stats;
+    stats.capacity = capacity;
+    stats.used = used;
+    stats.allocation_count = static_cast<uint32_t>(allocations.size());
+    stats.free_range_count = static_cast<uint32_t>(free_ranges.size());
+    stats.largest_free_range = free_ranges_by_size.empty() ? 0 : free_ranges_by_size.rbegin()->first;
+
+    uint32_t free_space = capacity - used;
+
+    if (free_space > 0) {
+        stats.fragmentation = 1.0f - static_cast<float>(stats.largest_free_range) / static_cast<float>(free_space);
+    }
+
+    return stats;
+}
+
+void OffsetAllocator::insert_free_range(uint32_t offset, uint32_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    auto next = free_ranges.lower_bound(offset);
+
+    // Merge with the range that ends where this one starts
+    if (next != free_ranges.begin()) {
+        auto prev = std::prev(next);
+
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            erase_free_range(prev);
+        }
+    }
+
+    // And with the one starting where it ends
+    if (next != free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        erase_free_range(next);
+    }
+
+    free_ranges[offset] = size;
+    free_ranges_by_size.insert({ size, offset });
+}
+
+void OffsetAllocator::erase_free_range(std::map<uint32_t, uint32_t>::iterator it)
+{
+    auto [first, last] = free_ranges_by_size.equal_range(it->second);
+
+    for (auto size_it = first; size_it != last; ++size_it) {
+        if (size_it->second == it->first) {
+            free_ranges_by_size.erase(size_it);
+            break;
+        }
+    }
+
+    free_ranges.erase(it);
+}
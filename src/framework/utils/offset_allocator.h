@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+// Sub-allocates ranges of [0, capacity), in whatever unit the caller uses (bytes, vertices...).
+// Best fit over the free ranges, released ranges are merged with their free neighbours
+class OffsetAllocator {
+
+public:
+
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+    struct sStats {
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+        uint32_t allocation_count = 0;
+        uint32_t free_range_count = 0;
+        uint32_t largest_free_range = 0;
+
+        // 0 when all the free space is contiguous, close to 1 when it is split in many small ranges
+        float fragmentation = 0.0f;
+    };
+
+    OffsetAllocator(uint32_t capacity = 0);
+
+    // The new space is added after the current capacity, existing offsets stay valid
+    void grow(uint32_t new_capacity);
+
+    // INVALID_OFFSET if no free range is large enough
+    uint32_t allocate(uint32_t size);
+    void release(uint32_t offset);
+
+    uint32_t get_capacity() const { return capacity; }
+    uint32_t get_allocation_size(uint32_t offset) const;
+
+    sStats get_stats() const;
+
+private:
+
+    void insert_free_range(uint32_t offset, uint32_t size);
+    void erase_free_range(std::map<uint32_t, uint32_t>::iterator it);
+
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+
+    // Offset to size, ordered to find the neighbours when merging
+    std::map<uint32_t, uint32_t> free_ranges;
+    // Size to offset, for the best fit search
+    std::multimap<uint32_t, uint32_t> free_ranges_by_size;
+
+    std::unordered_map<uint32_t, uint32_t> allocations;
+};
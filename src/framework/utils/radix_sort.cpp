@@ -0,0 +1,58 @@
+#include "radix_sort.h"
+
+#include <cstring>
+#include <utility>
+
+void radix_sort(std::vector<sRadixSortEntry>& entries, std::vector<sRadixSortEntry>& scratch)
+{
+    const size_t count = entries.size();
+
+    if (count < 2) {
+        return;
+    }
+
+    scratch.resize(count);
+
+    // Build the histograms of all passes at once
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = entries[i].key;
+        for (uint32_t pass = 0; pass < 8; ++pass) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    sRadixSortEntry* src = entries.data();
+    sRadixSortEntry* dst = scratch.data();
+
+    for (uint32_t pass = 0; pass < 8; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        const uint32_t shift = pass * 8;
+
+        // All keys have the same digit, nothing to reorder
+        if (histogram[(src[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; ++digit) {
+            uint32_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const sRadixSortEntry& entry = src[i];
+            dst[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+
+        std::swap(src, dst);
+    }
+
+    // Odd number of passes done, result lives in the scratch buffer
+    if (src != entries.data()) {
+        entries.swap(scratch);
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct sRadixSortEntry {
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort of 64-bit keys, 8 bits per pass. Passes where every key
+// shares the same digit are skipped. Keep the scratch vector alive between calls
+// to avoid per-frame allocations.
+void radix_sort(std::vector<sRadixSortEntry>& entries, std::vector<sRadixSortEntry>& scratch);
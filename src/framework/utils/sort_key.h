@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Render list sort keys, drawn in ascending key order. Fields from the most significant bit:
+//  opaque:      list (3) | priority (8) | pipeline (12) | material (21) | surface (20)
+//  transparent: list (3) | priority (8) | depth (24)    | pipeline (12) | material (17)
+// Higher priorities are drawn first. Ids are masked to their field width, wrapping only degrades batching, never correctness
+
+inline uint64_t pack_sort_key_header(uint32_t list, uint8_t priority)
+{
+    return (static_cast<uint64_t>(list & 0x7) << 61) | (static_cast<uint64_t>(255u - priority) << 53);
+}
+
+inline uint64_t pack_sort_key(uint32_t list, uint8_t priority, uint32_t pipeline_id, uint32_t material_id, uint32_t surface_id)
+{
+    return pack_sort_key_header(list, priority) | (static_cast<uint64_t>(pipeline_id & 0xFFF) << 41) |
+        (static_cast<uint64_t>(material_id & 0x1FFFFF) << 20) | (surface_id & 0xFFFFF);
+}
+
+// Back to front, far depths get the smaller keys
+inline uint64_t pack_transparent_sort_key(uint32_t list, uint8_t priority, float view_depth, uint32_t pipeline_id, uint32_t material_id)
+{
+    view_depth = std::max(view_depth, 0.0f);
+
+    // Positive floats keep their order when read as integers, the top 24 bits keep 16 bits of mantissa
+    uint32_t depth_bits;
+    memcpy(&depth_bits, &view_depth, sizeof(float));
+
+    uint64_t depth = 0xFFFFFF - ((depth_bits >> 7) & 0xFFFFFF);
+
+    return pack_sort_key_header(list, priority) | (depth << 29) | (static_cast<uint64_t>(pipeline_id & 0xFFF) << 17) | (material_id & 0x1FFFF);
+}
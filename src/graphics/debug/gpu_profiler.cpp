@@ -0,0 +1,415 @@
+#include "gpu_profiler.h"
+
+#include "graphics/webgpu_context.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <fstream>
+
+// Limit of a query set
+static constexpr uint32_t MAX_QUERY_COUNT = 4096;
+
+GPUProfiler::GPUProfiler()
+{
+
+}
+
+GPUProfiler::~GPUProfiler()
+{
+    destroy();
+}
+
+void GPUProfiler::create(WebGPUContext* webgpu_context)
+{
+    this->webgpu_context = webgpu_context;
+
+    owner_thread = std::this_thread::get_id();
+
+    if (!wgpuDeviceHasFeature(webgpu_context->device, WGPUFeatureName_TimestampQuery)) {
+        spdlog::warn("Timestamp queries not supported, GPU profiling disabled");
+        enabled = false;
+        return;
+    }
+
+    for (sFrameSlot& slot : slots) {
+        create_slot_resources(slot, INITIAL_QUERY_COUNT);
+    }
+
+    intern_label("frame");
+}
+
+void GPUProfiler::destroy()
+{
+    for (sFrameSlot& slot : slots) {
+        destroy_slot_resources(slot);
+        slot.state = SLOT_FREE;
+    }
+
+    recording_slot = nullptr;
+}
+
+void GPUProfiler::create_slot_resources(sFrameSlot& slot, uint32_t query_capacity)
+{
+    destroy_slot_resources(slot);
+
+    slot.query_capacity = query_capacity;
+    slot.query_set = webgpu_context->create_query_set(query_capacity);
+    slot.resolve_buffer = webgpu_context->create_buffer(sizeof(uint64_t) * query_capacity, WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc, nullptr, "gpu_profiler_resolve_buffer");
+    slot.readback_buffer = webgpu_context->create_buffer(sizeof(uint64_t) * query_capacity, WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead, nullptr, "gpu_profiler_readback_buffer");
+}
+
+void GPUProfiler::destroy_slot_resources(sFrameSlot& slot)
+{
+    if (slot.query_set) {
+        wgpuQuerySetDestroy(slot.query_set);
+        wgpuQuerySetRelease(slot.query_set);
+        slot.query_set = nullptr;
+    }
+
+    for (WGPUBuffer* buffer : { &slot.resolve_buffer, &slot.readback_buffer }) {
+        if (*buffer) {
+            wgpuBufferDestroy(*buffer);
+            wgpuBufferRelease(*buffer);
+            *buffer = nullptr;
+        }
+    }
+
+    slot.query_capacity = 0;
+    slot.query_count = 0;
+    slot.overflowed = false;
+    slot.scopes.clear();
+}
+
+bool GPUProfiler::is_recording() const
+{
+    return recording_slot && std::this_thread::get_id() == owner_thread;
+}
+
+void GPUProfiler::begin_frame()
+{
+    recording_slot = nullptr;
+    open_scopes.clear();
+
+    if (!enabled || !webgpu_context) {
+        return;
+    }
+
+    sFrameSlot& slot = slots[frame_index % FRAME_COUNT];
+
+    // Still being read back, measuring would need to wait for it
+    if (slot.state != SLOT_FREE) {
+        skipped_frames++;
+        return;
+    }
+
+    if (slot.overflowed && slot.query_capacity < MAX_QUERY_COUNT) {
+        create_slot_resources(slot, std::min(slot.query_capacity * 2, MAX_QUERY_COUNT));
+    }
+
+    slot.query_count = 0;
+    slot.overflowed = false;
+    slot.scopes.clear();
+    slot.state = SLOT_RECORDING;
+
+    recording_slot = &slot;
+
+    begin_scope("frame");
+}
+
+void GPUProfiler::end_frame(WGPUCommandEncoder command_encoder)
+{
+    if (!recording_slot) {
+        return;
+    }
+
+    if (open_scopes.size() > 1) {
+        spdlog::warn("GPU profiler scope \"{}\" not closed", labels[recording_slot->scopes[open_scopes.back()].label]);
+    }
+
+    while (!open_scopes.empty()) {
+        end_scope();
+    }
+
+    sFrameSlot& slot = *recording_slot;
+    recording_slot = nullptr;
+
+    frame_index++;
+
+    if (slot.query_count == 0) {
+        slot.state = SLOT_FREE;
+        return;
+    }
+
+    wgpuCommandEncoderResolveQuerySet(command_encoder, slot.query_set, 0, slot.query_count, slot.resolve_buffer, 0);
+    wgpuCommandEncoderCopyBufferToBuffer(command_encoder, slot.resolve_buffer, 0, slot.readback_buffer, 0, sizeof(uint64_t) * slot.query_count);
+
+    slot.state = SLOT_RESOLVED;
+}
+
+void GPUProfiler::map_readback()
+{
+    for (sFrameSlot& slot : slots) {
+
+        if (slot.state != SLOT_RESOLVED) {
+            continue;
+        }
+
+        slot.state = SLOT_MAPPING;
+
+        WGPUBufferMapCallbackInfo callback_info = {};
+        callback_info.mode = WGPUCallbackMode_AllowProcessEvents;
+        callback_info.userdata1 = this;
+        callback_info.userdata2 = &slot;
+
+        callback_info.callback = [](WGPUMapAsyncStatus status, struct WGPUStringView message, void* userdata1, void* userdata2) {
+            GPUProfiler* profiler = reinterpret_cast<GPUProfiler*>(userdata1);
+            sFrameSlot* slot = reinterpret_cast<sFrameSlot*>(userdata2);
+
+            slot->state = SLOT_FREE;
+
+            if (status != WGPUMapAsyncStatus_Success) {
+                return;
+            }
+
+            const uint64_t* timestamps = reinterpret_cast<const uint64_t*>(wgpuBufferGetConstMappedRange(slot->readback_buffer, 0, sizeof(uint64_t) * slot->query_count));
+
+            profiler->process_timestamps(*slot, timestamps);
+
+            wgpuBufferUnmap(slot->readback_buffer);
+        };
+
+        wgpuBufferMapAsync(slot.readback_buffer, WGPUMapMode_Read, 0, sizeof(uint64_t) * slot.query_count, callback_info);
+    }
+}
+
+uint32_t GPUProfiler::intern_label(std::string_view label)
+{
+    auto it = label_ids.find(label);
+
+    if (it != label_ids.end()) {
+        return it->second;
+    }
+
+    uint32_t label_id = static_cast<uint32_t>(labels.size());
+
+    labels.emplace_back(label);
+    label_ids.emplace(labels.back(), label_id);
+    label_histories.emplace_back();
+
+    return label_id;
+}
+
+void GPUProfiler::begin_scope(std::string_view label)
+{
+    if (!is_recording()) {
+        return;
+    }
+
+    sScope scope;
+    scope.label = intern_label(label);
+    scope.depth = static_cast<uint32_t>(open_scopes.size());
+
+    open_scopes.push_back(static_cast<uint32_t>(recording_slot->scopes.size()));
+    recording_slot->scopes.push_back(scope);
+}
+
+void GPUProfiler::end_scope()
+{
+    if (!is_recording()) {
+        return;
+    }
+
+    if (open_scopes.empty()) {
+        spdlog::warn("GPU profiler scope closed without being opened");
+        return;
+    }
+
+    std::vector<sScope>& scopes = recording_slot->scopes;
+
+    scopes[open_scopes.back()].last_child = static_cast<uint32_t>(scopes.size()) - 1;
+    open_scopes.pop_back();
+}
+
+const WGPUPassTimestampWrites* GPUProfiler::get_pass_timestamp_writes(std::string_view label, WGPUPassTimestampWrites& timestamp_writes)
+{
+    if (!is_recording()) {
+        return nullptr;
+    }
+
+    sFrameSlot& slot = *recording_slot;
+
+    if (slot.query_count + 2 > slot.query_capacity) {
+        slot.overflowed = true;
+        return nullptr;
+    }
+
+    sScope scope;
+    scope.label = intern_label(label);
+    scope.depth = static_cast<uint32_t>(open_scopes.size());
+    scope.first_query = slot.query_count;
+    scope.last_child = static_cast<uint32_t>(slot.scopes.size());
+
+    slot.scopes.push_back(scope);
+
+    timestamp_writes = {};
+    timestamp_writes.querySet = slot.query_set;
+    timestamp_writes.beginningOfPassWriteIndex = slot.query_count;
+    timestamp_writes.endOfPassWriteIndex = slot.query_count + 1;
+
+    slot.query_count += 2;
+
+    return &timestamp_writes;
+}
+
+void GPUProfiler::process_timestamps(sFrameSlot& slot, const uint64_t* timestamps)
+{
+    const std::vector<sScope>& scopes = slot.scopes;
+
+    std::vector<sTraceEvent> events(scopes.size());
+
+    // Backwards, so the passes of a group are known when the group is reached
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        const sScope& scope = scopes[i];
+        sTraceEvent& event = events[i];
+
+        event.label = scope.label;
+        event.depth = scope.depth;
+
+        if (scope.first_query != UINT32_MAX) {
+            event.begin = timestamps[scope.first_query];
+            event.end = timestamps[scope.first_query + 1];
+
+            // Pass not encoded after all, or the implementation clamped the values
+            if (event.begin == 0 || event.end < event.begin) {
+                event = {};
+            }
+
+            continue;
+        }
+
+        event.begin = UINT64_MAX;
+        event.end = 0;
+
+        for (uint32_t child = i + 1; child <= scope.last_child; ++child) {
+            if (events[child].end == 0) {
+                continue;
+            }
+
+            event.begin = std::min(event.begin, events[child].begin);
+            event.end = std::max(event.end, events[child].end);
+        }
+
+        if (event.end == 0) {
+            event = {};
+        }
+    }
+
+    std::vector<sTraceEvent>& trace_frame = trace_frames[trace_next_frame];
+    trace_frame.clear();
+
+    std::vector<sScopeStats> frame_stats;
+
+    for (const sTraceEvent& event : events) {
+        if (event.end == 0) {
+            continue;
+        }
+
+        trace_frame.push_back(event);
+
+        // Labels repeated in a frame are added up
+        sLabelHistory& history = label_histories[event.label];
+        float milliseconds = static_cast<float>(event.end - event.begin) * 1e-6f;
+
+        if (history.last_frame == resolved_frames) {
+            history.samples[(history.next_sample + HISTORY_FRAME_COUNT - 1) % HISTORY_FRAME_COUNT] += milliseconds;
+            continue;
+        }
+
+        history.last_frame = resolved_frames;
+        history.samples[history.next_sample] = milliseconds;
+        history.next_sample = (history.next_sample + 1) % HISTORY_FRAME_COUNT;
+        history.sample_count = std::min(history.sample_count + 1, HISTORY_FRAME_COUNT);
+
+        sScopeStats stats;
+        stats.label = event.label;
+        stats.depth = event.depth;
+        frame_stats.push_back(stats);
+    }
+
+    trace_next_frame = (trace_next_frame + 1) % HISTORY_FRAME_COUNT;
+    resolved_frames++;
+
+    scope_stats = std::move(frame_stats);
+    scope_stats_dirty = true;
+}
+
+const std::vector<GPUProfiler::sScopeStats>& GPUProfiler::get_scope_stats()
+{
+    if (!scope_stats_dirty) {
+        return scope_stats;
+    }
+
+    for (sScopeStats& stats : scope_stats) {
+        const sLabelHistory& history = label_histories[stats.label];
+
+        stats.last_ms = history.samples[(history.next_sample + HISTORY_FRAME_COUNT - 1) % HISTORY_FRAME_COUNT];
+        stats.min_ms = stats.last_ms;
+        stats.max_ms = stats.last_ms;
+
+        float sum = 0.0f;
+
+        for (uint32_t i = 0; i < history.sample_count; ++i) {
+            stats.min_ms = std::min(stats.min_ms, history.samples[i]);
+            stats.max_ms = std::max(stats.max_ms, history.samples[i]);
+            sum += history.samples[i];
+        }
+
+        stats.avg_ms = sum / static_cast<float>(std::max(history.sample_count, 1u));
+    }
+
+    scope_stats_dirty = false;
+
+    return scope_stats;
+}
+
+bool GPUProfiler::export_chrome_trace(const std::string& path) const
+{
+    std::ofstream trace_file(path, std::ios::out);
+
+    if (!trace_file.is_open()) {
+        spdlog::error("Could not open GPU trace file {}", path);
+        return false;
+    }
+
+    uint32_t frame_count = static_cast<uint32_t>(std::min<uint64_t>(resolved_frames, HISTORY_FRAME_COUNT));
+    uint32_t first_frame = resolved_frames > HISTORY_FRAME_COUNT ? trace_next_frame : 0;
+
+    uint64_t time_origin = UINT64_MAX;
+
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        for (const sTraceEvent& event : trace_frames[i]) {
+            time_origin = std::min(time_origin, event.begin);
+        }
+    }
+
+    trace_file << "{\"traceEvents\":[\n";
+    trace_file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        for (const sTraceEvent& event : trace_frames[(first_frame + i) % HISTORY_FRAME_COUNT]) {
+            // Microseconds
+            double begin = static_cast<double>(event.begin - time_origin) * 1e-3;
+            double duration = static_cast<double>(event.end - event.begin) * 1e-3;
+
+            trace_file << ",\n{\"name\":\"" << labels[event.label] << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+                << std::fixed << begin << ",\"dur\":" << duration << "}";
+        }
+    }
+
+    trace_file << "\n]}\n";
+
+    spdlog::info("GPU trace of {} frames written to {}", frame_count, path);
+
+    return true;
+}
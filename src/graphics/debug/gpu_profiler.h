@@ -0,0 +1,148 @@
+#pragma once
+
+#include "includes.h"
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct WebGPUContext;
+
+// GPU time of passes from timestamp queries. Every frame writes to its own query set of a ring, which is
+// read back some frames later, so nothing waits on the GPU. A frame whose slot is still being read is
+// not measured. Passes can be grouped in nested scopes, a scope spans from its first to its last pass
+class GPUProfiler {
+
+public:
+
+    static constexpr uint32_t FRAME_COUNT = 4;
+    static constexpr uint32_t INITIAL_QUERY_COUNT = 64;
+    // Frames kept for the statistics and the trace export
+    static constexpr uint32_t HISTORY_FRAME_COUNT = 128;
+
+    struct sScopeStats {
+        uint32_t label = 0;
+        uint32_t depth = 0;
+        float last_ms = 0.0f;
+        float min_ms = 0.0f;
+        float avg_ms = 0.0f;
+        float max_ms = 0.0f;
+    };
+
+    GPUProfiler();
+    ~GPUProfiler();
+
+    void create(WebGPUContext* webgpu_context);
+    void destroy();
+
+    // Frame boundaries, end_frame encodes the query resolve on the frame command encoder
+    void begin_frame();
+    void end_frame(WGPUCommandEncoder command_encoder);
+
+    // Call once the command encoder used in end_frame has been submitted
+    void map_readback();
+
+    // Labels are stored once, the id is stable for the profiler lifetime
+    uint32_t intern_label(std::string_view label);
+    const std::string& get_label(uint32_t label) const { return labels[label]; }
+
+    void begin_scope(std::string_view label);
+    void end_scope();
+
+    // Timestamp writes for the descriptor of a pass, written to the given struct. nullptr when the frame is
+    // not measured, the queries of the frame ran out (the set grows for the next use) or called from
+    // other than the creation thread
+    const WGPUPassTimestampWrites* get_pass_timestamp_writes(std::string_view label, WGPUPassTimestampWrites& timestamp_writes);
+
+    // Min, average and max of the last HISTORY_FRAME_COUNT measured frames, in the order of the last one
+    const std::vector<sScopeStats>& get_scope_stats();
+
+    // Measured frames in the Chrome trace event format (chrome://tracing, Perfetto)
+    bool export_chrome_trace(const std::string& path) const;
+
+    void set_enabled(bool value) { enabled = value; }
+    bool get_enabled() const { return enabled; }
+
+    uint32_t get_skipped_frames() const { return skipped_frames; }
+
+private:
+
+    enum eSlotState {
+        SLOT_FREE,
+        SLOT_RECORDING,
+        SLOT_RESOLVED,
+        SLOT_MAPPING
+    };
+
+    // Queries of a pass come in begin, end pairs. Group scopes have no queries
+    struct sScope {
+        uint32_t label = 0;
+        uint32_t depth = 0;
+        uint32_t first_query = UINT32_MAX;
+        // Scopes opened inside this one, up to this index
+        uint32_t last_child = 0;
+    };
+
+    struct sFrameSlot {
+        WGPUQuerySet query_set = nullptr;
+        WGPUBuffer resolve_buffer = nullptr;
+        WGPUBuffer readback_buffer = nullptr;
+        uint32_t query_capacity = 0;
+        uint32_t query_count = 0;
+        bool overflowed = false;
+        eSlotState state = SLOT_FREE;
+        std::vector<sScope> scopes;
+    };
+
+    struct sTraceEvent {
+        uint32_t label = 0;
+        uint32_t depth = 0;
+        uint64_t begin = 0;
+        uint64_t end = 0;
+    };
+
+    struct sLabelHistory {
+        float samples[HISTORY_FRAME_COUNT] = {};
+        uint32_t sample_count = 0;
+        uint32_t next_sample = 0;
+        uint64_t last_frame = UINT64_MAX;
+    };
+
+    struct sStringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const { return std::hash<std::string_view>()(value); }
+    };
+
+    WebGPUContext* webgpu_context = nullptr;
+    std::thread::id owner_thread;
+
+    bool enabled = true;
+
+    sFrameSlot slots[FRAME_COUNT];
+    sFrameSlot* recording_slot = nullptr;
+    uint64_t frame_index = 0;
+    uint32_t skipped_frames = 0;
+
+    std::vector<uint32_t> open_scopes;
+
+    std::vector<std::string> labels;
+    std::unordered_map<std::string, uint32_t, sStringHash, std::equal_to<>> label_ids;
+
+    // Ring of the resolved frames
+    std::vector<sTraceEvent> trace_frames[HISTORY_FRAME_COUNT];
+    uint32_t trace_next_frame = 0;
+    uint64_t resolved_frames = 0;
+
+    std::vector<sLabelHistory> label_histories;
+    std::vector<sScopeStats> scope_stats;
+    bool scope_stats_dirty = false;
+
+    bool is_recording() const;
+
+    void create_slot_resources(sFrameSlot& slot, uint32_t query_capacity);
+    void destroy_slot_resources(sFrameSlot& slot);
+
+    void process_timestamps(sFrameSlot& slot, const uint64_t* timestamps);
+};
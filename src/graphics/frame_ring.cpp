@@ -0,0 +1,130 @@
+#include "frame_ring.h"
+
+#include "graphics/webgpu_context.h"
+
+#include "framework/utils/cpu_profiler.h"
+
+#include <algorithm>
+
+FrameRing::FrameRing()
+{
+
+}
+
+FrameRing::~FrameRing()
+{
+    destroy();
+}
+
+void FrameRing::create(WebGPUContext* webgpu_context)
+{
+    this->webgpu_context = webgpu_context;
+}
+
+void FrameRing::destroy()
+{
+    if (!webgpu_context) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    wait_completed_frames(submitted_frames);
+#endif
+
+    for (const sPendingRelease& pending_release : pending_releases) {
+        release(pending_release);
+    }
+
+    pending_releases.clear();
+
+    webgpu_context = nullptr;
+}
+
+void FrameRing::begin_frame()
+{
+#ifndef __EMSCRIPTEN__
+    if (submitted_frames >= FRAME_COUNT) {
+        PROFILE_ZONE("FrameRing::wait");
+        wait_completed_frames(submitted_frames - FRAME_COUNT + 1);
+    }
+#endif
+
+    release_completed();
+}
+
+void FrameRing::end_frame()
+{
+    WGPUQueueWorkDoneCallbackInfo callback_info = {};
+    callback_info.mode = WGPUCallbackMode_AllowProcessEvents;
+    callback_info.userdata1 = this;
+    callback_info.userdata2 = reinterpret_cast<void*>(static_cast<uintptr_t>(submitted_frames));
+
+    callback_info.callback = [](WGPUQueueWorkDoneStatus status, struct WGPUStringView message, void* userdata1, void* userdata2) {
+        FrameRing* frame_ring = reinterpret_cast<FrameRing*>(userdata1);
+        uint64_t frame = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(userdata2));
+
+        // Also on errors, nothing will run on the GPU for that frame anymore
+        frame_ring->completed_frames = std::max(frame_ring->completed_frames, frame + 1);
+    };
+
+    wgpuQueueOnSubmittedWorkDone(webgpu_context->device_queue, callback_info);
+
+    submitted_frames++;
+}
+
+void FrameRing::release_later(WGPUBuffer buffer)
+{
+    pending_releases.push_back({ buffer, submitted_frames });
+}
+
+void FrameRing::release_later(WGPUBindGroup bind_group)
+{
+    pending_releases.push_back({ bind_group, submitted_frames });
+}
+
+void FrameRing::release_later(WGPURenderBundle render_bundle)
+{
+    pending_releases.push_back({ render_bundle, submitted_frames });
+}
+
+void FrameRing::release_later(std::function<void()> release_callback)
+{
+    pending_releases.push_back({ std::move(release_callback), submitted_frames });
+}
+
+void FrameRing::wait_completed_frames(uint64_t frame_count)
+{
+    while (completed_frames < frame_count) {
+        webgpu_context->process_events();
+    }
+}
+
+void FrameRing::release_completed()
+{
+    size_t released_count = 0;
+
+    while (released_count < pending_releases.size() && pending_releases[released_count].frame < completed_frames) {
+        release(pending_releases[released_count]);
+        released_count++;
+    }
+
+    pending_releases.erase(pending_releases.begin(), pending_releases.begin() + released_count);
+}
+
+void FrameRing::release(const sPendingRelease& pending_release)
+{
+    if (std::holds_alternative<WGPUBuffer>(pending_release.resource)) {
+        WGPUBuffer buffer = std::get<WGPUBuffer>(pending_release.resource);
+        wgpuBufferDestroy(buffer);
+        wgpuBufferRelease(buffer);
+    }
+    else if (std::holds_alternative<WGPUBindGroup>(pending_release.resource)) {
+        wgpuBindGroupRelease(std::get<WGPUBindGroup>(pending_release.resource));
+    }
+    else if (std::holds_alternative<WGPURenderBundle>(pending_release.resource)) {
+        wgpuRenderBundleRelease(std::get<WGPURenderBundle>(pending_release.resource));
+    }
+    else if (std::holds_alternative<std::function<void()>>(pending_release.resource)) {
+        std::get<std::function<void()>>(pending_release.resource)();
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "includes.h"
+
+#include <functional>
+#include <variant>
+#include <vector>
+
+struct WebGPUContext;
+
+// Paces the CPU against the GPU with FRAME_COUNT frames in flight. Resources written every frame are
+// kept per frame and indexed by get_frame_index(): a frame only starts once the GPU has completed the
+// one that used its index, so its buffers are rewritten while the GPU still reads the newer frames.
+// Resources replaced during a frame are released once every frame that may use them has completed
+class FrameRing {
+
+public:
+
+    static constexpr uint32_t FRAME_COUNT = 3;
+
+    FrameRing();
+    ~FrameRing();
+
+    void create(WebGPUContext* webgpu_context);
+
+    // Waits for the frames in flight and releases everything pending
+    void destroy();
+
+    // Call before writing the resources of the frame. Waits for the frame that last used the index,
+    // except on the web, where the callbacks need the browser loop (writes stay queue ordered there)
+    void begin_frame();
+
+    // Call after the frame has been submitted, frames that submit nothing do not use an index
+    void end_frame();
+
+    uint32_t get_frame_index() const { return static_cast<uint32_t>(submitted_frames % FRAME_COUNT); }
+
+    uint64_t get_submitted_frames() const { return submitted_frames; }
+    uint64_t get_completed_frames() const { return completed_frames; }
+
+    // Released once the frame being built has completed on the GPU. Buffers are also destroyed
+    void release_later(WGPUBuffer buffer);
+    void release_later(WGPUBindGroup bind_group);
+    void release_later(WGPURenderBundle render_bundle);
+
+    // Called at the same point, for CPU side allocations of GPU memory (buffer slots or ranges)
+    void release_later(std::function<void()> release_callback);
+
+private:
+
+    struct sPendingRelease {
+        std::variant<WGPUBuffer, WGPUBindGroup, WGPURenderBundle, std::function<void()>> resource;
+        uint64_t frame = 0;
+    };
+
+    WebGPUContext* webgpu_context = nullptr;
+
+    uint64_t submitted_frames = 0;
+    uint64_t completed_frames = 0;
+
+    // In the order they were queued, so also by frame
+    std::vector<sPendingRelease> pending_releases;
+
+    void wait_completed_frames(uint64_t frame_count);
+    void release_completed();
+
+    static void release(const sPendingRelease& pending_release);
+};
@@ -0,0 +1,306 @@
+#include "geometry_arena.h"
+
+#include "graphics/webgpu_context.h"
+#include "graphics/staging_belt.h"
+#include "graphics/surface.h"
+#include "graphics/mesh_optimizer.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <vector>
+
+GeometryArena* GeometryArena::instance = nullptr;
+
+GeometryArena::GeometryArena(WebGPUContext* webgpu_context)
+    : webgpu_context(webgpu_context)
+{
+    instance = this;
+}
+
+GeometryArena::~GeometryArena()
+{
+    // The staged writes to the arena have to run before its buffers are destroyed
+    if (StagingBelt::instance) {
+        StagingBelt::instance->flush();
+    }
+
+    if (position_buffer) {
+        wgpuBufferDestroy(position_buffer);
+    }
+
+    if (vertex_data_buffer) {
+        wgpuBufferDestroy(vertex_data_buffer);
+    }
+
+    if (index_buffer) {
+        wgpuBufferDestroy(index_buffer);
+    }
+
+    if (index_16_buffer) {
+        wgpuBufferDestroy(index_16_buffer);
+    }
+
+    if (meshlet_buffer) {
+        wgpuBufferDestroy(meshlet_buffer);
+    }
+
+    if (instance == this) {
+        instance = nullptr;
+    }
+}
+
+uint32_t GeometryArena::allocate_vertices(uint32_t vertex_count)
+{
+    uint32_t first_vertex = vertex_allocator.allocate(vertex_count);
+
+    if (first_vertex == INVALID_OFFSET && vertex_count > 0) {
+        if (!grow_vertices(vertex_allocator.get_capacity() + vertex_count)) {
+            return INVALID_OFFSET;
+        }
+
+        first_vertex = vertex_allocator.allocate(vertex_count);
+    }
+
+    return first_vertex;
+}
+
+uint32_t GeometryArena::allocate_indices(uint32_t index_count, WGPUIndexFormat format)
+{
+    OffsetAllocator& allocator = format == WGPUIndexFormat_Uint16 ? index_16_allocator : index_allocator;
+
+    if (format == WGPUIndexFormat_Uint16) {
+        index_count = (index_count + 1) & ~1u;
+    }
+
+    uint32_t first_index = allocator.allocate(index_count);
+
+    if (first_index == INVALID_OFFSET && index_count > 0) {
+        if (!grow_indices(allocator.get_capacity() + index_count, format)) {
+            return INVALID_OFFSET;
+        }
+
+        first_index = allocator.allocate(index_count);
+    }
+
+    return first_index;
+}
+
+uint32_t GeometryArena::allocate_meshlets(uint32_t meshlet_count)
+{
+    uint32_t first_meshlet = meshlet_allocator.allocate(meshlet_count);
+
+    if (first_meshlet == INVALID_OFFSET && meshlet_count > 0) {
+        if (!grow_meshlets(meshlet_allocator.get_capacity() + meshlet_count)) {
+            return INVALID_OFFSET;
+        }
+
+        first_meshlet = meshlet_allocator.allocate(meshlet_count);
+    }
+
+    return first_meshlet;
+}
+
+void GeometryArena::release_vertices(uint32_t first_vertex)
+{
+    vertex_allocator.release(first_vertex);
+}
+
+void GeometryArena::release_indices(uint32_t first_index, WGPUIndexFormat format)
+{
+    if (format == WGPUIndexFormat_Uint16) {
+        index_16_allocator.release(first_index);
+    } else {
+        index_allocator.release(first_index);
+    }
+}
+
+void GeometryArena::release_meshlets(uint32_t first_meshlet)
+{
+    meshlet_allocator.release(first_meshlet);
+}
+
+void GeometryArena::write_positions(uint32_t first_vertex, const glm::vec3* positions, uint32_t vertex_count)
+{
+    assert(vertex_allocator.get_allocation_size(first_vertex) >= vertex_count);
+    webgpu_context->update_buffer(position_buffer, static_cast<uint64_t>(first_vertex) * sizeof(glm::vec3), positions, vertex_count * sizeof(glm::vec3));
+}
+
+void GeometryArena::write_vertex_data(uint32_t first_vertex, const sInterleavedData* vertex_data, uint32_t vertex_count)
+{
+    assert(vertex_allocator.get_allocation_size(first_vertex) >= vertex_count);
+    webgpu_context->update_buffer(vertex_data_buffer, static_cast<uint64_t>(first_vertex) * sizeof(sInterleavedData), vertex_data, vertex_count * sizeof(sInterleavedData));
+}
+
+void GeometryArena::write_indices(uint32_t first_index, const uint32_t* indices, uint32_t index_count, WGPUIndexFormat format)
+{
+    if (format == WGPUIndexFormat_Uint16) {
+        uint32_t padded_count = (index_count + 1) & ~1u;
+        assert(index_16_allocator.get_allocation_size(first_index) >= padded_count);
+
+        std::vector<uint16_t> narrow_indices(padded_count, 0);
+        for (uint32_t i = 0; i < index_count; ++i) {
+            assert(indices[i] <= UINT16_MAX);
+            narrow_indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+
+        webgpu_context->update_buffer(index_16_buffer, static_cast<uint64_t>(first_index) * sizeof(uint16_t), narrow_indices.data(), padded_count * sizeof(uint16_t));
+        return;
+    }
+
+    assert(index_allocator.get_allocation_size(first_index) >= index_count);
+    webgpu_context->update_buffer(index_buffer, static_cast<uint64_t>(first_index) * sizeof(uint32_t), indices, index_count * sizeof(uint32_t));
+}
+
+void GeometryArena::write_meshlets(uint32_t first_meshlet, const sMeshlet* meshlets, uint32_t meshlet_count)
+{
+    assert(meshlet_allocator.get_allocation_size(first_meshlet) >= meshlet_count);
+    webgpu_context->update_buffer(meshlet_buffer, static_cast<uint64_t>(first_meshlet) * sizeof(sMeshlet), meshlets, meshlet_count * sizeof(sMeshlet));
+}
+
+GeometryArena::sStats GeometryArena::get_stats() const
+{
+    sStats stats;
+    stats.vertices = vertex_allocator.get_stats();
+    stats.indices = index_allocator.get_stats();
+    stats.indices_16 = index_16_allocator.get_stats();
+    stats.meshlets = meshlet_allocator.get_stats();
+    stats.allocated_bytes = static_cast<uint64_t>(stats.vertices.capacity) * (sizeof(glm::vec3) + sizeof(sInterleavedData)) +
+        static_cast<uint64_t>(stats.indices.capacity) * sizeof(uint32_t) +
+        static_cast<uint64_t>(stats.indices_16.capacity) * sizeof(uint16_t) +
+        static_cast<uint64_t>(stats.meshlets.capacity) * sizeof(sMeshlet);
+    stats.grow_count = grow_count;
+    return stats;
+}
+
+WGPUBuffer GeometryArena::create_grown_buffer(uint64_t new_size, WGPUBufferUsage usage, const char* label)
+{
+    if (new_size > webgpu_context->supported_limits.maxBufferSize) {
+        spdlog::error("Geometry arena buffer {} can not grow to {} bytes, the limit is {}", label, new_size, webgpu_context->supported_limits.maxBufferSize);
+        return nullptr;
+    }
+
+    return webgpu_context->create_buffer(new_size, usage | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc, nullptr, label);
+}
+
+void GeometryArena::replace_buffer(WGPUBuffer& buffer, WGPUBuffer new_buffer, uint64_t old_size)
+{
+    // Submitted right away, so writes queued before the growth are in the old buffer when it is copied
+    // and the ones queued after it go to the new buffer. The staged writes are submitted first for the same reason
+    if (buffer) {
+        webgpu_context->staging_belt->flush();
+
+        WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(webgpu_context->device, {});
+
+        wgpuCommandEncoderCopyBufferToBuffer(encoder, buffer, 0, new_buffer, 0, old_size);
+
+        WGPUCommandBufferDescriptor cmd_buff_descriptor = {};
+        cmd_buff_descriptor.label = { "geometry arena grow command", WGPU_STRLEN };
+
+        WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, &cmd_buff_descriptor);
+
+        wgpuQueueSubmit(webgpu_context->device_queue, 1, &commands);
+
+        wgpuCommandBufferRelease(commands);
+        wgpuCommandEncoderRelease(encoder);
+
+        // Released, not destroyed: passes already encoded this frame may still draw from it
+        wgpuBufferRelease(buffer);
+    }
+
+    buffer = new_buffer;
+}
+
+bool GeometryArena::grow_vertices(uint32_t min_capacity)
+{
+    uint32_t old_capacity = vertex_allocator.get_capacity();
+    uint32_t new_capacity = std::max({ old_capacity * 2, min_capacity, INITIAL_VERTEX_CAPACITY });
+
+    // Both vertex buffers share the ranges, so both must fit
+    uint64_t max_vertices = webgpu_context->supported_limits.maxBufferSize / sizeof(sInterleavedData);
+    new_capacity = static_cast<uint32_t>(std::min<uint64_t>(new_capacity, std::max<uint64_t>(max_vertices, min_capacity)));
+
+    // Both are created before either replaces the current one, so a failure leaves them matching the allocator
+    WGPUBuffer new_position_buffer = create_grown_buffer(new_capacity * sizeof(glm::vec3), WGPUBufferUsage_Vertex, "geometry_arena_positions");
+    WGPUBuffer new_vertex_data_buffer = create_grown_buffer(new_capacity * sizeof(sInterleavedData), WGPUBufferUsage_Vertex, "geometry_arena_vertex_data");
+
+    if (!new_position_buffer || !new_vertex_data_buffer) {
+        if (new_position_buffer) {
+            wgpuBufferDestroy(new_position_buffer);
+        }
+
+        if (new_vertex_data_buffer) {
+            wgpuBufferDestroy(new_vertex_data_buffer);
+        }
+
+        return false;
+    }
+
+    replace_buffer(position_buffer, new_position_buffer, old_capacity * sizeof(glm::vec3));
+    replace_buffer(vertex_data_buffer, new_vertex_data_buffer, old_capacity * sizeof(sInterleavedData));
+
+    vertex_allocator.grow(new_capacity);
+    grow_count++;
+
+    spdlog::trace("Geometry arena vertex capacity grown to {}", new_capacity);
+
+    return true;
+}
+
+bool GeometryArena::grow_indices(uint32_t min_capacity, WGPUIndexFormat format)
+{
+    bool is_16_bit = format == WGPUIndexFormat_Uint16;
+
+    OffsetAllocator& allocator = is_16_bit ? index_16_allocator : index_allocator;
+    WGPUBuffer& buffer = is_16_bit ? index_16_buffer : index_buffer;
+    uint64_t index_size = is_16_bit ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    uint32_t old_capacity = allocator.get_capacity();
+    uint32_t new_capacity = std::max({ old_capacity * 2, min_capacity, INITIAL_INDEX_CAPACITY });
+
+    // Even, so 16 bit ranges stay 4 byte aligned
+    uint64_t max_indices = (webgpu_context->supported_limits.maxBufferSize / index_size) & ~1ull;
+    new_capacity = static_cast<uint32_t>(std::min<uint64_t>(new_capacity, std::max<uint64_t>(max_indices, min_capacity)));
+
+    // 32 bit indices are also read by the meshlet cull kernel
+    WGPUBufferUsage usage = is_16_bit ? WGPUBufferUsage_Index : (WGPUBufferUsage_Index | WGPUBufferUsage_Storage);
+
+    WGPUBuffer new_buffer = create_grown_buffer(new_capacity * index_size, usage, is_16_bit ? "geometry_arena_indices_16" : "geometry_arena_indices");
+
+    if (!new_buffer) {
+        return false;
+    }
+
+    replace_buffer(buffer, new_buffer, old_capacity * index_size);
+
+    allocator.grow(new_capacity);
+    grow_count++;
+
+    spdlog::trace("Geometry arena {} bit index capacity grown to {}", is_16_bit ? 16 : 32, new_capacity);
+
+    return true;
+}
+
+bool GeometryArena::grow_meshlets(uint32_t min_capacity)
+{
+    uint32_t old_capacity = meshlet_allocator.get_capacity();
+    uint32_t new_capacity = std::max({ old_capacity * 2, min_capacity, INITIAL_MESHLET_CAPACITY });
+
+    uint64_t max_meshlets = webgpu_context->supported_limits.maxBufferSize / sizeof(sMeshlet);
+    new_capacity = static_cast<uint32_t>(std::min<uint64_t>(new_capacity, std::max<uint64_t>(max_meshlets, min_capacity)));
+
+    WGPUBuffer new_buffer = create_grown_buffer(new_capacity * sizeof(sMeshlet), WGPUBufferUsage_Storage, "geometry_arena_meshlets");
+
+    if (!new_buffer) {
+        return false;
+    }
+
+    replace_buffer(meshlet_buffer, new_buffer, old_capacity * sizeof(sMeshlet));
+
+    meshlet_allocator.grow(new_capacity);
+    grow_count++;
+
+    spdlog::trace("Geometry arena meshlet capacity grown to {}", new_capacity);
+
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "includes.h"
+#include "glm/vec3.hpp"
+
+#include "framework/utils/offset_allocator.h"
+
+struct WebGPUContext;
+struct sInterleavedData;
+struct sMeshlet;
+
+// Vertex and index data of every surface, sub-allocated from large buffers: positions, interleaved
+// vertex data and indices (one buffer per index format). A surface keeps a vertex range (shared by
+// positions and vertex data, so both use the same base vertex) and an index range. The buffers are
+// bound once per pass and draws select their ranges with baseVertex and firstIndex.
+// Meshlet bounds live in their own buffer, read by the meshlet cull kernel together with the 32 bit indices
+class GeometryArena {
+
+public:
+
+    static GeometryArena* instance;
+
+    static constexpr uint32_t INVALID_OFFSET = OffsetAllocator::INVALID_OFFSET;
+
+    struct sStats {
+        OffsetAllocator::sStats vertices;
+        OffsetAllocator::sStats indices;
+        OffsetAllocator::sStats indices_16;
+        OffsetAllocator::sStats meshlets;
+        uint64_t allocated_bytes = 0;
+        uint32_t grow_count = 0;
+    };
+
+    GeometryArena(WebGPUContext* webgpu_context);
+    ~GeometryArena();
+
+    // First vertex/index of the range, INVALID_OFFSET if the buffers can not grow enough
+    uint32_t allocate_vertices(uint32_t vertex_count);
+    uint32_t allocate_indices(uint32_t index_count, WGPUIndexFormat format);
+    uint32_t allocate_meshlets(uint32_t meshlet_count);
+
+    void release_vertices(uint32_t first_vertex);
+    void release_indices(uint32_t first_index, WGPUIndexFormat format);
+    void release_meshlets(uint32_t first_meshlet);
+
+    void write_positions(uint32_t first_vertex, const glm::vec3* positions, uint32_t vertex_count);
+    void write_vertex_data(uint32_t first_vertex, const sInterleavedData* vertex_data, uint32_t vertex_count);
+    // Indices are narrowed when the range is 16 bit, they must fit
+    void write_indices(uint32_t first_index, const uint32_t* indices, uint32_t index_count, WGPUIndexFormat format);
+    // Meshlet first indices must be absolute, inside the 32 bit index buffer
+    void write_meshlets(uint32_t first_meshlet, const sMeshlet* meshlets, uint32_t meshlet_count);
+
+    WGPUBuffer get_position_buffer() const { return position_buffer; }
+    WGPUBuffer get_vertex_data_buffer() const { return vertex_data_buffer; }
+    WGPUBuffer get_index_buffer(WGPUIndexFormat format) const { return format == WGPUIndexFormat_Uint16 ? index_16_buffer : index_buffer; }
+    WGPUBuffer get_meshlet_buffer() const { return meshlet_buffer; }
+    uint32_t get_index_capacity() const { return index_allocator.get_capacity(); }
+    uint32_t get_meshlet_capacity() const { return meshlet_allocator.get_capacity(); }
+
+    sStats get_stats() const;
+
+private:
+
+    static constexpr uint32_t INITIAL_VERTEX_CAPACITY = 1u << 16;
+    static constexpr uint32_t INITIAL_INDEX_CAPACITY = 1u << 18;
+    static constexpr uint32_t INITIAL_MESHLET_CAPACITY = 1u << 12;
+
+    // Null over the device buffer size limit
+    WGPUBuffer create_grown_buffer(uint64_t new_size, WGPUBufferUsage usage, const char* label);
+    // Copies the old contents to the new buffer and releases the old one
+    void replace_buffer(WGPUBuffer& buffer, WGPUBuffer new_buffer, uint64_t old_size);
+
+    bool grow_vertices(uint32_t min_capacity);
+    bool grow_indices(uint32_t min_capacity, WGPUIndexFormat format);
+    bool grow_meshlets(uint32_t min_capacity);
+
+    WebGPUContext* webgpu_context = nullptr;
+
+    OffsetAllocator vertex_allocator;
+    OffsetAllocator index_allocator;
+    // 16 bit ranges are kept at even sizes, buffer writes must be multiples of 4 bytes
+    OffsetAllocator index_16_allocator;
+    OffsetAllocator meshlet_allocator;
+
+    WGPUBuffer position_buffer = nullptr;
+    WGPUBuffer vertex_data_buffer = nullptr;
+    WGPUBuffer index_buffer = nullptr;
+    WGPUBuffer index_16_buffer = nullptr;
+    WGPUBuffer meshlet_buffer = nullptr;
+
+    uint32_t grow_count = 0;
+};
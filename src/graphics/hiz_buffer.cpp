@@ -0,0 +1,322 @@
+#include "hiz_buffer.h"
+
+#include "graphics/renderer_storage.h"
+#include "graphics/debug/gpu_profiler.h"
+#include "graphics/renderer.h"
+
+#include "shaders/hiz_downsample.wgsl.gen.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+HiZBuffer::HiZBuffer()
+{
+    copy_shader = RendererStorage::get_shader_from_source(shaders::hiz_downsample::source, shaders::hiz_downsample::path, shaders::hiz_downsample::libraries, { "COPY_DEPTH" });
+    copy_multisampled_shader = RendererStorage::get_shader_from_source(shaders::hiz_downsample::source, shaders::hiz_downsample::path, shaders::hiz_downsample::libraries, { "COPY_DEPTH_MULTISAMPLED" });
+    downsample_shader = RendererStorage::get_shader_from_source(shaders::hiz_downsample::source, shaders::hiz_downsample::path, shaders::hiz_downsample::libraries, { "DOWNSAMPLE" });
+
+    copy_pipeline.create_compute_async(copy_shader);
+    copy_multisampled_pipeline.create_compute_async(copy_multisampled_shader);
+    downsample_pipeline.create_compute_async(downsample_shader);
+}
+
+HiZBuffer::~HiZBuffer()
+{
+    destroy();
+}
+
+void HiZBuffer::create(WGPUTextureView depth_texture_view, uint32_t width, uint32_t height, bool multisampled)
+{
+    destroy();
+
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    this->depth_texture_view = depth_texture_view;
+    this->width = width;
+    this->height = height;
+    this->multisampled = multisampled;
+
+    mip_count = 1u + static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))));
+
+    pyramid_texture.create(
+        WGPUTextureDimension_2D,
+        WGPUTextureFormat_R32Float,
+        { width, height, 1 },
+        static_cast<WGPUTextureUsage>(WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc),
+        mip_count, 1, nullptr);
+
+    pyramid_view = pyramid_texture.get_view(WGPUTextureViewDimension_2D, 0, mip_count);
+
+    level_views.resize(mip_count);
+    level_bind_groups.resize(mip_count);
+
+    for (uint32_t level = 0; level < mip_count; ++level) {
+        level_views[level] = pyramid_texture.get_view(WGPUTextureViewDimension_2D, level, 1);
+    }
+
+    for (uint32_t level = 0; level < mip_count; ++level) {
+        Uniform source_view;
+        source_view.data = level == 0 ? depth_texture_view : level_views[level - 1];
+        source_view.binding = 0;
+
+        Uniform output_view;
+        output_view.data = level_views[level];
+        output_view.binding = 1;
+
+        std::vector<Uniform*> uniforms = { &source_view, &output_view };
+
+        Shader* shader = downsample_shader;
+
+        if (level == 0) {
+            shader = multisampled ? copy_multisampled_shader : copy_shader;
+        }
+
+        level_bind_groups[level] = webgpu_context->create_bind_group(uniforms, shader, 0, "hiz_level_bind_group");
+    }
+
+    // Smallest level that fits the readback size
+    readback_level = 0;
+
+    while (readback_level + 1 < mip_count && std::max(width >> readback_level, height >> readback_level) > MAX_READBACK_SIZE) {
+        readback_level++;
+    }
+
+    readback_width = std::max(width >> readback_level, 1u);
+    readback_height = std::max(height >> readback_level, 1u);
+
+    // Texture to buffer copies need rows aligned to 256 bytes
+    readback_bytes_per_row = (readback_width * sizeof(float) + 255u) & ~255u;
+
+    for (sReadbackSlot& slot : readback_slots) {
+        slot.buffer = webgpu_context->create_buffer(readback_bytes_per_row * readback_height, WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead, nullptr, "hiz_readback_buffer");
+    }
+
+    next_readback_slot = 0;
+}
+
+void HiZBuffer::destroy()
+{
+    for (WGPUBindGroup bind_group : level_bind_groups) {
+        wgpuBindGroupRelease(bind_group);
+    }
+
+    for (WGPUTextureView view : level_views) {
+        wgpuTextureViewRelease(view);
+    }
+
+    level_bind_groups.clear();
+    level_views.clear();
+
+    if (pyramid_view) {
+        wgpuTextureViewRelease(pyramid_view);
+        pyramid_view = nullptr;
+    }
+
+    for (sReadbackSlot& slot : readback_slots) {
+        if (slot.buffer) {
+            wgpuBufferDestroy(slot.buffer);
+            wgpuBufferRelease(slot.buffer);
+        }
+
+        slot = {};
+    }
+
+    // Old data does not match the new size
+    readback_depth.clear();
+
+    depth_texture_view = nullptr;
+}
+
+bool HiZBuffer::build(WGPUCommandEncoder command_encoder, const glm::mat4x4& view_projection, bool read_back)
+{
+    const Pipeline& first_level_pipeline = multisampled ? copy_multisampled_pipeline : copy_pipeline;
+
+    if (!is_created() || !first_level_pipeline.is_loaded() || !downsample_pipeline.is_loaded()) {
+        return false;
+    }
+
+    this->view_projection = view_projection;
+
+    WGPUPassTimestampWrites timestamp_writes;
+    WGPUComputePassDescriptor compute_pass_desc = { .label = { "hiz_build_pass", WGPU_STRLEN } };
+    compute_pass_desc.timestampWrites = Renderer::instance->get_gpu_profiler()->get_pass_timestamp_writes("hiz_build", timestamp_writes);
+
+    WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
+
+    first_level_pipeline.set(compute_pass);
+
+    for (uint32_t level = 0; level < mip_count; ++level) {
+        if (level == 1) {
+            downsample_pipeline.set(compute_pass);
+        }
+
+        wgpuComputePassEncoderSetBindGroup(compute_pass, 0, level_bind_groups[level], 0, nullptr);
+
+        uint32_t level_width = std::max(width >> level, 1u);
+        uint32_t level_height = std::max(height >> level, 1u);
+
+        wgpuComputePassEncoderDispatchWorkgroups(compute_pass, (level_width + 7) / 8, (level_height + 7) / 8, 1);
+    }
+
+    wgpuComputePassEncoderEnd(compute_pass);
+    wgpuComputePassEncoderRelease(compute_pass);
+
+    sReadbackSlot& readback_slot = readback_slots[next_readback_slot];
+
+    if (read_back && !readback_slot.copy_pending && !readback_slot.in_flight) {
+        WGPUTexelCopyTextureInfo src_copy = {};
+        src_copy.texture = pyramid_texture.get_texture();
+        src_copy.mipLevel = readback_level;
+        src_copy.origin = { 0, 0, 0 };
+        src_copy.aspect = WGPUTextureAspect_All;
+
+        WGPUTexelCopyBufferInfo dst_copy = {};
+        dst_copy.buffer = readback_slot.buffer;
+        dst_copy.layout.offset = 0;
+        dst_copy.layout.bytesPerRow = readback_bytes_per_row;
+        dst_copy.layout.rowsPerImage = readback_height;
+
+        WGPUExtent3D copy_size = { readback_width, readback_height, 1 };
+
+        wgpuCommandEncoderCopyTextureToBuffer(command_encoder, &src_copy, &dst_copy, &copy_size);
+
+        readback_slot.copy_pending = true;
+        readback_slot.view_projection = view_projection;
+
+        next_readback_slot = (next_readback_slot + 1) % FrameRing::FRAME_COUNT;
+    }
+
+    return true;
+}
+
+void HiZBuffer::map_readback()
+{
+    for (sReadbackSlot& slot : readback_slots) {
+
+        if (!slot.copy_pending) {
+            continue;
+        }
+
+        slot.copy_pending = false;
+        slot.in_flight = true;
+
+        WGPUBufferMapCallbackInfo callback_info = {};
+        callback_info.mode = WGPUCallbackMode_AllowProcessEvents;
+        callback_info.userdata1 = this;
+        callback_info.userdata2 = slot.buffer;
+
+        callback_info.callback = [](WGPUMapAsyncStatus status, struct WGPUStringView message, void* userdata1, void* userdata2) {
+            HiZBuffer* hiz_buffer = reinterpret_cast<HiZBuffer*>(userdata1);
+            WGPUBuffer buffer = reinterpret_cast<WGPUBuffer>(userdata2);
+
+            sReadbackSlot* slot = nullptr;
+
+            for (sReadbackSlot& readback_slot : hiz_buffer->readback_slots) {
+                if (readback_slot.buffer == buffer) {
+                    slot = &readback_slot;
+                    break;
+                }
+            }
+
+            // Buffer recreated meanwhile (resize)
+            if (!slot) {
+                return;
+            }
+
+            slot->in_flight = false;
+
+            if (status != WGPUMapAsyncStatus_Success) {
+                return;
+            }
+
+            const uint8_t* mapped_data = reinterpret_cast<const uint8_t*>(wgpuBufferGetConstMappedRange(buffer, 0, hiz_buffer->readback_bytes_per_row * hiz_buffer->readback_height));
+
+            hiz_buffer->readback_depth.resize(hiz_buffer->readback_width * hiz_buffer->readback_height);
+
+            for (uint32_t y = 0; y < hiz_buffer->readback_height; ++y) {
+                memcpy(&hiz_buffer->readback_depth[y * hiz_buffer->readback_width], mapped_data + y * hiz_buffer->readback_bytes_per_row, hiz_buffer->readback_width * sizeof(float));
+            }
+
+            hiz_buffer->readback_view_projection = slot->view_projection;
+
+            wgpuBufferUnmap(buffer);
+        };
+
+        wgpuBufferMapAsync(slot.buffer, WGPUMapMode_Read, 0, readback_bytes_per_row * readback_height, callback_info);
+    }
+}
+
+bool HiZBuffer::get_screen_bounds(const glm::mat4x4& view_projection, const AABB& world_aabb, glm::vec4& uv_rect, float& nearest_depth)
+{
+    const glm::vec3 box_min = world_aabb.center - world_aabb.half_size;
+    const glm::vec3 box_max = world_aabb.center + world_aabb.half_size;
+
+    glm::vec2 uv_min = glm::vec2(1.0f);
+    glm::vec2 uv_max = glm::vec2(0.0f);
+    nearest_depth = 0.0f;
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        const glm::vec3 corner = {
+            (i & 1) ? box_max.x : box_min.x,
+            (i & 2) ? box_max.y : box_min.y,
+            (i & 4) ? box_max.z : box_min.z
+        };
+
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+
+        if (clip.w <= 0.0f) {
+            return false;
+        }
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        const glm::vec2 uv = { ndc.x * 0.5f + 0.5f, 0.5f - ndc.y * 0.5f };
+
+        uv_min = glm::min(uv_min, uv);
+        uv_max = glm::max(uv_max, uv);
+
+        // Reverse-Z, nearest is the biggest
+        nearest_depth = std::max(nearest_depth, ndc.z);
+    }
+
+    uv_rect = glm::vec4(glm::clamp(uv_min, 0.0f, 1.0f), glm::clamp(uv_max, 0.0f, 1.0f));
+
+    return true;
+}
+
+bool HiZBuffer::is_occluded(const AABB& world_aabb) const
+{
+    if (readback_depth.empty()) {
+        return false;
+    }
+
+    glm::vec4 uv_rect;
+    float nearest_depth;
+
+    if (!get_screen_bounds(readback_view_projection, world_aabb, uv_rect, nearest_depth)) {
+        return false;
+    }
+
+    // Level texels cover 2^level pixels, the last row/column also the remainder
+    auto to_texel = [&](float uv, uint32_t size, uint32_t level_size) {
+        uint32_t pixel = std::min(static_cast<uint32_t>(uv * static_cast<float>(size)), size - 1u);
+        return std::min(pixel >> readback_level, level_size - 1u);
+    };
+
+    const uint32_t x0 = to_texel(uv_rect.x, width, readback_width);
+    const uint32_t y0 = to_texel(uv_rect.y, height, readback_height);
+    const uint32_t x1 = to_texel(uv_rect.z, width, readback_width);
+    const uint32_t y1 = to_texel(uv_rect.w, height, readback_height);
+
+    for (uint32_t y = y0; y <= y1; ++y) {
+        for (uint32_t x = x0; x <= x1; ++x) {
+            if (nearest_depth >= readback_depth[y * readback_width + x]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
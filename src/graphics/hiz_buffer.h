@@ -0,0 +1,109 @@
+#pragma once
+
+#include "includes.h"
+#include "glm/glm.hpp"
+
+#include "graphics/frame_ring.h"
+#include "graphics/pipeline.h"
+#include "graphics/texture.h"
+#include "graphics/uniform.h"
+
+#include "framework/math/aabb.h"
+
+#include <vector>
+
+class Shader;
+
+enum eOcclusionCullingMode {
+    OCCLUSION_CULLING_DISABLED,
+    OCCLUSION_CULLING_GPU,          // Tested in the instance cull kernel, needs GPU culling
+    OCCLUSION_CULLING_CPU_READBACK  // Tested while filling the render lists, a coarse level is read back
+};
+
+// Hierarchical depth pyramid built from the previous frame depth buffer. Each texel stores the
+// farthest depth (reverse-Z, so the minimum) of the area it covers, so an object whose nearest
+// depth is farther than every texel under its screen rect is hidden behind what was drawn last frame
+class HiZBuffer {
+
+public:
+
+    HiZBuffer();
+    ~HiZBuffer();
+
+    void create(WGPUTextureView depth_texture_view, uint32_t width, uint32_t height, bool multisampled);
+    void destroy();
+
+    // Encodes the pyramid build from the current depth contents, rendered with view_projection.
+    // With read_back, a coarse level is also copied to be available on the CPU some frames later.
+    // Returns false if the pyramid could not be built yet
+    bool build(WGPUCommandEncoder command_encoder, const glm::mat4x4& view_projection, bool read_back);
+
+    // Call once the command encoder used in build has been submitted
+    void map_readback();
+
+    bool is_created() const { return depth_texture_view != nullptr; }
+
+    WGPUTextureView get_view() const { return pyramid_view; }
+    uint32_t get_width() const { return width; }
+    uint32_t get_height() const { return height; }
+    uint32_t get_mip_count() const { return mip_count; }
+    const glm::mat4x4& get_view_projection() const { return view_projection; }
+
+    bool has_readback_data() const { return !readback_depth.empty(); }
+
+    // Thread safe, uses the last data read back
+    bool is_occluded(const AABB& world_aabb) const;
+
+    // Screen rect in [0, 1] uv (y down) and nearest NDC depth of the box.
+    // Returns false if the box crosses the near plane, it can not be tested then
+    static bool get_screen_bounds(const glm::mat4x4& view_projection, const AABB& world_aabb, glm::vec4& uv_rect, float& nearest_depth);
+
+private:
+
+    static constexpr uint32_t MAX_READBACK_SIZE = 256;
+
+    Texture pyramid_texture;
+    WGPUTextureView pyramid_view = nullptr;
+    std::vector<WGPUTextureView> level_views;
+
+    WGPUTextureView depth_texture_view = nullptr;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mip_count = 0;
+
+    glm::mat4x4 view_projection = glm::mat4x4(1.0f);
+
+    bool multisampled = false;
+
+    Shader* copy_shader = nullptr;
+    Shader* copy_multisampled_shader = nullptr;
+    Shader* downsample_shader = nullptr;
+
+    Pipeline copy_pipeline;
+    Pipeline copy_multisampled_pipeline;
+    Pipeline downsample_pipeline;
+
+    // One per level, the first one reads the depth buffer
+    std::vector<WGPUBindGroup> level_bind_groups;
+
+    struct sReadbackSlot {
+        WGPUBuffer buffer = nullptr;
+        glm::mat4x4 view_projection = glm::mat4x4(1.0f);
+        bool copy_pending = false;
+        bool in_flight = false;
+    };
+
+    // CPU readback of a single level. A buffer per frame in flight, so a copy is made every frame
+    // while the previous ones are still being mapped
+    sReadbackSlot readback_slots[FrameRing::FRAME_COUNT];
+    uint32_t next_readback_slot = 0;
+
+    uint32_t readback_level = 0;
+    uint32_t readback_width = 0;
+    uint32_t readback_height = 0;
+    uint32_t readback_bytes_per_row = 0;
+
+    std::vector<float> readback_depth;
+    glm::mat4x4 readback_view_projection = glm::mat4x4(1.0f);
+};
@@ -0,0 +1,164 @@
+#include "instance_cull_kernel.h"
+
+#include "graphics/renderer_storage.h"
+#include "graphics/renderer.h"
+#include "graphics/staging_belt.h"
+#include "graphics/graphics_utils.h"
+#include "graphics/hiz_buffer.h"
+
+#include "framework/math/frustum_cull.h"
+
+#include "shaders/kernels/instance_cull.wgsl.gen.h"
+
+#include <cstring>
+
+InstanceCullKernel::InstanceCullKernel()
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    shader = RendererStorage::get_shader_from_source(shaders::instance_cull::source, shaders::instance_cull::path, shaders::instance_cull::libraries);
+
+    sCullData default_cull_data = {};
+    cull_data_uniform.data = webgpu_context->create_buffer(sizeof(sCullData), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &default_cull_data, "instance_cull_data");
+    cull_data_uniform.binding = 4;
+    cull_data_uniform.buffer_size = sizeof(sCullData);
+
+    instances_uniform.binding = 0;
+    batch_first_instance_uniform.binding = 1;
+    draw_args_uniform.binding = 2;
+    output_uniform.binding = 3;
+
+    float far_depth = 0.0f;
+    dummy_hiz_texture.create(WGPUTextureDimension_2D, WGPUTextureFormat_R32Float, { 1, 1, 1 },
+        static_cast<WGPUTextureUsage>(WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst), 1, 1, nullptr);
+    dummy_hiz_texture.update(&far_depth, 0, { 0, 0, 0 });
+    dummy_hiz_view = dummy_hiz_texture.get_view();
+
+    hiz_uniform.data = dummy_hiz_view;
+    hiz_uniform.binding = 5;
+
+    std::vector<WGPUConstantEntry> constants = {
+        { nullptr, get_string_view("WORKGROUP_SIZE"), static_cast<double>(WORKGROUP_SIZE) },
+    };
+
+    pipeline.create_compute_async(shader, "compute", constants);
+}
+
+InstanceCullKernel::~InstanceCullKernel()
+{
+    instances_uniform.destroy();
+    batch_first_instance_uniform.destroy();
+    draw_args_uniform.destroy();
+    cull_data_uniform.destroy();
+
+    if (bind_group) {
+        wgpuBindGroupRelease(bind_group);
+    }
+
+    wgpuTextureViewRelease(dummy_hiz_view);
+}
+
+bool InstanceCullKernel::ensure_capacity(Uniform& uniform, uint64_t byte_size, int usage, const char* label)
+{
+    if (uniform.buffer_size >= byte_size) {
+        return false;
+    }
+
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    if (std::holds_alternative<WGPUBuffer>(uniform.data)) {
+        webgpu_context->staging_belt->discard_writes(std::get<WGPUBuffer>(uniform.data));
+        wgpuBufferDestroy(std::get<WGPUBuffer>(uniform.data));
+    }
+
+    // Grow in powers of two to avoid recreating the buffers every few frames
+    uint64_t capacity = 256;
+    while (capacity < byte_size) {
+        capacity *= 2;
+    }
+
+    uniform.data = webgpu_context->create_buffer(capacity, usage, nullptr, label);
+    uniform.buffer_size = capacity;
+
+    return true;
+}
+
+void InstanceCullKernel::update(const Frustum& frustum, const std::vector<sCullInstance>& instances, const std::vector<sDrawArgs>& draw_args,
+                                const std::vector<uint32_t>& batch_first_instance, WGPUBuffer output_buffer, uint64_t output_byte_size,
+                                const HiZBuffer* hiz_buffer)
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    instance_count = static_cast<uint32_t>(instances.size());
+
+    if (instance_count == 0) {
+        return;
+    }
+
+    bool recreate_bind_group = !bind_group;
+
+    recreate_bind_group |= ensure_capacity(instances_uniform, sizeof(sCullInstance) * instances.size(),
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, "instance_cull_instances");
+
+    recreate_bind_group |= ensure_capacity(batch_first_instance_uniform, sizeof(uint32_t) * batch_first_instance.size(),
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, "instance_cull_batches");
+
+    recreate_bind_group |= ensure_capacity(draw_args_uniform, sizeof(sDrawArgs) * draw_args.size(),
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect, "instance_cull_draw_args");
+
+    if (!std::holds_alternative<WGPUBuffer>(output_uniform.data) || std::get<WGPUBuffer>(output_uniform.data) != output_buffer || output_uniform.buffer_size != output_byte_size) {
+        // Not owned by the kernel, never destroyed here
+        output_uniform.data = output_buffer;
+        output_uniform.buffer_size = output_byte_size;
+        recreate_bind_group = true;
+    }
+
+    WGPUTextureView hiz_view = hiz_buffer ? hiz_buffer->get_view() : dummy_hiz_view;
+
+    if (std::get<WGPUTextureView>(hiz_uniform.data) != hiz_view) {
+        hiz_uniform.data = hiz_view;
+        recreate_bind_group = true;
+    }
+
+    if (recreate_bind_group) {
+        if (bind_group) {
+            wgpuBindGroupRelease(bind_group);
+        }
+
+        std::vector<Uniform*> uniforms = { &instances_uniform, &batch_first_instance_uniform, &draw_args_uniform, &output_uniform, &cull_data_uniform, &hiz_uniform };
+        bind_group = webgpu_context->create_bind_group(uniforms, shader, 0, "instance_cull_bind_group");
+    }
+
+    sCullData cull_data;
+    memcpy(cull_data.planes, frustum.get_planes(), sizeof(cull_data.planes));
+    cull_data.instance_count = instance_count;
+
+    if (hiz_buffer) {
+        cull_data.occlusion_view_projection = hiz_buffer->get_view_projection();
+        cull_data.hiz_size = { hiz_buffer->get_width(), hiz_buffer->get_height() };
+        cull_data.hiz_mip_count = hiz_buffer->get_mip_count();
+        cull_data.occlusion_enabled = 1;
+    }
+
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(cull_data_uniform.data), 0, &cull_data, sizeof(sCullData));
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(instances_uniform.data), 0, instances.data(), sizeof(sCullInstance) * instances.size());
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(batch_first_instance_uniform.data), 0, batch_first_instance.data(), sizeof(uint32_t) * batch_first_instance.size());
+
+    // Instance counts start at zero, the kernel fills them
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(draw_args_uniform.data), 0, draw_args.data(), sizeof(sDrawArgs) * draw_args.size());
+}
+
+void InstanceCullKernel::dispatch(WGPUComputePassEncoder compute_pass)
+{
+    if (instance_count == 0 || !pipeline.set(compute_pass)) {
+        return;
+    }
+
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    uint32_t workgroup_count = (instance_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+    glm::uvec2 dispatch_size = find_optimal_dispatch_size(webgpu_context, workgroup_count);
+
+    wgpuComputePassEncoderSetBindGroup(compute_pass, 0, bind_group, 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups(compute_pass, dispatch_size.x, dispatch_size.y, 1);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "includes.h"
+#include "glm/glm.hpp"
+
+#include "graphics/pipeline.h"
+#include "graphics/texture.h"
+#include "graphics/uniform.h"
+
+#include <vector>
+
+class Frustum;
+class HiZBuffer;
+class Shader;
+
+// Frustum culls instances on the GPU, appending the visible models of each draw batch
+// to an instance buffer and counting them in indirect draw arguments
+class InstanceCullKernel {
+
+public:
+
+    struct sCullInstance {
+        glm::mat4x4 model;
+        glm::vec4 aabb_center;  // w: batch index (bit copy)
+        glm::vec4 aabb_extent;  // w: 1.0 if never culled
+    };
+
+    // Indexed: index_count, instance_count, first_index, base_vertex, first_instance
+    // Non indexed: vertex_count, instance_count, first_vertex, first_instance, (unused)
+    struct sDrawArgs {
+        uint32_t data[5] = {};
+    };
+
+    InstanceCullKernel();
+    ~InstanceCullKernel();
+
+    // Uploads this frame instances and batches, output_buffer receives the compacted models.
+    // Instances are also tested against hiz_buffer when not null
+    void update(const Frustum& frustum, const std::vector<sCullInstance>& instances, const std::vector<sDrawArgs>& draw_args,
+                const std::vector<uint32_t>& batch_first_instance, WGPUBuffer output_buffer, uint64_t output_byte_size,
+                const HiZBuffer* hiz_buffer = nullptr);
+
+    void dispatch(WGPUComputePassEncoder compute_pass);
+
+    WGPUBuffer get_draw_args_buffer() const { return std::get<WGPUBuffer>(draw_args_uniform.data); }
+
+private:
+
+    struct sCullData {
+        glm::vec4 planes[6];
+        glm::mat4x4 occlusion_view_projection;
+        glm::vec2 hiz_size = {};
+        uint32_t hiz_mip_count = 1;
+        uint32_t instance_count = 0;
+        uint32_t occlusion_enabled = 0;
+        uint32_t padding[3] = {};
+    };
+
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    Shader* shader = nullptr;
+    Pipeline pipeline;
+
+    Uniform instances_uniform;
+    Uniform batch_first_instance_uniform;
+    Uniform draw_args_uniform;
+    Uniform output_uniform;
+    Uniform cull_data_uniform;
+    Uniform hiz_uniform;
+
+    // Bound while occlusion culling is off
+    Texture dummy_hiz_texture;
+    WGPUTextureView dummy_hiz_view = nullptr;
+
+    WGPUBindGroup bind_group = nullptr;
+
+    uint32_t instance_count = 0;
+
+    // Returns true if the buffer was recreated
+    bool ensure_capacity(Uniform& uniform, uint64_t byte_size, int usage, const char* label);
+};
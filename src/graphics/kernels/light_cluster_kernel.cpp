@@ -0,0 +1,167 @@
+#include "light_cluster_kernel.h"
+
+#include "graphics/renderer_storage.h"
+#include "graphics/renderer.h"
+#include "graphics/graphics_utils.h"
+
+#include "framework/camera/camera.h"
+
+#include "shaders/kernels/light_cluster.wgsl.gen.h"
+
+#include "framework/utils/cpu_profiler.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool LightClusterKernel::overflow_reported = false;
+
+LightClusterKernel::LightClusterKernel()
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    shader = RendererStorage::get_shader_from_source(shaders::light_cluster::source, shaders::light_cluster::path, shaders::light_cluster::libraries);
+
+    sLightClusterData default_cluster_data = {};
+    cluster_data_uniform.data = webgpu_context->create_buffer(sizeof(sLightClusterData), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &default_cluster_data, "light_cluster_data");
+    cluster_data_uniform.binding = 4;
+    cluster_data_uniform.buffer_size = sizeof(sLightClusterData);
+
+    // Count followed by the light indices, per cluster
+    uint64_t cluster_lights_size = sizeof(uint32_t) * CLUSTER_COUNT * (MAX_LIGHTS_PER_CLUSTER + 1);
+    cluster_lights_uniform.data = webgpu_context->create_buffer(cluster_lights_size, WGPUBufferUsage_Storage, nullptr, "light_cluster_lights");
+    cluster_lights_uniform.binding = 7;
+    cluster_lights_uniform.buffer_size = cluster_lights_size;
+
+    sOverflowStats default_overflow_stats = {};
+    overflow_stats_uniform.data = webgpu_context->create_buffer(sizeof(sOverflowStats), WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc | WGPUBufferUsage_Storage, &default_overflow_stats, "light_cluster_overflow_stats");
+    overflow_stats_uniform.binding = 8;
+    overflow_stats_uniform.buffer_size = sizeof(sOverflowStats);
+
+    overflow_readback_buffer = webgpu_context->create_buffer(sizeof(sOverflowStats), WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead, nullptr, "light_cluster_overflow_readback");
+
+    std::vector<WGPUConstantEntry> constants = {
+        { nullptr, get_string_view("WORKGROUP_SIZE"), static_cast<double>(WORKGROUP_SIZE) },
+    };
+
+    pipeline.create_compute_async(shader, "compute", constants);
+}
+
+LightClusterKernel::~LightClusterKernel()
+{
+#ifndef __EMSCRIPTEN__
+    // The map callback points to the kernel
+    while (overflow_mapping) {
+        Renderer::instance->get_webgpu_context()->process_events();
+    }
+#endif
+
+    cluster_data_uniform.destroy();
+    cluster_lights_uniform.destroy();
+    overflow_stats_uniform.destroy();
+
+    wgpuBufferDestroy(overflow_readback_buffer);
+    wgpuBufferRelease(overflow_readback_buffer);
+
+    if (bind_group) {
+        wgpuBindGroupRelease(bind_group);
+    }
+}
+
+void LightClusterKernel::update(const Camera& camera, float z_near, float z_far, Uniform* lights_uniform, uint32_t light_count)
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    WGPUBuffer lights_buffer = std::get<WGPUBuffer>(lights_uniform->data);
+
+    if (!bind_group || bound_lights_buffer != lights_buffer) {
+        if (bind_group) {
+            wgpuBindGroupRelease(bind_group);
+        }
+
+        std::vector<Uniform*> uniforms = { lights_uniform, &cluster_data_uniform, &cluster_lights_uniform, &overflow_stats_uniform };
+        bind_group = webgpu_context->create_bind_group(uniforms, shader, 0, "light_cluster_bind_group");
+
+        bound_lights_buffer = lights_buffer;
+    }
+
+    sLightClusterData cluster_data;
+    cluster_data.view = camera.get_view();
+    cluster_data.view_projection = camera.get_view_projection();
+    cluster_data.inverse_projection = glm::inverse(camera.get_projection());
+    cluster_data.z_near = std::max(std::min(z_near, z_far), 1e-4f);
+    cluster_data.z_far = std::max(std::max(z_near, z_far), cluster_data.z_near * 2.0f);
+    cluster_data.light_count = light_count;
+
+    // slice = log(depth) * scale - bias, inverse of the exponential distribution of the kernel
+    float log_depth_ratio = std::log(cluster_data.z_far / cluster_data.z_near);
+    cluster_data.slice_scale = static_cast<float>(GRID_SIZE_Z) / log_depth_ratio;
+    cluster_data.slice_bias = static_cast<float>(GRID_SIZE_Z) * std::log(cluster_data.z_near) / log_depth_ratio;
+
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(cluster_data_uniform.data), 0, &cluster_data, sizeof(sLightClusterData));
+
+    // The staged writes land before the passes, so a second update in the same frame keeps both dispatches counted
+    sOverflowStats cleared_stats = {};
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(overflow_stats_uniform.data), 0, &cleared_stats, sizeof(sOverflowStats));
+}
+
+void LightClusterKernel::dispatch(WGPUComputePassEncoder compute_pass)
+{
+    if (!bind_group || !pipeline.set(compute_pass)) {
+        return;
+    }
+
+    wgpuComputePassEncoderSetBindGroup(compute_pass, 0, bind_group, 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups(compute_pass, (CLUSTER_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+void LightClusterKernel::copy_overflow_stats(WGPUCommandEncoder command_encoder)
+{
+    if (!bind_group || overflow_copy_pending || overflow_mapping) {
+        return;
+    }
+
+    wgpuCommandEncoderCopyBufferToBuffer(command_encoder, std::get<WGPUBuffer>(overflow_stats_uniform.data), 0, overflow_readback_buffer, 0, sizeof(sOverflowStats));
+
+    overflow_copy_pending = true;
+}
+
+void LightClusterKernel::map_overflow_stats()
+{
+    if (!overflow_copy_pending) {
+        return;
+    }
+
+    overflow_copy_pending = false;
+    overflow_mapping = true;
+
+    WGPUBufferMapCallbackInfo callback_info = {};
+    callback_info.mode = WGPUCallbackMode_AllowProcessEvents;
+    callback_info.userdata1 = this;
+
+    callback_info.callback = [](WGPUMapAsyncStatus status, struct WGPUStringView message, void* userdata1, void* userdata2) {
+        LightClusterKernel* kernel = reinterpret_cast<LightClusterKernel*>(userdata1);
+
+        kernel->overflow_mapping = false;
+
+        if (status != WGPUMapAsyncStatus_Success) {
+            return;
+        }
+
+        const sOverflowStats* mapped_stats = reinterpret_cast<const sOverflowStats*>(wgpuBufferGetConstMappedRange(kernel->overflow_readback_buffer, 0, sizeof(sOverflowStats)));
+        kernel->overflow_stats = *mapped_stats;
+
+        wgpuBufferUnmap(kernel->overflow_readback_buffer);
+
+        PROFILE_COUNTER_SET("cluster_lights_dropped", kernel->overflow_stats.dropped_lights);
+
+        if (kernel->overflow_stats.dropped_lights > 0 && !overflow_reported) {
+            spdlog::warn("Light clusters: {} lights dropped from {} clusters over the cap of {} lights per cluster",
+                kernel->overflow_stats.dropped_lights, kernel->overflow_stats.clusters, MAX_LIGHTS_PER_CLUSTER);
+            overflow_reported = true;
+        }
+    };
+
+    wgpuBufferMapAsync(overflow_readback_buffer, WGPUMapMode_Read, 0, sizeof(sOverflowStats), callback_info);
+}
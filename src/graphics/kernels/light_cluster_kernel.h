@@ -0,0 +1,91 @@
+#pragma once
+
+#include "includes.h"
+#include "glm/glm.hpp"
+
+#include "graphics/pipeline.h"
+#include "graphics/uniform.h"
+
+class Camera;
+class Shader;
+
+// Bins the lights into a view space froxel grid. Each cluster stores the count and indices of
+// the lights that reach it, so the forward pass only shades with the lights of its cluster
+class LightClusterKernel {
+
+public:
+
+    static constexpr uint32_t GRID_SIZE_X = 16;
+    static constexpr uint32_t GRID_SIZE_Y = 9;
+    static constexpr uint32_t GRID_SIZE_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = GRID_SIZE_X * GRID_SIZE_Y * GRID_SIZE_Z;
+
+    // Lights past this count in a single cluster are dropped, see get_overflow_stats()
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 63;
+
+    // Clusters that reached more lights than the cap and the lights left out of them, summed over the dispatches of a frame
+    struct sOverflowStats {
+        uint32_t clusters = 0;
+        uint32_t dropped_lights = 0;
+    };
+
+    LightClusterKernel();
+    ~LightClusterKernel();
+
+    // The lights uniform is owned by the renderer, the bind group is rebuilt when its buffer changes.
+    // Near and far can come in any order (reverse-Z cameras swap them)
+    void update(const Camera& camera, float z_near, float z_far, Uniform* lights_uniform, uint32_t light_count);
+
+    void dispatch(WGPUComputePassEncoder compute_pass);
+
+    // Copies the overflow counters of the frame to the readback buffer, skipped while the previous copy is still mapping
+    void copy_overflow_stats(WGPUCommandEncoder command_encoder);
+
+    // Call after submitting the copy
+    void map_overflow_stats();
+
+    // Last counters read back, a few frames late
+    const sOverflowStats& get_overflow_stats() const { return overflow_stats; }
+
+    // Bindings 4 and 7 of the lighting bind group
+    Uniform* get_cluster_data_uniform() { return &cluster_data_uniform; }
+    Uniform* get_cluster_lights_uniform() { return &cluster_lights_uniform; }
+
+private:
+
+    struct sLightClusterData {
+        glm::mat4x4 view;
+        glm::mat4x4 view_projection;
+        glm::mat4x4 inverse_projection;
+        glm::uvec3 grid_size = { GRID_SIZE_X, GRID_SIZE_Y, GRID_SIZE_Z };
+        uint32_t max_cluster_lights = MAX_LIGHTS_PER_CLUSTER;
+        float z_near = 0.01f;
+        float z_far = 1000.0f;
+        float slice_scale = 0.0f;
+        float slice_bias = 0.0f;
+        uint32_t light_count = 0;
+        uint32_t padding[3] = {};
+    };
+
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    Shader* shader = nullptr;
+    Pipeline pipeline;
+
+    Uniform cluster_data_uniform;
+    Uniform cluster_lights_uniform;
+    // Binding 8, only in the kernel
+    Uniform overflow_stats_uniform;
+
+    WGPUBuffer overflow_readback_buffer = nullptr;
+    bool overflow_copy_pending = false;
+    bool overflow_mapping = false;
+
+    sOverflowStats overflow_stats;
+
+    // Warn once about the dropped lights, whichever kernel finds them first
+    static bool overflow_reported;
+
+    WGPUBuffer bound_lights_buffer = nullptr;
+    WGPUBindGroup bind_group = nullptr;
+};
@@ -0,0 +1,330 @@
+#include "meshlet_cull_kernel.h"
+
+#include "graphics/renderer_storage.h"
+#include "graphics/renderer.h"
+#include "graphics/staging_belt.h"
+#include "graphics/graphics_utils.h"
+#include "graphics/geometry_arena.h"
+#include "graphics/hiz_buffer.h"
+#include "graphics/mesh_optimizer.h"
+
+#include "framework/math/frustum_cull.h"
+
+#include "shaders/kernels/meshlet_cull.wgsl.gen.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+    // Moves the first element of a range back so that its byte offset can be bound
+    uint64_t align_first_element(uint64_t first, uint64_t stride, uint64_t alignment)
+    {
+        uint64_t step = alignment / std::gcd(stride, alignment);
+        return first - first % step;
+    }
+
+    uint64_t get_binding_size(uint64_t first, uint64_t end, uint64_t stride, uint64_t alignment)
+    {
+        return (end - align_first_element(first, stride, alignment)) * stride;
+    }
+}
+
+MeshletCullKernel::MeshletCullKernel()
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    shader = RendererStorage::get_shader_from_source(shaders::meshlet_cull::source, shaders::meshlet_cull::path, shaders::meshlet_cull::libraries);
+
+    cull_data_stride = std::max(static_cast<uint32_t>(sizeof(sCullData)), webgpu_context->required_limits.minUniformBufferOffsetAlignment);
+
+    draws_uniform.binding = 0;
+    draw_args_uniform.binding = 4;
+
+    float far_depth = 0.0f;
+    dummy_hiz_texture.create(WGPUTextureDimension_2D, WGPUTextureFormat_R32Float, { 1, 1, 1 },
+        static_cast<WGPUTextureUsage>(WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst), 1, 1, nullptr);
+    dummy_hiz_texture.update(&far_depth, 0, { 0, 0, 0 });
+    dummy_hiz_view = dummy_hiz_texture.get_view();
+
+    hiz_uniform.data = dummy_hiz_view;
+    hiz_uniform.binding = 6;
+
+    std::vector<WGPUConstantEntry> constants = {
+        { nullptr, get_string_view("WORKGROUP_SIZE"), static_cast<double>(WORKGROUP_SIZE) },
+    };
+
+    pipeline.create_compute_async(shader, "compute", constants);
+}
+
+MeshletCullKernel::~MeshletCullKernel()
+{
+    draws_uniform.destroy();
+    output_indices_uniform.destroy();
+    draw_args_uniform.destroy();
+    cull_data_uniform.destroy();
+
+    for (sWindow& window : windows) {
+        if (window.bind_group) {
+            wgpuBindGroupRelease(window.bind_group);
+        }
+    }
+
+    wgpuTextureViewRelease(dummy_hiz_view);
+}
+
+bool MeshletCullKernel::ensure_capacity(Uniform& uniform, uint64_t byte_size, int usage, const char* label)
+{
+    if (uniform.buffer_size >= byte_size) {
+        return false;
+    }
+
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    if (std::holds_alternative<WGPUBuffer>(uniform.data)) {
+        webgpu_context->staging_belt->discard_writes(std::get<WGPUBuffer>(uniform.data));
+        wgpuBufferDestroy(std::get<WGPUBuffer>(uniform.data));
+    }
+
+    // Grow in powers of two to avoid recreating the buffers every few frames
+    uint64_t capacity = 256;
+    while (capacity < byte_size) {
+        capacity *= 2;
+    }
+
+    uniform.data = webgpu_context->create_buffer(capacity, usage, nullptr, label);
+    uniform.buffer_size = capacity;
+
+    return true;
+}
+
+bool MeshletCullKernel::bind_range(Uniform& uniform, WGPUBuffer buffer, uint64_t byte_offset, uint64_t byte_size)
+{
+    if (std::holds_alternative<WGPUBuffer>(uniform.data) && std::get<WGPUBuffer>(uniform.data) == buffer &&
+        uniform.buffer_offset == byte_offset && uniform.buffer_size == byte_size) {
+        return false;
+    }
+
+    uniform.data = buffer;
+    uniform.buffer_offset = byte_offset;
+    uniform.buffer_size = byte_size;
+
+    return true;
+}
+
+bool MeshletCullKernel::fits_binding(uint32_t index_count, uint32_t meshlet_count)
+{
+    const WGPULimits& limits = Renderer::instance->get_webgpu_context()->supported_limits;
+
+    // The window may start up to one alignment before the range
+    uint64_t max_size = limits.maxStorageBufferBindingSize - limits.minStorageBufferOffsetAlignment;
+
+    return static_cast<uint64_t>(index_count) * sizeof(uint32_t) <= max_size && static_cast<uint64_t>(meshlet_count) * sizeof(sMeshlet) <= max_size;
+}
+
+void MeshletCullKernel::update(const Frustum& frustum, const glm::vec3& eye, std::vector<sMeshletDraw>& draws, std::vector<sDrawArgs>& draw_args,
+                               const std::vector<uint32_t>& draw_first_indices, const std::vector<uint32_t>& draw_index_counts, const HiZBuffer* hiz_buffer)
+{
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+    GeometryArena* geometry_arena = GeometryArena::instance;
+
+    assert(draws.size() == draw_args.size() && draws.size() == draw_first_indices.size() && draws.size() == draw_index_counts.size());
+
+    window_count = 0;
+
+    if (draws.empty()) {
+        return;
+    }
+
+    // Each draw gets an output range as large as all its meshlets, counts are filled by the kernel
+    uint32_t work_count = 0;
+    uint32_t output_index_count = 0;
+
+    for (size_t i = 0; i < draws.size(); ++i) {
+        draws[i].first_work = work_count;
+        draws[i].output_first_index = output_index_count;
+
+        draw_args[i].data[0] = 0;
+        draw_args[i].data[2] = output_index_count;
+
+        work_count += draws[i].meshlet_count;
+        output_index_count += draw_index_counts[i];
+    }
+
+    bool recreate_bind_groups = false;
+
+    recreate_bind_groups |= ensure_capacity(draws_uniform, sizeof(sMeshletDraw) * draws.size(),
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, "meshlet_cull_draws");
+
+    ensure_capacity(output_indices_uniform, sizeof(uint32_t) * output_index_count,
+        WGPUBufferUsage_Storage | WGPUBufferUsage_Index, "meshlet_cull_indices");
+
+    recreate_bind_groups |= ensure_capacity(draw_args_uniform, sizeof(sDrawArgs) * draw_args.size(),
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect, "meshlet_cull_draw_args");
+
+    WGPUTextureView hiz_view = hiz_buffer ? hiz_buffer->get_view() : dummy_hiz_view;
+
+    if (std::get<WGPUTextureView>(hiz_uniform.data) != hiz_view) {
+        hiz_uniform.data = hiz_view;
+        recreate_bind_groups = true;
+    }
+
+    // Consecutive draws share a window while the union of their ranges fits in a storage binding
+    const WGPULimits& limits = webgpu_context->supported_limits;
+    uint64_t max_binding_size = limits.maxStorageBufferBindingSize;
+    uint64_t alignment = limits.minStorageBufferOffsetAlignment;
+
+    uint64_t meshlet_first = 0, meshlet_end = 0;
+    uint64_t index_first = 0, index_end = 0;
+    uint64_t output_first = 0, output_end = 0;
+
+    std::vector<uint32_t> window_bases;
+
+    auto close_window = [&]() {
+        sWindow& window = windows[window_count - 1];
+
+        uint64_t meshlet_base = align_first_element(meshlet_first, sizeof(sMeshlet), alignment);
+        uint64_t index_base = align_first_element(index_first, sizeof(uint32_t), alignment);
+        uint64_t output_base = align_first_element(output_first, sizeof(uint32_t), alignment);
+
+        bool changed = bind_range(window.meshlets_uniform, geometry_arena->get_meshlet_buffer(),
+            meshlet_base * sizeof(sMeshlet), (meshlet_end - meshlet_base) * sizeof(sMeshlet));
+
+        changed |= bind_range(window.indices_uniform, geometry_arena->get_index_buffer(WGPUIndexFormat_Uint32),
+            index_base * sizeof(uint32_t), (index_end - index_base) * sizeof(uint32_t));
+
+        changed |= bind_range(window.output_indices_uniform, std::get<WGPUBuffer>(output_indices_uniform.data),
+            output_base * sizeof(uint32_t), (output_end - output_base) * sizeof(uint32_t));
+
+        window_bases.push_back(static_cast<uint32_t>(meshlet_base));
+        window_bases.push_back(static_cast<uint32_t>(index_base));
+        window_bases.push_back(static_cast<uint32_t>(output_base));
+
+        if (changed && window.bind_group) {
+            wgpuBindGroupRelease(window.bind_group);
+            window.bind_group = nullptr;
+        }
+    };
+
+    for (uint32_t i = 0; i < draws.size(); ++i) {
+        assert(fits_binding(draw_index_counts[i], draws[i].meshlet_count));
+
+        uint64_t draw_meshlet_end = draws[i].first_meshlet + draws[i].meshlet_count;
+        uint64_t draw_index_end = static_cast<uint64_t>(draw_first_indices[i]) + draw_index_counts[i];
+        uint64_t draw_output_end = static_cast<uint64_t>(draws[i].output_first_index) + draw_index_counts[i];
+
+        bool fits = window_count > 0 &&
+            get_binding_size(std::min<uint64_t>(meshlet_first, draws[i].first_meshlet), std::max(meshlet_end, draw_meshlet_end), sizeof(sMeshlet), alignment) <= max_binding_size &&
+            get_binding_size(std::min<uint64_t>(index_first, draw_first_indices[i]), std::max(index_end, draw_index_end), sizeof(uint32_t), alignment) <= max_binding_size &&
+            get_binding_size(output_first, draw_output_end, sizeof(uint32_t), alignment) <= max_binding_size;
+
+        if (fits) {
+            meshlet_first = std::min<uint64_t>(meshlet_first, draws[i].first_meshlet);
+            meshlet_end = std::max(meshlet_end, draw_meshlet_end);
+            index_first = std::min<uint64_t>(index_first, draw_first_indices[i]);
+            index_end = std::max(index_end, draw_index_end);
+            output_end = draw_output_end;
+        } else {
+            if (window_count > 0) {
+                close_window();
+            }
+
+            window_count++;
+
+            if (windows.size() < window_count) {
+                windows.resize(window_count);
+            }
+
+            sWindow& window = windows[window_count - 1];
+            window.first_draw = i;
+            window.draw_count = 0;
+            window.first_work = draws[i].first_work;
+            window.work_count = 0;
+            window.meshlets_uniform.binding = 1;
+            window.indices_uniform.binding = 2;
+            window.output_indices_uniform.binding = 3;
+            window.cull_data_uniform.binding = 5;
+
+            meshlet_first = draws[i].first_meshlet;
+            meshlet_end = draw_meshlet_end;
+            index_first = draw_first_indices[i];
+            index_end = draw_index_end;
+            output_first = draws[i].output_first_index;
+            output_end = draw_output_end;
+        }
+
+        sWindow& window = windows[window_count - 1];
+        window.draw_count++;
+        window.work_count += draws[i].meshlet_count;
+    }
+
+    close_window();
+
+    recreate_bind_groups |= ensure_capacity(cull_data_uniform, static_cast<uint64_t>(cull_data_stride) * window_count,
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, "meshlet_cull_data");
+
+    sCullData cull_data;
+    memcpy(cull_data.planes, frustum.get_planes(), sizeof(cull_data.planes));
+    cull_data.eye = eye;
+    cull_data.cone_culling_enabled = cone_culling_enabled ? 1 : 0;
+
+    if (hiz_buffer) {
+        cull_data.occlusion_view_projection = hiz_buffer->get_view_projection();
+        cull_data.hiz_size = { hiz_buffer->get_width(), hiz_buffer->get_height() };
+        cull_data.hiz_mip_count = hiz_buffer->get_mip_count();
+        cull_data.occlusion_enabled = 1;
+    }
+
+    cull_data_upload.resize(static_cast<size_t>(cull_data_stride) * window_count);
+
+    for (uint32_t w = 0; w < window_count; ++w) {
+        sWindow& window = windows[w];
+
+        cull_data.work_count = window.work_count;
+        cull_data.draw_count = window.draw_count;
+        cull_data.first_work = window.first_work;
+        cull_data.first_draw = window.first_draw;
+        cull_data.meshlet_base = window_bases[w * 3];
+        cull_data.index_base = window_bases[w * 3 + 1];
+        cull_data.output_base = window_bases[w * 3 + 2];
+
+        memcpy(cull_data_upload.data() + static_cast<size_t>(cull_data_stride) * w, &cull_data, sizeof(sCullData));
+
+        bool changed = bind_range(window.cull_data_uniform, std::get<WGPUBuffer>(cull_data_uniform.data),
+            static_cast<uint64_t>(cull_data_stride) * w, sizeof(sCullData));
+
+        if (window.bind_group && (changed || recreate_bind_groups)) {
+            wgpuBindGroupRelease(window.bind_group);
+            window.bind_group = nullptr;
+        }
+
+        if (!window.bind_group) {
+            std::vector<Uniform*> uniforms = { &draws_uniform, &window.meshlets_uniform, &window.indices_uniform, &window.output_indices_uniform,
+                &draw_args_uniform, &window.cull_data_uniform, &hiz_uniform };
+            window.bind_group = webgpu_context->create_bind_group(uniforms, shader, 0, "meshlet_cull_bind_group");
+        }
+    }
+
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(cull_data_uniform.data), 0, cull_data_upload.data(), cull_data_upload.size());
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(draws_uniform.data), 0, draws.data(), sizeof(sMeshletDraw) * draws.size());
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(draw_args_uniform.data), 0, draw_args.data(), sizeof(sDrawArgs) * draw_args.size());
+}
+
+void MeshletCullKernel::dispatch(WGPUComputePassEncoder compute_pass)
+{
+    if (window_count == 0 || !pipeline.set(compute_pass)) {
+        return;
+    }
+
+    WebGPUContext* webgpu_context = Renderer::instance->get_webgpu_context();
+
+    for (uint32_t w = 0; w < window_count; ++w) {
+        const sWindow& window = windows[w];
+
+        // One workgroup per meshlet
+        glm::uvec2 dispatch_size = find_optimal_dispatch_size(webgpu_context, window.work_count);
+
+        wgpuComputePassEncoderSetBindGroup(compute_pass, 0, window.bind_group, 0, nullptr);
+        wgpuComputePassEncoderDispatchWorkgroups(compute_pass, dispatch_size.x, dispatch_size.y, 1);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "includes.h"
+#include "glm/glm.hpp"
+
+#include "graphics/pipeline.h"
+#include "graphics/texture.h"
+#include "graphics/uniform.h"
+
+#include "graphics/kernels/instance_cull_kernel.h"
+
+#include <vector>
+
+class Frustum;
+class HiZBuffer;
+class Shader;
+
+// Culls the meshlets of each draw on the GPU (frustum, normal cone and optionally Hi-Z) and copies the
+// indices of the visible ones to a compacted index buffer, drawn with one indexed indirect call per draw.
+// The arena buffers only bind the ranges of the culled surfaces, split in several dispatches when they
+// do not fit in a storage binding
+class MeshletCullKernel {
+
+public:
+
+    struct sMeshletDraw {
+        glm::mat4x4 model;
+        uint32_t first_meshlet = 0;
+        uint32_t meshlet_count = 0;
+        uint32_t first_work = 0;            // filled by update()
+        uint32_t output_first_index = 0;    // filled by update()
+    };
+
+    // Same layout as the instance cull arguments, index counts start at zero
+    using sDrawArgs = InstanceCullKernel::sDrawArgs;
+
+    MeshletCullKernel();
+    ~MeshletCullKernel();
+
+    // draw_args[i] must hold the instance count, base vertex and first instance of draws[i]. The index
+    // range of each draw is the one of its surface in the arena, its count is the output range reserved for it
+    void update(const Frustum& frustum, const glm::vec3& eye, std::vector<sMeshletDraw>& draws, std::vector<sDrawArgs>& draw_args,
+                const std::vector<uint32_t>& draw_first_indices, const std::vector<uint32_t>& draw_index_counts, const HiZBuffer* hiz_buffer = nullptr);
+
+    void dispatch(WGPUComputePassEncoder compute_pass);
+
+    void set_cone_culling_enabled(bool value) { cone_culling_enabled = value; }
+
+    WGPUBuffer get_draw_args_buffer() const { return std::get<WGPUBuffer>(draw_args_uniform.data); }
+    WGPUBuffer get_index_buffer() const { return std::get<WGPUBuffer>(output_indices_uniform.data); }
+
+    // Whether the indices and meshlets of a surface fit in a single binding window
+    static bool fits_binding(uint32_t index_count, uint32_t meshlet_count);
+
+private:
+
+    struct sCullData {
+        glm::vec4 planes[6];
+        glm::mat4x4 occlusion_view_projection;
+        glm::vec3 eye = {};
+        uint32_t work_count = 0;
+        glm::vec2 hiz_size = {};
+        uint32_t hiz_mip_count = 1;
+        uint32_t draw_count = 0;
+        uint32_t occlusion_enabled = 0;
+        uint32_t cone_culling_enabled = 1;
+        // Work and draws of the window, the bases are the first elements of its bound ranges
+        uint32_t first_work = 0;
+        uint32_t first_draw = 0;
+        uint32_t meshlet_base = 0;
+        uint32_t index_base = 0;
+        uint32_t output_base = 0;
+        uint32_t padding = 0;
+    };
+
+    // Consecutive draws dispatched together, with their own ranges of the meshlet and index buffers
+    struct sWindow {
+        uint32_t first_draw = 0;
+        uint32_t draw_count = 0;
+        uint32_t first_work = 0;
+        uint32_t work_count = 0;
+
+        Uniform meshlets_uniform;
+        Uniform indices_uniform;
+        Uniform output_indices_uniform;
+        Uniform cull_data_uniform;
+
+        WGPUBindGroup bind_group = nullptr;
+    };
+
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    Shader* shader = nullptr;
+    Pipeline pipeline;
+
+    Uniform draws_uniform;
+    Uniform output_indices_uniform;
+    Uniform draw_args_uniform;
+    // The cull data of every window, each one aligned to bind it at its own offset
+    Uniform cull_data_uniform;
+    Uniform hiz_uniform;
+
+    uint32_t cull_data_stride = 0;
+    std::vector<uint8_t> cull_data_upload;
+
+    // Bound while occlusion culling is off
+    Texture dummy_hiz_texture;
+    WGPUTextureView dummy_hiz_view = nullptr;
+
+    // Only the first window_count are used this frame, the others keep their bind groups
+    std::vector<sWindow> windows;
+    uint32_t window_count = 0;
+
+    bool cone_culling_enabled = true;
+
+    // Returns true if the buffer was recreated
+    bool ensure_capacity(Uniform& uniform, uint64_t byte_size, int usage, const char* label);
+
+    // Returns true if the binding changed, the bound buffers are not owned by the window
+    bool bind_range(Uniform& uniform, WGPUBuffer buffer, uint64_t byte_offset, uint64_t byte_size);
+};
@@ -8,6 +8,8 @@
 
 #define UNREF_TEXTURE(x) if(x) { x->unref(); }
 
+uint32_t Material::last_material_id = 0;
+
 Material::Material()
 {
     properties["color"] = &color;
@@ -214,6 +214,7 @@ public:
     eCullType get_cull_type() const;
     eMaterialType get_type() const;
     uint8_t get_priority() const;
+    uint32_t get_sort_id() const { return sort_id.value; }
 
     const Shader* get_shader() const;
     Shader* get_shader_ref();
@@ -286,4 +287,17 @@ private:
 
     eMaterialType type = MATERIAL_PBR;
     uint8_t priority = 10;
+
+    static uint32_t last_material_id;
+
+    // Stable id used to build render list sort keys. Copies take a new one, equal ids would merge their batches
+    struct sSortId {
+        uint32_t value = last_material_id++;
+
+        sSortId() = default;
+        sSortId(const sSortId&) : value(last_material_id++) {}
+        sSortId& operator=(const sSortId&) { return *this; }
+    };
+
+    sSortId sort_id;
 };
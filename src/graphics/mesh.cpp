@@ -39,6 +39,7 @@ void Mesh::set_surface_material_override(Surface* surface, Material* material)
 {
     material->ref();
     material_overrides[surface] = material;
+    revision++;
 }
 
 void Mesh::set_frustum_culling_enabled(bool enabled)
@@ -53,8 +54,11 @@ bool Mesh::get_frustum_culling_enabled() const
 
 Material* Mesh::get_surface_material_override(Surface* surface)
 {
-    if (material_overrides.contains(surface)) {
-        return material_overrides[surface];
+    // Called from the culling threads, lookup only
+    auto it = material_overrides.find(surface);
+
+    if (it != material_overrides.end()) {
+        return it->second;
     }
 
     return nullptr;
@@ -64,6 +68,7 @@ void Mesh::add_surface(Surface* surface)
 {
     surface->ref();
     surfaces.push_back(surface);
+    revision++;
 }
 
 Surface* Mesh::get_surface(int surface_idx) const
@@ -116,6 +121,7 @@ void Mesh::render_gui()
 
                 ImGui::Checkbox("Receive Shadows", &receive_shadows);
                 ImGui::Checkbox("Frustum Culling", &frustum_culling_enabled);
+                ImGui::Checkbox("Occluder", &occluder);
 
                 Material* material = get_surface_material_override(surface);
                 if (!material) {
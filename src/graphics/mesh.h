@@ -25,6 +25,12 @@ protected:
     bool frustum_culling_enabled = true;
     bool receive_shadows = false;
 
+    // Rasterized in the software occlusion buffer, surfaces need their vertex data stored on the CPU
+    bool occluder = false;
+
+    // Increased every time the surface list or a material override changes
+    uint32_t revision = 0;
+
 public:
 
     Mesh();
@@ -33,6 +39,7 @@ public:
     Material* get_surface_material(int surface_idx);
     bool get_frustum_culling_enabled() const;
     bool get_receive_shadows() const { return receive_shadows; }
+    bool get_is_occluder() const { return occluder; }
     Material* get_surface_material_override(Surface* surface);
     const std::vector<Surface*>& get_surfaces() const;
     std::vector<Surface*>& get_surfaces();
@@ -41,10 +48,12 @@ public:
     Skeleton* get_skeleton() const;
     Node* get_node_ref() const { return node_ref; }
     const std::string& get_mesh_type() const { return mesh_type; }
+    uint32_t get_revision() const { return revision; }
 
     void set_surface_material_override(Surface* surface, Material* material);
     void set_frustum_culling_enabled(bool enabled);
     void set_receive_shadows(bool receive_shadows) { this->receive_shadows = receive_shadows; }
+    void set_is_occluder(bool occluder) { this->occluder = occluder; }
     void set_node_ref(Node* node) { node_ref = node; }
     void set_mesh_type(const std::string& new_mesh_type) { mesh_type = new_mesh_type; }
     void set_skeleton(Skeleton* s);
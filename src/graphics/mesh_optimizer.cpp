@@ -0,0 +1,178 @@
+#include "mesh_optimizer.h"
+
+#include "graphics/surface.h"
+
+#include "spdlog/spdlog.h"
+
+#include <numeric>
+
+void sMeshOptimizationStats::merge(const sMeshOptimizationStats& other)
+{
+    triangle_count += other.triangle_count;
+    vertices_before += other.vertices_before;
+    vertices_after += other.vertices_after;
+
+    cache_before.vertices_transformed += other.cache_before.vertices_transformed;
+    cache_after.vertices_transformed += other.cache_after.vertices_transformed;
+
+    if (triangle_count > 0) {
+        cache_before.acmr = static_cast<float>(cache_before.vertices_transformed) / static_cast<float>(triangle_count);
+        cache_after.acmr = static_cast<float>(cache_after.vertices_transformed) / static_cast<float>(triangle_count);
+    }
+
+    if (vertices_before > 0) {
+        cache_before.atvr = static_cast<float>(cache_before.vertices_transformed) / static_cast<float>(vertices_before);
+    }
+
+    if (vertices_after > 0) {
+        cache_after.atvr = static_cast<float>(cache_after.vertices_transformed) / static_cast<float>(vertices_after);
+    }
+}
+
+void sMeshOptimizationStats::log(const std::string& mesh_name) const
+{
+    if (triangle_count == 0) {
+        return;
+    }
+
+    spdlog::info("Optimized {} ({} triangles): {} -> {} vertices, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", mesh_name, triangle_count,
+        vertices_before, vertices_after, cache_before.acmr, cache_after.acmr, cache_before.atvr, cache_after.atvr);
+}
+
+namespace {
+
+    // remap[old_vertex] is the new index or UINT32_MAX to drop it
+    template <typename T>
+    void remap_attribute(std::vector<T>& attribute, const std::vector<uint32_t>& remap, uint32_t new_count)
+    {
+        if (attribute.empty()) {
+            return;
+        }
+
+        std::vector<T> remapped(new_count);
+        for (size_t i = 0; i < remap.size(); ++i) {
+            if (remap[i] != UINT32_MAX) {
+                remapped[remap[i]] = attribute[i];
+            }
+        }
+
+        attribute = std::move(remapped);
+    }
+
+    void remap_surface_data(sSurfaceData& surface_data, const std::vector<uint32_t>& remap, uint32_t new_count)
+    {
+        remap_attribute(surface_data.vertices, remap, new_count);
+        remap_attribute(surface_data.uvs, remap, new_count);
+        remap_attribute(surface_data.normals, remap, new_count);
+        remap_attribute(surface_data.tangents, remap, new_count);
+        remap_attribute(surface_data.colors, remap, new_count);
+        remap_attribute(surface_data.weights, remap, new_count);
+        remap_attribute(surface_data.joints, remap, new_count);
+    }
+
+    template <typename T>
+    void add_vertex_stream(std::vector<sVertexStream>& streams, const std::vector<T>& attribute)
+    {
+        if (!attribute.empty()) {
+            streams.push_back({ attribute.data(), sizeof(T) });
+        }
+    }
+
+    // Identical vertices (every attribute) collapse to the first one, returns the new vertex count
+    uint32_t weld_vertices(sSurfaceData& surface_data)
+    {
+        const uint32_t vertex_count = static_cast<uint32_t>(surface_data.vertices.size());
+
+        std::vector<sVertexStream> streams;
+        add_vertex_stream(streams, surface_data.vertices);
+        add_vertex_stream(streams, surface_data.uvs);
+        add_vertex_stream(streams, surface_data.normals);
+        add_vertex_stream(streams, surface_data.tangents);
+        add_vertex_stream(streams, surface_data.colors);
+        add_vertex_stream(streams, surface_data.weights);
+        add_vertex_stream(streams, surface_data.joints);
+
+        std::vector<uint32_t> remap;
+        uint32_t unique_count = generate_vertex_remap(streams.data(), static_cast<uint32_t>(streams.size()), vertex_count, remap);
+
+        if (unique_count == vertex_count) {
+            return vertex_count;
+        }
+
+        for (uint32_t& index : surface_data.indices) {
+            index = remap[index];
+        }
+
+        remap_surface_data(surface_data, remap, unique_count);
+
+        return unique_count;
+    }
+}
+
+sMeshOptimizationStats optimize_surface_data(sSurfaceData& surface_data)
+{
+    sMeshOptimizationStats stats;
+
+    uint32_t vertex_count = static_cast<uint32_t>(surface_data.vertices.size());
+
+    stats.vertices_before = vertex_count;
+    stats.vertices_after = vertex_count;
+
+    if (vertex_count == 0) {
+        return stats;
+    }
+
+    // Unindexed data (e.g. OBJ) gets an index buffer
+    if (surface_data.indices.empty()) {
+        surface_data.indices.resize(vertex_count);
+        std::iota(surface_data.indices.begin(), surface_data.indices.end(), 0u);
+    }
+
+    if (surface_data.indices.size() % 3 != 0) {
+        spdlog::warn("Mesh optimization skipped, {} indices is not a triangle list", surface_data.indices.size());
+        return stats;
+    }
+
+    stats.triangle_count = static_cast<uint32_t>(surface_data.indices.size() / 3);
+    stats.cache_before = analyze_vertex_cache(surface_data.indices.data(), static_cast<uint32_t>(surface_data.indices.size()), vertex_count);
+
+    vertex_count = weld_vertices(surface_data);
+
+    optimize_vertex_cache(surface_data.indices, vertex_count);
+    optimize_overdraw(surface_data.indices, surface_data.vertices.data(), vertex_count);
+
+    std::vector<uint32_t> remap;
+    uint32_t fetch_vertex_count = optimize_vertex_fetch_remap(surface_data.indices, vertex_count, remap);
+    remap_surface_data(surface_data, remap, fetch_vertex_count);
+
+    vertex_count = fetch_vertex_count;
+
+    stats.vertices_after = vertex_count;
+    stats.cache_after = analyze_vertex_cache(surface_data.indices.data(), static_cast<uint32_t>(surface_data.indices.size()), vertex_count);
+
+    return stats;
+}
+
+sSurfaceData simplify_surface_data(const sSurfaceData& surface_data, float target_ratio, float target_error, float* result_error)
+{
+    sSurfaceData simplified = surface_data;
+
+    const uint32_t vertex_count = static_cast<uint32_t>(simplified.vertices.size());
+
+    if (simplified.indices.empty()) {
+        simplified.indices.resize(vertex_count);
+        std::iota(simplified.indices.begin(), simplified.indices.end(), 0u);
+    }
+
+    uint32_t target_index_count = static_cast<uint32_t>(static_cast<float>(simplified.indices.size()) * target_ratio) / 3 * 3;
+
+    simplified.indices = simplify_indices(simplified.indices, simplified.vertices.data(), vertex_count, target_index_count, target_error, result_error);
+
+    optimize_vertex_cache(simplified.indices, vertex_count);
+
+    std::vector<uint32_t> remap;
+    uint32_t used_vertex_count = optimize_vertex_fetch_remap(simplified.indices, vertex_count, remap);
+    remap_surface_data(simplified, remap, used_vertex_count);
+
+    return simplified;
+}
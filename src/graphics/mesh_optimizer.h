@@ -0,0 +1,28 @@
+#pragma once
+
+#include "framework/math/mesh_processing.h"
+
+#include <string>
+
+struct sSurfaceData;
+
+struct sMeshOptimizationStats {
+    uint32_t triangle_count = 0;
+    uint32_t vertices_before = 0;
+    uint32_t vertices_after = 0;
+    sVertexCacheStats cache_before;
+    sVertexCacheStats cache_after;
+
+    // Totals of several meshes, the ratios are recomputed from the sums
+    void merge(const sMeshOptimizationStats& other);
+
+    void log(const std::string& mesh_name) const;
+};
+
+// Triangle list optimization done at import time: welds identical vertices (unindexed data gets an
+// index buffer), then vertex cache, overdraw and vertex fetch passes over all the attributes
+sMeshOptimizationStats optimize_surface_data(sSurfaceData& surface_data);
+
+// Simplified copy for a LOD, keeping target_ratio of the triangles at most. Unused vertices are
+// removed and the result is cache and fetch optimized
+sSurfaceData simplify_surface_data(const sSurfaceData& surface_data, float target_ratio, float target_error, float* result_error = nullptr);
@@ -11,6 +11,7 @@
 using namespace std::chrono_literals;
 
 WebGPUContext* Pipeline::webgpu_context = nullptr;
+uint32_t Pipeline::last_pipeline_id = 0;
 
 Pipeline::~Pipeline()
 {
@@ -134,6 +135,8 @@ void Pipeline::create_compute_async(Shader* shader, const std::string& entry_poi
 
 void Pipeline::reload(Shader* shader)
 {
+    generation++;
+
 	if (std::holds_alternative<WGPURenderPipeline>(pipeline)) {
 		wgpuRenderPipelineRelease(std::get<WGPURenderPipeline>(pipeline));
         if (description.blending_enabled) {
@@ -162,6 +165,17 @@ bool Pipeline::set(const WGPURenderPassEncoder& render_pass) const
     return true;
 }
 
+bool Pipeline::set(const WGPURenderBundleEncoder& render_bundle_encoder) const
+{
+    if (async_compile && !loaded) {
+        return false;
+    }
+
+    wgpuRenderBundleEncoderSetPipeline(render_bundle_encoder, std::get<WGPURenderPipeline>(pipeline));
+
+    return true;
+}
+
 bool Pipeline::set(const WGPUComputePassEncoder& compute_pass) const
 {
     if (async_compile && !loaded) {
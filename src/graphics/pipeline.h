@@ -30,6 +30,7 @@ public:
 	void reload(Shader* shader);
 
     bool set(const WGPURenderPassEncoder& render_pass) const;
+    bool set(const WGPURenderBundleEncoder& render_bundle_encoder) const;
     bool set(const WGPUComputePassEncoder& compute_pass) const;
 
     bool is_render_pipeline() const;
@@ -41,6 +42,12 @@ public:
         return loaded;
     }
 
+    // Stable id used to build render list sort keys
+    uint32_t get_sort_id() const { return sort_id; }
+
+    // Changes when reload replaces the pipeline, commands recorded before use the old one
+    uint32_t get_generation() const { return generation; }
+
     friend void render_pipeline_creation_callback(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline, struct WGPUStringView message, void* userdata1, void* userdata2);
     friend void compute_pipeline_creation_callback(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, struct WGPUStringView message, void* userdata1, void* userdata2);
 
@@ -57,4 +64,8 @@ private:
 
     bool async_compile = false;
 	bool loaded = false;
+
+    static uint32_t last_pipeline_id;
+    uint32_t sort_id = last_pipeline_id++;
+    uint32_t generation = 0;
 };
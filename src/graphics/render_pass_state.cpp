@@ -0,0 +1,155 @@
+#include "render_pass_state.h"
+
+#include "graphics/pipeline.h"
+
+#include <algorithm>
+#include <cassert>
+
+void RenderPassState::reset(WGPURenderPassEncoder render_pass)
+{
+    this->render_pass = render_pass;
+    render_bundle_encoder = nullptr;
+
+    reset_state();
+}
+
+void RenderPassState::reset(WGPURenderBundleEncoder render_bundle_encoder)
+{
+    this->render_bundle_encoder = render_bundle_encoder;
+    render_pass = nullptr;
+
+    reset_state();
+}
+
+void RenderPassState::reset_state()
+{
+    pipeline = nullptr;
+
+    std::fill(std::begin(bind_groups), std::end(bind_groups), sBoundBindGroup());
+    std::fill(std::begin(vertex_buffers), std::end(vertex_buffers), sBoundBuffer());
+
+    index_buffer = {};
+    index_format = WGPUIndexFormat_Undefined;
+
+    issued_calls = 0;
+    elided_calls = 0;
+}
+
+bool RenderPassState::set_pipeline(const Pipeline* pipeline)
+{
+    if (pipeline == this->pipeline) {
+        elided_calls++;
+        return true;
+    }
+
+    if (render_bundle_encoder ? !pipeline->set(render_bundle_encoder) : !pipeline->set(render_pass)) {
+        return false;
+    }
+
+    this->pipeline = pipeline;
+    issued_calls++;
+
+    return true;
+}
+
+void RenderPassState::set_bind_group(uint32_t group, WGPUBindGroup bind_group, uint32_t dynamic_offset_count, const uint32_t* dynamic_offsets)
+{
+    assert(group < MAX_BIND_GROUPS && dynamic_offset_count <= MAX_DYNAMIC_OFFSETS);
+
+    sBoundBindGroup& bound = bind_groups[group];
+
+    if (bound.bind_group == bind_group && bound.dynamic_offset_count == dynamic_offset_count &&
+        std::equal(dynamic_offsets, dynamic_offsets + dynamic_offset_count, bound.dynamic_offsets)) {
+        elided_calls++;
+        return;
+    }
+
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderSetBindGroup(render_bundle_encoder, group, bind_group, dynamic_offset_count, dynamic_offsets);
+    } else {
+        wgpuRenderPassEncoderSetBindGroup(render_pass, group, bind_group, dynamic_offset_count, dynamic_offsets);
+    }
+
+    bound.bind_group = bind_group;
+    bound.dynamic_offset_count = dynamic_offset_count;
+    std::copy(dynamic_offsets, dynamic_offsets + dynamic_offset_count, bound.dynamic_offsets);
+
+    issued_calls++;
+}
+
+void RenderPassState::set_vertex_buffer(uint32_t slot, WGPUBuffer buffer, uint64_t offset, uint64_t size)
+{
+    assert(slot < MAX_VERTEX_BUFFERS);
+
+    sBoundBuffer& bound = vertex_buffers[slot];
+
+    if (bound.buffer == buffer && bound.offset == offset && bound.size == size) {
+        elided_calls++;
+        return;
+    }
+
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderSetVertexBuffer(render_bundle_encoder, slot, buffer, offset, size);
+    } else {
+        wgpuRenderPassEncoderSetVertexBuffer(render_pass, slot, buffer, offset, size);
+    }
+
+    bound = { buffer, offset, size };
+
+    issued_calls++;
+}
+
+void RenderPassState::set_index_buffer(WGPUBuffer buffer, WGPUIndexFormat format, uint64_t offset, uint64_t size)
+{
+    if (index_buffer.buffer == buffer && index_format == format && index_buffer.offset == offset && index_buffer.size == size) {
+        elided_calls++;
+        return;
+    }
+
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderSetIndexBuffer(render_bundle_encoder, buffer, format, offset, size);
+    } else {
+        wgpuRenderPassEncoderSetIndexBuffer(render_pass, buffer, format, offset, size);
+    }
+
+    index_buffer = { buffer, offset, size };
+    index_format = format;
+
+    issued_calls++;
+}
+
+void RenderPassState::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderDraw(render_bundle_encoder, vertex_count, instance_count, first_vertex, first_instance);
+    } else {
+        wgpuRenderPassEncoderDraw(render_pass, vertex_count, instance_count, first_vertex, first_instance);
+    }
+}
+
+void RenderPassState::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t base_vertex, uint32_t first_instance)
+{
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderDrawIndexed(render_bundle_encoder, index_count, instance_count, first_index, base_vertex, first_instance);
+    } else {
+        wgpuRenderPassEncoderDrawIndexed(render_pass, index_count, instance_count, first_index, base_vertex, first_instance);
+    }
+}
+
+void RenderPassState::draw_indirect(WGPUBuffer indirect_buffer, uint64_t indirect_offset)
+{
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderDrawIndirect(render_bundle_encoder, indirect_buffer, indirect_offset);
+    } else {
+        wgpuRenderPassEncoderDrawIndirect(render_pass, indirect_buffer, indirect_offset);
+    }
+}
+
+void RenderPassState::draw_indexed_indirect(WGPUBuffer indirect_buffer, uint64_t indirect_offset)
+{
+    if (render_bundle_encoder) {
+        wgpuRenderBundleEncoderDrawIndexedIndirect(render_bundle_encoder, indirect_buffer, indirect_offset);
+    } else {
+        wgpuRenderPassEncoderDrawIndexedIndirect(render_pass, indirect_buffer, indirect_offset);
+    }
+}
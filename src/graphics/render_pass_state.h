@@ -0,0 +1,63 @@
+#pragma once
+
+#include "includes.h"
+
+class Pipeline;
+
+// Last state set on a render pass or render bundle encoder, so calls that would set the same state again
+// are skipped. Anything recorded on the encoder from outside must be followed by a reset, as the cache can not see it
+class RenderPassState {
+
+public:
+
+    static constexpr uint32_t MAX_BIND_GROUPS = 4;
+    static constexpr uint32_t MAX_DYNAMIC_OFFSETS = 4;
+    static constexpr uint32_t MAX_VERTEX_BUFFERS = 2;
+
+    void reset(WGPURenderPassEncoder render_pass);
+    void reset(WGPURenderBundleEncoder render_bundle_encoder);
+
+    // False if the pipeline is not ready yet
+    bool set_pipeline(const Pipeline* pipeline);
+
+    void set_bind_group(uint32_t group, WGPUBindGroup bind_group, uint32_t dynamic_offset_count = 0, const uint32_t* dynamic_offsets = nullptr);
+    void set_vertex_buffer(uint32_t slot, WGPUBuffer buffer, uint64_t offset, uint64_t size);
+    void set_index_buffer(WGPUBuffer buffer, WGPUIndexFormat format, uint64_t offset, uint64_t size);
+
+    void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+    void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t base_vertex, uint32_t first_instance);
+    void draw_indirect(WGPUBuffer indirect_buffer, uint64_t indirect_offset);
+    void draw_indexed_indirect(WGPUBuffer indirect_buffer, uint64_t indirect_offset);
+
+    uint32_t get_issued_calls() const { return issued_calls; }
+    uint32_t get_elided_calls() const { return elided_calls; }
+
+private:
+
+    struct sBoundBindGroup {
+        WGPUBindGroup bind_group = nullptr;
+        uint32_t dynamic_offset_count = 0;
+        uint32_t dynamic_offsets[MAX_DYNAMIC_OFFSETS] = {};
+    };
+
+    struct sBoundBuffer {
+        WGPUBuffer buffer = nullptr;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // Only one of them is set
+    WGPURenderPassEncoder render_pass = nullptr;
+    WGPURenderBundleEncoder render_bundle_encoder = nullptr;
+
+    void reset_state();
+
+    const Pipeline* pipeline = nullptr;
+    sBoundBindGroup bind_groups[MAX_BIND_GROUPS];
+    sBoundBuffer vertex_buffers[MAX_VERTEX_BUFFERS];
+    sBoundBuffer index_buffer;
+    WGPUIndexFormat index_format = WGPUIndexFormat_Undefined;
+
+    uint32_t issued_calls = 0;
+    uint32_t elided_calls = 0;
+};
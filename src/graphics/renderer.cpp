@@ -18,12 +18,15 @@
 
 #include "framework/camera/camera.h"
 #include "framework/nodes/light_3d.h"
+#include "graphics/debug/gpu_profiler.h"
 #include "graphics/debug/renderdoc_capture.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
+#include "graphics/geometry_arena.h"
 #include "graphics/pipeline.h"
 #include "graphics/renderer_storage.h"
 #include "graphics/shader.h"
+#include "graphics/staging_belt.h"
 #include "graphics/texture.h"
 
 #include "shaders/AABB_shader.wgsl.gen.h"
@@ -35,12 +38,18 @@
 #include "framework/camera/flyover_camera.h"
 #include "framework/camera/orbit_camera.h"
 #include "framework/input.h"
+#include "framework/math/intersections.h"
+#include "framework/utils/hash.h"
 #include "framework/nodes/gs_node.h"
 #include "framework/nodes/mesh_instance_3d.h"
 #include "framework/parsers/parse_scene.h"
 #include "framework/ui/io.h"
+#include "framework/utils/cpu_profiler.h"
 
 #include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
 
 #include "shaders/gaussian_splatting/gs_render.wgsl.gen.h"
 #include "shaders/mesh_texture_cube.wgsl.gen.h"
@@ -63,6 +72,10 @@ Renderer::Renderer()
 
     renderer_storage = new RendererStorage();
 
+    job_system = new JobSystem();
+    cull_thread_data.resize(job_system->get_thread_count());
+    camera_render_lists.resize(RENDER_LIST_COUNT);
+
 #ifdef _DEBUG
     RenderdocCapture::init();
 #endif
@@ -73,6 +86,9 @@ Renderer::Renderer()
     Surface::webgpu_context = webgpu_context;
     Texture::webgpu_context = webgpu_context;
 
+    // Buffers are created with the first surface
+    geometry_arena = new GeometryArena(webgpu_context);
+
 #if defined(OPENXR_SUPPORT)
     OpenXRContext* openxr_context = new OpenXRContext();
     is_xr_available = openxr_context->create_instance();
@@ -90,6 +106,8 @@ Renderer::Renderer()
 
 Renderer::~Renderer()
 {
+    delete job_system;
+    delete geometry_arena;
     delete webgpu_context;
 
 #ifdef XR_SUPPORT
@@ -107,8 +125,6 @@ int Renderer::pre_initialize(GLFWwindow* window, const sRendererConfiguration& c
     webgpu_context->window = window;
     webgpu_context->create_instance();
 
-    Shader::set_custom_define("MAX_LIGHTS", MAX_LIGHTS);
-
     eye_depth_textures = new Texture[EYE_COUNT];
     multisample_textures = new Texture[EYE_COUNT];
 
@@ -140,6 +156,10 @@ int Renderer::initialize()
         if (device_future.id == 0) {
             // The engine needs FloatFilterable as a default
             required_features.push_back(WGPUFeatureName_Float32Filterable);
+            // Indirect draws of the GPU culled batches start at the batch first instance
+            if (wgpuAdapterHasFeature(webgpu_context->adapter, WGPUFeatureName_IndirectFirstInstance)) {
+                required_features.push_back(WGPUFeatureName_IndirectFirstInstance);
+            }
             device_future = webgpu_context->request_device(required_features);
         }
         webgpu_context->process_events();
@@ -178,6 +198,13 @@ int Renderer::initialize()
         }
     }
 
+    indirect_first_instance_supported = wgpuDeviceHasFeature(webgpu_context->device, WGPUFeatureName_IndirectFirstInstance);
+
+    if (gpu_culling_enabled && !indirect_first_instance_supported) {
+        spdlog::warn("GPU culling needs the IndirectFirstInstance feature, using CPU culling");
+        gpu_culling_enabled = false;
+    }
+
     spdlog::info("Renderer initialized");
 
     initialized = true;
@@ -199,12 +226,15 @@ int Renderer::post_initialize()
 
     init_depth_buffers();
 
+    frame_ring.create(webgpu_context);
+
     init_lighting_bind_group();
     init_camera_bind_group();
 
     init_multisample_textures();
 
-    init_timestamp_queries();
+    gpu_profiler = new GPUProfiler();
+    gpu_profiler->create(webgpu_context);
 
 #if defined(OPENXR_SUPPORT) && defined(USE_MIRROR_WINDOW)
     if (is_xr_available) {
@@ -309,28 +339,55 @@ void Renderer::clean()
 
     RendererStorage::clean_registered_pipelines();
 
-    wgpuBindGroupRelease(render_camera_bind_group);
-    wgpuBindGroupRelease(render_camera_bind_group_2d);
-    wgpuBindGroupRelease(shadow_camera_bind_group);
+    // Nothing can be released while the GPU may still use it
+    frame_ring.destroy();
 
-    camera_uniform.destroy();
-    camera_2d_uniform.destroy();
-    shadow_camera_uniform.destroy();
+    release_camera_bundles();
 
-    for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
-        render_instances_data.instances_data_uniforms[i].destroy();
+    for (sFrameResources& frame : frame_resources) {
+        wgpuBindGroupRelease(frame.render_camera_bind_group);
+        wgpuBindGroupRelease(frame.render_camera_bind_group_2d);
+        wgpuBindGroupRelease(frame.shadow_camera_bind_group);
+        wgpuBindGroupRelease(frame.compute_camera_bind_group);
+
+        frame.camera_uniform.destroy();
+        frame.camera_2d_uniform.destroy();
+        frame.eye_camera_uniform.destroy();
+        frame.shadow_camera_uniform.destroy();
+
+        for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
+            frame.render_instances_data.instances_data_uniforms[i].destroy();
+
+            if (frame.render_instances_data.instances_bind_groups[i]) {
+                wgpuBindGroupRelease(frame.render_instances_data.instances_bind_groups[i]);
+            }
+
+            delete frame.render_instances_data.cull_kernels[i];
+
+            for (sInstanceData& instances_data : frame.shadow_instances_data) {
+                instances_data.instances_data_uniforms[i].destroy();
+
+                if (instances_data.instances_bind_groups[i]) {
+                    wgpuBindGroupRelease(instances_data.instances_bind_groups[i]);
+                }
 
-        if (render_instances_data.instances_bind_groups[i]) {
-            wgpuBindGroupRelease(render_instances_data.instances_bind_groups[i]);
+                delete instances_data.cull_kernels[i];
+            }
         }
 
-        shadow_instances_data.instances_data_uniforms[i].destroy();
+        delete frame.render_instances_data.meshlet_cull_kernel;
 
-        if (shadow_instances_data.instances_bind_groups[i]) {
-            wgpuBindGroupRelease(shadow_instances_data.instances_bind_groups[i]);
+        if (frame.lighting_bind_group) {
+            wgpuBindGroupRelease(frame.lighting_bind_group);
         }
+
+        frame.lights_buffer.destroy();
+        delete frame.light_cluster_kernel;
     }
 
+    delete hiz_buffer;
+    delete gpu_profiler;
+
     webgpu_context->destroy();
 
     delete renderer_storage;
@@ -363,10 +420,15 @@ void Renderer::update(float delta_time)
         RenderdocCapture::start_capture_frame();
     }
 
+    // The resources of this frame index are free once the frame that used them has completed
+    frame_ring.begin_frame();
+
     // Create the command encoder
     WGPUCommandEncoderDescriptor encoder_desc = {};
     global_command_encoder = wgpuDeviceCreateCommandEncoder(webgpu_context->device, &encoder_desc);
 
+    gpu_profiler->begin_frame();
+
     if (!is_xr_available) {
         const auto& io = ImGui::GetIO();
         if (!io.WantCaptureMouse && !io.WantCaptureKeyboard && !IO::any_focus()) {
@@ -379,6 +441,8 @@ void Renderer::update(float delta_time)
 
 void Renderer::render()
 {
+    PROFILE_ZONE("Renderer::render");
+
     WGPUTextureView screen_surface_texture_view;
     WGPUSurfaceTexture screen_surface_texture;
 
@@ -420,6 +484,8 @@ void Renderer::render()
         screen_surface_texture_view = webgpu_context->create_texture_view(screen_surface_texture.texture, WGPUTextureViewDimension_2D, webgpu_context->swapchain_format);
     }
 
+    sFrameResources& frame = get_frame_resources();
+
     update_lights();
 
     //render_shadow_maps();
@@ -428,24 +494,56 @@ void Renderer::render()
     camera_data.ibl_intensity = ibl_intensity;
     camera_data.screen_size = { webgpu_context->screen_width, webgpu_context->screen_height };
 
-    std::vector<std::vector<sRenderData>> render_lists(RENDER_LIST_COUNT);
+    std::vector<std::vector<sRenderData>>& render_lists = camera_render_lists;
+
+    for (std::vector<sRenderData>& render_list : render_lists) {
+        render_list.clear();
+    }
+
+    hiz_built = false;
 
     if (!is_xr_available) {
         camera_data.right_controller_position = camera_data.eye;
 
-        prepare_cull_instancing(*camera_3d, render_lists, render_instances_data);
+        // Occlusion is tested against what was visible last frame
+        bool use_hiz = occlusion_culling_mode == OCCLUSION_CULLING_CPU_READBACK || (occlusion_culling_mode == OCCLUSION_CULLING_GPU && gpu_culling_enabled);
+
+        if (use_hiz && last_view_projection_valid) {
+            if (!hiz_buffer) {
+                hiz_buffer = new HiZBuffer();
+            }
+
+            if (!hiz_buffer->is_created()) {
+                hiz_buffer->create(eye_depth_texture_view[EYE_LEFT], webgpu_context->render_width, webgpu_context->render_height, msaa_count > 1);
+            }
+
+            hiz_built = hiz_buffer->build(global_command_encoder, last_view_projection, occlusion_culling_mode == OCCLUSION_CULLING_CPU_READBACK);
+        }
+
+        prepare_cull_instancing(*camera_3d, render_lists, frame.render_instances_data);
 
         camera_data.eye = camera_3d->get_eye();
         camera_data.view_projection = camera_3d->get_view_projection();
         camera_data.view = camera_3d->get_view();
         camera_data.projection = camera_3d->get_projection();
 
-        wgpuQueueWriteBuffer(webgpu_context->device_queue, std::get<WGPUBuffer>(camera_uniform.data), 0, &camera_data, sizeof(sCameraData));
+        webgpu_context->update_buffer(std::get<WGPUBuffer>(frame.camera_uniform.data), 0, &camera_data, sizeof(sCameraData));
+
+        update_light_clusters(*camera_3d, camera_3d->get_near(), camera_3d->get_far());
 
         //glm::vec3 eye = camera_3d->get_eye();
         //glm::vec3 center = camera_3d->get_center();
 
-        render_camera(render_lists, screen_surface_texture_view, eye_depth_texture_view[EYE_LEFT], render_instances_data, render_camera_bind_group, true, "forward_render");
+        if (render_bundle_cache_enabled) {
+            update_camera_bundles(render_lists, frame.render_instances_data, frame.render_camera_bind_group);
+
+            render_camera(render_lists, screen_surface_texture_view, eye_depth_texture_view[EYE_LEFT], frame.render_instances_data, frame.render_camera_bind_group, true, "forward_render", 0, 0, &frame.camera_bundles);
+        } else {
+            render_camera(render_lists, screen_surface_texture_view, eye_depth_texture_view[EYE_LEFT], frame.render_instances_data, frame.render_camera_bind_group, true, "forward_render");
+        }
+
+        last_view_projection = camera_data.view_projection;
+        last_view_projection_valid = true;
     }
 #ifdef XR_SUPPORT
     else {
@@ -486,23 +584,51 @@ void Renderer::render()
             }
         }
 
-        prepare_cull_instancing(vr_camera, render_lists, render_instances_data);
+        prepare_cull_instancing(vr_camera, render_lists, frame.render_instances_data);
+
+        // Both eyes share the clusters of the combined camera
+        update_light_clusters(vr_camera, xr_context->z_near, xr_context->z_far);
+
+        // Both eyes cull with the combined camera, so their lists only differ in the camera
+        if (xr_stereo_bundles_enabled) {
+            update_camera_bundles(render_lists, frame.render_instances_data, frame.render_camera_bind_group);
+        }
+
+        WGPUBuffer camera_buffer = std::get<WGPUBuffer>(frame.camera_uniform.data);
+        WGPUBuffer eye_camera_buffer = std::get<WGPUBuffer>(frame.eye_camera_uniform.data);
 
         for (uint32_t eye_idx = 0; eye_idx < EYE_COUNT; eye_idx++) {
             xr_context->acquire_swapchain(eye_idx);
 
+            gpu_profiler->begin_scope(eye_idx == EYE_LEFT ? "xr_left_eye" : "xr_right_eye");
+
             camera_data.eye = cameras[eye_idx].get_eye();
             camera_data.view_projection = cameras[eye_idx].get_view_projection();
             camera_data.view = cameras[eye_idx].get_view();
             camera_data.projection = cameras[eye_idx].get_projection();
 
-            wgpuQueueWriteBuffer(webgpu_context->device_queue, std::get<WGPUBuffer>(camera_uniform.data), eye_idx * camera_buffer_stride, &camera_data, sizeof(sCameraData));
+            webgpu_context->update_buffer(camera_buffer, eye_idx * camera_buffer_stride, &camera_data, sizeof(sCameraData));
+
+            if (xr_stereo_bundles_enabled) {
+                // The bundles bind the first slot, the eye camera is copied there before its pass
+                webgpu_context->update_buffer(eye_camera_buffer, eye_idx * camera_buffer_stride, &camera_data, sizeof(sCameraData));
+                wgpuCommandEncoderCopyBufferToBuffer(global_command_encoder, eye_camera_buffer, eye_idx * camera_buffer_stride, camera_buffer, 0, sizeof(sCameraData));
+
+                render_camera(render_lists, xr_context->get_swapchain_view(eye_idx), eye_depth_texture_view[eye_idx], frame.render_instances_data, frame.render_camera_bind_group, true, "forward_render_xr", eye_idx, 0, &frame.camera_bundles);
+            } else {
+                render_camera(render_lists, xr_context->get_swapchain_view(eye_idx), eye_depth_texture_view[eye_idx], frame.render_instances_data, frame.render_camera_bind_group, true, "forward_render_xr", eye_idx, eye_idx);
+            }
 
-            render_camera(render_lists, xr_context->get_swapchain_view(eye_idx), eye_depth_texture_view[eye_idx], render_instances_data, render_camera_bind_group, true, "forward_render_xr", eye_idx, eye_idx);
+            gpu_profiler->end_scope();
 
             xr_context->release_swapchain(eye_idx);
         }
 
+        if (xr_stereo_bundles_enabled) {
+            // Back to the left eye for anything reading the camera later in the frame
+            wgpuCommandEncoderCopyBufferToBuffer(global_command_encoder, eye_camera_buffer, 0, camera_buffer, 0, sizeof(sCameraData));
+        }
+
 #if defined(USE_MIRROR_WINDOW)
         if (use_mirror_screen) {
             render_mirror(screen_surface_texture_view, custom_mirror_fbo_bind_group ? custom_mirror_fbo_bind_group : swapchain_bind_groups[xr_context->get_swapchain_image_index(0)]);
@@ -519,7 +645,7 @@ void Renderer::render()
         camera_2d_data.exposure = exposure;
         camera_2d_data.ibl_intensity = ibl_intensity;
 
-        wgpuQueueWriteBuffer(webgpu_context->device_queue, std::get<WGPUBuffer>(camera_2d_uniform.data), 0, &camera_2d_data, sizeof(sCameraData));
+        webgpu_context->update_buffer(std::get<WGPUBuffer>(frame.camera_2d_uniform.data), 0, &camera_2d_data, sizeof(sCameraData));
 
         // Prepare the color attachment
         WGPURenderPassColorAttachment render_pass_color_attachment = {};
@@ -535,22 +661,24 @@ void Renderer::render()
         render_pass_color_attachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
         render_pass_color_attachment.clearValue = WGPUColor{ clear_color.r, clear_color.g, clear_color.b, clear_color.a };
 
+        WGPUPassTimestampWrites timestamp_writes;
         WGPURenderPassDescriptor render_pass_descr = {};
         render_pass_descr.colorAttachmentCount = 1;
         render_pass_descr.colorAttachments = &render_pass_color_attachment;
         render_pass_descr.depthStencilAttachment = nullptr;
+        render_pass_descr.timestampWrites = gpu_profiler->get_pass_timestamp_writes("render_2d", timestamp_writes);
 
         // Create & fill the render pass (encoder)
         WGPURenderPassEncoder render_pass = wgpuCommandEncoderBeginRenderPass(global_command_encoder, &render_pass_descr);
 
         if (custom_pre_2d_pass) {
-            custom_pre_2d_pass(render_pass, render_camera_bind_group_2d, custom_pass_user_data, 0);
+            custom_pre_2d_pass(render_pass, frame.render_camera_bind_group_2d, custom_pass_user_data, 0);
         }
 
-        render_2D(render_pass, render_lists, render_instances_data, render_camera_bind_group_2d);
+        render_2D(render_pass, render_lists, frame.render_instances_data, frame.render_camera_bind_group_2d);
 
         if (custom_post_2d_pass) {
-            custom_post_2d_pass(render_pass, render_camera_bind_group_2d, custom_pass_user_data, 0);
+            custom_post_2d_pass(render_pass, frame.render_camera_bind_group_2d, custom_pass_user_data, 0);
         }
 
         wgpuRenderPassEncoderEnd(render_pass);
@@ -571,10 +699,12 @@ void Renderer::render()
             color_attachments.clearValue = { 0.0, 0.0, 0.0, 0.0 };
             color_attachments.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
 
+            WGPUPassTimestampWrites timestamp_writes;
             WGPURenderPassDescriptor render_pass_desc = {};
             render_pass_desc.colorAttachmentCount = 1;
             render_pass_desc.colorAttachments = &color_attachments;
             render_pass_desc.depthStencilAttachment = nullptr;
+            render_pass_desc.timestampWrites = gpu_profiler->get_pass_timestamp_writes("imgui", timestamp_writes);
 
             WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(global_command_encoder, &render_pass_desc);
 
@@ -592,6 +722,10 @@ void Renderer::render()
 
     submit_global_command_encoder();
 
+    if (hiz_buffer) {
+        hiz_buffer->map_readback();
+    }
+
     if (RenderdocCapture::is_capture_started() && debug_this_frame) {
         RenderdocCapture::end_capture_frame();
         debug_this_frame = false;
@@ -619,17 +753,21 @@ void Renderer::render()
     }
 #endif
 
-    if (timestamps_requested) {
-        get_timestamps();
-        timestamps_requested = false;
-    }
+    PROFILE_COUNTER_ADD("draw_calls", frame_stats.draw_calls);
+
+    last_frame_stats = frame_stats;
+    frame_stats = {};
 
     clear_renderables();
 }
 
 void Renderer::render_camera(const std::vector<std::vector<sRenderData>>& render_lists, WGPUTextureView framebuffer_view, WGPUTextureView depth_view,
-        const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, bool render_transparents, const std::string& pass_name, uint32_t eye_idx, uint32_t camera_offset)
+        const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, bool render_transparents, const std::string& pass_name, uint32_t eye_idx, uint32_t camera_offset,
+        const sCameraBundles* bundles)
 {
+    // Material changes since the last pass, in a single upload
+    RendererStorage::flush_material_params(webgpu_context);
+
     {
         // Prepare the color attachment
         WGPURenderPassColorAttachment render_pass_color_attachment = {};
@@ -669,12 +807,8 @@ void Renderer::render_camera(const std::vector<std::vector<sRenderData>>& render
         render_pass_descr.depthStencilAttachment = depth_view ? &render_pass_depth_attachment : nullptr;
         render_pass_descr.label = { pass_name.c_str(), pass_name.length() };
 
-        std::vector<WGPUPassTimestampWrites> timestampWrites(1);
-        timestampWrites[0].beginningOfPassWriteIndex = timestamp(global_command_encoder, (pass_name + "_pre_render").c_str());
-        timestampWrites[0].querySet = timestamp_query_set;
-        timestampWrites[0].endOfPassWriteIndex = timestamp(global_command_encoder, (pass_name + "_render").c_str());
-
-        render_pass_descr.timestampWrites = timestampWrites.data();
+        WGPUPassTimestampWrites timestamp_writes;
+        render_pass_descr.timestampWrites = gpu_profiler->get_pass_timestamp_writes(pass_name, timestamp_writes);
 
         // Create & fill the render pass (encoder)
         WGPURenderPassEncoder render_pass = wgpuCommandEncoderBeginRenderPass(global_command_encoder, &render_pass_descr);
@@ -687,7 +821,13 @@ void Renderer::render_camera(const std::vector<std::vector<sRenderData>>& render
             custom_pre_opaque_pass(render_pass, camera_bind_group, custom_pass_user_data, camera_offset * camera_buffer_stride);
         }
 
-        render_opaque(render_pass, render_lists, instance_data, camera_bind_group, camera_offset * camera_buffer_stride);
+        if (bundles) {
+            if (bundles->opaque.bundle) {
+                wgpuRenderPassEncoderExecuteBundles(render_pass, 1, &bundles->opaque.bundle);
+            }
+        } else {
+            render_opaque(render_pass, render_lists, instance_data, camera_bind_group, camera_offset * camera_buffer_stride);
+        }
 
         if (custom_post_opaque_pass) {
             custom_post_opaque_pass(render_pass, camera_bind_group, custom_pass_user_data, camera_offset * camera_buffer_stride);
@@ -698,7 +838,13 @@ void Renderer::render_camera(const std::vector<std::vector<sRenderData>>& render
                 custom_pre_transparent_pass(render_pass, camera_bind_group, custom_pass_user_data, camera_offset * camera_buffer_stride);
             }
 
-            render_transparent(render_pass, render_lists, instance_data, camera_bind_group, camera_offset * camera_buffer_stride);
+            if (bundles) {
+                if (bundles->transparent.bundle) {
+                    wgpuRenderPassEncoderExecuteBundles(render_pass, 1, &bundles->transparent.bundle);
+                }
+            } else {
+                render_transparent(render_pass, render_lists, instance_data, camera_bind_group, camera_offset * camera_buffer_stride);
+            }
 
             if (custom_post_transparent_pass) {
                 custom_post_transparent_pass(render_pass, camera_bind_group, custom_pass_user_data, camera_offset * camera_buffer_stride);
@@ -746,11 +892,47 @@ void Renderer::submit_global_command_encoder()
     cmd_buff_descriptor.nextInChain = NULL;
     cmd_buff_descriptor.label = { "Command buffer", WGPU_STRLEN };
 
-    resolve_query_set(global_command_encoder, 0);
+    if (gpu_profiler) {
+        gpu_profiler->end_frame(global_command_encoder);
+    }
+
+    sFrameResources& frame = get_frame_resources();
+
+    if (frame.light_cluster_kernel) {
+        frame.light_cluster_kernel->copy_overflow_stats(global_command_encoder);
+    }
 
     WGPUCommandBuffer commands = wgpuCommandEncoderFinish(global_command_encoder, &cmd_buff_descriptor);
 
-    wgpuQueueSubmit(webgpu_context->device_queue, 1, &commands);
+    // The passes are already encoded, so the staged writes go in a command buffer submitted before them
+    WGPUCommandBuffer upload_commands = webgpu_context->staging_belt->finish();
+
+    if (upload_commands) {
+        WGPUCommandBuffer frame_commands[2] = { upload_commands, commands };
+        wgpuQueueSubmit(webgpu_context->device_queue, 2, frame_commands);
+        wgpuCommandBufferRelease(upload_commands);
+    }
+    else {
+        wgpuQueueSubmit(webgpu_context->device_queue, 1, &commands);
+    }
+
+    webgpu_context->staging_belt->recall();
+
+    const StagingBelt::sStats& upload_stats = webgpu_context->staging_belt->end_frame();
+    frame_stats.staged_bytes = upload_stats.staged_bytes;
+    frame_stats.direct_bytes = upload_stats.direct_bytes;
+    frame_stats.staged_copies = upload_stats.copies;
+
+    if (frame.light_cluster_kernel) {
+        frame.light_cluster_kernel->map_overflow_stats();
+        frame_stats.cluster_lights_dropped = frame.light_cluster_kernel->get_overflow_stats().dropped_lights;
+    }
+
+    frame_ring.end_frame();
+
+    if (gpu_profiler) {
+        gpu_profiler->map_readback();
+    }
 
     wgpuCommandBufferRelease(commands);
     wgpuCommandEncoderRelease(global_command_encoder);
@@ -797,9 +979,8 @@ void Renderer::init_lighting_bind_group()
 {
     // delete if already created
     if (std::holds_alternative<WGPUTextureView>(irradiance_texture_uniform.data)) {
-        wgpuTextureViewRelease(std::get<WGPUTextureView>(irradiance_texture_uniform.data));
-        wgpuSamplerRelease(std::get<WGPUSampler>(ibl_sampler_uniform.data));
-        wgpuBindGroupRelease(lighting_bind_group);
+        RendererStorage::release_texture_view(std::get<WGPUTextureView>(irradiance_texture_uniform.data));
+        RendererStorage::release_sampler(std::get<WGPUSampler>(ibl_sampler_uniform.data));
     } else {
         // only created once
         brdf_lut_uniform.data = webgpu_context->brdf_lut_texture->get_view();
@@ -807,10 +988,10 @@ void Renderer::init_lighting_bind_group()
     }
 
     if (irradiance_texture) {
-        irradiance_texture_uniform.data = irradiance_texture->get_view(WGPUTextureViewDimension_Cube, 0, 6, 0, 6);
+        irradiance_texture_uniform.data = RendererStorage::get_texture_view(irradiance_texture, WGPUTextureViewDimension_Cube, 0, 6, 0, 6);
         irradiance_texture_uniform.binding = 0;
 
-        ibl_sampler_uniform.data = webgpu_context->create_sampler(
+        ibl_sampler_uniform.data = RendererStorage::get_sampler(webgpu_context,
                 WGPUAddressMode_ClampToEdge,
                 WGPUAddressMode_ClampToEdge,
                 WGPUAddressMode_ClampToEdge,
@@ -822,25 +1003,27 @@ void Renderer::init_lighting_bind_group()
         ibl_sampler_uniform.binding = 2;
     }
 
-    if (std::holds_alternative<WGPUBuffer>(lights_buffer.data)) {
-        wgpuBufferDestroy(std::get<WGPUBuffer>(lights_buffer.data));
-        lights_buffer.data = {};
-    }
+    for (sFrameResources& frame : frame_resources) {
+        if (std::holds_alternative<WGPUBuffer>(frame.lights_buffer.data)) {
+            frame_ring.release_later(std::get<WGPUBuffer>(frame.lights_buffer.data));
+            frame.lights_buffer.data = {};
+        }
 
-    lights_buffer.data = webgpu_context->create_buffer(sizeof(sLightUniformData) * MAX_LIGHTS, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &lights_uniform_data[0], "lights_buffer");
-    lights_buffer.binding = 3;
-    lights_buffer.buffer_size = sizeof(sLightUniformData) * MAX_LIGHTS;
+        frame.lights_buffer.data = webgpu_context->create_buffer(sizeof(sLightUniformData) * lights_buffer_capacity, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, nullptr, "lights_buffer");
+        frame.lights_buffer.binding = 3;
+        frame.lights_buffer.buffer_size = sizeof(sLightUniformData) * lights_buffer_capacity;
 
-    num_lights_buffer.data = webgpu_context->create_buffer(sizeof(int), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &num_lights, "num_lights_buffer");
-    num_lights_buffer.binding = 4;
-    num_lights_buffer.buffer_size = sizeof(int);
+        if (!frame.light_cluster_kernel) {
+            frame.light_cluster_kernel = new LightClusterKernel();
+        }
+    }
 
     // Shadow maps
     {
         shadow_array_texture = webgpu_context->create_texture(
                 WGPUTextureDimension_2D,
                 WGPUTextureFormat_Depth32Float,
-                { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, MAX_LIGHTS },
+                { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, MAX_SHADOW_LIGHTS },
                 WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
                 1,
                 1,
@@ -854,12 +1037,16 @@ void Renderer::init_lighting_bind_group()
                 0,
                 1,
                 0,
-                MAX_LIGHTS,
+                MAX_SHADOW_LIGHTS,
                 "shadow_depth_texture_view");
         shadow_maps_array.binding = 5;
 
         // Shadowmap sampler
-        shadow_sampler.data = webgpu_context->create_sampler(
+        if (std::holds_alternative<WGPUSampler>(shadow_sampler.data)) {
+            RendererStorage::release_sampler(std::get<WGPUSampler>(shadow_sampler.data));
+        }
+
+        shadow_sampler.data = RendererStorage::get_sampler(webgpu_context,
                 WGPUAddressMode_ClampToEdge,
                 WGPUAddressMode_ClampToEdge,
                 WGPUAddressMode_ClampToEdge,
@@ -873,8 +1060,20 @@ void Renderer::init_lighting_bind_group()
         shadow_sampler.binding = 6;
     }
 
-    std::vector<Uniform*> uniforms = { &irradiance_texture_uniform, &brdf_lut_uniform, &ibl_sampler_uniform, &lights_buffer, &num_lights_buffer /*, &shadow_maps_array, &shadow_sampler*/ };
-    lighting_bind_group = webgpu_context->create_bind_group(uniforms, RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries), 3);
+    for (sFrameResources& frame : frame_resources) {
+        create_lighting_bind_group(frame);
+    }
+}
+
+void Renderer::create_lighting_bind_group(sFrameResources& frame)
+{
+    if (frame.lighting_bind_group) {
+        frame_ring.release_later(frame.lighting_bind_group);
+    }
+
+    std::vector<Uniform*> uniforms = { &irradiance_texture_uniform, &brdf_lut_uniform, &ibl_sampler_uniform, &frame.lights_buffer,
+        frame.light_cluster_kernel->get_cluster_data_uniform(), frame.light_cluster_kernel->get_cluster_lights_uniform() /*, &shadow_maps_array, &shadow_sampler*/ };
+    frame.lighting_bind_group = webgpu_context->create_bind_group(uniforms, RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries), 3);
 }
 
 void Renderer::init_depth_buffers()
@@ -890,7 +1089,7 @@ void Renderer::init_depth_buffers()
                 WGPUTextureDimension_2D,
                 WGPUTextureFormat_Depth32Float,
                 { webgpu_context->render_width, webgpu_context->render_height, 1 },
-                WGPUTextureUsage_RenderAttachment,
+                static_cast<WGPUTextureUsage>(WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding),
                 1, msaa_count, nullptr);
 
         if (eye_depth_texture_view[i]) {
@@ -901,6 +1100,13 @@ void Renderer::init_depth_buffers()
         eye_depth_texture_view[i] = eye_depth_textures[i].get_view();
     }
 
+    // The pyramid is created again with the new depth buffers on the next frame
+    if (hiz_buffer) {
+        hiz_buffer->destroy();
+    }
+
+    last_view_projection_valid = false;
+
     spdlog::info("Depth buffers initialized with size ({}, {})", webgpu_context->render_width, webgpu_context->render_height);
 }
 
@@ -932,41 +1138,6 @@ void Renderer::init_multisample_textures()
     spdlog::info("Multisample textures initialized with size ({}, {})", webgpu_context->render_width, webgpu_context->render_height);
 }
 
-void Renderer::init_timestamp_queries()
-{
-    timestamp_query_set = webgpu_context->create_query_set(maximum_query_sets);
-    timestamp_query_buffer = webgpu_context->create_buffer(sizeof(uint64_t) * maximum_query_sets, WGPUBufferUsage_QueryResolve | WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst, nullptr);
-}
-
-void Renderer::resolve_query_set(WGPUCommandEncoder encoder, uint8_t first_query)
-{
-    wgpuCommandEncoderResolveQuerySet(encoder, timestamp_query_set, first_query, query_index, timestamp_query_buffer, 0);
-}
-
-void Renderer::get_timestamps()
-{
-    auto read_callback = [&](const void* output_buffer, void* user_data) {
-        const uint64_t* timestamps_buffer = reinterpret_cast<const uint64_t*>(output_buffer);
-        uint8_t* query_index_cpy = static_cast<uint8_t*>(user_data);
-
-        std::vector<float> time_diffs;
-        for (int i = 0; i < *query_index_cpy; i += 2) {
-            uint64_t diff = timestamps_buffer[i + 1] - timestamps_buffer[i];
-            float milliseconds = (float)diff * 1e-6f;
-            time_diffs.push_back(milliseconds);
-        }
-
-        last_frame_timestamps = time_diffs;
-
-        delete query_index_cpy;
-    };
-
-    // copy query_index, otherwise it'd have been already modified when reading
-    uint8_t* query_index_cpy = new uint8_t();
-    *query_index_cpy = query_index;
-    webgpu_context->read_buffer_async(timestamp_query_buffer, sizeof(uint64_t) * maximum_query_sets, read_callback, query_index_cpy);
-}
-
 void Renderer::set_msaa_count(uint8_t msaa_count, bool is_initial_value)
 {
     if (is_initial_value) {
@@ -1003,108 +1174,51 @@ uint8_t Renderer::get_msaa_count()
 
 void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::vector<sRenderData>>& render_lists, sInstanceData& instances_data, bool is_shadow_pass)
 {
+    PROFILE_ZONE("Renderer::prepare_cull_instancing");
+
     if (!frustum_camera_paused) {
         frustum_cull.set_view_projection(camera.get_view_projection());
+        cull_view_projection = camera.get_view_projection();
     }
 
     render_entity_list.push_back({ skybox_mesh, glm::translate(glm::mat4(1.0f), get_camera_eye()) });
 
-    // Get all surfaces from entity meshes
-    for (auto render_list_data : render_entity_list) {
-        Mesh* mesh = render_list_data.mesh;
-        glm::mat4x4 global_matrix = render_list_data.global_matrix;
-
-        const std::vector<Surface*>& surfaces = mesh->get_surfaces();
-
-        for (Surface* surface : surfaces) {
-            Material* material_override = mesh->get_surface_material_override(surface);
-            Material* material = material_override ? material_override : surface->get_material();
-
-            if (is_shadow_pass) {
-                material = shadow_material;
-            }
-
-            if (!material || !material->get_shader()) {
-                continue;
-            }
-
-            bool material_is_2d = material->get_is_2D();
-
-            if (is_shadow_pass && (!mesh->get_receive_shadows() || material_is_2d || material->get_transparency_type() == ALPHA_BLEND)) {
-                continue;
-            }
-
-            if (!material_is_2d && mesh->get_frustum_culling_enabled()) {
-                const AABB& surface_aabb = surface->get_aabb();
-
-                AABB aabb_transformed = surface_aabb.transform(global_matrix);
-
-                if (!is_inside_frustum(aabb_transformed.center - aabb_transformed.half_size, aabb_transformed.center + aabb_transformed.half_size)) {
-                    continue;
-                }
-            }
+    if (!is_shadow_pass) {
+        const glm::mat4x4& projection = camera.get_projection();
+        lod_eye = camera.get_eye();
+        lod_projection_scale = projection[1][1];
+        lod_perspective = projection[3][3] == 0.0f;
+    }
 
-            RendererStorage::instance->register_material_bind_group(webgpu_context, mesh, material);
+    cpu_occlusion_culling = !is_shadow_pass && !is_xr_available && occlusion_culling_mode == OCCLUSION_CULLING_CPU_READBACK &&
+        hiz_buffer && hiz_buffer->has_readback_data();
 
-            RendererStorage::register_render_pipeline(material);
+    cull_render_entities(is_shadow_pass);
+    merge_cull_thread_data(render_lists);
 
-            eRenderListType list = RENDER_LIST_OPAQUE;
+    prepare_instancing(camera, render_lists, instances_data, is_shadow_pass);
+}
 
-            if (material_is_2d) {
-                list = material->get_transparency_type() == ALPHA_BLEND ? RENDER_LIST_2D_TRANSPARENT : RENDER_LIST_2D;
-            } else if (material->get_transparency_type() == ALPHA_BLEND) {
-                list = RENDER_LIST_TRANSPARENT;
-            }
+void Renderer::prepare_instancing(const Camera& camera, std::vector<std::vector<sRenderData>>& render_lists, sInstanceData& instances_data, bool is_shadow_pass)
+{
+    const glm::mat4x4& view = camera.get_view();
+    const glm::vec3 view_direction = -glm::vec3(view[0][2], view[1][2], view[2][2]);
 
-            render_lists[list].push_back({ surface, 1, global_matrix, mesh, material });
-        }
-    }
+    instances_data.meshlet_culled = false;
 
     for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
         instances_data.instances_data[i].clear();
         instances_data.instances_data[i].resize(render_lists[i].size());
 
-        /*if (i != RENDER_LIST_TRANSPARENT)*/ {
-            // Sort opaques render_list
-            std::sort(render_lists[i].begin(), render_lists[i].end(), [](auto& lhs, auto& rhs) {
-                Material* lhs_mat = lhs.material;
-                Material* rhs_mat = rhs.material;
-
-                bool equal_priority = lhs_mat->get_priority() == rhs_mat->get_priority();
-                bool equal_surface = lhs.surface == rhs.surface;
-
-                if (lhs_mat->get_priority() > rhs_mat->get_priority()) {
-                    return true;
-                }
-                if (equal_priority && lhs.surface > rhs.surface) {
-                    return true;
-                }
-                if (equal_priority && equal_surface && lhs_mat > rhs_mat) {
-                    return true;
-                }
-
-                return false;
-            });
-        }
-        //else {
-        //    // Sort transparent render_list by distance to camera
-        //    std::sort(render_list[i].begin(), render_list[i].end(), [&](auto& lhs, auto& rhs) {
-        //        glm::vec3 lhs_pos = glm::vec3(lhs.global_matrix[3]);
-        //        glm::vec3 rhs_pos = glm::vec3(rhs.global_matrix[3]);
-
-        //        float lhs_dist = glm::distance2(lhs_pos, camera_position);
-        //        float rhs_dist = glm::distance2(rhs_pos, camera_position);
+        sort_render_list(render_lists[i], static_cast<eRenderListType>(i), camera.get_eye(), view_direction);
 
-        //        if (lhs_dist > rhs_dist) return true;
-
-        //        return false;
-        //    });
-        //}
+        bool meshlet_culled_list = !is_shadow_pass && meshlet_culling_enabled && i == RENDER_LIST_OPAQUE;
 
         // Check instances
         {
             const Surface* prev_surface = nullptr;
             Material* prev_material = nullptr;
+            bool prev_meshlet_draw = false;
 
             uint32_t repeats = 0;
             for (uint32_t j = 0; j < render_lists[i].size(); ++j) {
@@ -1112,8 +1226,11 @@ void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::ve
 
                 Material* material = render_data.material;
 
-                // Repeated MeshInstance3D, must be instanced
-                if (prev_surface == render_data.surface && prev_material == material && !material->get_is_2D()) {
+                bool meshlet_draw = meshlet_culled_list && is_meshlet_draw(render_data);
+
+                // Repeated MeshInstance3D, must be instanced. Only adjacent entries are merged and instances
+                // keep the list order, so the back to front order of the transparent list is preserved
+                if (prev_surface == render_data.surface && prev_material == material && !material->get_is_2D() && !meshlet_draw && !prev_meshlet_draw) {
                     repeats++;
                 } else {
                     if (repeats > 0) {
@@ -1126,6 +1243,7 @@ void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::ve
 
                 prev_surface = render_data.surface;
                 prev_material = material;
+                prev_meshlet_draw = meshlet_draw;
 
                 // Fill instance_data
                 instances_data.instances_data[i][j] = { render_data.global_matrix };
@@ -1141,11 +1259,19 @@ void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::ve
         // Fill instance buffers
         uint32_t instances = static_cast<uint32_t>(instances_data.instances_data[i].size());
 
+        if (!is_shadow_pass) {
+            PROFILE_COUNTER_ADD("visible_instances", instances);
+        }
+
+        // Shadow views are culled on the CPU, the cull kernels use the camera frustum
+        bool gpu_culled_list = !is_shadow_pass && is_gpu_culled_list(i);
+
         if (instances > (instances_data.instances_data_uniforms[i].buffer_size / sizeof(sUniformData))) {
             //std::vector<sUniformData> default_data = { instances, { glm::mat4x4(1.0f), glm::vec4(1.0f) } };
 
+            // The frames in flight may still read the old buffer
             if (std::holds_alternative<WGPUBuffer>(instances_data.instances_data_uniforms[i].data)) {
-                wgpuBufferDestroy(std::get<WGPUBuffer>(instances_data.instances_data_uniforms[i].data));
+                frame_ring.release_later(std::get<WGPUBuffer>(instances_data.instances_data_uniforms[i].data));
             }
 
             instances_data.instances_data_uniforms[i].data = webgpu_context->create_buffer(sizeof(sUniformData) * instances, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, instances_data.instances_data[i].data(), "instance_mesh_buffer");
@@ -1159,7 +1285,7 @@ void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::ve
                 const sRenderData& render_data = render_lists[i][j];
 
                 if (instances_data.instances_bind_groups[i]) {
-                    wgpuBindGroupRelease(instances_data.instances_bind_groups[i]);
+                    frame_ring.release_later(instances_data.instances_bind_groups[i]);
                 }
 
                 instances_data.instances_bind_groups[i] = webgpu_context->create_bind_group(uniforms, render_data.material->get_shader(), 0);
@@ -1167,167 +1293,1054 @@ void Renderer::prepare_cull_instancing(const Camera& camera, std::vector<std::ve
                 j += render_data.repeat;
             }
 
-        } else if (instances > 0) {
+        } else if (instances > 0 && !gpu_culled_list) {
             webgpu_context->update_buffer(std::get<WGPUBuffer>(instances_data.instances_data_uniforms[i].data), 0, instances_data.instances_data[i].data(), sizeof(sUniformData) * instances);
         }
-    }
-}
 
-void Renderer::render_shadow_maps()
-{
-    camera_data.exposure = exposure;
-    camera_data.ibl_intensity = ibl_intensity;
-    camera_data.screen_size = { webgpu_context->screen_width, webgpu_context->screen_height };
+        bool gpu_occlusion_culling = hiz_built && occlusion_culling_mode == OCCLUSION_CULLING_GPU;
 
-    std::vector<std::vector<sRenderData>> render_lists(RENDER_LIST_COUNT);
+        // Before the instance culling, which must keep the meshlet draw instances
+        if (meshlet_culled_list) {
+            prepare_meshlet_culling(render_lists[i], instances_data, camera.get_eye(), gpu_occlusion_culling ? hiz_buffer : nullptr);
+        }
 
-    for (uint32_t light_idx = 0; light_idx < lights_with_shadow.size(); ++light_idx) {
-        Light3D* light = lights_with_shadow[light_idx];
+        instances_data.gpu_culled[i] = gpu_culled_list && instances > 0;
 
-        const Camera& light_camera = light->get_light_camera();
+        if (instances_data.gpu_culled[i]) {
+            prepare_gpu_culling(render_lists[i], i, instances_data, gpu_occlusion_culling ? hiz_buffer : nullptr);
+        }
+    }
 
-        prepare_cull_instancing(light->get_light_camera(), render_lists, shadow_instances_data, true);
+    // Culling runs before any of the passes that read the compacted instances
+    bool any_gpu_culled = instances_data.meshlet_culled;
 
-        // Update main 3d camera
+    for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
+        any_gpu_culled |= instances_data.gpu_culled[i];
+    }
 
-        camera_data.eye = light_camera.get_eye();
-        camera_data.view = light_camera.get_view();
-        camera_data.projection = light_camera.get_projection();
-        camera_data.view_projection = light_camera.get_view_projection();
+    if (any_gpu_culled) {
+        WGPUPassTimestampWrites timestamp_writes;
+        WGPUComputePassDescriptor compute_pass_desc = { .label = { "gpu_culling_pass", WGPU_STRLEN } };
+        compute_pass_desc.timestampWrites = gpu_profiler->get_pass_timestamp_writes(is_shadow_pass ? "shadow_gpu_culling" : "gpu_culling", timestamp_writes);
 
-        wgpuQueueWriteBuffer(webgpu_context->device_queue, std::get<WGPUBuffer>(shadow_camera_uniform.data), light_idx * camera_buffer_stride, &camera_data, sizeof(sCameraData));
+        WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(global_command_encoder, &compute_pass_desc);
 
-        if (!light->get_shadow_depth_texture()) {
-            light->create_shadow_data();
+        for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
+            if (instances_data.gpu_culled[i]) {
+                instances_data.cull_kernels[i]->dispatch(compute_pass);
+            }
+        }
+
+        if (instances_data.meshlet_culled) {
+            instances_data.meshlet_cull_kernel->dispatch(compute_pass);
         }
 
-        render_camera(render_lists, nullptr, light->get_shadow_depth_texture_view(), shadow_instances_data, shadow_camera_bind_group, false, "shadow_map", 0, light_idx);
+        wgpuComputePassEncoderEnd(compute_pass);
+        wgpuComputePassEncoderRelease(compute_pass);
     }
+}
 
-    // copy shadow maps (temp solution)
-    {
-        for (uint32_t light_idx = 0; light_idx < lights_with_shadow.size(); ++light_idx) {
-            Light3D* light = lights_with_shadow[light_idx];
-            const WGPUExtent3D& size = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
-            webgpu_context->copy_texture_to_texture(light->get_shadow_depth_texture(), shadow_array_texture, 0, 0, size, { 0, 0, 0 }, { 0, 0, light_idx }, get_global_command_encoder());
-        }
+void Renderer::set_gpu_culling_enabled(bool value)
+{
+    // Without the feature the indirect draws with a first instance are skipped
+    if (value && initialized && !indirect_first_instance_supported) {
+        spdlog::warn("GPU culling needs the IndirectFirstInstance feature, using CPU culling");
+        return;
     }
+
+    gpu_culling_enabled = value;
 }
 
-void Renderer::render_render_list(WGPURenderPassEncoder render_pass, const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+bool Renderer::is_gpu_culled_list(int list_index) const
+{
+    // Compaction order is not deterministic, so only the opaque list can skip the back to front order
+    return gpu_culling_enabled && list_index == RENDER_LIST_OPAQUE;
+}
+
+void Renderer::prepare_gpu_culling(const std::vector<sRenderData>& render_list, int list_index, sInstanceData& instances_data, const HiZBuffer* occlusion_hiz_buffer)
 {
-    const Pipeline* prev_pipeline = nullptr;
+    if (!instances_data.cull_kernels[list_index]) {
+        instances_data.cull_kernels[list_index] = new InstanceCullKernel();
+    }
 
-    wgpuRenderPassEncoderSetBindGroup(render_pass, 0, instance_data.instances_bind_groups[list_index], 0, nullptr);
-    wgpuRenderPassEncoderSetBindGroup(render_pass, 1, camera_bind_group, 1, &camera_buffer_stride);
+    gpu_cull_instances.resize(render_list.size());
+    gpu_cull_draw_args.clear();
+    gpu_cull_batch_first_instance.clear();
 
-    const Material* prev_material = nullptr;
+    // One batch per instanced draw, instances keep their slot inside the batch range
+    for (uint32_t j = 0; j < render_list.size();) {
+        const sRenderData& batch_data = render_list[j];
+        const Surface* surface = batch_data.surface;
 
-    for (int i = 0; i < render_list.size();) {
-        const sRenderData& render_data = render_list[i];
+        uint32_t batch_index = static_cast<uint32_t>(gpu_cull_draw_args.size());
 
-        const Material* material = render_data.material;
+        InstanceCullKernel::sDrawArgs draw_args;
 
-        if (!material) {
-            assert(0);
-            continue;
+        // Ranges inside the geometry arena buffers
+        if (surface->get_index_buffer()) {
+            draw_args.data[0] = surface->get_index_count();
+            draw_args.data[2] = surface->get_first_index();
+            draw_args.data[3] = surface->get_base_vertex();
+            draw_args.data[4] = j;
+        } else {
+            draw_args.data[0] = surface->get_vertex_count();
+            draw_args.data[2] = surface->get_base_vertex();
+            draw_args.data[3] = j;
         }
 
-        const Pipeline* pipeline = material->get_shader()->get_pipeline();
+        gpu_cull_draw_args.push_back(draw_args);
+        gpu_cull_batch_first_instance.push_back(j);
 
-        assert(pipeline);
+        float batch_bits;
+        memcpy(&batch_bits, &batch_index, sizeof(float));
 
-        if (pipeline != prev_pipeline) {
-            if (!pipeline->set(render_pass)) {
-                i += render_data.repeat;
-                continue;
-            }
-        }
+        for (uint32_t k = j; k < j + batch_data.repeat; ++k) {
+            const sRenderData& render_data = render_list[k];
 
-        // Not initialized
-        if (render_data.surface->get_vertex_count() == 0) {
-            spdlog::error("Skipping not initialized mesh");
-            continue;
+            // Meshlet draws are culled per cluster, their instance is always needed
+            bool never_culled = !render_data.mesh_ref->get_frustum_culling_enabled() || render_data.material->get_is_2D() ||
+                render_data.meshlet_draw != UINT32_MAX;
+
+            gpu_cull_instances[k] = {
+                render_data.global_matrix,
+                glm::vec4(render_data.world_aabb.center, batch_bits),
+                glm::vec4(render_data.world_aabb.half_size, never_culled ? 1.0f : 0.0f)
+            };
         }
 
-        // Set bind groups
+        j += batch_data.repeat;
+    }
 
-        if (material != prev_material && (material->get_fragment_write() || (!material->get_fragment_write() && material->get_use_skinning()))) {
-            wgpuRenderPassEncoderSetBindGroup(render_pass, 2, renderer_storage->get_material_bind_group(material), 0, nullptr);
+    const Uniform& instances_uniform = instances_data.instances_data_uniforms[list_index];
 
-            if ((!prev_material && material->get_type() == MATERIAL_PBR) ||
-                    (prev_material && prev_material->get_type() != MATERIAL_PBR && material->get_type() == MATERIAL_PBR)) {
-                wgpuRenderPassEncoderSetBindGroup(render_pass, 3, lighting_bind_group, 0, nullptr);
-            }
+    instances_data.cull_kernels[list_index]->update(frustum_cull, gpu_cull_instances, gpu_cull_draw_args, gpu_cull_batch_first_instance,
+        std::get<WGPUBuffer>(instances_uniform.data), instances_uniform.buffer_size, occlusion_hiz_buffer);
+}
 
-            prev_material = material;
-        }
+bool Renderer::is_meshlet_draw(const sRenderData& render_data) const
+{
+    // Skinning moves the triangles away from the meshlet bounds. Meshlet draws are indirect and start at
+    // their first instance, and the cull kernel binds the surface ranges, which must fit in a storage binding
+    const Surface* surface = render_data.surface;
 
-        //#ifndef NDEBUG
-        //        webgpu_context->push_debug_group(render_pass, render_data.surface->get_name().c_str());
-        //#endif
+    return surface->has_meshlets() && render_data.mesh_ref->get_frustum_culling_enabled() &&
+        !render_data.material->get_is_2D() && !render_data.material->get_use_skinning() && indirect_first_instance_supported &&
+        MeshletCullKernel::fits_binding(surface->get_index_count(), static_cast<uint32_t>(surface->get_meshlets().size()));
+}
 
-        if (material->get_type() == MATERIAL_UI) {
-            WGPUBindGroup ui_bind_group = renderer_storage->get_ui_widget_bind_group(render_data.mesh_ref);
-            if (ui_bind_group) {
-                wgpuRenderPassEncoderSetBindGroup(render_pass, 3, ui_bind_group, 0, nullptr);
-            }
-        }
+void Renderer::prepare_meshlet_culling(std::vector<sRenderData>& render_list, sInstanceData& instances_data, const glm::vec3& eye, const HiZBuffer* occlusion_hiz_buffer)
+{
+    meshlet_draws.clear();
+    meshlet_draw_args.clear();
+    meshlet_draw_first_indices.clear();
+    meshlet_draw_index_counts.clear();
 
-        // Set vertex buffer while encoding the render pass
-        wgpuRenderPassEncoderSetVertexBuffer(render_pass, 0, render_data.surface->get_vertex_buffer(), 0, render_data.surface->get_vertices_byte_size());
+    for (uint32_t j = 0; j < render_list.size(); j += render_list[j].repeat) {
+        sRenderData& render_data = render_list[j];
 
-        if (material->get_fragment_write()) {
-            wgpuRenderPassEncoderSetVertexBuffer(render_pass, 1, render_data.surface->get_vertex_data_buffer(), 0, render_data.surface->get_interleaved_data_byte_size());
+        if (!is_meshlet_draw(render_data)) {
+            continue;
         }
 
-        WGPUBuffer index_buffer = render_data.surface->get_index_buffer();
+        const Surface* surface = render_data.surface;
 
-        if (index_buffer) {
-            wgpuRenderPassEncoderSetIndexBuffer(render_pass, index_buffer, WGPUIndexFormat_Uint32, 0, render_data.surface->get_indices_byte_size());
+        render_data.meshlet_draw = static_cast<uint32_t>(meshlet_draws.size());
 
-            wgpuRenderPassEncoderDrawIndexed(render_pass, render_data.surface->get_index_count(), render_data.repeat, 0, 0, i);
-        } else {
-            wgpuRenderPassEncoderDraw(render_pass, render_data.surface->get_vertex_count(), render_data.repeat, 0, i);
-        }
+        MeshletCullKernel::sMeshletDraw draw;
+        draw.model = render_data.global_matrix;
+        draw.first_meshlet = surface->get_first_meshlet();
+        draw.meshlet_count = static_cast<uint32_t>(surface->get_meshlets().size());
+        meshlet_draws.push_back(draw);
 
-        //#ifndef NDEBUG
-        //        webgpu_context->pop_debug_group(render_pass);
-        //#endif
+        // The index count and first index are set by the kernel
+        MeshletCullKernel::sDrawArgs draw_args;
+        draw_args.data[1] = 1;
+        draw_args.data[3] = surface->get_base_vertex();
+        draw_args.data[4] = j;
+        meshlet_draw_args.push_back(draw_args);
+
+        meshlet_draw_first_indices.push_back(surface->get_first_index());
+        meshlet_draw_index_counts.push_back(surface->get_index_count());
+    }
 
-        prev_pipeline = pipeline;
+    instances_data.meshlet_culled = !meshlet_draws.empty();
 
-        i += render_data.repeat;
+    if (!instances_data.meshlet_culled) {
+        return;
     }
-}
 
-void Renderer::render_opaque(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
-{
-#ifndef NDEBUG
-    webgpu_context->push_debug_group(render_pass, { "Opaque", WGPU_STRLEN });
-#endif
+    if (!instances_data.meshlet_cull_kernel) {
+        instances_data.meshlet_cull_kernel = new MeshletCullKernel();
+    }
 
-    render_render_list(render_pass, render_lists[RENDER_LIST_OPAQUE], RENDER_LIST_OPAQUE, instance_data, camera_bind_group, camera_buffer_stride);
+    // Both eyes draw the culling of the combined camera, its eye is not valid for the normal cones
+    instances_data.meshlet_cull_kernel->set_cone_culling_enabled(!is_xr_available);
 
-#ifndef NDEBUG
-    webgpu_context->pop_debug_group(render_pass);
-#endif
+    instances_data.meshlet_cull_kernel->update(frustum_cull, eye, meshlet_draws, meshlet_draw_args, meshlet_draw_first_indices,
+        meshlet_draw_index_counts, occlusion_hiz_buffer);
 }
 
-void Renderer::render_transparent(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+void Renderer::cull_render_entities(bool is_shadow_pass)
 {
-#ifndef NDEBUG
-    webgpu_context->push_debug_group(render_pass, { "Transparent", WGPU_STRLEN });
-#endif
+    if (render_proxy_tree.needs_rebuild()) {
+        render_proxy_tree.rebuild();
+    }
 
-    render_render_list(render_pass, render_lists[RENDER_LIST_TRANSPARENT], RENDER_LIST_TRANSPARENT, instance_data, camera_bind_group, camera_buffer_stride);
+    proxy_candidates.clear();
 
-#ifndef NDEBUG
-    webgpu_context->pop_debug_group(render_pass);
-#endif
-}
+    if (gpu_culling_enabled) {
+        // Everything submitted is kept, the frustum test is done per list when adding the surfaces
+        for (uint32_t proxy_id = 0; proxy_id < render_proxies.size(); ++proxy_id) {
+            const sRenderProxy& proxy = render_proxies[proxy_id];
+            if (proxy.in_use && proxy.submitted_frame == frame_counter && !proxy.uncullable) {
+                proxy_candidates.push_back(proxy_id | PROXY_FULLY_INSIDE);
+            }
+        }
+    } else {
+        // Whole subtrees outside the frustum are discarded here
+        render_proxy_tree.query_frustum(frustum_cull, [&](uint32_t proxy_id, bool fully_inside) {
+            if (render_proxies[proxy_id].submitted_frame == frame_counter) {
+                proxy_candidates.push_back(fully_inside ? (proxy_id | PROXY_FULLY_INSIDE) : proxy_id);
+            }
+        });
+    }
 
-void Renderer::render_splats(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+    for (uint32_t proxy_id : uncullable_render_proxies) {
+        if (render_proxies[proxy_id].submitted_frame == frame_counter) {
+            proxy_candidates.push_back(proxy_id | PROXY_FULLY_INSIDE);
+        }
+    }
+
+    // Occluders are finished before the threads start testing against them
+    software_occlusion_active = software_occlusion_enabled && !is_shadow_pass;
+
+    if (software_occlusion_active) {
+        rasterize_occluders();
+    }
+
+    // Tree leaves are enlarged, test the exact proxy bounds in batches
+    job_system->parallel_for(static_cast<uint32_t>(proxy_candidates.size()), 64u, [&](uint32_t thread_index, uint32_t begin, uint32_t end) {
+        sCullThreadData& thread_data = cull_thread_data[thread_index];
+        sRenderProxyBounds& candidate_bounds = thread_data.candidate_bounds;
+        std::vector<sRenderData>* thread_render_lists = thread_data.render_lists;
+
+        begin_cull_chunk(thread_data, begin, thread_render_lists, RENDER_LIST_COUNT);
+
+        const uint32_t count = end - begin;
+
+        candidate_bounds.resize(count);
+        thread_data.visibility_mask.resize((count + 31) / 32);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t proxy_id = proxy_candidates[begin + i] & ~PROXY_FULLY_INSIDE;
+            candidate_bounds.set(i, render_proxies[proxy_id].world_aabb);
+        }
+
+        frustum_cull.test_boxes(candidate_bounds.center_x.data(), candidate_bounds.center_y.data(), candidate_bounds.center_z.data(),
+            candidate_bounds.extent_x.data(), candidate_bounds.extent_y.data(), candidate_bounds.extent_z.data(),
+            count, thread_data.visibility_mask.data());
+
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t candidate = proxy_candidates[begin + i];
+            bool fully_inside = candidate & PROXY_FULLY_INSIDE;
+
+            sRenderProxy& proxy = render_proxies[candidate & ~PROXY_FULLY_INSIDE];
+
+            bool proxy_visible = fully_inside || ((thread_data.visibility_mask[i / 32] >> (i % 32)) & 1u);
+
+            if (!proxy_visible) {
+                continue;
+            }
+
+            for (sRenderProxySurface& proxy_surface : proxy.surfaces) {
+                Material* material = proxy_surface.material_override ? proxy_surface.material_override : proxy_surface.surface->get_material();
+
+                // Single surface proxies share the bounds already tested
+                bool inside_frustum = true;
+
+                if (!fully_inside && proxy.surfaces.size() > 1) {
+                    const AABB& world_aabb = proxy_surface.world_aabb;
+                    inside_frustum = is_inside_frustum(world_aabb.center - world_aabb.half_size, world_aabb.center + world_aabb.half_size);
+                }
+
+                // Each proxy is handled by a single thread, its LOD state can be written here
+                Surface* surface = is_shadow_pass ? proxy_surface.surface->get_lod_surface(proxy_surface.lod_level) :
+                    select_lod_surface(proxy_surface.surface, proxy_surface.world_aabb, proxy_surface.lod_level);
+
+                add_surface_to_render_lists(proxy.mesh, surface, material, proxy.global_matrix, proxy_surface.world_aabb, inside_frustum, thread_render_lists, is_shadow_pass);
+            }
+        }
+    });
+
+    // Get all surfaces from immediate entity meshes
+    job_system->parallel_for(static_cast<uint32_t>(render_entity_list.size()), 32u, [&](uint32_t thread_index, uint32_t begin, uint32_t end) {
+        std::vector<sRenderData>* thread_render_lists = cull_thread_data[thread_index].render_lists;
+
+        begin_cull_chunk(cull_thread_data[thread_index], (1ull << 32) | begin, thread_render_lists, RENDER_LIST_COUNT);
+
+        for (uint32_t i = begin; i < end; ++i) {
+            Mesh* mesh = render_entity_list[i].mesh;
+            const glm::mat4x4& global_matrix = render_entity_list[i].global_matrix;
+
+            for (Surface* surface : mesh->get_surfaces()) {
+                Material* material_override = mesh->get_surface_material_override(surface);
+                Material* material = material_override ? material_override : surface->get_material();
+
+                AABB world_aabb;
+                bool inside_frustum = true;
+
+                Surface* lod_surface = surface;
+
+                if (mesh->get_frustum_culling_enabled()) {
+                    world_aabb = surface->get_aabb().transform(global_matrix);
+
+                    if (!gpu_culling_enabled) {
+                        inside_frustum = is_inside_frustum(world_aabb.center - world_aabb.half_size, world_aabb.center + world_aabb.half_size);
+                    }
+
+                    // Immediate meshes keep no state, the level is picked from scratch every frame
+                    uint32_t lod_level = 0;
+
+                    if (!is_shadow_pass) {
+                        lod_surface = select_lod_surface(surface, world_aabb, lod_level);
+                    }
+                }
+
+                add_surface_to_render_lists(mesh, lod_surface, material, global_matrix, world_aabb, inside_frustum, thread_render_lists, is_shadow_pass);
+            }
+        }
+    });
+}
+
+Surface* Renderer::select_lod_surface(Surface* surface, const AABB& world_aabb, uint32_t& lod_level) const
+{
+    const std::vector<Surface::sLod>& lods = surface->get_lods();
+
+    if (!lod_enabled || lods.empty()) {
+        lod_level = 0;
+        return surface;
+    }
+
+    // Projected radius of the bounding sphere, as a fraction of the viewport height
+    float screen_size = glm::length(world_aabb.half_size) * lod_projection_scale * lod_bias;
+
+    if (lod_perspective) {
+        screen_size /= std::max(glm::length(world_aabb.center - lod_eye), 1e-4f);
+    }
+
+    const uint32_t max_level = static_cast<uint32_t>(lods.size());
+
+    lod_level = std::min(lod_level, max_level);
+
+    // lods[level] is the next coarser level, lods[level - 1] the current one
+    while (lod_level < max_level && screen_size < lods[lod_level].screen_size * (1.0f - LOD_HYSTERESIS)) {
+        lod_level++;
+    }
+
+    while (lod_level > 0 && screen_size > lods[lod_level - 1].screen_size * (1.0f + LOD_HYSTERESIS)) {
+        lod_level--;
+    }
+
+    return surface->get_lod_surface(lod_level);
+}
+
+void Renderer::rasterize_occluders()
+{
+    software_occlusion_culler.clear(cull_view_projection);
+
+    auto rasterize_mesh = [&](Mesh* mesh, const glm::mat4x4& global_matrix) {
+        for (Surface* surface : mesh->get_surfaces()) {
+            const sSurfaceData& surface_data = surface->get_surface_data();
+
+            // Vertex data not kept on the CPU
+            if (surface_data.vertices.empty()) {
+                continue;
+            }
+
+            software_occlusion_culler.rasterize(surface_data.vertices.data(), static_cast<uint32_t>(surface_data.vertices.size()),
+                surface_data.indices.empty() ? nullptr : surface_data.indices.data(), static_cast<uint32_t>(surface_data.indices.size()), global_matrix);
+        }
+    };
+
+    for (uint32_t candidate : proxy_candidates) {
+        const sRenderProxy& proxy = render_proxies[candidate & ~PROXY_FULLY_INSIDE];
+
+        if (proxy.mesh->get_is_occluder()) {
+            rasterize_mesh(proxy.mesh, proxy.global_matrix);
+        }
+    }
+
+    for (const sRenderListData& render_entity : render_entity_list) {
+        if (render_entity.mesh->get_is_occluder()) {
+            rasterize_mesh(render_entity.mesh, render_entity.global_matrix);
+        }
+    }
+}
+
+void Renderer::merge_cull_thread_data(std::vector<std::vector<sRenderData>>& render_lists)
+{
+    sort_cull_chunks();
+
+    for (int i = 0; i < RENDER_LIST_COUNT; ++i) {
+        merge_cull_chunks(i, RENDER_LIST_COUNT, false, render_lists[i]);
+
+        // Renderer storage is not thread safe, register the visible surfaces serially
+        for (const sRenderData& render_data : render_lists[i]) {
+            RendererStorage::instance->register_material_bind_group(webgpu_context, render_data.mesh_ref, render_data.material);
+            RendererStorage::register_render_pipeline(render_data.material);
+        }
+    }
+
+    clear_cull_chunks();
+}
+
+void Renderer::begin_cull_chunk(sCullThreadData& thread_data, uint64_t order, const std::vector<sRenderData>* thread_lists, uint32_t list_count)
+{
+    thread_data.chunk_orders.push_back(order);
+
+    for (uint32_t i = 0; i < list_count; ++i) {
+        thread_data.chunk_offsets.push_back(static_cast<uint32_t>(thread_lists[i].size()));
+    }
+}
+
+void Renderer::sort_cull_chunks()
+{
+    cull_chunks.clear();
+
+    for (uint32_t thread_index = 0; thread_index < cull_thread_data.size(); ++thread_index) {
+        const std::vector<uint64_t>& chunk_orders = cull_thread_data[thread_index].chunk_orders;
+
+        for (uint32_t chunk_index = 0; chunk_index < chunk_orders.size(); ++chunk_index) {
+            cull_chunks.push_back({ chunk_orders[chunk_index], thread_index, chunk_index });
+        }
+    }
+
+    std::sort(cull_chunks.begin(), cull_chunks.end(), [](const sCullChunk& a, const sCullChunk& b) { return a.order < b.order; });
+}
+
+void Renderer::merge_cull_chunks(uint32_t list_index, uint32_t list_count, bool is_shadow_view, std::vector<sRenderData>& render_list)
+{
+    size_t total_size = render_list.size();
+
+    for (sCullThreadData& thread_data : cull_thread_data) {
+        total_size += is_shadow_view ? thread_data.shadow_render_lists[list_index].size() : thread_data.render_lists[list_index].size();
+    }
+
+    render_list.reserve(total_size);
+
+    // Each chunk filled a contiguous slice of its thread lists, up to where the next chunk of the thread started
+    for (const sCullChunk& chunk : cull_chunks) {
+        sCullThreadData& thread_data = cull_thread_data[chunk.thread_index];
+        std::vector<sRenderData>& thread_list = is_shadow_view ? thread_data.shadow_render_lists[list_index] : thread_data.render_lists[list_index];
+
+        const uint32_t next_chunk = chunk.chunk_index + 1;
+
+        size_t slice_begin = thread_data.chunk_offsets[chunk.chunk_index * list_count + list_index];
+        size_t slice_end = next_chunk < thread_data.chunk_orders.size() ? thread_data.chunk_offsets[next_chunk * list_count + list_index] : thread_list.size();
+
+        render_list.insert(render_list.end(), thread_list.begin() + slice_begin, thread_list.begin() + slice_end);
+    }
+
+    for (sCullThreadData& thread_data : cull_thread_data) {
+        if (is_shadow_view) {
+            thread_data.shadow_render_lists[list_index].clear();
+        } else {
+            thread_data.render_lists[list_index].clear();
+        }
+    }
+}
+
+void Renderer::clear_cull_chunks()
+{
+    for (sCullThreadData& thread_data : cull_thread_data) {
+        thread_data.chunk_orders.clear();
+        thread_data.chunk_offsets.clear();
+    }
+
+    cull_chunks.clear();
+}
+
+void Renderer::cull_shadow_views()
+{
+    // View masks are 32 bits wide, extra lights are left without shadows
+    const uint32_t view_count = std::min(static_cast<uint32_t>(lights_with_shadow.size()), MAX_SHADOW_VIEWS);
+    const uint32_t all_views = view_count == 32u ? 0xFFFFFFFFu : (1u << view_count) - 1u;
+
+    shadow_frustums.resize(view_count);
+    shadow_render_lists.resize(view_count);
+
+    for (uint32_t view = 0; view < view_count; ++view) {
+        shadow_frustums[view].set_view_projection(lights_with_shadow[view]->get_light_camera().get_view_projection());
+        shadow_render_lists[view].resize(RENDER_LIST_COUNT);
+
+        for (std::vector<sRenderData>& render_list : shadow_render_lists[view]) {
+            render_list.clear();
+        }
+    }
+
+    if (view_count == 0) {
+        return;
+    }
+
+    if (render_proxy_tree.needs_rebuild()) {
+        render_proxy_tree.rebuild();
+    }
+
+    // One tree walk per view, each proxy gathers the views it touches and is listed only once
+    shadow_view_masks.resize(render_proxies.size(), 0u);
+    proxy_candidates.clear();
+
+    auto add_views = [&](uint32_t proxy_id, uint32_t view_mask) {
+        if (shadow_view_masks[proxy_id] == 0u) {
+            proxy_candidates.push_back(proxy_id);
+        }
+
+        shadow_view_masks[proxy_id] |= view_mask;
+    };
+
+    for (uint32_t view = 0; view < view_count; ++view) {
+        render_proxy_tree.query_frustum(shadow_frustums[view], [&](uint32_t proxy_id, bool fully_inside) {
+            if (render_proxies[proxy_id].submitted_frame == frame_counter) {
+                add_views(proxy_id, 1u << view);
+            }
+        });
+    }
+
+    for (uint32_t proxy_id : uncullable_render_proxies) {
+        if (render_proxies[proxy_id].submitted_frame == frame_counter) {
+            add_views(proxy_id, all_views);
+        }
+    }
+
+    for (sCullThreadData& thread_data : cull_thread_data) {
+        thread_data.shadow_render_lists.resize(view_count);
+    }
+
+    // Every surface is visited once, whatever the number of views it lands in
+    job_system->parallel_for(static_cast<uint32_t>(proxy_candidates.size()), 64u, [&](uint32_t thread_index, uint32_t begin, uint32_t end) {
+        std::vector<std::vector<sRenderData>>& thread_shadow_lists = cull_thread_data[thread_index].shadow_render_lists;
+
+        begin_cull_chunk(cull_thread_data[thread_index], begin, thread_shadow_lists.data(), view_count);
+
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t proxy_id = proxy_candidates[i];
+            const sRenderProxy& proxy = render_proxies[proxy_id];
+
+            for (const sRenderProxySurface& proxy_surface : proxy.surfaces) {
+                Material* material = proxy_surface.material_override ? proxy_surface.material_override : proxy_surface.surface->get_material();
+
+                // Same level as the camera pass, so surfaces don't shadow themselves with a different LOD
+                Surface* surface = proxy_surface.surface->get_lod_surface(proxy_surface.lod_level);
+
+                add_surface_to_shadow_views(proxy.mesh, surface, material, proxy.global_matrix, proxy_surface.world_aabb, shadow_view_masks[proxy_id], thread_shadow_lists);
+            }
+        }
+    });
+
+    job_system->parallel_for(static_cast<uint32_t>(render_entity_list.size()), 32u, [&](uint32_t thread_index, uint32_t begin, uint32_t end) {
+        std::vector<std::vector<sRenderData>>& thread_shadow_lists = cull_thread_data[thread_index].shadow_render_lists;
+
+        begin_cull_chunk(cull_thread_data[thread_index], (1ull << 32) | begin, thread_shadow_lists.data(), view_count);
+
+        for (uint32_t i = begin; i < end; ++i) {
+            Mesh* mesh = render_entity_list[i].mesh;
+            const glm::mat4x4& global_matrix = render_entity_list[i].global_matrix;
+
+            for (Surface* surface : mesh->get_surfaces()) {
+                Material* material_override = mesh->get_surface_material_override(surface);
+                Material* material = material_override ? material_override : surface->get_material();
+
+                AABB world_aabb;
+
+                if (mesh->get_frustum_culling_enabled()) {
+                    world_aabb = surface->get_aabb().transform(global_matrix);
+                }
+
+                add_surface_to_shadow_views(mesh, surface, material, global_matrix, world_aabb, all_views, thread_shadow_lists);
+            }
+        }
+    });
+
+    for (uint32_t proxy_id : proxy_candidates) {
+        shadow_view_masks[proxy_id] = 0u;
+    }
+
+    sort_cull_chunks();
+
+    // Only the opaque list is filled, every entry uses the shadow material
+    for (uint32_t view = 0; view < view_count; ++view) {
+        std::vector<sRenderData>& render_list = shadow_render_lists[view][RENDER_LIST_OPAQUE];
+
+        merge_cull_chunks(view, view_count, true, render_list);
+
+        for (const sRenderData& render_data : render_list) {
+            RendererStorage::instance->register_material_bind_group(webgpu_context, render_data.mesh_ref, render_data.material);
+        }
+    }
+
+    clear_cull_chunks();
+
+    RendererStorage::register_render_pipeline(shadow_material);
+}
+
+void Renderer::add_surface_to_shadow_views(Mesh* mesh, Surface* surface, Material* material, const glm::mat4x4& global_matrix, const AABB& world_aabb,
+        uint32_t view_mask, std::vector<std::vector<sRenderData>>& shadow_lists)
+{
+    if (!shadow_material || !shadow_material->get_shader() || !material) {
+        return;
+    }
+
+    if (!mesh->get_receive_shadows() || material->get_is_2D() || material->get_transparency_type() == ALPHA_BLEND) {
+        return;
+    }
+
+    // Tree leaves are enlarged and cover the whole proxy, test the exact surface bounds per view
+    bool cullable = mesh->get_frustum_culling_enabled() && world_aabb.initialized();
+
+    const glm::vec3 box_min = world_aabb.center - world_aabb.half_size;
+    const glm::vec3 box_max = world_aabb.center + world_aabb.half_size;
+
+    while (view_mask) {
+        uint32_t view = std::countr_zero(view_mask);
+        view_mask &= view_mask - 1u;
+
+        if (cullable && !shadow_frustums[view].is_box_visible(box_min, box_max)) {
+            continue;
+        }
+
+        shadow_lists[view].push_back({ surface, 1, global_matrix, mesh, shadow_material, world_aabb });
+    }
+}
+
+void Renderer::add_surface_to_render_lists(Mesh* mesh, Surface* surface, Material* material, const glm::mat4x4& global_matrix, const AABB& world_aabb,
+        bool inside_frustum, std::vector<sRenderData>* render_lists, bool is_shadow_pass)
+{
+    if (is_shadow_pass) {
+        material = shadow_material;
+    }
+
+    if (!material || !material->get_shader()) {
+        return;
+    }
+
+    bool material_is_2d = material->get_is_2D();
+
+    if (is_shadow_pass && (!mesh->get_receive_shadows() || material_is_2d || material->get_transparency_type() == ALPHA_BLEND)) {
+        return;
+    }
+
+    eRenderListType list = RENDER_LIST_OPAQUE;
+
+    if (material_is_2d) {
+        list = material->get_transparency_type() == ALPHA_BLEND ? RENDER_LIST_2D_TRANSPARENT : RENDER_LIST_2D;
+    } else if (material->get_transparency_type() == ALPHA_BLEND) {
+        list = RENDER_LIST_TRANSPARENT;
+    }
+
+    if (!material_is_2d && mesh->get_frustum_culling_enabled()) {
+        // GPU culled lists are tested in the compute pass, the rest were skipped by the CPU cull
+        if (gpu_culling_enabled && !is_gpu_culled_list(list)) {
+            inside_frustum = is_inside_frustum(world_aabb.center - world_aabb.half_size, world_aabb.center + world_aabb.half_size);
+        }
+
+        if (!inside_frustum) {
+            return;
+        }
+
+        if (software_occlusion_active && !mesh->get_is_occluder() && !software_occlusion_culler.is_visible(world_aabb)) {
+            return;
+        }
+
+        if (cpu_occlusion_culling && hiz_buffer->is_occluded(world_aabb)) {
+            return;
+        }
+    }
+
+    render_lists[list].push_back({ surface, 1, global_matrix, mesh, material, world_aabb });
+}
+
+uint64_t Renderer::compute_sort_key(const sRenderData& render_data, eRenderListType list, const glm::vec3& eye, const glm::vec3& view_direction) const
+{
+    const Material* material = render_data.material;
+    const Pipeline* pipeline = material->get_shader()->get_pipeline();
+
+    uint32_t pipeline_id = pipeline ? pipeline->get_sort_id() : 0;
+
+    if (list == RENDER_LIST_TRANSPARENT) {
+        // View depth of the bounds center, the origin may be far from the geometry
+        const glm::vec3 position = render_data.world_aabb.initialized() ? render_data.world_aabb.center : glm::vec3(render_data.global_matrix[3]);
+        float view_depth = glm::dot(position - eye, view_direction);
+
+        return pack_transparent_sort_key(list, material->get_priority(), view_depth, pipeline_id, material->get_sort_id());
+    }
+
+    return pack_sort_key(list, material->get_priority(), pipeline_id, material->get_sort_id(), render_data.surface->get_sort_id());
+}
+
+void Renderer::sort_render_list(std::vector<sRenderData>& render_list, eRenderListType list, const glm::vec3& eye, const glm::vec3& view_direction)
+{
+    const uint32_t count = static_cast<uint32_t>(render_list.size());
+
+    if (count < 2) {
+        return;
+    }
+
+    sort_entries.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        sRenderData& render_data = render_list[i];
+        render_data.sort_key = compute_sort_key(render_data, list, eye, view_direction);
+        sort_entries[i] = { render_data.sort_key, i };
+    }
+
+    radix_sort(sort_entries, sort_entries_scratch);
+
+    render_list_scratch.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        render_list_scratch[i] = render_list[sort_entries[i].index];
+    }
+
+    render_list.swap(render_list_scratch);
+}
+
+void Renderer::render_shadow_maps()
+{
+    camera_data.exposure = exposure;
+    camera_data.ibl_intensity = ibl_intensity;
+    camera_data.screen_size = { webgpu_context->screen_width, webgpu_context->screen_height };
+
+    // All the views are culled together, then each light only sorts and uploads its own lists
+    cull_shadow_views();
+
+    const uint32_t view_count = static_cast<uint32_t>(shadow_render_lists.size());
+
+    sFrameResources& frame = get_frame_resources();
+
+    // Each light keeps its instance buffers, they are all written before the frame is submitted
+    if (frame.shadow_instances_data.size() < view_count) {
+        frame.shadow_instances_data.resize(view_count);
+    }
+
+    gpu_profiler->begin_scope("shadow_maps");
+
+    for (uint32_t light_idx = 0; light_idx < view_count; ++light_idx) {
+        Light3D* light = lights_with_shadow[light_idx];
+
+        const Camera& light_camera = light->get_light_camera();
+
+        std::vector<std::vector<sRenderData>>& render_lists = shadow_render_lists[light_idx];
+        sInstanceData& instances_data = frame.shadow_instances_data[light_idx];
+
+        prepare_instancing(light_camera, render_lists, instances_data, true);
+
+        // Update main 3d camera
+
+        camera_data.eye = light_camera.get_eye();
+        camera_data.view = light_camera.get_view();
+        camera_data.projection = light_camera.get_projection();
+        camera_data.view_projection = light_camera.get_view_projection();
+
+        webgpu_context->update_buffer(std::get<WGPUBuffer>(frame.shadow_camera_uniform.data), light_idx * camera_buffer_stride, &camera_data, sizeof(sCameraData));
+
+        if (!light->get_shadow_depth_texture()) {
+            light->create_shadow_data();
+        }
+
+        render_camera(render_lists, nullptr, light->get_shadow_depth_texture_view(), instances_data, frame.shadow_camera_bind_group, false, "shadow_map", 0, light_idx);
+    }
+
+    gpu_profiler->end_scope();
+
+    // copy shadow maps (temp solution)
+    {
+        for (uint32_t light_idx = 0; light_idx < view_count; ++light_idx) {
+            Light3D* light = lights_with_shadow[light_idx];
+            const WGPUExtent3D& size = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+            webgpu_context->copy_texture_to_texture(light->get_shadow_depth_texture(), shadow_array_texture, 0, 0, size, { 0, 0, 0 }, { 0, 0, light_idx }, get_global_command_encoder());
+        }
+    }
+}
+
+void Renderer::render_render_list(WGPURenderPassEncoder render_pass, const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+{
+    // Custom passes may record on the encoder between lists, the state is only known within one
+    render_pass_state.reset(render_pass);
+
+    encode_render_list(render_list, list_index, instance_data, camera_bind_group, camera_buffer_stride);
+}
+
+void Renderer::build_render_list_key(const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group,
+    std::vector<uint64_t>& key) const
+{
+    // Everything encode_render_list reads, so an equal key records the same commands. Per frame data
+    // such as transforms, material values or culling results lives in buffers and is not part of it
+    const InstanceCullKernel* cull_kernel = instance_data.gpu_culled[list_index] ? instance_data.cull_kernels[list_index] : nullptr;
+    const MeshletCullKernel* meshlet_cull_kernel = instance_data.meshlet_culled ? instance_data.meshlet_cull_kernel : nullptr;
+
+    auto add_handle = [&key](const void* handle) { key.push_back(reinterpret_cast<uintptr_t>(handle)); };
+
+    key.clear();
+
+    key.push_back(list_index);
+    key.push_back(msaa_count);
+    key.push_back(render_list.size());
+    add_handle(instance_data.instances_bind_groups[list_index]);
+    add_handle(camera_bind_group);
+    add_handle(get_frame_resources().lighting_bind_group);
+    add_handle(cull_kernel ? cull_kernel->get_draw_args_buffer() : nullptr);
+    add_handle(meshlet_cull_kernel ? meshlet_cull_kernel->get_draw_args_buffer() : nullptr);
+    add_handle(meshlet_cull_kernel ? meshlet_cull_kernel->get_index_buffer() : nullptr);
+
+    for (int i = 0; i < render_list.size(); i += render_list[i].repeat) {
+        const sRenderData& render_data = render_list[i];
+        const Material* material = render_data.material;
+        const Surface* surface = render_data.surface;
+
+        add_handle(surface);
+        add_handle(material);
+        key.push_back(render_data.repeat);
+        key.push_back(render_data.meshlet_draw);
+        add_handle(surface->get_vertex_buffer());
+        add_handle(surface->get_index_buffer());
+        key.push_back(surface->get_vertex_count());
+        key.push_back(surface->get_base_vertex());
+        key.push_back(surface->get_index_count());
+        key.push_back(surface->get_first_index());
+
+        if (!material) {
+            continue;
+        }
+
+        // Reloading a shader replaces the pipeline behind the same object
+        const Pipeline* pipeline = material->get_shader()->get_pipeline();
+
+        add_handle(pipeline);
+        key.push_back(pipeline ? pipeline->get_generation() : 0);
+        add_handle(renderer_storage->get_material_bind_group(material));
+        key.push_back(RendererStorage::get_material_params_offset(material));
+
+        if (material->get_type() == MATERIAL_UI) {
+            add_handle(renderer_storage->get_ui_widget_bind_group(render_data.mesh_ref));
+        }
+    }
+}
+
+void Renderer::update_render_list_bundle(sCachedBundle& cached_bundle, const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, const char* label)
+{
+    build_render_list_key(render_list, list_index, instance_data, camera_bind_group, bundle_key);
+
+    size_t key_hash = 0;
+    for (uint64_t value : bundle_key) {
+        hash_combine(key_hash, std::hash<uint64_t>()(value));
+    }
+
+    // The whole key is compared, a hash collision must not replay another list
+    if (render_bundle_cache_enabled && cached_bundle.reusable && cached_bundle.key_hash == key_hash && cached_bundle.key == bundle_key) {
+        frame_stats.bundles_reused++;
+        return;
+    }
+
+    if (cached_bundle.bundle) {
+        frame_ring.release_later(cached_bundle.bundle);
+    }
+
+    cached_bundle = {};
+    cached_bundle.key = bundle_key;
+    cached_bundle.key_hash = key_hash;
+
+    if (render_list.empty()) {
+        cached_bundle.reusable = true;
+        return;
+    }
+
+    WGPUTextureFormat color_format = is_xr_available ? webgpu_context->xr_swapchain_format : webgpu_context->swapchain_format;
+
+    // Must match the attachments of the camera passes
+    WGPURenderBundleEncoderDescriptor bundle_encoder_descr = {};
+    bundle_encoder_descr.label = { label, WGPU_STRLEN };
+    bundle_encoder_descr.colorFormatCount = 1;
+    bundle_encoder_descr.colorFormats = &color_format;
+    bundle_encoder_descr.depthStencilFormat = WGPUTextureFormat_Depth32Float;
+    bundle_encoder_descr.sampleCount = msaa_count;
+    bundle_encoder_descr.depthReadOnly = false;
+    bundle_encoder_descr.stencilReadOnly = true;
+
+    WGPURenderBundleEncoder bundle_encoder = wgpuDeviceCreateRenderBundleEncoder(webgpu_context->device, &bundle_encoder_descr);
+
+    render_pass_state.reset(bundle_encoder);
+
+    // Draws of pipelines still compiling are missing, the bundle is only good for this frame
+    cached_bundle.reusable = encode_render_list(render_list, list_index, instance_data, camera_bind_group, 0);
+
+    WGPURenderBundleDescriptor bundle_descr = {};
+    bundle_descr.label = { label, WGPU_STRLEN };
+
+    cached_bundle.bundle = wgpuRenderBundleEncoderFinish(bundle_encoder, &bundle_descr);
+
+    wgpuRenderBundleEncoderRelease(bundle_encoder);
+
+    frame_stats.bundles_recorded++;
+}
+
+void Renderer::update_camera_bundles(const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group)
+{
+    // Materials used by the bundles have to be uploaded before they are recorded
+    RendererStorage::flush_material_params(webgpu_context);
+
+    // Each frame index keeps its bundles, they bind the buffers of that index
+    sCameraBundles& camera_bundles = get_frame_resources().camera_bundles;
+
+    update_render_list_bundle(camera_bundles.opaque, render_lists[RENDER_LIST_OPAQUE], RENDER_LIST_OPAQUE, instance_data, camera_bind_group, "opaque_bundle");
+    update_render_list_bundle(camera_bundles.transparent, render_lists[RENDER_LIST_TRANSPARENT], RENDER_LIST_TRANSPARENT, instance_data, camera_bind_group, "transparent_bundle");
+}
+
+void Renderer::release_camera_bundles()
+{
+    for (sFrameResources& frame : frame_resources) {
+        for (sCachedBundle* cached_bundle : { &frame.camera_bundles.opaque, &frame.camera_bundles.transparent }) {
+            if (cached_bundle->bundle) {
+                wgpuRenderBundleRelease(cached_bundle->bundle);
+            }
+
+            *cached_bundle = {};
+        }
+    }
+}
+
+bool Renderer::encode_render_list(const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+{
+    bool complete = true;
+
+    render_pass_state.set_bind_group(0, instance_data.instances_bind_groups[list_index]);
+    render_pass_state.set_bind_group(1, camera_bind_group, 1, &camera_buffer_stride);
+
+    // Indirect args are laid out one per instanced draw, in list order
+    const InstanceCullKernel* cull_kernel = instance_data.gpu_culled[list_index] ? instance_data.cull_kernels[list_index] : nullptr;
+    const MeshletCullKernel* meshlet_cull_kernel = instance_data.meshlet_culled ? instance_data.meshlet_cull_kernel : nullptr;
+    uint32_t batch_index = 0;
+
+    for (int i = 0; i < render_list.size(); i += render_list[i].repeat, batch_index++) {
+        const sRenderData& render_data = render_list[i];
+
+        const Material* material = render_data.material;
+
+        if (!material) {
+            assert(0);
+            continue;
+        }
+
+        const Pipeline* pipeline = material->get_shader()->get_pipeline();
+
+        assert(pipeline);
+
+        if (!render_pass_state.set_pipeline(pipeline)) {
+            complete = false;
+            continue;
+        }
+
+        // Not initialized
+        if (render_data.surface->get_vertex_count() == 0) {
+            spdlog::error("Skipping not initialized mesh");
+            complete = false;
+            continue;
+        }
+
+        // Set bind groups
+
+        if (material->get_fragment_write() || material->get_use_skinning()) {
+            // Slot of the material in the shared parameters buffer, depth only skinning shaders do not bind it
+            uint32_t params_offset = RendererStorage::get_material_params_offset(material);
+            uint32_t dynamic_offset_count = material->get_fragment_write() ? 1 : 0;
+            render_pass_state.set_bind_group(2, renderer_storage->get_material_bind_group(material), dynamic_offset_count, &params_offset);
+
+            if (material->get_type() == MATERIAL_PBR) {
+                render_pass_state.set_bind_group(3, get_frame_resources().lighting_bind_group);
+            }
+        }
+
+        //#ifndef NDEBUG
+        //        webgpu_context->push_debug_group(render_pass, render_data.surface->get_name().c_str());
+        //#endif
+
+        if (material->get_type() == MATERIAL_UI) {
+            WGPUBindGroup ui_bind_group = renderer_storage->get_ui_widget_bind_group(render_data.mesh_ref);
+            if (ui_bind_group) {
+                render_pass_state.set_bind_group(3, ui_bind_group);
+            }
+        }
+
+        // All the surfaces share the geometry arena buffers, so these are only sent once per list
+        // unless the arena grows in between
+        const Surface* surface = render_data.surface;
+
+        render_pass_state.set_vertex_buffer(0, surface->get_vertex_buffer(), 0, WGPU_WHOLE_SIZE);
+
+        if (material->get_fragment_write()) {
+            render_pass_state.set_vertex_buffer(1, surface->get_vertex_data_buffer(), 0, WGPU_WHOLE_SIZE);
+        }
+
+        WGPUBuffer index_buffer = surface->get_index_buffer();
+
+        if (meshlet_cull_kernel && render_data.meshlet_draw != UINT32_MAX) {
+            render_pass_state.set_index_buffer(meshlet_cull_kernel->get_index_buffer(), WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);
+            render_pass_state.draw_indexed_indirect(meshlet_cull_kernel->get_draw_args_buffer(), render_data.meshlet_draw * sizeof(MeshletCullKernel::sDrawArgs));
+        } else if (index_buffer) {
+            render_pass_state.set_index_buffer(index_buffer, surface->get_index_format(), 0, WGPU_WHOLE_SIZE);
+
+            if (cull_kernel) {
+                render_pass_state.draw_indexed_indirect(cull_kernel->get_draw_args_buffer(), batch_index * sizeof(InstanceCullKernel::sDrawArgs));
+            } else {
+                render_pass_state.draw_indexed(surface->get_index_count(), render_data.repeat, surface->get_first_index(), static_cast<int32_t>(surface->get_base_vertex()), i);
+            }
+        } else {
+            if (cull_kernel) {
+                render_pass_state.draw_indirect(cull_kernel->get_draw_args_buffer(), batch_index * sizeof(InstanceCullKernel::sDrawArgs));
+            } else {
+                render_pass_state.draw(surface->get_vertex_count(), render_data.repeat, surface->get_base_vertex(), i);
+            }
+        }
+
+        frame_stats.draw_calls++;
+
+        //#ifndef NDEBUG
+        //        webgpu_context->pop_debug_group(render_pass);
+        //#endif
+    }
+
+    frame_stats.state_calls_issued += render_pass_state.get_issued_calls();
+    frame_stats.state_calls_elided += render_pass_state.get_elided_calls();
+
+    return complete;
+}
+
+void Renderer::render_opaque(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+{
+#ifndef NDEBUG
+    webgpu_context->push_debug_group(render_pass, { "Opaque", WGPU_STRLEN });
+#endif
+
+    render_render_list(render_pass, render_lists[RENDER_LIST_OPAQUE], RENDER_LIST_OPAQUE, instance_data, camera_bind_group, camera_buffer_stride);
+
+#ifndef NDEBUG
+    webgpu_context->pop_debug_group(render_pass);
+#endif
+}
+
+void Renderer::render_transparent(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
+{
+#ifndef NDEBUG
+    webgpu_context->push_debug_group(render_pass, { "Transparent", WGPU_STRLEN });
+#endif
+
+    render_render_list(render_pass, render_lists[RENDER_LIST_TRANSPARENT], RENDER_LIST_TRANSPARENT, instance_data, camera_bind_group, camera_buffer_stride);
+
+#ifndef NDEBUG
+    webgpu_context->pop_debug_group(render_pass);
+#endif
+}
+
+void Renderer::render_splats(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride)
 {
 #ifndef NDEBUG
     webgpu_context->push_debug_group(render_pass, { "Gaussian Splats", WGPU_STRLEN });
@@ -1372,15 +2385,6 @@ bool Renderer::is_inside_frustum(const glm::vec3& minp, const glm::vec3& maxp) c
     return frustum_cull.is_box_visible(minp, maxp);
 }
 
-uint8_t Renderer::timestamp(WGPUCommandEncoder encoder, const char* label)
-{
-    queries_label_map[query_index] = std::string(label);
-
-    assert(query_index + 1 < maximum_query_sets);
-
-    return query_index++;
-}
-
 void Renderer::add_renderable(Mesh* mesh, const glm::mat4x4& global_matrix)
 {
     if ((render_entity_list.size() + 1) >= current_render_list_size) {
@@ -1396,6 +2400,215 @@ void Renderer::add_splat_scene(GSNode* gs_scene)
     gs_scenes_list.push_back(gs_scene);
 }
 
+uint32_t Renderer::register_render_proxy(Mesh* mesh, MeshInstance3D* instance)
+{
+    uint32_t proxy_id;
+
+    if (!free_render_proxies.empty()) {
+        proxy_id = free_render_proxies.back();
+        free_render_proxies.pop_back();
+    } else {
+        proxy_id = static_cast<uint32_t>(render_proxies.size());
+        render_proxies.emplace_back();
+    }
+
+    sRenderProxy& proxy = render_proxies[proxy_id];
+    proxy = {};
+    proxy.mesh = mesh;
+    proxy.instance = instance;
+    proxy.mesh_revision = mesh->get_revision() - 1u; // force surface gathering on first submit
+    proxy.in_use = true;
+
+    return proxy_id;
+}
+
+void Renderer::submit_render_proxy(uint32_t proxy_id, const glm::mat4x4& global_matrix)
+{
+    assert(proxy_id < render_proxies.size() && render_proxies[proxy_id].in_use);
+
+    sRenderProxy& proxy = render_proxies[proxy_id];
+
+    if (proxy.global_matrix != global_matrix) {
+        proxy.global_matrix = global_matrix;
+        proxy.transform_dirty = true;
+    }
+
+    proxy.submitted_frame = frame_counter;
+
+    refresh_render_proxy(proxy_id);
+}
+
+void Renderer::remove_render_proxy(uint32_t proxy_id)
+{
+    if (proxy_id >= render_proxies.size() || !render_proxies[proxy_id].in_use) {
+        return;
+    }
+
+    sRenderProxy& proxy = render_proxies[proxy_id];
+
+    if (proxy.tree_leaf != AABBTree::NULL_NODE) {
+        render_proxy_tree.remove(proxy.tree_leaf);
+    }
+
+    if (proxy.uncullable) {
+        std::erase(uncullable_render_proxies, proxy_id);
+    }
+
+    proxy = {};
+    free_render_proxies.push_back(proxy_id);
+}
+
+void Renderer::update_render_proxy_culling(uint32_t proxy_id, bool cullable, bool bounds_changed)
+{
+    sRenderProxy& proxy = render_proxies[proxy_id];
+
+    if (cullable) {
+        if (proxy.uncullable) {
+            std::erase(uncullable_render_proxies, proxy_id);
+            proxy.uncullable = false;
+        }
+
+        if (proxy.tree_leaf == AABBTree::NULL_NODE) {
+            proxy.tree_leaf = render_proxy_tree.insert(proxy.world_aabb, proxy_id);
+        } else if (bounds_changed) {
+            render_proxy_tree.move(proxy.tree_leaf, proxy.world_aabb);
+        }
+    } else if (!proxy.uncullable) {
+        if (proxy.tree_leaf != AABBTree::NULL_NODE) {
+            render_proxy_tree.remove(proxy.tree_leaf);
+            proxy.tree_leaf = AABBTree::NULL_NODE;
+        }
+
+        uncullable_render_proxies.push_back(proxy_id);
+        proxy.uncullable = true;
+    }
+}
+
+void Renderer::refresh_render_proxy(uint32_t proxy_id)
+{
+    sRenderProxy& proxy = render_proxies[proxy_id];
+    Mesh* mesh = proxy.mesh;
+
+    // Surface list or material overrides changed, gather them again
+    if (proxy.mesh_revision != mesh->get_revision() || proxy.surfaces.size() != mesh->get_surface_count()) {
+        const std::vector<Surface*>& surfaces = mesh->get_surfaces();
+
+        proxy.surfaces.resize(surfaces.size());
+
+        for (uint32_t i = 0; i < surfaces.size(); ++i) {
+            sRenderProxySurface& proxy_surface = proxy.surfaces[i];
+            proxy_surface.surface = surfaces[i];
+            proxy_surface.material_override = mesh->get_surface_material_override(surfaces[i]);
+            proxy_surface.local_aabb = surfaces[i]->get_aabb();
+        }
+
+        proxy.mesh_revision = mesh->get_revision();
+        proxy.transform_dirty = true;
+    }
+
+    bool bounds_changed = proxy.transform_dirty;
+
+    // 2D materials are never culled, keep those proxies out of the tree
+    bool cullable = mesh->get_frustum_culling_enabled();
+
+    for (sRenderProxySurface& proxy_surface : proxy.surfaces) {
+        const AABB surface_aabb = proxy_surface.surface->get_aabb();
+
+        // Surfaces may be regenerated (text, ui..) without the mesh knowing it
+        bool aabb_changed = surface_aabb.center != proxy_surface.local_aabb.center || surface_aabb.half_size != proxy_surface.local_aabb.half_size;
+
+        if (proxy.transform_dirty || aabb_changed) {
+            proxy_surface.local_aabb = surface_aabb;
+            proxy_surface.world_aabb = surface_aabb.transform(proxy.global_matrix);
+            bounds_changed = true;
+        }
+
+        Material* material = proxy_surface.material_override ? proxy_surface.material_override : proxy_surface.surface->get_material();
+        cullable &= !(material && material->get_is_2D());
+    }
+
+    if (bounds_changed) {
+        proxy.world_aabb = {};
+
+        for (const sRenderProxySurface& proxy_surface : proxy.surfaces) {
+            proxy.world_aabb = merge_aabbs(proxy.world_aabb, proxy_surface.world_aabb);
+        }
+    }
+
+    update_render_proxy_culling(proxy_id, cullable, bounds_changed);
+
+    proxy.transform_dirty = false;
+}
+
+bool Renderer::is_render_proxy_pickable(const sRenderProxy& proxy) const
+{
+    // Queries run during update, before this frame's submission
+    return proxy.in_use && proxy.instance && (frame_counter - proxy.submitted_frame) <= 1u;
+}
+
+MeshInstance3D* Renderer::ray_cast_instances(const glm::vec3& ray_origin, const glm::vec3& ray_direction, float* distance)
+{
+    MeshInstance3D* closest_instance = nullptr;
+    float closest_distance = std::numeric_limits<float>::max();
+
+    auto test_proxy = [&](uint32_t proxy_id) {
+        const sRenderProxy& proxy = render_proxies[proxy_id];
+
+        if (!is_render_proxy_pickable(proxy)) {
+            return;
+        }
+
+        for (const sRenderProxySurface& proxy_surface : proxy.surfaces) {
+            float hit_distance;
+
+            if (intersection::ray_AABB(ray_origin, ray_direction, proxy_surface.world_aabb.center, proxy_surface.world_aabb.half_size, &hit_distance)
+                && hit_distance < closest_distance) {
+                closest_distance = hit_distance;
+                closest_instance = proxy.instance;
+            }
+        }
+    };
+
+    render_proxy_tree.query_ray(ray_origin, ray_direction, closest_distance, [&](uint32_t proxy_id, float& max_distance) {
+        test_proxy(proxy_id);
+        max_distance = closest_distance;
+    });
+
+    for (uint32_t proxy_id : uncullable_render_proxies) {
+        test_proxy(proxy_id);
+    }
+
+    if (distance && closest_instance) {
+        *distance = closest_distance;
+    }
+
+    return closest_instance;
+}
+
+void Renderer::query_instances(const AABB& box, std::vector<MeshInstance3D*>& instances)
+{
+    render_proxy_tree.query_aabb(box, [&](uint32_t proxy_id) {
+        const sRenderProxy& proxy = render_proxies[proxy_id];
+
+        if (is_render_proxy_pickable(proxy)) {
+            instances.push_back(proxy.instance);
+        }
+    });
+
+    const glm::vec3 box_min = box.center - box.half_size;
+    const glm::vec3 box_max = box.center + box.half_size;
+
+    for (uint32_t proxy_id : uncullable_render_proxies) {
+        const sRenderProxy& proxy = render_proxies[proxy_id];
+        const glm::vec3 proxy_min = proxy.world_aabb.center - proxy.world_aabb.half_size;
+        const glm::vec3 proxy_max = proxy.world_aabb.center + proxy.world_aabb.half_size;
+
+        if (is_render_proxy_pickable(proxy) && glm::all(glm::lessThanEqual(proxy_min, box_max)) && glm::all(glm::greaterThanEqual(proxy_max, box_min))) {
+            instances.push_back(proxy.instance);
+        }
+    }
+}
+
 void Renderer::clear_renderables()
 {
     render_entity_list.clear();
@@ -1403,30 +2616,59 @@ void Renderer::clear_renderables()
 
     lights_with_shadow.clear();
 
-    for (int i = 0; i < MAX_LIGHTS; ++i) {
-        lights_uniform_data[i] = {};
-    }
-
+    lights_uniform_data.clear();
     num_lights = 0;
-    query_index = 0;
 }
 
 void Renderer::update_lights()
 {
     // update uniform data
 
-    uint64_t buffer_size = sizeof(sLightUniformData) * num_lights;
+    while (lights_buffer_capacity < num_lights) {
+        lights_buffer_capacity *= 2;
+    }
+
+    // The buffers of the other frame indices grow when their frame comes
+    sFrameResources& frame = get_frame_resources();
+
+    if (frame.lights_buffer.buffer_size < sizeof(sLightUniformData) * lights_buffer_capacity) {
+        frame_ring.release_later(std::get<WGPUBuffer>(frame.lights_buffer.data));
+
+        frame.lights_buffer.data = webgpu_context->create_buffer(sizeof(sLightUniformData) * lights_buffer_capacity, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage, nullptr, "lights_buffer");
+        frame.lights_buffer.buffer_size = sizeof(sLightUniformData) * lights_buffer_capacity;
+
+        create_lighting_bind_group(frame);
+    }
+
+    if (num_lights > 0) {
+        uint64_t buffer_size = sizeof(sLightUniformData) * num_lights;
+        webgpu_context->update_buffer(std::get<WGPUBuffer>(frame.lights_buffer.data), 0, lights_uniform_data.data(), buffer_size);
+    }
+}
+
+void Renderer::update_light_clusters(const Camera& camera, float z_near, float z_far)
+{
+    sFrameResources& frame = get_frame_resources();
+
+    frame.light_cluster_kernel->update(camera, z_near, z_far, &frame.lights_buffer, num_lights);
+
+    WGPUPassTimestampWrites timestamp_writes;
+    WGPUComputePassDescriptor compute_pass_desc = { .label = { "light_cluster_pass", WGPU_STRLEN } };
+    compute_pass_desc.timestampWrites = gpu_profiler->get_pass_timestamp_writes("light_clusters", timestamp_writes);
+
+    WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(global_command_encoder, &compute_pass_desc);
 
-    webgpu_context->update_buffer(std::get<WGPUBuffer>(lights_buffer.data), 0, &lights_uniform_data[0], buffer_size);
+    frame.light_cluster_kernel->dispatch(compute_pass);
 
-    webgpu_context->update_buffer(std::get<WGPUBuffer>(num_lights_buffer.data), 0, &num_lights, sizeof(int));
+    wgpuComputePassEncoderEnd(compute_pass);
+    wgpuComputePassEncoderRelease(compute_pass);
 }
 
 void Renderer::add_light(Light3D* new_light)
 {
     sLightUniformData data;
     new_light->get_uniform_data(data);
-    lights_uniform_data[num_lights] = data;
+    lights_uniform_data.push_back(data);
     num_lights++;
 
     const LightType light_type = new_light->get_type();
@@ -1576,11 +2818,11 @@ void Renderer::render_mirror(WGPUTextureView screen_surface_texture_view, WGPUBi
             wgpuRenderPassEncoderSetBindGroup(render_pass, 0, displayed_fbo_bind_group, 0, nullptr);
 
             // Set vertex buffer while encoding the render pass
-            wgpuRenderPassEncoderSetVertexBuffer(render_pass, 0, quad_surface.get_vertex_buffer(), 0, quad_surface.get_vertices_byte_size());
-            wgpuRenderPassEncoderSetVertexBuffer(render_pass, 1, quad_surface.get_vertex_data_buffer(), 0, quad_surface.get_interleaved_data_byte_size());
+            wgpuRenderPassEncoderSetVertexBuffer(render_pass, 0, quad_surface.get_vertex_buffer(), 0, WGPU_WHOLE_SIZE);
+            wgpuRenderPassEncoderSetVertexBuffer(render_pass, 1, quad_surface.get_vertex_data_buffer(), 0, WGPU_WHOLE_SIZE);
 
             // Submit drawcall
-            wgpuRenderPassEncoderDraw(render_pass, 6, 1, 0, 0);
+            wgpuRenderPassEncoderDraw(render_pass, 6, 1, quad_surface.get_base_vertex(), 0);
 
             webgpu_context->pop_debug_group(render_pass);
 
@@ -1622,23 +2864,8 @@ void Renderer::init_camera_bind_group()
 {
     camera_buffer_stride = std::max(static_cast<uint32_t>(sizeof(sCameraData)), webgpu_context->required_limits.minUniformBufferOffsetAlignment);
 
-    camera_uniform.data = webgpu_context->create_buffer(camera_buffer_stride * EYE_COUNT, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "camera_buffer");
-    camera_uniform.binding = 0;
-    camera_uniform.buffer_size = sizeof(sCameraData);
-
-    camera_2d_uniform.data = webgpu_context->create_buffer(sizeof(sCameraData), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "camera_2d_buffer");
-    camera_2d_uniform.binding = 0;
-    camera_2d_uniform.buffer_size = sizeof(sCameraData);
-
-    shadow_camera_uniform.data = webgpu_context->create_buffer(camera_buffer_stride * shadow_uniform_buffer_size, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "shadow_camera_buffer");
-    shadow_camera_uniform.binding = 0;
-    shadow_camera_uniform.buffer_size = sizeof(sCameraData);
-
-    std::vector<Uniform*> uniforms = { &camera_uniform };
-    render_camera_bind_group = webgpu_context->create_bind_group(uniforms, RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries), 1);
-
-    uniforms = { &shadow_camera_uniform };
-    shadow_camera_bind_group = webgpu_context->create_bind_group(uniforms, RendererStorage::get_shader_from_source(shaders::mesh_shadow::source, shaders::mesh_shadow::path, shaders::mesh_shadow::libraries), 1);
+    Shader* mesh_forward_shader = RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries);
+    Shader* mesh_shadow_shader = RendererStorage::get_shader_from_source(shaders::mesh_shadow::source, shaders::mesh_shadow::path, shaders::mesh_shadow::libraries);
 
     WGPUBindGroupLayoutEntry entry = {};
     entry.binding = 0;
@@ -1646,13 +2873,34 @@ void Renderer::init_camera_bind_group()
     entry.buffer.hasDynamicOffset = true;
     entry.visibility = WGPUShaderStage_Compute;
 
-    uniforms = { &camera_uniform };
-
     WGPUBindGroupLayout compute_camera_bind_group_layout = webgpu_context->create_bind_group_layout({ entry });
-    compute_camera_bind_group = webgpu_context->create_bind_group(uniforms, compute_camera_bind_group_layout);
 
-    uniforms = { &camera_2d_uniform };
-    render_camera_bind_group_2d = webgpu_context->create_bind_group(uniforms, RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries), 1);
+    for (sFrameResources& frame : frame_resources) {
+        frame.camera_uniform.data = webgpu_context->create_buffer(camera_buffer_stride * EYE_COUNT, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "camera_buffer");
+        frame.camera_uniform.binding = 0;
+        frame.camera_uniform.buffer_size = sizeof(sCameraData);
+
+        frame.eye_camera_uniform.data = webgpu_context->create_buffer(camera_buffer_stride * EYE_COUNT, WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc, nullptr, "eye_camera_buffer");
+        frame.eye_camera_uniform.buffer_size = camera_buffer_stride * EYE_COUNT;
+
+        frame.camera_2d_uniform.data = webgpu_context->create_buffer(sizeof(sCameraData), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "camera_2d_buffer");
+        frame.camera_2d_uniform.binding = 0;
+        frame.camera_2d_uniform.buffer_size = sizeof(sCameraData);
+
+        frame.shadow_camera_uniform.data = webgpu_context->create_buffer(camera_buffer_stride * shadow_uniform_buffer_size, WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "shadow_camera_buffer");
+        frame.shadow_camera_uniform.binding = 0;
+        frame.shadow_camera_uniform.buffer_size = sizeof(sCameraData);
+
+        std::vector<Uniform*> uniforms = { &frame.camera_uniform };
+        frame.render_camera_bind_group = webgpu_context->create_bind_group(uniforms, mesh_forward_shader, 1);
+        frame.compute_camera_bind_group = webgpu_context->create_bind_group(uniforms, compute_camera_bind_group_layout);
+
+        uniforms = { &frame.shadow_camera_uniform };
+        frame.shadow_camera_bind_group = webgpu_context->create_bind_group(uniforms, mesh_shadow_shader, 1);
+
+        uniforms = { &frame.camera_2d_uniform };
+        frame.render_camera_bind_group_2d = webgpu_context->create_bind_group(uniforms, mesh_forward_shader, 1);
+    }
 }
 
 glm::vec3 Renderer::get_camera_eye()
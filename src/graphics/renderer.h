@@ -1,8 +1,19 @@
 #pragma once
 
 #include "config_structs.h"
+#include "framework/math/aabb_tree.h"
 #include "framework/math/frustum_cull.h"
+#include "framework/math/software_occlusion.h"
+#include "framework/utils/job_system.h"
+#include "framework/utils/radix_sort.h"
+#include "framework/utils/sort_key.h"
+#include "graphics/frame_ring.h"
+#include "graphics/hiz_buffer.h"
+#include "graphics/kernels/instance_cull_kernel.h"
+#include "graphics/kernels/light_cluster_kernel.h"
+#include "graphics/kernels/meshlet_cull_kernel.h"
 #include "graphics/pipeline.h"
+#include "graphics/render_pass_state.h"
 #include "graphics/surface.h"
 #include "graphics/uniform.h"
 #include "graphics/uniforms_structs.h"
@@ -17,7 +28,7 @@
 #include <map>
 #include <string>
 
-#define MAX_LIGHTS 32u
+#define MAX_SHADOW_LIGHTS 32u
 #define SHADOW_MAP_SIZE 1024
 
 class Camera;
@@ -25,15 +36,34 @@ class Texture;
 class Surface;
 class Light3D;
 class RenderdocCapture;
+class GPUProfiler;
 class RendererStorage;
 class Mesh;
 class MeshInstance3D;
 class GSNode;
+class GeometryArena;
 struct GLFWwindow;
 struct WebGPUContext;
 struct XRContext;
 struct sLightUniformData;
 
+// Counters of the render lists encoded in a frame
+struct sRenderStats {
+    uint32_t draw_calls = 0;
+    // Pipeline, bind group, vertex and index buffer calls sent to the encoder or skipped as redundant
+    uint32_t state_calls_issued = 0;
+    uint32_t state_calls_elided = 0;
+    // Camera list bundles recorded again or replayed from the last frame
+    uint32_t bundles_recorded = 0;
+    uint32_t bundles_reused = 0;
+    // Buffer writes batched by the staging belt, the bytes written to the queue directly and the copies submitted
+    uint64_t staged_bytes = 0;
+    uint64_t direct_bytes = 0;
+    uint32_t staged_copies = 0;
+    // Lights left out of the clusters over the per cluster cap, read back a few frames late
+    uint32_t cluster_lights_dropped = 0;
+};
+
 class Renderer {
 protected:
     XRContext* xr_context;
@@ -53,16 +83,6 @@ protected:
     Camera* camera_3d = nullptr;
     Camera* camera_2d = nullptr;
 
-    // Render meshes with material color
-    WGPUBindGroup render_camera_bind_group = nullptr;
-    WGPUBindGroup shadow_camera_bind_group = nullptr;
-    WGPUBindGroup compute_camera_bind_group = nullptr;
-    WGPUBindGroup render_camera_bind_group_2d = nullptr;
-
-    Uniform camera_uniform;
-    Uniform camera_2d_uniform;
-    Uniform shadow_camera_uniform;
-
     uint32_t camera_buffer_stride = 0;
 
     Texture* irradiance_texture = nullptr;
@@ -102,12 +122,56 @@ protected:
         glm::mat4x4 global_matrix;
     };
 
+    struct sRenderProxySurface {
+        Surface* surface = nullptr;
+        Material* material_override = nullptr;
+        AABB local_aabb;
+        AABB world_aabb;
+        // Selected by the camera pass, shadow views reuse it
+        uint32_t lod_level = 0;
+    };
+
+    // Persistent render state of a mesh instance, only refreshed when its transform or mesh changes
+    struct sRenderProxy {
+        Mesh* mesh = nullptr;
+        MeshInstance3D* instance = nullptr;
+        glm::mat4x4 global_matrix = glm::mat4x4(1.0f);
+        std::vector<sRenderProxySurface> surfaces;
+        AABB world_aabb;
+        uint32_t mesh_revision = 0;
+        uint32_t submitted_frame = UINT32_MAX;
+        int32_t tree_leaf = AABBTree::NULL_NODE;
+        bool transform_dirty = true;
+        bool uncullable = false;
+        bool in_use = false;
+    };
+
+    // World bounds as structure of arrays, tested in batches by the frustum
+    struct sRenderProxyBounds {
+        std::vector<float> center_x, center_y, center_z;
+        std::vector<float> extent_x, extent_y, extent_z;
+
+        void resize(size_t size) {
+            center_x.resize(size); center_y.resize(size); center_z.resize(size);
+            extent_x.resize(size); extent_y.resize(size); extent_z.resize(size);
+        }
+
+        void set(uint32_t index, const AABB& aabb) {
+            center_x[index] = aabb.center.x; center_y[index] = aabb.center.y; center_z[index] = aabb.center.z;
+            extent_x[index] = aabb.half_size.x; extent_y[index] = aabb.half_size.y; extent_z[index] = aabb.half_size.z;
+        }
+    };
+
     struct sRenderData {
         Surface* surface;
         uint32_t repeat;
         glm::mat4x4 global_matrix;
         Mesh* mesh_ref;
         Material* material;
+        AABB world_aabb;
+        uint64_t sort_key = 0;
+        // Indirect draw of the meshlet cull kernel, only in the camera opaque list
+        uint32_t meshlet_draw = UINT32_MAX;
     };
 
     enum eRenderListType {
@@ -123,6 +187,14 @@ protected:
         std::vector<sUniformData> instances_data[RENDER_LIST_COUNT];
         Uniform instances_data_uniforms[RENDER_LIST_COUNT];
         WGPUBindGroup instances_bind_groups[RENDER_LIST_COUNT] = {};
+
+        // GPU driven lists: instances are culled and compacted by a compute pass and drawn indirectly
+        InstanceCullKernel* cull_kernels[RENDER_LIST_COUNT] = {};
+        bool gpu_culled[RENDER_LIST_COUNT] = {};
+
+        // Surfaces with meshlets in the opaque list, culled per cluster and drawn from a compacted index buffer
+        MeshletCullKernel* meshlet_cull_kernel = nullptr;
+        bool meshlet_culled = false;
     };
 
     struct sCameraData {
@@ -148,12 +220,74 @@ protected:
 
     void render_render_list(WGPURenderPassEncoder render_pass, const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride = 0);
 
+    // Records through render_pass_state, which must be reset on the pass or bundle encoder first.
+    // False if some draw was skipped, as its pipeline is not ready yet
+    bool encode_render_list(const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride);
+
+    // WebGPU has no multiview, so the eye passes can not share a draw. The lists are recorded in
+    // bundles instead and every eye pass executes them with its camera in the first slot
+    bool xr_stereo_bundles_enabled = true;
+
+    // Bundles are kept between frames while the key of their list does not change, so a static scene
+    // is not encoded again. Changes in the proxies, materials or instance buffers give a new key
+    bool render_bundle_cache_enabled = true;
+
+    // The key holds every value the bundle was recorded from, its hash only speeds up the comparison
+    struct sCachedBundle {
+        WGPURenderBundle bundle = nullptr;
+        std::vector<uint64_t> key;
+        size_t key_hash = 0;
+        bool reusable = false;
+    };
+
+    struct sCameraBundles {
+        sCachedBundle opaque;
+        sCachedBundle transparent;
+    };
+
+    void build_render_list_key(const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group,
+            std::vector<uint64_t>& key) const;
+
+    std::vector<uint64_t> bundle_key;
+    void update_render_list_bundle(sCachedBundle& cached_bundle, const std::vector<sRenderData>& render_list, int list_index, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, const char* label);
+    void update_camera_bundles(const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group);
+    void release_camera_bundles();
+
     void init_camera_bind_group();
 
-    void get_timestamps();
+    // Buffers written by the CPU every frame and the bind groups and bundles using them. Each frame
+    // in flight has its own set, built while the GPU still reads the sets of the previous frames
+    struct sFrameResources {
+        // Render meshes with material color
+        WGPUBindGroup render_camera_bind_group = nullptr;
+        WGPUBindGroup shadow_camera_bind_group = nullptr;
+        WGPUBindGroup compute_camera_bind_group = nullptr;
+        WGPUBindGroup render_camera_bind_group_2d = nullptr;
+
+        Uniform camera_uniform;
+        Uniform camera_2d_uniform;
+        // Eye cameras for the stereo bundles, each one is copied to the first slot of camera_uniform before its pass
+        Uniform eye_camera_uniform;
+        Uniform shadow_camera_uniform;
 
-    sInstanceData render_instances_data;
-    sInstanceData shadow_instances_data;
+        sInstanceData render_instances_data;
+        std::vector<sInstanceData> shadow_instances_data;
+
+        // Storage buffer grown on demand up to lights_buffer_capacity
+        Uniform lights_buffer;
+
+        // Clusters are binned from the lights of the frame
+        LightClusterKernel* light_cluster_kernel = nullptr;
+        WGPUBindGroup lighting_bind_group = nullptr;
+
+        sCameraBundles camera_bundles;
+    };
+
+    FrameRing frame_ring;
+    sFrameResources frame_resources[FrameRing::FRAME_COUNT];
+
+    sFrameResources& get_frame_resources() { return frame_resources[frame_ring.get_frame_index()]; }
+    const sFrameResources& get_frame_resources() const { return frame_resources[frame_ring.get_frame_index()]; }
 
     std::vector<sUIData> instance_ui_data;
     Uniform instance_ui_data_uniform;
@@ -162,12 +296,151 @@ protected:
     std::vector<sRenderListData> render_entity_list;
     uint32_t current_render_list_size = 32;
 
+    // Retained entities, they are only rendered on the frames they are submitted
+    std::vector<sRenderProxy> render_proxies;
+    std::vector<uint32_t> free_render_proxies;
+
+    // Hierarchy over the cullable proxies, the rest are always sent to the render lists
+    AABBTree render_proxy_tree;
+    std::vector<uint32_t> uncullable_render_proxies;
+
+    // Proxies that passed the tree test this pass, PROXY_FULLY_INSIDE marks the ones that need no further test
+    static constexpr uint32_t PROXY_FULLY_INSIDE = 0x80000000u;
+    std::vector<uint32_t> proxy_candidates;
+
+    void refresh_render_proxy(uint32_t proxy_id);
+    void update_render_proxy_culling(uint32_t proxy_id, bool cullable, bool bounds_changed);
+    bool is_render_proxy_pickable(const sRenderProxy& proxy) const;
+
+    // Thread safe, renderer storage registration is done later on the main thread
+    void add_surface_to_render_lists(Mesh* mesh, Surface* surface, Material* material, const glm::mat4x4& global_matrix, const AABB& world_aabb,
+            bool inside_frustum, std::vector<sRenderData>* render_lists, bool is_shadow_pass);
+
+    // Culling is split between the job system threads, each one filling its own render lists
+    JobSystem* job_system = nullptr;
+
+    struct sCullThreadData {
+        std::vector<sRenderData> render_lists[RENDER_LIST_COUNT];
+        std::vector<uint32_t> visibility_mask;
+        sRenderProxyBounds candidate_bounds;
+
+        // One list per shadow view
+        std::vector<std::vector<sRenderData>> shadow_render_lists;
+
+        // Chunks taken by the thread in the order they were culled, with the size of each list when they started
+        std::vector<uint64_t> chunk_orders;
+        std::vector<uint32_t> chunk_offsets;
+    };
+
+    std::vector<sCullThreadData> cull_thread_data;
+
+    // Chunks go to whichever thread is free, the merged lists follow the chunk order instead so equal sort keys
+    // keep the same order every frame
+    struct sCullChunk {
+        uint64_t order = 0;
+        uint32_t thread_index = 0;
+        uint32_t chunk_index = 0;
+    };
+
+    std::vector<sCullChunk> cull_chunks;
+
+    // Called by the thread taking the chunk. Order is the dispatch in the high bits and the first element of the chunk in the low ones
+    static void begin_cull_chunk(sCullThreadData& thread_data, uint64_t order, const std::vector<sRenderData>* thread_lists, uint32_t list_count);
+    void sort_cull_chunks();
+    void merge_cull_chunks(uint32_t list_index, uint32_t list_count, bool is_shadow_view, std::vector<sRenderData>& render_list);
+    void clear_cull_chunks();
+
+    void cull_render_entities(bool is_shadow_pass);
+
+    // Shadow views are culled in a single pass: each proxy collects a bit per light frustum it
+    // touches, so surfaces are visited once and only tested against the views in their mask
+    static constexpr uint32_t MAX_SHADOW_VIEWS = MAX_SHADOW_LIGHTS;
+
+    std::vector<Frustum> shadow_frustums;
+    std::vector<uint32_t> shadow_view_masks;
+    std::vector<std::vector<std::vector<sRenderData>>> shadow_render_lists;
+
+    void cull_shadow_views();
+
+    // Thread safe, same as add_surface_to_render_lists
+    void add_surface_to_shadow_views(Mesh* mesh, Surface* surface, Material* material, const glm::mat4x4& global_matrix, const AABB& world_aabb,
+            uint32_t view_mask, std::vector<std::vector<sRenderData>>& shadow_lists);
+
+    bool gpu_culling_enabled = false;
+    // Required by the indirect draws of the culled batches, which start at the batch first instance
+    bool indirect_first_instance_supported = false;
+
+    std::vector<InstanceCullKernel::sCullInstance> gpu_cull_instances;
+    std::vector<InstanceCullKernel::sDrawArgs> gpu_cull_draw_args;
+    std::vector<uint32_t> gpu_cull_batch_first_instance;
+
+    bool is_gpu_culled_list(int list_index) const;
+    void prepare_gpu_culling(const std::vector<sRenderData>& render_list, int list_index, sInstanceData& instances_data, const HiZBuffer* occlusion_hiz_buffer);
+
+    bool meshlet_culling_enabled = true;
+
+    std::vector<MeshletCullKernel::sMeshletDraw> meshlet_draws;
+    std::vector<MeshletCullKernel::sDrawArgs> meshlet_draw_args;
+    std::vector<uint32_t> meshlet_draw_first_indices;
+    std::vector<uint32_t> meshlet_draw_index_counts;
+
+    // Meshlet draws are never instanced, each instance is culled with its own transform
+    bool is_meshlet_draw(const sRenderData& render_data) const;
+    void prepare_meshlet_culling(std::vector<sRenderData>& render_list, sInstanceData& instances_data, const glm::vec3& eye, const HiZBuffer* occlusion_hiz_buffer);
+
+    // Hi-Z pyramid from the previous frame depth, only for the desktop camera
+    HiZBuffer* hiz_buffer = nullptr;
+    eOcclusionCullingMode occlusion_culling_mode = OCCLUSION_CULLING_DISABLED;
+
+    glm::mat4x4 last_view_projection = glm::mat4x4(1.0f);
+    bool last_view_projection_valid = false;
+    bool hiz_built = false;
+    bool cpu_occlusion_culling = false;
+
+    // Meshes marked as occluders are rasterized on the CPU before testing the rest
+    SoftwareOcclusionCuller software_occlusion_culler;
+    bool software_occlusion_enabled = false;
+    bool software_occlusion_active = false;
+
+    // View projection of the frustum being culled
+    glm::mat4x4 cull_view_projection = glm::mat4x4(1.0f);
+
+    // LODs switch when the projected size crosses the threshold by this fraction, to avoid popping back and forth
+    static constexpr float LOD_HYSTERESIS = 0.1f;
+
+    bool lod_enabled = true;
+    float lod_bias = 1.0f;
+
+    // Camera used to measure the projected size of the surfaces
+    glm::vec3 lod_eye = {};
+    float lod_projection_scale = 1.0f;
+    bool lod_perspective = true;
+
+    // Thread safe, lod_level keeps the current level of the instance and is updated in place
+    Surface* select_lod_surface(Surface* surface, const AABB& world_aabb, uint32_t& lod_level) const;
+
+    void rasterize_occluders();
+    void merge_cull_thread_data(std::vector<std::vector<sRenderData>>& render_lists);
+
+    // Render lists are ordered by a packed 64-bit key (list, priority, pipeline, material, surface).
+    // Transparent lists replace the state bits by a quantized view depth, back to front
+    uint64_t compute_sort_key(const sRenderData& render_data, eRenderListType list, const glm::vec3& eye, const glm::vec3& view_direction) const;
+    void sort_render_list(std::vector<sRenderData>& render_list, eRenderListType list, const glm::vec3& eye, const glm::vec3& view_direction);
+
+    // Scratch storage reused between frames to avoid allocations while sorting
+    std::vector<sRadixSortEntry> sort_entries;
+    std::vector<sRadixSortEntry> sort_entries_scratch;
+    std::vector<sRenderData> render_list_scratch;
+
+    // Camera render lists, kept between frames so their capacity is reused
+    std::vector<std::vector<sRenderData>> camera_render_lists;
+
     // Gaussian Splatting scenes to render
     std::vector<GSNode*> gs_scenes_list;
 
     // Bind group for lighting
 
-    WGPUBindGroup lighting_bind_group;
+    void create_lighting_bind_group(sFrameResources& frame);
 
     // Indirect lighting
 
@@ -177,18 +450,22 @@ protected:
 
     // Direct lighting
 
-    sLightUniformData lights_uniform_data[MAX_LIGHTS];
-    int num_lights = 0;
+    std::vector<sLightUniformData> lights_uniform_data;
+    uint32_t num_lights = 0;
+
+    // Lights buffers grow on demand, lights are binned in clusters so there is no fixed limit
+    uint32_t lights_buffer_capacity = 32;
+
+    // Bins this frame lights with the camera the forward pass uses to find each fragment cluster
+    void update_light_clusters(const Camera& camera, float z_near, float z_far);
 
-    Uniform lights_buffer;
-    Uniform num_lights_buffer;
     Uniform shadow_maps_array;
     Uniform shadow_sampler;
     WGPUTexture shadow_array_texture;
 
     // Shadows
 
-    uint32_t shadow_uniform_buffer_size = MAX_LIGHTS;
+    uint32_t shadow_uniform_buffer_size = MAX_SHADOW_LIGHTS;
     std::vector<Light3D*> lights_with_shadow;
 
     Material* shadow_material;
@@ -196,14 +473,7 @@ protected:
     Pipeline gs_render_pipeline;
     Shader* gs_render_shader = nullptr;
 
-    WGPUQuerySet timestamp_query_set;
-    uint8_t maximum_query_sets = 16;
-
-    WGPUBuffer timestamp_query_buffer;
-    uint8_t query_index = 0;
-    std::map<uint8_t, std::string> queries_label_map;
-    std::vector<float> last_frame_timestamps;
-    bool timestamps_requested = false;
+    GPUProfiler* gpu_profiler = nullptr;
 
     bool frustum_camera_paused = false;
     bool debug_this_frame = false;
@@ -217,6 +487,13 @@ protected:
 
     uint32_t frame_counter = 0;
 
+    RenderPassState render_pass_state;
+
+    GeometryArena* geometry_arena = nullptr;
+
+    sRenderStats frame_stats;
+    sRenderStats last_frame_stats;
+
     Mesh* skybox_mesh = nullptr;
     Surface* skybox_surface = nullptr;
     Material* skybox_material = nullptr;
@@ -239,7 +516,8 @@ public:
     virtual void render();
 
     void render_camera(const std::vector<std::vector<sRenderData>>& render_lists, WGPUTextureView framebuffer_view, WGPUTextureView depth_view,
-            const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, bool render_transparents = true, const std::string& pass_name = "", uint32_t eye_idx = 0, uint32_t camera_offset = 0);
+            const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, bool render_transparents = true, const std::string& pass_name = "", uint32_t eye_idx = 0, uint32_t camera_offset = 0,
+            const sCameraBundles* bundles = nullptr);
 
     void process_events();
 
@@ -253,26 +531,47 @@ public:
     void increase_frame_counter() { frame_counter++; }
     uint32_t get_frame_counter() { return frame_counter; }
 
+    const sRenderStats& get_last_frame_stats() const { return last_frame_stats; }
+
+    // Usage and fragmentation of the shared vertex and index buffers
+    GeometryArena* get_geometry_arena() { return geometry_arena; }
+
     void init_lighting_bind_group();
-    WGPUBindGroup get_lighting_bind_group() { return lighting_bind_group; }
-    WGPUBindGroup get_render_camera_bind_group() { return render_camera_bind_group; }
-    WGPUBindGroup get_compute_camera_bind_group() { return compute_camera_bind_group; }
+    // Bind groups of the frame being built
+    WGPUBindGroup get_lighting_bind_group() { return get_frame_resources().lighting_bind_group; }
+    WGPUBindGroup get_render_camera_bind_group() { return get_frame_resources().render_camera_bind_group; }
+    WGPUBindGroup get_compute_camera_bind_group() { return get_frame_resources().compute_camera_bind_group; }
+
+    FrameRing* get_frame_ring() { return &frame_ring; }
 
     void init_depth_buffers();
     void init_multisample_textures();
-    void init_timestamp_queries();
 
     void set_frustum_camera_paused(bool value);
+    void set_gpu_culling_enabled(bool value);
+    bool get_gpu_culling_enabled() const { return gpu_culling_enabled; }
+    void set_meshlet_culling_enabled(bool value) { meshlet_culling_enabled = value; }
+    bool get_meshlet_culling_enabled() const { return meshlet_culling_enabled; }
+    void set_xr_stereo_bundles_enabled(bool value) { xr_stereo_bundles_enabled = value; }
+    bool get_xr_stereo_bundles_enabled() const { return xr_stereo_bundles_enabled; }
+    void set_render_bundle_cache_enabled(bool value) { render_bundle_cache_enabled = value; }
+    bool get_render_bundle_cache_enabled() const { return render_bundle_cache_enabled; }
+    void set_occlusion_culling_mode(eOcclusionCullingMode mode) { occlusion_culling_mode = mode; }
+    eOcclusionCullingMode get_occlusion_culling_mode() const { return occlusion_culling_mode; }
+    void set_software_occlusion_enabled(bool value) { software_occlusion_enabled = value; }
+    bool get_software_occlusion_enabled() const { return software_occlusion_enabled; }
+    void set_lod_enabled(bool value) { lod_enabled = value; }
+    bool get_lod_enabled() const { return lod_enabled; }
+    // Scales the projected sizes, higher values keep the finer LODs longer
+    void set_lod_bias(float value) { lod_bias = value; }
+    float get_lod_bias() const { return lod_bias; }
     bool get_frustum_camera_paused();
 
     bool get_use_custom_mirror() { return use_custom_mirror; }
 
-    void request_timestamps() { timestamps_requested = true; }
-
     WGPUCommandEncoder get_global_command_encoder() { return global_command_encoder; }
 
-    void resolve_query_set(WGPUCommandEncoder encoder, uint8_t first_query);
-    std::vector<float>& get_last_frame_timestamps() { return last_frame_timestamps; }
+    GPUProfiler* get_gpu_profiler() { return gpu_profiler; }
 
     void set_msaa_count(uint8_t msaa_count, bool is_initial_value = false);
     uint8_t get_msaa_count();
@@ -280,6 +579,9 @@ public:
     bool is_inside_frustum(const glm::vec3& minp, const glm::vec3& maxp) const;
 
     void prepare_cull_instancing(const Camera& camera, std::vector<std::vector<sRenderData>>& render_lists, sInstanceData& instances_data, bool is_shadow_pass = false);
+
+    // Sorts already culled lists, merges repeated surfaces into instances and uploads their data
+    void prepare_instancing(const Camera& camera, std::vector<std::vector<sRenderData>>& render_lists, sInstanceData& instances_data, bool is_shadow_pass = false);
     void render_opaque(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride = 0);
     void render_transparent(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride = 0);
     void render_splats(WGPURenderPassEncoder render_pass, const std::vector<std::vector<sRenderData>>& render_lists, const sInstanceData& instance_data, WGPUBindGroup camera_bind_group, uint32_t camera_buffer_stride = 0);
@@ -296,7 +598,7 @@ public:
     float get_exposure() { return exposure; }
     float get_ibl_intensity() { return ibl_intensity; }
 
-    inline Uniform* get_current_camera_uniform() { return &camera_uniform; }
+    inline Uniform* get_current_camera_uniform() { return &get_frame_resources().camera_uniform; }
     glm::vec3 get_camera_eye();
     glm::vec3 get_camera_front();
 
@@ -319,10 +621,6 @@ public:
     std::vector<WGPUBindGroup> swapchain_bind_groups;
 #endif // USE_MIRROR_WINDOW
 
-    uint8_t timestamp(WGPUCommandEncoder encoder, const char* label = "");
-
-    WGPUQuerySet get_query_set() { return timestamp_query_set; }
-    std::map<uint8_t, std::string>& get_queries_label_map() { return queries_label_map; }
 
     glm::vec4 get_clear_color() { return clear_color; }
 
@@ -338,6 +636,16 @@ public:
     void add_splat_scene(GSNode* gs_scene);
     void clear_renderables();
 
+    static constexpr uint32_t INVALID_RENDER_PROXY = UINT32_MAX;
+
+    uint32_t register_render_proxy(Mesh* mesh, MeshInstance3D* instance = nullptr);
+    void submit_render_proxy(uint32_t proxy_id, const glm::mat4x4& global_matrix);
+    void remove_render_proxy(uint32_t proxy_id);
+
+    // Scene queries over the retained instances rendered last frame
+    MeshInstance3D* ray_cast_instances(const glm::vec3& ray_origin, const glm::vec3& ray_direction, float* distance = nullptr);
+    void query_instances(const AABB& box, std::vector<MeshInstance3D*>& instances);
+
     void update_lights();
     void add_light(Light3D* new_light);
 
@@ -12,7 +12,10 @@
 #include "framework/nodes/skeleton_instance_3d.h"
 #include "framework/animation/animation.h"
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <limits>
 
 #ifdef __EMSCRIPTEN__
 
@@ -38,6 +41,23 @@ std::map<std::string, std::vector<std::string>> RendererStorage::shader_library_
 std::unordered_map<const Material*, RendererStorage::sBindingData> RendererStorage::material_bind_groups;
 std::unordered_map<const void*, RendererStorage::sBindingData> RendererStorage::ui_widget_bind_groups;
 
+Uniform RendererStorage::material_params_uniform;
+std::vector<uint8_t> RendererStorage::material_params_data;
+std::unordered_map<sMaterialParams, uint32_t> RendererStorage::material_params_slots;
+std::vector<uint32_t> RendererStorage::material_params_ref_counts;
+std::vector<uint32_t> RendererStorage::free_material_params_slots;
+uint32_t RendererStorage::material_params_capacity = 0;
+uint32_t RendererStorage::material_params_stride = 0;
+uint32_t RendererStorage::material_params_dirty_begin = std::numeric_limits<uint32_t>::max();
+uint32_t RendererStorage::material_params_dirty_end = 0;
+
+std::unordered_map<TextureViewKey, RendererStorage::sCachedObject<WGPUTextureView>> RendererStorage::texture_views_cache;
+std::unordered_map<WGPUTextureView, TextureViewKey> RendererStorage::texture_views_keys;
+std::unordered_map<SamplerKey, RendererStorage::sCachedObject<WGPUSampler>> RendererStorage::samplers_cache;
+std::unordered_map<WGPUSampler, SamplerKey> RendererStorage::samplers_keys;
+std::unordered_map<BindGroupKey, RendererStorage::sCachedObject<WGPUBindGroup>> RendererStorage::bind_groups_cache;
+std::unordered_map<WGPUBindGroup, BindGroupKey> RendererStorage::bind_groups_keys;
+
 std::unordered_map<RenderPipelineKey, Pipeline*> RendererStorage::registered_render_pipelines;
 std::unordered_map<Shader*, Pipeline*> RendererStorage::registered_compute_pipelines;
 
@@ -70,7 +90,6 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
     uint32_t binding = 0;
 
     std::vector<Uniform*>& uniforms = material_bind_groups[material].uniforms;
-    std::unordered_map<eMaterialProperties, uint8_t>& uniform_indices = material_bind_groups[material].uniform_indices;
     const Texture* texture_ref = nullptr;
 
     Texture* diffuse_texture = material->get_diffuse_texture();
@@ -82,22 +101,17 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
             view_dimension = WGPUTextureViewDimension_3D;
             array_layers = 1;
         }
-        u->data = diffuse_texture->get_view(view_dimension, 0, diffuse_texture->get_mipmap_count(), 0, array_layers);
+        u->data = get_texture_view(diffuse_texture, view_dimension, 0, diffuse_texture->get_mipmap_count(), 0, array_layers);
         u->binding = 0;
         uniforms.push_back(u);
         uses_textures |= true;
         texture_ref = diffuse_texture;
     }
 
-    // Albedo color factor
+    // Color and the rest of scalar factors, all in the material slot of the shared buffer
     {
-        Uniform* u = new Uniform();
-        const glm::vec4& color = material->get_color();
-        u->data = webgpu_context->create_buffer(sizeof(glm::vec4), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &color, "mat_albedo");
-        u->binding = 1;
-        u->buffer_size = sizeof(glm::vec4);
-        uniform_indices[eMaterialProperties::PROP_COLOR] = static_cast<uint8_t>(uniforms.size());
-        uniforms.push_back(u);
+        material_bind_groups[material].params_slot = acquire_material_params_slot(webgpu_context, get_material_params(material));
+        uniforms.push_back(&material_params_uniform);
     }
 
     if (material->get_type() == MATERIAL_PBR) {
@@ -105,70 +119,37 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
         Texture* metallic_roughness_texture = material->get_metallic_roughness_texture();
         if (metallic_roughness_texture) {
             Uniform* u = new Uniform();
-            u->data = metallic_roughness_texture->get_view(WGPUTextureViewDimension_2D, 0, metallic_roughness_texture->get_mipmap_count());
+            u->data = get_texture_view(metallic_roughness_texture, WGPUTextureViewDimension_2D, 0, metallic_roughness_texture->get_mipmap_count());
             u->binding = 2;
             uniforms.push_back(u);
             uses_textures |= true;
             texture_ref = metallic_roughness_texture;
         }
 
-        // Occlusion, roughness, metallic factors
-        {
-            Uniform* u = new Uniform();
-            glm::vec3 occlusion_roughness_metallic = { material->get_occlusion(), material->get_roughness(), material->get_metallic() };
-            u->data = webgpu_context->create_buffer(sizeof(glm::vec3), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &occlusion_roughness_metallic, "mat_occlusion_roughness_metallic");
-            u->binding = 3;
-            u->buffer_size = sizeof(glm::vec3);
-            uniform_indices[eMaterialProperties::PROP_OCLUSSION_ROUGHNESS_METALLIC] = static_cast<uint8_t>(uniforms.size());
-            uniforms.push_back(u);
-        }
-
         Texture* normal_texture = material->get_normal_texture();
         if (normal_texture) {
             Uniform* u = new Uniform();
-            u->data = normal_texture->get_view(WGPUTextureViewDimension_2D, 0, normal_texture->get_mipmap_count());
+            u->data = get_texture_view(normal_texture, WGPUTextureViewDimension_2D, 0, normal_texture->get_mipmap_count());
             u->binding = 4;
             uniforms.push_back(u);
             uses_textures |= true;
             texture_ref = normal_texture;
-
-            // Normal scale
-            {
-                Uniform* u = new Uniform();
-                float normal_scale = material->get_normal_scale();
-                u->data = webgpu_context->create_buffer(sizeof(float), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &normal_scale, "mat_normal_scale");
-                u->binding = 5;
-                u->buffer_size = sizeof(float);
-                uniform_indices[eMaterialProperties::PROP_NORMAL_SCALE] = static_cast<uint8_t>(uniforms.size());
-                uniforms.push_back(u);
-            }
         }
 
         Texture* emissive_texture = material->get_emissive_texture();
         if (emissive_texture) {
             Uniform* u = new Uniform();
-            u->data = emissive_texture->get_view(WGPUTextureViewDimension_2D, 0, emissive_texture->get_mipmap_count());
+            u->data = get_texture_view(emissive_texture, WGPUTextureViewDimension_2D, 0, emissive_texture->get_mipmap_count());
             u->binding = 6;
             uniforms.push_back(u);
             uses_textures |= true;
             texture_ref = emissive_texture;
         }
 
-        // Emissive color factor
-        {
-            Uniform* u = new Uniform();
-            const glm::vec3& emissive = material->get_emissive();
-            u->data = webgpu_context->create_buffer(sizeof(glm::vec3), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &emissive, "mat_emissive");
-            u->binding = 8;
-            u->buffer_size = sizeof(glm::vec3);
-            uniform_indices[eMaterialProperties::PROP_EMISSIVE] = static_cast<uint8_t>(uniforms.size());
-            uniforms.push_back(u);
-        }
-
         Texture* occlusion_texture = material->get_occlusion_texture();
         if (occlusion_texture) {
             Uniform* u = new Uniform();
-            u->data = occlusion_texture->get_view(WGPUTextureViewDimension_2D, 0, occlusion_texture->get_mipmap_count());
+            u->data = get_texture_view(occlusion_texture, WGPUTextureViewDimension_2D, 0, occlusion_texture->get_mipmap_count());
             u->binding = 13;
             uniforms.push_back(u);
             uses_textures |= true;
@@ -180,18 +161,10 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
         */
 
         if (material->has_clearcoat()) {
-            Uniform* u = new Uniform();
-            glm::vec2 clearcoat_data = { material->get_clearcoat_factor(), material->get_clearcoat_roughness() };
-            u->data = webgpu_context->create_buffer(sizeof(glm::vec2), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &clearcoat_data, "mat_clearcoat");
-            u->binding = 14;
-            u->buffer_size = sizeof(glm::vec2);
-            uniform_indices[eMaterialProperties::PROP_CLEARCOAT] = static_cast<uint8_t>(uniforms.size());
-            uniforms.push_back(u);
-
             Texture* clearcoat_texture = material->get_clearcoat_texture();
             if (clearcoat_texture) {
                 Uniform* u = new Uniform();
-                u->data = clearcoat_texture->get_view(WGPUTextureViewDimension_2D, 0, clearcoat_texture->get_mipmap_count());
+                u->data = get_texture_view(clearcoat_texture, WGPUTextureViewDimension_2D, 0, clearcoat_texture->get_mipmap_count());
                 u->binding = 15;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -201,7 +174,7 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
             Texture* clearcoat_roughness_texture = material->get_clearcoat_roughness_texture();
             if (clearcoat_roughness_texture) {
                 Uniform* u = new Uniform();
-                u->data = clearcoat_roughness_texture->get_view(WGPUTextureViewDimension_2D, 0, clearcoat_roughness_texture->get_mipmap_count());
+                u->data = get_texture_view(clearcoat_roughness_texture, WGPUTextureViewDimension_2D, 0, clearcoat_roughness_texture->get_mipmap_count());
                 u->binding = 16;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -211,7 +184,7 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
             Texture* clearcoat_normal_texture = material->get_clearcoat_normal_texture();
             if (clearcoat_normal_texture) {
                 Uniform* u = new Uniform();
-                u->data = clearcoat_normal_texture->get_view(WGPUTextureViewDimension_2D, 0, clearcoat_normal_texture->get_mipmap_count());
+                u->data = get_texture_view(clearcoat_normal_texture, WGPUTextureViewDimension_2D, 0, clearcoat_normal_texture->get_mipmap_count());
                 u->binding = 17;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -224,18 +197,10 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
         */
 
         if (material->has_iridescence()) {
-            Uniform* u = new Uniform();
-            glm::vec4 iridescence_data = { material->get_iridescence_factor(), material->get_iridescence_ior(), material->get_iridescence_thickness_min(), material->get_iridescence_thickness_max() };
-            u->data = webgpu_context->create_buffer(sizeof(glm::vec4), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &iridescence_data, "mat_iridescence");
-            u->binding = 18;
-            u->buffer_size = sizeof(glm::vec4);
-            uniform_indices[eMaterialProperties::PROP_IRIDESCENCE] = static_cast<uint8_t>(uniforms.size());
-            uniforms.push_back(u);
-
             Texture* iridescence_texture = material->get_iridescence_texture();
             if (iridescence_texture) {
                 Uniform* u = new Uniform();
-                u->data = iridescence_texture->get_view(WGPUTextureViewDimension_2D, 0, iridescence_texture->get_mipmap_count());
+                u->data = get_texture_view(iridescence_texture, WGPUTextureViewDimension_2D, 0, iridescence_texture->get_mipmap_count());
                 u->binding = 19;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -245,7 +210,7 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
             Texture* iridescence_thickness_texture = material->get_iridescence_thickness_texture();
             if (iridescence_thickness_texture) {
                 Uniform* u = new Uniform();
-                u->data = iridescence_thickness_texture->get_view(WGPUTextureViewDimension_2D, 0, iridescence_thickness_texture->get_mipmap_count());
+                u->data = get_texture_view(iridescence_thickness_texture, WGPUTextureViewDimension_2D, 0, iridescence_thickness_texture->get_mipmap_count());
                 u->binding = 20;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -258,19 +223,10 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
         */
 
         if (material->has_anisotropy()) {
-            Uniform* u = new Uniform();
-            float rotation = material->get_anisotropy_rotation();
-            glm::vec3 anisotropy_data = { cosf(rotation), sinf(rotation), material->get_anisotropy_factor() };
-            u->data = webgpu_context->create_buffer(sizeof(glm::vec3), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &anisotropy_data, "mat_anisotropy");
-            u->binding = 21;
-            u->buffer_size = sizeof(glm::vec3);
-            uniform_indices[eMaterialProperties::PROP_ANISOTROPY] = static_cast<uint8_t>(uniforms.size());
-            uniforms.push_back(u);
-
             Texture* anisotropy_texture = material->get_anisotropy_texture();
             if (anisotropy_texture) {
                 Uniform* u = new Uniform();
-                u->data = anisotropy_texture->get_view(WGPUTextureViewDimension_2D, 0, anisotropy_texture->get_mipmap_count());
+                u->data = get_texture_view(anisotropy_texture, WGPUTextureViewDimension_2D, 0, anisotropy_texture->get_mipmap_count());
                 u->binding = 22;
                 uniforms.push_back(u);
                 uses_textures |= true;
@@ -283,7 +239,7 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
     if (uses_textures)
     {
         Uniform* sampler_uniform = new Uniform();
-        sampler_uniform->data = webgpu_context->create_sampler(
+        sampler_uniform->data = get_sampler(webgpu_context,
             texture_ref->get_wrap_u(),
             texture_ref->get_wrap_v(),
             WGPUAddressMode_ClampToEdge,
@@ -308,16 +264,6 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
         }
     }
 
-    if (material->get_transparency_type() == ALPHA_MASK) {
-        Uniform* u = new Uniform();
-        float alpha_mask = material->get_alpha_mask();
-        u->data = webgpu_context->create_buffer(sizeof(float), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, &alpha_mask, "mat_alpha_cutoff");
-        u->binding = 9;
-        u->buffer_size = sizeof(float);
-        uniform_indices[eMaterialProperties::PROP_ALPHA_MASK] = static_cast<uint8_t>(uniforms.size());
-        uniforms.push_back(u);
-    }
-
     if (material->get_use_skinning()) {
 
         MeshInstance3D* instance_3d = static_cast<MeshInstance3D*>(mesh->get_node_ref());
@@ -357,7 +303,7 @@ void RendererStorage::register_material_bind_group(WebGPUContext* webgpu_context
     material->reset_dirty_flags();
 
     if (material->get_fragment_write() || (!material->get_fragment_write() && material->get_use_skinning())) {
-        material_bind_groups[material].bind_group = webgpu_context->create_bind_group(uniforms, material->get_shader(), 2);
+        material_bind_groups[material].bind_group = get_bind_group(webgpu_context, uniforms, material->get_shader(), 2);
     }
 }
 
@@ -376,73 +322,305 @@ void RendererStorage::delete_material_bind_group(WebGPUContext* webgpu_context,
     auto it = material_bind_groups.find(material);
 
     if (it != material_bind_groups.end()) {
-        wgpuBindGroupRelease(it->second.bind_group);
+        if (it->second.bind_group) {
+            release_bind_group(it->second.bind_group);
+        }
 
         for (auto uniform : it->second.uniforms) {
-            uniform->destroy();
+            // Shared by all the materials
+            if (uniform == &material_params_uniform) {
+                continue;
+            }
+
+            // Views and samplers come from the caches
+            if (std::holds_alternative<WGPUTextureView>(uniform->data)) {
+                release_texture_view(std::get<WGPUTextureView>(uniform->data));
+                uniform->data = {};
+            }
+            else if (std::holds_alternative<WGPUSampler>(uniform->data)) {
+                release_sampler(std::get<WGPUSampler>(uniform->data));
+                uniform->data = {};
+            }
+            else {
+                uniform->destroy();
+            }
         }
 
+        release_material_params_slot(it->second.params_slot);
+
         material_bind_groups.erase(it);
     }
 }
 
 void RendererStorage::update_material_bind_group(WebGPUContext* webgpu_context, Mesh* mesh, Material* material)
 {
-    std::vector<Uniform*>& uniforms = material_bind_groups[material].uniforms;
-    std::unordered_map<eMaterialProperties, uint8_t>& uniform_indices = material_bind_groups[material].uniform_indices;
+    sBindingData& binding_data = material_bind_groups[material];
+
+    // Every scalar property is in the material slot, move to the one holding the new values.
+    // The bind group does not change, only the dynamic offset
+    sMaterialParams params = get_material_params(material);
+    uint32_t previous_slot = binding_data.params_slot;
+
+    binding_data.params_slot = acquire_material_params_slot(webgpu_context, params);
+    release_material_params_slot(previous_slot);
+
+    material->reset_dirty_flags();
+}
+
+sMaterialParams RendererStorage::get_material_params(const Material* material)
+{
+    sMaterialParams params;
+    params.color = material->get_color();
+    params.emissive = material->get_emissive();
+    params.normal_scale = material->get_normal_scale();
+    params.occlusion_roughness_metallic = { material->get_occlusion(), material->get_roughness(), material->get_metallic() };
+    params.alpha_cutoff = material->get_alpha_mask();
+    params.iridescence = { material->get_iridescence_factor(), material->get_iridescence_ior(), material->get_iridescence_thickness_min(), material->get_iridescence_thickness_max() };
+
+    float rotation = material->get_anisotropy_rotation();
+    params.anisotropy = { cosf(rotation), sinf(rotation), material->get_anisotropy_factor() };
+
+    params.clearcoat = { material->get_clearcoat_factor(), material->get_clearcoat_roughness() };
+
+    return params;
+}
+
+uint32_t RendererStorage::acquire_material_params_slot(WebGPUContext* webgpu_context, const sMaterialParams& params)
+{
+    auto it = material_params_slots.find(params);
+    if (it != material_params_slots.end()) {
+        material_params_ref_counts[it->second]++;
+        return it->second;
+    }
+
+    uint32_t slot;
+
+    if (!free_material_params_slots.empty()) {
+        slot = free_material_params_slots.back();
+        free_material_params_slots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(material_params_ref_counts.size());
+        material_params_ref_counts.push_back(0);
+    }
+
+    if (slot >= material_params_capacity) {
+        // Dynamic offsets must be aligned
+        material_params_stride = std::max(static_cast<uint32_t>(sizeof(sMaterialParams)), webgpu_context->required_limits.minUniformBufferOffsetAlignment);
+        material_params_capacity = std::max(material_params_capacity * 2, 256u);
+        material_params_data.resize(static_cast<size_t>(material_params_capacity) * material_params_stride);
+
+        // Released, not destroyed: passes already encoded this frame may still use the old buffer
+        if (std::holds_alternative<WGPUBuffer>(material_params_uniform.data)) {
+            wgpuBufferRelease(std::get<WGPUBuffer>(material_params_uniform.data));
+        }
+
+        material_params_uniform.data = webgpu_context->create_buffer(material_params_data.size(), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, nullptr, "material_params_buffer");
+        material_params_uniform.binding = 1;
+        material_params_uniform.buffer_size = sizeof(sMaterialParams);
+
+        // The new buffer starts empty, upload every slot in use
+        material_params_dirty_begin = 0;
+        material_params_dirty_end = static_cast<uint32_t>(material_params_ref_counts.size());
+
+        // All the material bind groups point to the old buffer, release them all before getting the new ones
+        for (auto& [bound_material, binding_data] : material_bind_groups) {
+            if (binding_data.bind_group) {
+                release_bind_group(binding_data.bind_group);
+            }
+        }
+
+        for (auto& [bound_material, binding_data] : material_bind_groups) {
+            if (binding_data.bind_group) {
+                binding_data.bind_group = get_bind_group(webgpu_context, binding_data.uniforms, bound_material->get_shader(), 2);
+            }
+        }
+    }
+
+    memcpy(&material_params_data[static_cast<size_t>(slot) * material_params_stride], &params, sizeof(sMaterialParams));
+
+    material_params_dirty_begin = std::min(material_params_dirty_begin, slot);
+    material_params_dirty_end = std::max(material_params_dirty_end, slot + 1);
 
-    uint32_t dirty_flags = material->get_dirty_flags();
+    material_params_slots[params] = slot;
+    material_params_ref_counts[slot] = 1;
 
-    if (dirty_flags & eMaterialProperties::PROP_COLOR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_COLOR]];
-        const glm::vec4& color = material->get_color();
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &color, sizeof(glm::vec4));
+    return slot;
+}
+
+void RendererStorage::release_material_params_slot(uint32_t slot)
+{
+    assert(slot < material_params_ref_counts.size() && material_params_ref_counts[slot] > 0);
+
+    if (--material_params_ref_counts[slot] > 0) {
+        return;
+    }
+
+    sMaterialParams params;
+    memcpy(&params, &material_params_data[static_cast<size_t>(slot) * material_params_stride], sizeof(sMaterialParams));
+
+    material_params_slots.erase(params);
+
+    // Passes already encoded in the frames in flight may still read the slot, new values can only
+    // be written to it once they have completed
+    if (Renderer::instance) {
+        Renderer::instance->get_frame_ring()->release_later([slot]() { free_material_params_slots.push_back(slot); });
+    }
+    else {
+        free_material_params_slots.push_back(slot);
+    }
+}
+
+uint32_t RendererStorage::get_material_params_offset(const Material* material)
+{
+    auto it = material_bind_groups.find(material);
+    if (it == material_bind_groups.end()) {
+        assert(false);
+        return 0;
+    }
+
+    return it->second.params_slot * material_params_stride;
+}
+
+void RendererStorage::flush_material_params(WebGPUContext* webgpu_context)
+{
+    if (material_params_dirty_begin >= material_params_dirty_end) {
+        return;
+    }
+
+    // Clean slots in between are uploaded too, one write instead of one per material
+    uint64_t offset = static_cast<uint64_t>(material_params_dirty_begin) * material_params_stride;
+    uint64_t size = static_cast<uint64_t>(material_params_dirty_end - material_params_dirty_begin) * material_params_stride;
+
+    webgpu_context->update_buffer(std::get<WGPUBuffer>(material_params_uniform.data), offset, &material_params_data[offset], size);
+
+    material_params_dirty_begin = std::numeric_limits<uint32_t>::max();
+    material_params_dirty_end = 0;
+}
+
+WGPUTextureView RendererStorage::get_texture_view(Texture* texture, WGPUTextureViewDimension view_dimension, uint32_t base_mip_level, uint32_t mip_level_count, uint32_t base_array_layer, uint32_t array_layer_count)
+{
+    TextureViewKey key = { texture->get_texture(), view_dimension, base_mip_level, mip_level_count, base_array_layer, array_layer_count };
+
+    sCachedObject<WGPUTextureView>& cached = texture_views_cache[key];
+
+    if (!cached.handle) {
+        cached.handle = texture->get_view(view_dimension, base_mip_level, mip_level_count, base_array_layer, array_layer_count);
+        texture_views_keys[cached.handle] = key;
+    }
+
+    cached.ref_count++;
+
+    return cached.handle;
+}
+
+void RendererStorage::release_texture_view(WGPUTextureView texture_view)
+{
+    auto key_it = texture_views_keys.find(texture_view);
+    if (key_it == texture_views_keys.end()) {
+        spdlog::error("Releasing a texture view not created by the cache");
+        assert(false);
+        return;
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_OCLUSSION_ROUGHNESS_METALLIC && material->get_type() == MATERIAL_PBR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_OCLUSSION_ROUGHNESS_METALLIC]];
-        glm::vec3 occlusion_roughness_metallic = { material->get_occlusion(), material->get_roughness(), material->get_metallic() };
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &occlusion_roughness_metallic, sizeof(glm::vec3));
+    auto it = texture_views_cache.find(key_it->second);
+
+    if (--it->second.ref_count == 0) {
+        wgpuTextureViewRelease(texture_view);
+        texture_views_cache.erase(it);
+        texture_views_keys.erase(key_it);
+    }
+}
+
+WGPUSampler RendererStorage::get_sampler(WebGPUContext* webgpu_context, WGPUAddressMode wrap_u, WGPUAddressMode wrap_v, WGPUAddressMode wrap_w,
+    WGPUFilterMode mag_filter, WGPUFilterMode min_filter, WGPUMipmapFilterMode mipmap_filter, float lod_max_clamp, uint16_t max_anisotropy, WGPUCompareFunction compare_function)
+{
+    SamplerKey key = { wrap_u, wrap_v, wrap_w, mag_filter, min_filter, mipmap_filter, lod_max_clamp, max_anisotropy, compare_function };
+
+    sCachedObject<WGPUSampler>& cached = samplers_cache[key];
+
+    if (!cached.handle) {
+        cached.handle = webgpu_context->create_sampler(wrap_u, wrap_v, wrap_w, mag_filter, min_filter, mipmap_filter, lod_max_clamp, max_anisotropy, compare_function);
+        samplers_keys[cached.handle] = key;
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_EMISSIVE && material->get_type() == MATERIAL_PBR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_EMISSIVE]];
-        const glm::vec3& emissive = material->get_emissive();
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &emissive, sizeof(glm::vec3));
+    cached.ref_count++;
+
+    return cached.handle;
+}
+
+void RendererStorage::release_sampler(WGPUSampler sampler)
+{
+    auto key_it = samplers_keys.find(sampler);
+    if (key_it == samplers_keys.end()) {
+        spdlog::error("Releasing a sampler not created by the cache");
+        assert(false);
+        return;
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_ALPHA_MASK && material->get_transparency_type() == ALPHA_MASK) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_ALPHA_MASK]];
-        float alpha_mask = material->get_alpha_mask();
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &alpha_mask, sizeof(float));
+    auto it = samplers_cache.find(key_it->second);
+
+    if (--it->second.ref_count == 0) {
+        wgpuSamplerRelease(sampler);
+        samplers_cache.erase(it);
+        samplers_keys.erase(key_it);
     }
+}
 
-    if (dirty_flags & eMaterialProperties::PROP_NORMAL_SCALE && material->get_normal_texture()) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_NORMAL_SCALE]];
-        float normal_scale = material->get_normal_scale();
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &normal_scale, sizeof(float));
+WGPUBindGroup RendererStorage::get_bind_group(WebGPUContext* webgpu_context, const std::vector<Uniform*>& uniforms, const Shader* shader, uint16_t bind_group)
+{
+    const std::vector<WGPUBindGroupLayout>& layouts = shader->get_bind_group_layouts();
+
+    if (layouts.size() <= bind_group) {
+        spdlog::error("Can't find bind group {} in shader: {}", bind_group, shader->get_path());
+        assert(false);
+        return nullptr;
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_CLEARCOAT && material->get_type() == MATERIAL_PBR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_CLEARCOAT]];
-        glm::vec2 clearcoat_data = { material->get_clearcoat_factor(), material->get_clearcoat_roughness() };
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &clearcoat_data, sizeof(glm::vec2));
+    BindGroupKey key;
+    key.layout = layouts[bind_group];
+    key.entries.reserve(uniforms.size());
+
+    for (const Uniform* uniform : uniforms) {
+        WGPUBindGroupEntry entry = uniform->get_bind_group_entry();
+        const void* resource = entry.buffer ? static_cast<const void*>(entry.buffer) :
+            (entry.textureView ? static_cast<const void*>(entry.textureView) : static_cast<const void*>(entry.sampler));
+        key.entries.push_back({ entry.binding, resource, entry.offset, entry.size });
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_IRIDESCENCE && material->get_type() == MATERIAL_PBR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_IRIDESCENCE]];
-        glm::vec4 iridescence_data = { material->get_iridescence_factor(), material->get_iridescence_ior(), material->get_iridescence_thickness_min(), material->get_iridescence_thickness_max() };
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &iridescence_data, sizeof(glm::vec4));
+    // Same resources in a different order are the same bind group
+    std::sort(key.entries.begin(), key.entries.end(), [](const BindGroupKey::sEntry& a, const BindGroupKey::sEntry& b) {
+        return a.binding < b.binding;
+    });
+
+    sCachedObject<WGPUBindGroup>& cached = bind_groups_cache[key];
+
+    if (!cached.handle) {
+        cached.handle = webgpu_context->create_bind_group(uniforms, shader, bind_group);
+        bind_groups_keys[cached.handle] = key;
     }
 
-    if (dirty_flags & eMaterialProperties::PROP_ANISOTROPY && material->get_type() == MATERIAL_PBR) {
-        Uniform* u = uniforms[uniform_indices[eMaterialProperties::PROP_ANISOTROPY]];
-        float rotation = material->get_anisotropy_rotation();
-        glm::vec3 anisotropy_data = { cosf(rotation), sinf(rotation), material->get_anisotropy_factor() };
-        webgpu_context->update_buffer(std::get<WGPUBuffer>(u->data), 0, &anisotropy_data, sizeof(glm::vec3));
+    cached.ref_count++;
+
+    return cached.handle;
+}
+
+void RendererStorage::release_bind_group(WGPUBindGroup bind_group)
+{
+    auto key_it = bind_groups_keys.find(bind_group);
+    if (key_it == bind_groups_keys.end()) {
+        spdlog::error("Releasing a bind group not created by the cache");
+        assert(false);
+        return;
     }
 
-    material->reset_dirty_flags();
+    auto it = bind_groups_cache.find(key_it->second);
+
+    if (--it->second.ref_count == 0) {
+        wgpuBindGroupRelease(bind_group);
+        bind_groups_cache.erase(it);
+        bind_groups_keys.erase(key_it);
+    }
 }
 
 void RendererStorage::register_ui_widget(WebGPUContext* webgpu_context, Shader* shader, void* entity_mesh, const sUIData& ui_data, uint8_t bind_group_id, bool force)
@@ -49,9 +49,9 @@ public:
 
     struct sBindingData {
         std::vector<Uniform*> uniforms;
-        // Depending on material properties, uniforms will have different indices in the array
-        std::unordered_map<eMaterialProperties, uint8_t> uniform_indices;
-        WGPUBindGroup bind_group;
+        WGPUBindGroup bind_group = nullptr;
+        // Slot in the shared material parameters buffer
+        uint32_t params_slot = 0;
     };
 
     static std::unordered_map<const Material*, sBindingData> material_bind_groups;
@@ -64,6 +64,56 @@ public:
 
     static void update_material_bind_group(WebGPUContext* webgpu_context, Mesh* mesh, Material* material);
 
+    // Scalar parameters of all the materials share a uniform buffer, one slot each bound with a dynamic offset.
+    // Materials with the same parameters share the slot. Changes are kept on the CPU copy and uploaded
+    // together by flush_material_params
+    static Uniform material_params_uniform;
+    static std::vector<uint8_t> material_params_data;
+    static std::unordered_map<sMaterialParams, uint32_t> material_params_slots;
+    static std::vector<uint32_t> material_params_ref_counts;
+    static std::vector<uint32_t> free_material_params_slots;
+    static uint32_t material_params_capacity;
+    static uint32_t material_params_stride;
+    static uint32_t material_params_dirty_begin;
+    static uint32_t material_params_dirty_end;
+
+    static sMaterialParams get_material_params(const Material* material);
+    static uint32_t acquire_material_params_slot(WebGPUContext* webgpu_context, const sMaterialParams& params);
+    static void release_material_params_slot(uint32_t slot);
+
+    // Dynamic offset of the material slot, for binding 1 of the material bind group
+    static uint32_t get_material_params_offset(const Material* material);
+
+    // Single upload of every slot written since the last flush
+    static void flush_material_params(WebGPUContext* webgpu_context);
+
+    // Texture views, samplers and bind groups are shared between all their users with the same
+    // parameters (or resources, for bind groups). Each get must be paired with a release
+    template <typename T>
+    struct sCachedObject {
+        T handle = nullptr;
+        uint32_t ref_count = 0;
+    };
+
+    static std::unordered_map<TextureViewKey, sCachedObject<WGPUTextureView>> texture_views_cache;
+    static std::unordered_map<WGPUTextureView, TextureViewKey> texture_views_keys;
+    static std::unordered_map<SamplerKey, sCachedObject<WGPUSampler>> samplers_cache;
+    static std::unordered_map<WGPUSampler, SamplerKey> samplers_keys;
+    static std::unordered_map<BindGroupKey, sCachedObject<WGPUBindGroup>> bind_groups_cache;
+    static std::unordered_map<WGPUBindGroup, BindGroupKey> bind_groups_keys;
+
+    static WGPUTextureView get_texture_view(Texture* texture, WGPUTextureViewDimension view_dimension = WGPUTextureViewDimension_2D,
+        uint32_t base_mip_level = 0, uint32_t mip_level_count = 1, uint32_t base_array_layer = 0, uint32_t array_layer_count = 1);
+    static void release_texture_view(WGPUTextureView texture_view);
+
+    static WGPUSampler get_sampler(WebGPUContext* webgpu_context, WGPUAddressMode wrap_u = WGPUAddressMode_ClampToEdge, WGPUAddressMode wrap_v = WGPUAddressMode_ClampToEdge, WGPUAddressMode wrap_w = WGPUAddressMode_ClampToEdge,
+        WGPUFilterMode mag_filter = WGPUFilterMode_Linear, WGPUFilterMode min_filter = WGPUFilterMode_Linear, WGPUMipmapFilterMode mipmap_filter = WGPUMipmapFilterMode_Linear,
+        float lod_max_clamp = 1.0f, uint16_t max_anisotropy = 1u, WGPUCompareFunction compare_function = WGPUCompareFunction_Undefined);
+    static void release_sampler(WGPUSampler sampler);
+
+    static WGPUBindGroup get_bind_group(WebGPUContext* webgpu_context, const std::vector<Uniform*>& uniforms, const Shader* shader, uint16_t bind_group);
+    static void release_bind_group(WGPUBindGroup bind_group);
+
     static void register_ui_widget(WebGPUContext* webgpu_context, Shader* shader, void* widget, const sUIData& ui_data, uint8_t bind_group_id, bool force = false);
     static WGPUBindGroup get_ui_widget_bind_group(const void* widget);
     static void update_ui_widget(WebGPUContext* webgpu_context, void* entity_mesh, const sUIData& ui_data);
@@ -25,6 +25,43 @@
 std::unordered_map<std::string, custom_define_type> Shader::custom_defines;
 std::unordered_map<std::string, std::string> Shader::engine_libraries;
 
+// Formats allowed in "#unique <step_mode>:<format>" tags, named as in the WebGPU spec
+static bool get_vertex_format_from_name(const std::string& name, WGPUVertexFormat* format, size_t* byte_size)
+{
+    static const std::unordered_map<std::string, std::pair<WGPUVertexFormat, size_t>> formats = {
+        { "uint8x2", { WGPUVertexFormat_Uint8x2, 2 } },
+        { "uint8x4", { WGPUVertexFormat_Uint8x4, 4 } },
+        { "unorm8x2", { WGPUVertexFormat_Unorm8x2, 2 } },
+        { "unorm8x4", { WGPUVertexFormat_Unorm8x4, 4 } },
+        { "snorm8x2", { WGPUVertexFormat_Snorm8x2, 2 } },
+        { "snorm8x4", { WGPUVertexFormat_Snorm8x4, 4 } },
+        { "uint16x2", { WGPUVertexFormat_Uint16x2, 4 } },
+        { "uint16x4", { WGPUVertexFormat_Uint16x4, 8 } },
+        { "unorm16x2", { WGPUVertexFormat_Unorm16x2, 4 } },
+        { "unorm16x4", { WGPUVertexFormat_Unorm16x4, 8 } },
+        { "snorm16x2", { WGPUVertexFormat_Snorm16x2, 4 } },
+        { "snorm16x4", { WGPUVertexFormat_Snorm16x4, 8 } },
+        { "float16x2", { WGPUVertexFormat_Float16x2, 4 } },
+        { "float16x4", { WGPUVertexFormat_Float16x4, 8 } },
+        { "unorm10-10-10-2", { WGPUVertexFormat_Unorm10_10_10_2, 4 } },
+    };
+
+    auto it = formats.find(name);
+    if (it == formats.end()) {
+        return false;
+    }
+
+    if (format) {
+        *format = it->second.first;
+    }
+
+    if (byte_size) {
+        *byte_size = it->second.second;
+    }
+
+    return true;
+}
+
 Shader::Shader()
 {
     engine_libraries[shaders::math::path] = shaders::math::source;
@@ -217,6 +254,19 @@ bool Shader::parse_preprocessor_line(std::istringstream& string_stream, std::str
         uint8_t location = tokens[2].at(10) - '0';
         WGPUVertexStepMode step_mode = WGPUVertexStepMode_Undefined;
 
+        // Optional packed format after the step mode, e.g. "#unique vertex:snorm16x2"
+        size_t format_pos = step_mode_str.find(':');
+        if (format_pos != std::string::npos) {
+            std::string format_str = step_mode_str.substr(format_pos + 1);
+            step_mode_str = step_mode_str.substr(0, format_pos);
+
+            if (!get_vertex_format_from_name(format_str, nullptr, nullptr)) {
+                spdlog::error("Unknown vertex format \"{}\" at location {}", format_str, location);
+            } else {
+                vertex_formats[location] = format_str;
+            }
+        }
+
         if (step_mode_str == "vertex") {
             step_mode = WGPUVertexStepMode_Vertex;
         } else if (step_mode_str == "instance") {
@@ -453,45 +503,67 @@ void Shader::get_reflection_data(const std::string& shader_content)
                 vertex_attribute.shaderLocation = input_variable.attributes.location.value();
 
                 size_t byte_size = 0;
-                switch (input_variable.component_type) {
-                    case tint::inspector::ComponentType::kF32:
-                        byte_size = sizeof(float);
-                        vertex_attribute.format = WGPUVertexFormat_Float32;
-                        break;
-                    case tint::inspector::ComponentType::kU32:
-                        byte_size = sizeof(uint32_t);
-                        vertex_attribute.format = WGPUVertexFormat_Uint32;
-                        break;
-                    case tint::inspector::ComponentType::kI32:
-                        byte_size = sizeof(int32_t);
-                        vertex_attribute.format = WGPUVertexFormat_Sint32;
-                        break;
-                    //case tint::inspector::ComponentType::kF16:
-                    //	byte_size = sizeof(uint16_t);
-                    //	break;
-                    default:
-                        spdlog::error("Shader reflection failed: Vertex component type not implemented");
-                        break;
-                }
 
-                switch (input_variable.composition_type) {
-                    case tint::inspector::CompositionType::kScalar:
-                        break;
-                    case tint::inspector::CompositionType::kVec2:
-                        byte_size *= 2;
-                        vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 1);
-                        break;
-                    case tint::inspector::CompositionType::kVec3:
-                        byte_size *= 3;
-                        vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 2);
-                        break;
-                    case tint::inspector::CompositionType::kVec4:
-                        byte_size *= 4;
-                        vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 3);
-                        break;
-                    default:
-                        spdlog::error("Shader reflection failed: Vertex composition type not implemented");
-                        break;
+                // Packed attributes tagged in the shader don't take the format from the shader type
+                if (vertex_formats.contains(vertex_attribute.shaderLocation)) {
+                    get_vertex_format_from_name(vertex_formats[vertex_attribute.shaderLocation], &vertex_attribute.format, &byte_size);
+                } else if (input_variable.component_type == tint::inspector::ComponentType::kF16) {
+                    // There is no float16x3 format
+                    switch (input_variable.composition_type) {
+                        case tint::inspector::CompositionType::kScalar:
+                            byte_size = sizeof(uint16_t);
+                            vertex_attribute.format = WGPUVertexFormat_Float16;
+                            break;
+                        case tint::inspector::CompositionType::kVec2:
+                            byte_size = sizeof(uint16_t) * 2;
+                            vertex_attribute.format = WGPUVertexFormat_Float16x2;
+                            break;
+                        case tint::inspector::CompositionType::kVec4:
+                            byte_size = sizeof(uint16_t) * 4;
+                            vertex_attribute.format = WGPUVertexFormat_Float16x4;
+                            break;
+                        default:
+                            spdlog::error("Shader reflection failed: Vertex composition type not implemented for f16");
+                            break;
+                    }
+                } else {
+                    switch (input_variable.component_type) {
+                        case tint::inspector::ComponentType::kF32:
+                            byte_size = sizeof(float);
+                            vertex_attribute.format = WGPUVertexFormat_Float32;
+                            break;
+                        case tint::inspector::ComponentType::kU32:
+                            byte_size = sizeof(uint32_t);
+                            vertex_attribute.format = WGPUVertexFormat_Uint32;
+                            break;
+                        case tint::inspector::ComponentType::kI32:
+                            byte_size = sizeof(int32_t);
+                            vertex_attribute.format = WGPUVertexFormat_Sint32;
+                            break;
+                        default:
+                            spdlog::error("Shader reflection failed: Vertex component type not implemented");
+                            break;
+                    }
+
+                    switch (input_variable.composition_type) {
+                        case tint::inspector::CompositionType::kScalar:
+                            break;
+                        case tint::inspector::CompositionType::kVec2:
+                            byte_size *= 2;
+                            vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 1);
+                            break;
+                        case tint::inspector::CompositionType::kVec3:
+                            byte_size *= 3;
+                            vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 2);
+                            break;
+                        case tint::inspector::CompositionType::kVec4:
+                            byte_size *= 4;
+                            vertex_attribute.format = get_vertex_format_offset(vertex_attribute.format, 3);
+                            break;
+                        default:
+                            spdlog::error("Shader reflection failed: Vertex composition type not implemented");
+                            break;
+                    }
                 }
 
                 if (!unique_vertex_buffers.contains(vertex_attribute.shaderLocation)) {
@@ -83,6 +83,8 @@ private:
     static std::unordered_map<std::string, custom_define_type> custom_defines;
     std::unordered_map<uint8_t, uint8_t> dynamic_bindings;
     std::unordered_map<uint8_t, WGPUVertexStepMode> unique_vertex_buffers;
+    // Packed vertex formats by location, from the "#unique" tags
+    std::unordered_map<uint8_t, std::string> vertex_formats;
     std::vector<std::string> define_specializations;
 
 	bool loaded = false;
@@ -0,0 +1,335 @@
+#include "staging_belt.h"
+
+#include "graphics/webgpu_context.h"
+
+#include "framework/utils/cpu_profiler.h"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <cstring>
+
+StagingBelt* StagingBelt::instance = nullptr;
+
+StagingBelt::StagingBelt(WebGPUContext* webgpu_context)
+    : webgpu_context(webgpu_context), owner_thread(std::this_thread::get_id())
+{
+    instance = this;
+}
+
+StagingBelt::~StagingBelt()
+{
+    for (sDeferredWrite& deferred_write : deferred_writes) {
+        wgpuBufferRelease(deferred_write.buffer);
+    }
+
+    deferred_writes.clear();
+
+    for (WGPUBuffer buffer : pending_buffers) {
+        wgpuBufferRelease(buffer);
+    }
+
+    pending_buffers.clear();
+    copies.clear();
+
+#ifndef __EMSCRIPTEN__
+    while (mapping_count > 0) {
+        webgpu_context->process_events();
+    }
+#endif
+
+    for (std::vector<sChunk*>* chunks : { &active_chunks, &closed_chunks, &free_chunks }) {
+        for (sChunk* chunk : *chunks) {
+            wgpuBufferDestroy(chunk->buffer);
+            wgpuBufferRelease(chunk->buffer);
+            delete chunk;
+        }
+
+        chunks->clear();
+    }
+
+    if (instance == this) {
+        instance = nullptr;
+    }
+}
+
+bool StagingBelt::write(WGPUBuffer buffer, uint64_t buffer_offset, void const* data, uint64_t size)
+{
+    if (size == 0) {
+        return true;
+    }
+
+    // A queue write from another thread could land before the copies staged earlier, it is deferred to the frame thread
+    if (std::this_thread::get_id() != owner_thread) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        std::lock_guard<std::mutex> lock(deferred_writes_mutex);
+
+        wgpuBufferAddRef(buffer);
+        deferred_writes.push_back({ buffer, buffer_offset, std::vector<uint8_t>(bytes, bytes + size) });
+        has_deferred_writes = true;
+
+        return true;
+    }
+
+    // The writes other threads did before this one go first
+    apply_deferred_writes();
+
+    bool can_stage = size <= CHUNK_SIZE && size % 4 == 0 && buffer_offset % 4 == 0;
+
+    if (!can_stage) {
+        // Queue writes land before the next submit, the staged ones to the same buffer have to go first
+        if (pending_buffers.contains(buffer)) {
+            flush();
+        }
+
+        frame_stats.direct_bytes += size;
+        return false;
+    }
+
+    if (active_chunks.size() >= MAX_ACTIVE_CHUNKS && active_chunks.back()->used + size > CHUNK_SIZE) {
+        flush();
+    }
+
+    sChunk* chunk = get_chunk(size);
+
+    uint64_t chunk_offset = chunk->used;
+    memcpy(chunk->mapped_data + chunk_offset, data, size);
+    chunk->used += size;
+
+    frame_stats.staged_bytes += size;
+    frame_stats.writes++;
+
+    if (!copies.empty()) {
+        sCopy& last_copy = copies.back();
+
+        if (last_copy.chunk == chunk && last_copy.buffer == buffer &&
+            last_copy.chunk_offset + last_copy.size == chunk_offset &&
+            last_copy.buffer_offset + last_copy.size == buffer_offset) {
+            last_copy.size += size;
+            return true;
+        }
+    }
+
+    if (pending_buffers.insert(buffer).second) {
+        wgpuBufferAddRef(buffer);
+    }
+
+    copies.push_back({ chunk, chunk_offset, buffer, buffer_offset, size });
+
+    return true;
+}
+
+void StagingBelt::discard_writes(WGPUBuffer buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(deferred_writes_mutex);
+
+        std::erase_if(deferred_writes, [buffer](const sDeferredWrite& deferred_write) {
+            if (deferred_write.buffer != buffer) {
+                return false;
+            }
+
+            wgpuBufferRelease(deferred_write.buffer);
+            return true;
+        });
+    }
+
+    if (!pending_buffers.erase(buffer)) {
+        return;
+    }
+
+    std::erase_if(copies, [buffer](const sCopy& copy) { return copy.buffer == buffer; });
+
+    wgpuBufferRelease(buffer);
+}
+
+WGPUCommandBuffer StagingBelt::finish()
+{
+    assert(std::this_thread::get_id() == owner_thread);
+
+    apply_deferred_writes();
+
+    WGPUCommandBuffer commands = nullptr;
+
+    if (!copies.empty()) {
+        WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(webgpu_context->device, {});
+
+        for (const sCopy& copy : copies) {
+            wgpuCommandEncoderCopyBufferToBuffer(encoder, copy.chunk->buffer, copy.chunk_offset, copy.buffer, copy.buffer_offset, copy.size);
+        }
+
+        WGPUCommandBufferDescriptor cmd_buff_descriptor = {};
+        cmd_buff_descriptor.label = { "staging belt command", WGPU_STRLEN };
+
+        commands = wgpuCommandEncoderFinish(encoder, &cmd_buff_descriptor);
+
+        wgpuCommandEncoderRelease(encoder);
+
+        frame_stats.copies += static_cast<uint32_t>(copies.size());
+
+        copies.clear();
+    }
+
+    for (WGPUBuffer buffer : pending_buffers) {
+        wgpuBufferRelease(buffer);
+    }
+
+    pending_buffers.clear();
+
+    // Chunks must be unmapped before the submit using them
+    std::vector<sChunk*> remaining_chunks;
+
+    for (sChunk* chunk : active_chunks) {
+        if (chunk->used == 0) {
+            remaining_chunks.push_back(chunk);
+            continue;
+        }
+
+        wgpuBufferUnmap(chunk->buffer);
+        chunk->mapped_data = nullptr;
+        closed_chunks.push_back(chunk);
+    }
+
+    active_chunks = std::move(remaining_chunks);
+
+    return commands;
+}
+
+void StagingBelt::recall()
+{
+    for (sChunk* chunk : closed_chunks) {
+        WGPUBufferMapCallbackInfo callback_info = {};
+        callback_info.mode = WGPUCallbackMode_AllowProcessEvents;
+        callback_info.userdata1 = this;
+        callback_info.userdata2 = chunk;
+
+        callback_info.callback = [](WGPUMapAsyncStatus status, struct WGPUStringView message, void* userdata1, void* userdata2) {
+            StagingBelt* staging_belt = reinterpret_cast<StagingBelt*>(userdata1);
+            sChunk* chunk = reinterpret_cast<sChunk*>(userdata2);
+
+            staging_belt->mapping_count--;
+
+            if (status != WGPUMapAsyncStatus_Success) {
+                // The device is gone, nothing will be staged anymore
+                wgpuBufferRelease(chunk->buffer);
+                staging_belt->chunk_count--;
+                delete chunk;
+                return;
+            }
+
+            chunk->mapped_data = reinterpret_cast<uint8_t*>(wgpuBufferGetMappedRange(chunk->buffer, 0, CHUNK_SIZE));
+            chunk->used = 0;
+
+            staging_belt->free_chunks.push_back(chunk);
+        };
+
+        mapping_count++;
+
+        wgpuBufferMapAsync(chunk->buffer, WGPUMapMode_Write, 0, CHUNK_SIZE, callback_info);
+    }
+
+    closed_chunks.clear();
+}
+
+void StagingBelt::flush()
+{
+    // The pending copies belong to the frame thread
+    if (std::this_thread::get_id() != owner_thread) {
+        return;
+    }
+
+    WGPUCommandBuffer commands = finish();
+
+    if (commands) {
+        wgpuQueueSubmit(webgpu_context->device_queue, 1, &commands);
+        wgpuCommandBufferRelease(commands);
+    }
+
+    recall();
+}
+
+const StagingBelt::sStats& StagingBelt::end_frame()
+{
+    frame_stats.chunks = chunk_count;
+
+    PROFILE_COUNTER_ADD("staged_bytes", frame_stats.staged_bytes);
+    PROFILE_COUNTER_ADD("staged_copies", frame_stats.copies);
+
+    last_frame_stats = frame_stats;
+    frame_stats = {};
+
+    return last_frame_stats;
+}
+
+void StagingBelt::apply_deferred_writes()
+{
+    // Also reached from the writes below, the ones deferred meanwhile wait until these are done
+    if (!has_deferred_writes || applying_deferred_writes) {
+        return;
+    }
+
+    applying_deferred_writes = true;
+
+    std::vector<sDeferredWrite> writes;
+
+    {
+        std::lock_guard<std::mutex> lock(deferred_writes_mutex);
+        writes.swap(deferred_writes);
+        has_deferred_writes = false;
+    }
+
+    for (sDeferredWrite& deferred_write : writes) {
+        const uint64_t size = deferred_write.data.size();
+
+        if (!write(deferred_write.buffer, deferred_write.buffer_offset, deferred_write.data.data(), size)) {
+            wgpuQueueWriteBuffer(webgpu_context->device_queue, deferred_write.buffer, deferred_write.buffer_offset, deferred_write.data.data(), size);
+        }
+
+        wgpuBufferRelease(deferred_write.buffer);
+    }
+
+    applying_deferred_writes = false;
+}
+
+StagingBelt::sChunk* StagingBelt::get_chunk(uint64_t size)
+{
+    if (!active_chunks.empty() && active_chunks.back()->used + size <= CHUNK_SIZE) {
+        return active_chunks.back();
+    }
+
+    sChunk* chunk = nullptr;
+
+    if (!free_chunks.empty()) {
+        chunk = free_chunks.back();
+        free_chunks.pop_back();
+    }
+    else {
+        chunk = create_chunk();
+    }
+
+    active_chunks.push_back(chunk);
+
+    return chunk;
+}
+
+StagingBelt::sChunk* StagingBelt::create_chunk()
+{
+    WGPUBufferDescriptor buffer_desc = {};
+    buffer_desc.size = CHUNK_SIZE;
+    buffer_desc.usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+    buffer_desc.mappedAtCreation = true;
+    buffer_desc.label = { "staging_belt_chunk", WGPU_STRLEN };
+
+    sChunk* chunk = new sChunk();
+    chunk->buffer = wgpuDeviceCreateBuffer(webgpu_context->device, &buffer_desc);
+    chunk->mapped_data = reinterpret_cast<uint8_t*>(wgpuBufferGetMappedRange(chunk->buffer, 0, CHUNK_SIZE));
+
+    chunk_count++;
+
+    if (chunk_count % 16 == 0) {
+        spdlog::warn("Staging belt grew to {} chunks of {} bytes", chunk_count, CHUNK_SIZE);
+    }
+
+    return chunk;
+}
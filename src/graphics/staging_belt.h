@@ -0,0 +1,118 @@
+#pragma once
+
+#include "includes.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+struct WebGPUContext;
+
+// Batches the buffer writes of a frame. Each write is copied into a mapped staging chunk and recorded
+// as a buffer to buffer copy, contiguous writes to the same buffer become a single copy. finish() encodes
+// the copies in their own command buffer, which must be submitted before anything reading the written
+// buffers. The chunks are mapped again once the GPU is done with them and reused in the next frames.
+// Unaligned writes and writes bigger than a chunk go straight to the queue. Writes from other threads are
+// copied and applied in order by the frame thread, at its next write or finish()
+class StagingBelt {
+
+public:
+
+    static constexpr uint64_t CHUNK_SIZE = 1 << 20;
+
+    // Staged data waiting for a submit, past this the belt flushes on its own
+    static constexpr uint32_t MAX_ACTIVE_CHUNKS = 64;
+
+    static StagingBelt* instance;
+
+    struct sStats {
+        uint64_t staged_bytes = 0;
+        uint64_t direct_bytes = 0;
+        uint32_t writes = 0;
+        // Copies encoded after merging the contiguous writes
+        uint32_t copies = 0;
+        uint32_t chunks = 0;
+    };
+
+    StagingBelt(WebGPUContext* webgpu_context);
+    ~StagingBelt();
+
+    // False if the data was not staged and has to be written to the queue, done in order with the staged writes.
+    // Always true from other threads
+    bool write(WGPUBuffer buffer, uint64_t buffer_offset, void const* data, uint64_t size);
+
+    // Drops the pending copies to a buffer, call before destroying it
+    void discard_writes(WGPUBuffer buffer);
+
+    // Encodes the pending copies, nullptr if there are none. Submit it and then call recall()
+    WGPUCommandBuffer finish();
+
+    // Maps again the chunks of the finished copies
+    void recall();
+
+    // Submits the pending copies right away, for submits outside the frame reading the written buffers
+    void flush();
+
+    // Closes the statistics of the frame
+    const sStats& end_frame();
+
+    const sStats& get_last_frame_stats() const { return last_frame_stats; }
+
+private:
+
+    struct sChunk {
+        WGPUBuffer buffer = nullptr;
+        uint8_t* mapped_data = nullptr;
+        uint64_t used = 0;
+    };
+
+    struct sCopy {
+        sChunk* chunk = nullptr;
+        uint64_t chunk_offset = 0;
+        WGPUBuffer buffer = nullptr;
+        uint64_t buffer_offset = 0;
+        uint64_t size = 0;
+    };
+
+    WebGPUContext* webgpu_context = nullptr;
+
+    // The frame thread, the only one staging writes
+    std::thread::id owner_thread;
+
+    // Mapped, the last one is being filled
+    std::vector<sChunk*> active_chunks;
+    // Used by the finished copies, waiting to be mapped again
+    std::vector<sChunk*> closed_chunks;
+    // Mapped and empty
+    std::vector<sChunk*> free_chunks;
+
+    uint32_t chunk_count = 0;
+    uint32_t mapping_count = 0;
+
+    std::vector<sCopy> copies;
+
+    // Written by other threads, waiting for the frame thread
+    struct sDeferredWrite {
+        WGPUBuffer buffer = nullptr;
+        uint64_t buffer_offset = 0;
+        std::vector<uint8_t> data;
+    };
+
+    std::mutex deferred_writes_mutex;
+    std::vector<sDeferredWrite> deferred_writes;
+    std::atomic<bool> has_deferred_writes = false;
+    bool applying_deferred_writes = false;
+
+    // Referenced until the copies are encoded, so releasing them meanwhile is safe
+    std::unordered_set<WGPUBuffer> pending_buffers;
+
+    sStats frame_stats;
+    sStats last_frame_stats;
+
+    void apply_deferred_writes();
+
+    sChunk* get_chunk(uint64_t size);
+    sChunk* create_chunk();
+};
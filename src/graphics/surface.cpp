@@ -4,14 +4,24 @@
 #include "framework/colors.h"
 
 #include "graphics/renderer_storage.h"
+#include "graphics/geometry_arena.h"
+#include "graphics/mesh_optimizer.h"
 
 #include "spdlog/spdlog.h"
 
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <numeric>
+
 WebGPUContext* Surface::webgpu_context = nullptr;
 Surface* Surface::quad_mesh = nullptr;
+uint32_t Surface::last_surface_id = 0;
 
 Surface::~Surface()
 {
+    clear_lods();
+
     clean_buffers();
 
     if (material) {
@@ -23,17 +33,34 @@ Surface::~Surface()
 
 void Surface::clean_buffers()
 {
-    if (vertex_pos_buffer) {
-        wgpuBufferDestroy(vertex_pos_buffer);
+    GeometryArena* geometry_arena = GeometryArena::instance;
+
+    if (first_vertex != GeometryArena::INVALID_OFFSET) {
+        if (geometry_arena) {
+            geometry_arena->release_vertices(first_vertex);
+        }
+
+        first_vertex = GeometryArena::INVALID_OFFSET;
     }
 
-    if (vertex_data_buffer) {
-        wgpuBufferDestroy(vertex_data_buffer);
+    if (first_index != GeometryArena::INVALID_OFFSET) {
+        if (geometry_arena) {
+            geometry_arena->release_indices(first_index, index_format);
+        }
+
+        first_index = GeometryArena::INVALID_OFFSET;
     }
 
-    if (index_buffer) {
-        wgpuBufferDestroy(index_buffer);
+    if (first_meshlet != GeometryArena::INVALID_OFFSET) {
+        if (geometry_arena) {
+            geometry_arena->release_meshlets(first_meshlet);
+        }
+
+        first_meshlet = GeometryArena::INVALID_OFFSET;
     }
+
+    vertex_count = 0;
+    index_count = 0;
 }
 
 void Surface::set_material(Material* material)
@@ -48,23 +75,35 @@ void Surface::set_material(Material* material)
     }
 
     this->material = material;
+
+    for (const sLod& lod : lods) {
+        lod.surface->set_material(material);
+    }
 }
 
 void Surface::update_vertex_buffer(const std::vector<glm::vec3>& vertices)
 {
-    if (vertices.size() != vertex_count && vertex_pos_buffer) {
-        wgpuBufferDestroy(vertex_pos_buffer);
-        vertex_pos_buffer = nullptr;
+    GeometryArena* geometry_arena = GeometryArena::instance;
 
-        vertex_count = static_cast<uint32_t>(vertices.size());
+    // A different count needs a new range, the vertex data is not updated here
+    if (vertices.size() != vertex_count && first_vertex != GeometryArena::INVALID_OFFSET) {
+        geometry_arena->release_vertices(first_vertex);
+        first_vertex = GeometryArena::INVALID_OFFSET;
     }
 
-    if (!vertex_pos_buffer) {
-        vertex_pos_buffer = webgpu_context->create_buffer(get_vertices_byte_size(), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, vertices.data(), ("vertex_buffer_" + name).c_str());
-    }
-    else {
-        webgpu_context->update_buffer(vertex_pos_buffer, 0, vertices.data(), get_vertices_byte_size());
+    vertex_count = static_cast<uint32_t>(vertices.size());
+
+    if (first_vertex == GeometryArena::INVALID_OFFSET) {
+        first_vertex = geometry_arena->allocate_vertices(vertex_count);
+
+        if (first_vertex == GeometryArena::INVALID_OFFSET) {
+            spdlog::error("Can not allocate {} vertices for surface {}", vertex_count, name);
+            vertex_count = 0;
+            return;
+        }
     }
+
+    geometry_arena->write_positions(first_vertex, vertices.data(), vertex_count);
 }
 
 void Surface::update_surface_data(const sSurfaceData& vertices_data, bool store_data)
@@ -73,20 +112,16 @@ void Surface::update_surface_data(const sSurfaceData& vertices_data, bool store_
         surface_data = vertices_data;
     }
 
-    if (vertices_data.vertices.size() != vertex_count && vertex_pos_buffer) {
-        wgpuBufferDestroy(vertex_pos_buffer);
-        vertex_pos_buffer = nullptr;
-    }
-
-    if (!vertex_pos_buffer) {
+    if (vertices_data.vertices.size() != vertex_count || first_vertex == GeometryArena::INVALID_OFFSET) {
         create_surface_data(vertices_data);
     }
     else {
-        vertex_count = static_cast<uint32_t>(vertices_data.vertices.size());
-        webgpu_context->update_buffer(vertex_pos_buffer, 0, vertices_data.vertices.data(), get_vertices_byte_size());
+        GeometryArena* geometry_arena = GeometryArena::instance;
+
+        geometry_arena->write_positions(first_vertex, vertices_data.vertices.data(), vertex_count);
 
         const std::vector<sInterleavedData>& interleaved_data = create_interleaved_data(vertices_data);
-        webgpu_context->update_buffer(vertex_data_buffer, 0, interleaved_data.data(), get_interleaved_data_byte_size());
+        geometry_arena->write_vertex_data(first_vertex, interleaved_data.data(), vertex_count);
     }
 }
 
@@ -96,11 +131,28 @@ void Surface::create_surface_data(const sSurfaceData& vertices_data, bool store_
         surface_data = vertices_data;
     }
 
-    vertex_count = static_cast<uint32_t>(vertices_data.vertices.size());
-    vertex_pos_buffer = webgpu_context->create_buffer(get_vertices_byte_size(), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, vertices_data.vertices.data(), ("vertex_buffer_" + name).c_str());
+    // Ranges of previous data go back to the arena
+    clean_buffers();
+
+    GeometryArena* geometry_arena = GeometryArena::instance;
+
+    uint32_t new_vertex_count = static_cast<uint32_t>(vertices_data.vertices.size());
+
+    first_vertex = geometry_arena->allocate_vertices(new_vertex_count);
+
+    if (first_vertex == GeometryArena::INVALID_OFFSET) {
+        if (new_vertex_count > 0) {
+            spdlog::error("Can not allocate {} vertices for surface {}", new_vertex_count, name);
+        }
+        return;
+    }
+
+    vertex_count = new_vertex_count;
+
+    geometry_arena->write_positions(first_vertex, vertices_data.vertices.data(), vertex_count);
 
     const std::vector<sInterleavedData>& interleaved_data = create_interleaved_data(vertices_data);
-    vertex_data_buffer = webgpu_context->create_buffer(get_interleaved_data_byte_size(), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex, interleaved_data.data(), ("vertex_data_buffer_" + name).c_str());
+    geometry_arena->write_vertex_data(first_vertex, interleaved_data.data(), vertex_count);
 
     if (!vertices_data.indices.empty()) {
         create_index_buffer(vertices_data.indices);
@@ -114,8 +166,64 @@ void Surface::set_surface_data(const sSurfaceData& vertices_data)
 
 void Surface::create_index_buffer(const std::vector<uint32_t>& indices)
 {
+    GeometryArena* geometry_arena = GeometryArena::instance;
+
+    if (first_index != GeometryArena::INVALID_OFFSET) {
+        geometry_arena->release_indices(first_index, index_format);
+        first_index = GeometryArena::INVALID_OFFSET;
+        index_count = 0;
+    }
+
+    if (first_meshlet != GeometryArena::INVALID_OFFSET) {
+        geometry_arena->release_meshlets(first_meshlet);
+        first_meshlet = GeometryArena::INVALID_OFFSET;
+    }
+
+    if (!meshlets.empty()) {
+        const sMeshlet& last_meshlet = meshlets.back();
+
+        // Built for other indices
+        if (last_meshlet.first_index + last_meshlet.index_count != indices.size()) {
+            spdlog::warn("Meshlets of surface {} do not match its new indices, discarding them", name);
+            meshlets.clear();
+        }
+    }
+
+    // Half the index memory and bandwidth when all the indices fit. The meshlet cull kernel only reads 32 bit indices.
+    // 0xFFFF is left out, strip topologies always read it as a primitive restart
+    uint32_t max_index = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+    index_format = (max_index < UINT16_MAX && meshlets.empty()) ? WGPUIndexFormat_Uint16 : WGPUIndexFormat_Uint32;
+
+    first_index = geometry_arena->allocate_indices(static_cast<uint32_t>(indices.size()), index_format);
+
+    if (first_index == GeometryArena::INVALID_OFFSET) {
+        if (!indices.empty()) {
+            spdlog::error("Can not allocate {} indices for surface {}", indices.size(), name);
+        }
+        return;
+    }
+
     index_count = static_cast<uint32_t>(indices.size());
-    index_buffer = webgpu_context->create_buffer(get_indices_byte_size(), WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index, indices.data(), ("index_buffer_" + name).c_str());
+    geometry_arena->write_indices(first_index, indices.data(), index_count, index_format);
+
+    if (meshlets.empty()) {
+        return;
+    }
+
+    first_meshlet = geometry_arena->allocate_meshlets(static_cast<uint32_t>(meshlets.size()));
+
+    if (first_meshlet == GeometryArena::INVALID_OFFSET) {
+        spdlog::error("Can not allocate {} meshlets for surface {}", meshlets.size(), name);
+        return;
+    }
+
+    // The kernel reads the shared index buffer, ranges become absolute
+    std::vector<sMeshlet> arena_meshlets = meshlets;
+    for (sMeshlet& meshlet : arena_meshlets) {
+        meshlet.first_index += first_index;
+    }
+
+    geometry_arena->write_meshlets(first_meshlet, arena_meshlets.data(), static_cast<uint32_t>(arena_meshlets.size()));
 }
 
 Material* Surface::get_material() const
@@ -133,19 +241,19 @@ sSurfaceData& Surface::get_surface_data()
     return surface_data;
 }
 
-const WGPUBuffer& Surface::get_vertex_buffer() const
+WGPUBuffer Surface::get_vertex_buffer() const
 {
-    return vertex_pos_buffer;
+    return GeometryArena::instance->get_position_buffer();
 }
 
-const WGPUBuffer& Surface::get_vertex_data_buffer() const
+WGPUBuffer Surface::get_vertex_data_buffer() const
 {
-    return vertex_data_buffer;
+    return GeometryArena::instance->get_vertex_data_buffer();
 }
 
-const WGPUBuffer& Surface::get_index_buffer() const
+WGPUBuffer Surface::get_index_buffer() const
 {
-    return index_buffer;
+    return index_count > 0 ? GeometryArena::instance->get_index_buffer(index_format) : nullptr;
 }
 
 void Surface::update_aabb(std::vector<glm::vec3>& vertices)
@@ -1202,16 +1310,75 @@ std::vector<sInterleavedData> Surface::create_interleaved_data(const sSurfaceDat
     std::vector<sInterleavedData> interleaved_data;
     interleaved_data.reserve(vertices_data.size());
 
+    // Octahedral mapping of a unit vector to [-1, 1]^2, zero vectors map to +Z
+    auto encode_octahedral = [](const glm::vec3& v) -> glm::vec2 {
+        float l1_norm = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+        if (l1_norm <= 0.0f) {
+            return glm::vec2(0.0f);
+        }
+
+        glm::vec3 n = v / l1_norm;
+        if (n.z >= 0.0f) {
+            return glm::vec2(n);
+        }
+
+        glm::vec2 sign_not_zero = { n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f };
+        return (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign_not_zero;
+    };
+
+    // 8 bit weights that still add up to 1, the rounding error goes to the largest one
+    auto quantize_weights = [](const glm::vec4& weights) -> uint32_t {
+        glm::vec4 clamped = glm::clamp(weights, 0.0f, 1.0f);
+        float sum = clamped.x + clamped.y + clamped.z + clamped.w;
+        if (sum <= 0.0f) {
+            return 0u;
+        }
+
+        glm::ivec4 quantized = glm::ivec4(glm::round(clamped / sum * 255.0f));
+
+        int largest = 0;
+        for (int i = 1; i < 4; ++i) {
+            if (quantized[i] > quantized[largest]) {
+                largest = i;
+            }
+        }
+
+        quantized[largest] += 255 - (quantized.x + quantized.y + quantized.z + quantized.w);
+
+        return static_cast<uint32_t>(quantized.x) | (static_cast<uint32_t>(quantized.y) << 8) |
+            (static_cast<uint32_t>(quantized.z) << 16) | (static_cast<uint32_t>(quantized.w) << 24);
+    };
+
     for (uint32_t idx = 0; idx < vertices_data.size(); idx++) {
 
-        interleaved_data.push_back({
-            vertices_data.uvs.empty() ? glm::vec2(0.0f) : vertices_data.uvs[idx],
-            vertices_data.normals.empty() ? glm::vec3(0.0f) : vertices_data.normals[idx],
-            vertices_data.tangents.empty() ? glm::vec4(0.0f) : vertices_data.tangents[idx],
-            vertices_data.colors.empty() ? glm::vec3(1.0f) : vertices_data.colors[idx],
-            vertices_data.weights.empty() ? glm::vec4(0.0f) : vertices_data.weights[idx],
-            vertices_data.joints.empty() ? glm::ivec4(0) : vertices_data.joints[idx],
-        });
+        sInterleavedData& vertex = interleaved_data.emplace_back();
+
+        if (!vertices_data.uvs.empty()) {
+            vertex.uv = glm::packHalf2x16(vertices_data.uvs[idx]);
+        }
+
+        if (!vertices_data.normals.empty()) {
+            vertex.normal = glm::packSnorm2x16(encode_octahedral(vertices_data.normals[idx]));
+        }
+
+        if (!vertices_data.tangents.empty()) {
+            const glm::vec4& tangent = vertices_data.tangents[idx];
+            vertex.tangent = glm::packSnorm4x8(glm::vec4(encode_octahedral(glm::vec3(tangent)), tangent.w < 0.0f ? -1.0f : 1.0f, 0.0f));
+        }
+
+        if (!vertices_data.colors.empty()) {
+            vertex.color = glm::packUnorm4x8(glm::vec4(vertices_data.colors[idx], 1.0f));
+        }
+
+        if (!vertices_data.weights.empty()) {
+            vertex.weights = quantize_weights(vertices_data.weights[idx]);
+        }
+
+        if (!vertices_data.joints.empty()) {
+            const glm::ivec4& joints = vertices_data.joints[idx];
+            assert(glm::all(glm::greaterThanEqual(joints, glm::ivec4(0))) && glm::all(glm::lessThanEqual(joints, glm::ivec4(UINT16_MAX))));
+            vertex.joints = glm::u16vec4(joints);
+        }
     }
 
     return interleaved_data;
@@ -1245,7 +1412,7 @@ uint32_t Surface::get_index_count() const
 
 uint64_t Surface::get_indices_byte_size() const
 {
-    return index_count * sizeof(uint32_t);
+    return index_count * (index_format == WGPUIndexFormat_Uint16 ? sizeof(uint16_t) : sizeof(uint32_t));
 }
 
 int Surface::mikkt_get_num_faces(const SMikkTSpaceContext* pContext)
@@ -1369,6 +1536,103 @@ void Surface::set_aabb(const AABB& aabb)
     this->aabb = aabb;
 }
 
+void Surface::generate_lods(const sSurfaceData& vertices_data, bool create_data)
+{
+    clear_lods();
+
+    // Simplification stops past this error, relative to the surface extent
+    constexpr float MAX_LOD_ERROR = 0.05f;
+
+    // A LOD is used while its error stays under about a pixel of a 1080p viewport
+    constexpr float PIXEL_ERROR = 1.0f / 1080.0f;
+
+    uint32_t previous_index_count = vertices_data.indices.empty() ? vertices_data.size() : static_cast<uint32_t>(vertices_data.indices.size());
+    float previous_screen_size = FLT_MAX;
+    float target_ratio = 1.0f;
+
+    for (uint32_t level = 1; level <= MAX_LODS; ++level) {
+        target_ratio *= 0.5f;
+
+        // Always from the full data, errors don't pile up along the chain
+        float lod_error = 0.0f;
+        sSurfaceData lod_data = simplify_surface_data(vertices_data, target_ratio, MAX_LOD_ERROR, &lod_error);
+
+        // Locked borders and seams or the error limit stopped it, not worth another level
+        if (lod_data.indices.size() > previous_index_count * 0.8f) {
+            break;
+        }
+
+        previous_index_count = static_cast<uint32_t>(lod_data.indices.size());
+
+        float screen_size = lod_error > 0.0f ? PIXEL_ERROR / lod_error : previous_screen_size;
+        screen_size = std::min(screen_size, previous_screen_size);
+        previous_screen_size = screen_size;
+
+        Surface* lod_surface = new Surface();
+        lod_surface->set_name(name + "_lod" + std::to_string(level));
+        lod_surface->set_aabb(aabb);
+
+        if (material) {
+            lod_surface->set_material(material);
+        }
+
+        if (create_data) {
+            lod_surface->create_surface_data(lod_data);
+        } else {
+            lod_surface->set_surface_data(lod_data);
+        }
+
+        lods.push_back({ lod_surface, screen_size, lod_error });
+    }
+
+    if (!lods.empty()) {
+        spdlog::trace("Surface {}: {} LODs, coarsest {} indices", name, lods.size(), previous_index_count);
+    }
+}
+
+void Surface::create_lods_surface_data()
+{
+    for (const sLod& lod : lods) {
+        sSurfaceData& lod_data = lod.surface->get_surface_data();
+        lod.surface->create_surface_data(lod_data);
+
+        // Only needed for the upload
+        lod_data.clear();
+    }
+}
+
+void Surface::generate_meshlets(sSurfaceData& vertices_data)
+{
+    const uint32_t vertex_count = static_cast<uint32_t>(vertices_data.vertices.size());
+
+    if (vertices_data.indices.empty()) {
+        vertices_data.indices.resize(vertex_count);
+        std::iota(vertices_data.indices.begin(), vertices_data.indices.end(), 0u);
+    }
+
+    meshlets = build_meshlets(vertices_data.indices, vertices_data.vertices.data(), vertex_count);
+
+    spdlog::trace("Surface {} split in {} meshlets", name, meshlets.size());
+}
+
+void Surface::clear_lods()
+{
+    for (const sLod& lod : lods) {
+        delete lod.surface;
+    }
+
+    lods.clear();
+}
+
+Surface* Surface::get_lod_surface(uint32_t level)
+{
+    if (level == 0 || lods.empty()) {
+        return this;
+    }
+
+    return lods[std::min(level, static_cast<uint32_t>(lods.size())) - 1].surface;
+}
+
 uint32_t sSurfaceData::size() const
 {
     return static_cast<uint32_t>(vertices.size());
@@ -4,10 +4,12 @@
 #include "framework/math/aabb.h"
 #include "material.h"
 #include "framework/resources/resource.h"
+#include "graphics/mesh_optimizer.h"
 
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
+#include "glm/gtc/type_precision.hpp"
 
 #include "mikktspace.h"
 
@@ -39,17 +41,33 @@ struct sSurfaceData {
     void clear();
 };
 
+// Packed vertex attributes (28 bytes), the formats must match the "#unique" tags of VertexInput in
+// mesh_includes.wgsl. Normals and tangents are octahedral encoded, the tangent handedness goes in z
 struct sInterleavedData {
-    glm::vec2 uv;
-    glm::vec3 normal;
-    glm::vec4 tangent;
-    glm::vec3 color = glm::vec3(1.0f);
-    glm::vec4 weights;
-    glm::ivec4 joints;
+    uint32_t uv = 0u;                   // float16x2
+    uint32_t normal = 0u;               // snorm16x2
+    uint32_t tangent = 0u;              // snorm8x4
+    uint32_t color = 0xFFFFFFFFu;       // unorm8x4
+    uint32_t weights = 0u;              // unorm8x4
+    glm::u16vec4 joints = {};           // uint16x4
 };
 
 class Surface : public Resource
 {
+public:
+
+    // A coarser version of a surface, used while the projected size of the surface bounds is below
+    // screen_size (fraction of the viewport height)
+    struct sLod {
+        Surface* surface = nullptr;
+        float screen_size = 0.0f;
+        float error = 0.0f;
+    };
+
+    static constexpr uint32_t MAX_LODS = 4;
+
+private:
+
     uint32_t vertex_count = 0;
     uint32_t index_count = 0;
 
@@ -57,14 +75,28 @@ class Surface : public Resource
 
     sSurfaceData surface_data; // optional when loading
 
-    WGPUBuffer vertex_pos_buffer = nullptr;
-    WGPUBuffer vertex_data_buffer = nullptr;
-    WGPUBuffer index_buffer = nullptr;
+    // Ranges in the geometry arena buffers
+    uint32_t first_vertex = UINT32_MAX;
+    uint32_t first_index = UINT32_MAX;
+
+    // 16 bit when all the indices fit
+    WGPUIndexFormat index_format = WGPUIndexFormat_Uint32;
 
     AABB aabb;
 
+    // Stable id used to build render list sort keys
+    static uint32_t last_surface_id;
+    uint32_t sort_id = last_surface_id++;
+
     static Surface* quad_mesh;
 
+    // Owned, finest first. They share the material of this surface
+    std::vector<sLod> lods;
+
+    // Triangle clusters over the index ranges, uploaded with the indices
+    std::vector<sMeshlet> meshlets;
+    uint32_t first_meshlet = UINT32_MAX;
+
     sSurfaceData generate_quad(float w = 1.f, float h = 1.f, const glm::vec3& position = { 0.f, 0.f, 0.f }, const glm::vec3& normal = { 0.f, 1.f, 0.f }, const glm::vec3& color = { 1.f, 1.f, 1.f }, bool flip_y = false);
     void clean_buffers();
 
@@ -81,9 +113,15 @@ public:
     const sSurfaceData& get_surface_data() const;
     sSurfaceData& get_surface_data();
 
-    const WGPUBuffer& get_vertex_buffer() const;
-    const WGPUBuffer& get_vertex_data_buffer() const;
-    const WGPUBuffer& get_index_buffer() const;
+    // Shared geometry arena buffers, draws must use the base vertex and first index
+    WGPUBuffer get_vertex_buffer() const;
+    WGPUBuffer get_vertex_data_buffer() const;
+    // Null for non indexed surfaces
+    WGPUBuffer get_index_buffer() const;
+
+    uint32_t get_base_vertex() const { return first_vertex; }
+    uint32_t get_first_index() const { return first_index; }
+    WGPUIndexFormat get_index_format() const { return index_format; }
 
     void create_axis(float s = 1.f);
     void create_quad(float w = 1.f, float h = 1.f, bool flip_y = false, bool centered = true, const glm::vec3& color = { 1.f, 1.f, 1.f });
@@ -129,5 +167,26 @@ public:
 
     AABB get_aabb() const;
     void set_aabb(const AABB& aabb);
+
+    uint32_t get_sort_id() const { return sort_id; }
+
+    // Quadric simplification of the given data, each LOD keeps about half the triangles of the previous
+    // one. Without create_data the LOD data is only stored, for create_lods_surface_data to upload it later
+    void generate_lods(const sSurfaceData& vertices_data, bool create_data = true);
+    void create_lods_surface_data();
+    void clear_lods();
+
+    const std::vector<sLod>& get_lods() const { return lods; }
+
+    // Level 0 is this surface, levels past the chain return the coarsest LOD
+    Surface* get_lod_surface(uint32_t level);
     void update_aabb(std::vector<glm::vec3>& vertices);
+
+    // Reorders the triangles of the given data in meshlets, for per cluster GPU culling. Must be called
+    // before uploading that data, meshlet surfaces always use 32 bit indices
+    void generate_meshlets(sSurfaceData& vertices_data);
+
+    const std::vector<sMeshlet>& get_meshlets() const { return meshlets; }
+    uint32_t get_first_meshlet() const { return first_meshlet; }
+    bool has_meshlets() const { return first_meshlet != UINT32_MAX; }
 };
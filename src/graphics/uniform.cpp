@@ -1,5 +1,7 @@
 #include "uniform.h"
 
+#include "graphics/staging_belt.h"
+
 Uniform::Uniform()
 {
 }
@@ -12,6 +14,9 @@ Uniform::~Uniform()
 void Uniform::destroy()
 {
     if (std::holds_alternative<WGPUBuffer>(data)) {
+        if (StagingBelt::instance) {
+            StagingBelt::instance->discard_writes(std::get<WGPUBuffer>(data));
+        }
         wgpuBufferDestroy(std::get<WGPUBuffer>(data));
     }
     else if (std::holds_alternative<WGPUTextureView>(data)) {
@@ -38,7 +43,7 @@ WGPUBindGroupEntry Uniform::get_bind_group_entry() const
         bindingGroup.buffer = std::get<WGPUBuffer>(data);
         // We can specify an offset within the buffer, so that a single buffer can hold
         // multiple uniform blocks.
-        bindingGroup.offset = 0;
+        bindingGroup.offset = buffer_offset;
         // And we specify again the size of the buffer.
         bindingGroup.size = buffer_size;
     }
@@ -15,6 +15,8 @@ struct Uniform {
     std::variant<std::monostate, WGPUBuffer, WGPUSampler, WGPUTextureView> data;
 
     uint32_t binding = 0;
+    // Bound range of the buffer
+    uint64_t buffer_offset = 0;
     uint64_t buffer_size = 0;
 
     WGPUBindGroupEntry       get_bind_group_entry() const;
@@ -19,6 +19,22 @@ struct sLightUniformData {
     float outer_cone_cos = 0.0f;
 };
 
+// Scalar parameters of a material, mirrors MaterialParams in mesh_includes.wgsl
+struct sMaterialParams {
+    glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glm::vec3 emissive = { 0.0f, 0.0f, 0.0f };
+    float normal_scale = 1.0f;
+    glm::vec3 occlusion_roughness_metallic = { 1.0f, 1.0f, 0.0f };
+    float alpha_cutoff = 0.5f;
+    glm::vec4 iridescence = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glm::vec3 anisotropy = { 1.0f, 0.0f, 0.0f };
+    float padding0 = 0.0f;
+    glm::vec2 clearcoat = { 0.0f, 0.0f };
+    glm::vec2 padding1 = { 0.0f, 0.0f };
+
+    bool operator==(const sMaterialParams& other) const = default;
+};
+
 enum sUIDataFlags {
     UI_DATA_HOVERED = 1 << 0,
     UI_DATA_PRESSED = 1 << 1,
@@ -3,6 +3,7 @@
 #include "pipeline.h"
 #include "renderer_storage.h"
 #include "shader.h"
+#include "staging_belt.h"
 #include "texture.h"
 
 #include "shaders/brdf_lut_gen.wgsl.gen.h"
@@ -11,9 +12,11 @@
 #include "shaders/panorama_to_cubemap.wgsl.gen.h"
 #include "shaders/prefilter_env.wgsl.gen.h"
 
+#include "framework/utils/cpu_profiler.h"
 #include "framework/utils/utils.h"
 
 #include "renderer.h"
+#include "debug/gpu_profiler.h"
 
 #include "spdlog/spdlog.h"
 
@@ -46,6 +49,14 @@ WGPUTextureFormat WebGPUContext::xr_swapchain_format = WGPUTextureFormat_BGRA8Un
 WGPUTextureFormat WebGPUContext::xr_swapchain_format = WGPUTextureFormat_Undefined;
 #endif
 
+// Mipmaps are also generated while loading, before the renderer exists and from other threads
+static const WGPUPassTimestampWrites* get_profiler_timestamp_writes(std::string_view label, WGPUPassTimestampWrites& timestamp_writes)
+{
+    GPUProfiler* gpu_profiler = Renderer::instance ? Renderer::instance->get_gpu_profiler() : nullptr;
+
+    return gpu_profiler ? gpu_profiler->get_pass_timestamp_writes(label, timestamp_writes) : nullptr;
+}
+
 WGPUStringView get_string_view(const char* str)
 {
     return { str, strlen(str) };
@@ -257,6 +268,8 @@ int WebGPUContext::initialize(bool create_screen_swapchain)
 
     device_queue = wgpuDeviceGetQueue(device);
 
+    staging_belt = new StagingBelt(this);
+
     {
         std::vector<std::string> defines;
 #if defined(BACKEND_METAL) || defined(BACKEND_EMSCRIPTEN)
@@ -309,6 +322,9 @@ void WebGPUContext::destroy()
         return;
     }
 
+    delete staging_belt;
+    staging_belt = nullptr;
+
     wgpuSurfaceRelease(surface);
     wgpuDeviceDestroy(device);
     wgpuQueueRelease(device_queue);
@@ -381,8 +397,10 @@ WGPUBuffer WebGPUContext::create_buffer(size_t size, int usage, const void* data
 
     WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &bufferDesc);
 
+    // Not staged, the helpers creating buffers with data may submit their own commands right after
     if (data != nullptr) {
-        update_buffer(buffer, 0, data, size);
+        PROFILE_COUNTER_ADD("bytes_uploaded", size);
+        wgpuQueueWriteBuffer(device_queue, buffer, 0, data, size);
     }
 
     return buffer;
@@ -453,8 +471,9 @@ void WebGPUContext::create_texture_mipmaps(WGPUTexture texture, WGPUExtent3D tex
     WGPUCommandEncoderDescriptor encoder_desc = {};
     WGPUCommandEncoder command_encoder = custom_command_encoder ? custom_command_encoder : wgpuDeviceCreateCommandEncoder(device, &encoder_desc);
 
+    WGPUPassTimestampWrites timestamp_writes;
     WGPUComputePassDescriptor compute_pass_desc = { .label = { "texture_mipmaps_pass", WGPU_STRLEN } };
-    compute_pass_desc.timestampWrites = nullptr;
+    compute_pass_desc.timestampWrites = get_profiler_timestamp_writes("texture_mipmaps", timestamp_writes);
     WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
 
     Uniform sampler;
@@ -553,8 +572,9 @@ void WebGPUContext::create_cubemap_mipmaps(WGPUTexture texture, WGPUExtent3D tex
     WGPUCommandEncoderDescriptor encoder_desc = {};
     WGPUCommandEncoder command_encoder = custom_command_encoder ? custom_command_encoder : wgpuDeviceCreateCommandEncoder(device, &encoder_desc);
 
+    WGPUPassTimestampWrites timestamp_writes;
     WGPUComputePassDescriptor compute_pass_desc = { .label = { "cubemap_mipmaps_pass", WGPU_STRLEN } };
-    compute_pass_desc.timestampWrites = nullptr;
+    compute_pass_desc.timestampWrites = get_profiler_timestamp_writes("cubemap_mipmaps", timestamp_writes);
     WGPUComputePassEncoder compute_pass = wgpuCommandEncoderBeginComputePass(command_encoder, &compute_pass_desc);
 
     push_debug_group(compute_pass, { "Create Cubemap Mipmaps", WGPU_STRLEN });
@@ -780,6 +800,9 @@ void WebGPUContext::read_buffer(WGPUBuffer buffer, size_t size, void* output_dat
 {
     WGPUBuffer output_buffer = create_buffer(size, WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead, nullptr, "read_buffer");
 
+    // The buffer may have staged writes still waiting for the frame submit
+    staging_belt->flush();
+
     WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, {});
 
     wgpuCommandEncoderCopyBufferToBuffer(encoder, buffer, 0, output_buffer, 0, size);
@@ -837,6 +860,9 @@ void WebGPUContext::read_buffer_async(WGPUBuffer buffer, size_t size, const std:
 {
     WGPUBuffer output_buffer = create_buffer(size, WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead, nullptr, "read_buffer_async");
 
+    // The buffer may have staged writes still waiting for the frame submit
+    staging_belt->flush();
+
     WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, {});
 
     wgpuCommandEncoderCopyBufferToBuffer(encoder, buffer, 0, output_buffer, 0, size);
@@ -1108,11 +1134,10 @@ WGPURenderPipeline WebGPUContext::create_render_pipeline(WGPUShaderModule render
     pipeline_descr.layout = pipeline_layout;
     pipeline_descr.vertex = vertex_state;
 
-    bool strip_topology = (description.topology == WGPUPrimitiveTopology_TriangleStrip) || (description.topology == WGPUPrimitiveTopology_LineStrip);
-
+    // Surfaces use 16 or 32 bit indices, so strip pipelines don't fix the format (no primitive restart is used)
     pipeline_descr.primitive = {
         .topology = description.topology,
-        .stripIndexFormat = strip_topology ? WGPUIndexFormat_Uint32 : WGPUIndexFormat_Undefined, // order of the connected vertices
+        .stripIndexFormat = WGPUIndexFormat_Undefined,
         .frontFace = WGPUFrontFace_CCW,
         .cullMode = description.cull_mode
     },
@@ -1126,6 +1151,8 @@ WGPURenderPipeline WebGPUContext::create_render_pipeline(WGPUShaderModule render
 
     pipeline_descr.fragment = &fragment_state;
 
+    PROFILE_COUNTER_ADD("pipelines_created", 1);
+
     return wgpuDeviceCreateRenderPipeline(device, &pipeline_descr);
 }
 
@@ -1169,11 +1196,10 @@ void WebGPUContext::create_render_pipeline_async(WGPUShaderModule render_shader_
     pipeline_descr.layout = pipeline_layout;
     pipeline_descr.vertex = vertex_state;
 
-    bool strip_topology = (description.topology == WGPUPrimitiveTopology_TriangleStrip) || (description.topology == WGPUPrimitiveTopology_LineStrip);
-
+    // Surfaces use 16 or 32 bit indices, so strip pipelines don't fix the format (no primitive restart is used)
     pipeline_descr.primitive = {
         .topology = description.topology,
-        .stripIndexFormat = strip_topology ? WGPUIndexFormat_Uint32 : WGPUIndexFormat_Undefined, // order of the connected vertices
+        .stripIndexFormat = WGPUIndexFormat_Undefined,
         .frontFace = WGPUFrontFace_CCW,
         .cullMode = description.cull_mode
     },
@@ -1189,6 +1215,8 @@ void WebGPUContext::create_render_pipeline_async(WGPUShaderModule render_shader_
         pipeline_descr.fragment = &fragment_state;
     }
 
+    PROFILE_COUNTER_ADD("pipelines_created", 1);
+
     wgpuDeviceCreateRenderPipelineAsync(device, &pipeline_descr, callback_info);
 }
 
@@ -1203,6 +1231,8 @@ WGPUComputePipeline WebGPUContext::create_compute_pipeline(WGPUShaderModule comp
     computePipelineDesc.compute.module = compute_shader_module;
     computePipelineDesc.layout = pipeline_layout;
 
+    PROFILE_COUNTER_ADD("pipelines_created", 1);
+
     return wgpuDeviceCreateComputePipeline(device, &computePipelineDesc);
 }
 
@@ -1217,6 +1247,8 @@ void WebGPUContext::create_compute_pipeline_async(WGPUShaderModule compute_shade
     computePipelineDesc.compute.module = compute_shader_module;
     computePipelineDesc.layout = pipeline_layout;
 
+    PROFILE_COUNTER_ADD("pipelines_created", 1);
+
     wgpuDeviceCreateComputePipelineAsync(device, &computePipelineDesc, callback_info);
 }
 
@@ -1231,10 +1263,10 @@ WGPUVertexBufferLayout WebGPUContext::create_vertex_buffer_layout(const std::vec
     return vertexBufferLayout;
 }
 
-WGPUQuerySet WebGPUContext::create_query_set(uint8_t maximum_query_sets)
+WGPUQuerySet WebGPUContext::create_query_set(uint32_t query_count)
 {
     WGPUQuerySetDescriptor query_set_descriptor = {};
-    query_set_descriptor.count = maximum_query_sets;
+    query_set_descriptor.count = query_count;
     query_set_descriptor.type = WGPUQueryType_Timestamp;
     query_set_descriptor.label = { "timestamp_query", WGPU_STRLEN };
 
@@ -1463,6 +1495,12 @@ void WebGPUContext::generate_prefiltered_env_texture(Texture* prefiltered_env_te
 
 void WebGPUContext::update_buffer(WGPUBuffer buffer, uint64_t buffer_offset, void const* data, size_t size)
 {
+    PROFILE_COUNTER_ADD("bytes_uploaded", size);
+
+    if (staging_belt && staging_belt->write(buffer, buffer_offset, data, size)) {
+        return;
+    }
+
     wgpuQueueWriteBuffer(device_queue, buffer, buffer_offset, data, size);
 }
 
@@ -10,6 +10,7 @@
 class Shader;
 class Pipeline;
 class Texture;
+class StagingBelt;
 struct XRContext;
 struct GLFWwindow;
 
@@ -44,6 +45,9 @@ struct WebGPUContext {
     WGPUDevice device = nullptr;
     WGPUQueue device_queue = nullptr;
 
+    // Batches the update_buffer writes of the frame, submitted with the frame commands
+    StagingBelt* staging_belt = nullptr;
+
     // For desktop window
     uint32_t screen_width = 0;
     uint32_t screen_height = 0;
@@ -133,7 +137,7 @@ struct WebGPUContext {
 
     WGPUVertexBufferLayout create_vertex_buffer_layout(const std::vector<WGPUVertexAttribute>& vertex_attributes, uint64_t stride, WGPUVertexStepMode step_mode);
 
-    WGPUQuerySet create_query_set(uint8_t maximum_query_sets);
+    WGPUQuerySet create_query_set(uint32_t query_count);
 
     void generate_brdf_lut_texture();
     void generate_prefiltered_env_texture(Texture* prefiltered_env_texture, Texture* hdr_texture);
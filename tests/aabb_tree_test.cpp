@@ -0,0 +1,260 @@
+#include "framework/math/aabb_tree.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "test_utils.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Every query is checked against a scan over the exact boxes. With no margin and moves that keep the
+// box size, the leaves hold the exact boxes and both must report the same set
+struct sItem {
+    AABB aabb;
+    int32_t leaf = AABBTree::NULL_NODE;
+    bool alive = false;
+};
+
+static bool overlaps(const AABB& a, const AABB& b)
+{
+    const glm::vec3 a_min = a.center - a.half_size, a_max = a.center + a.half_size;
+    const glm::vec3 b_min = b.center - b.half_size, b_max = b.center + b.half_size;
+
+    return a_min.x <= b_max.x && a_max.x >= b_min.x && a_min.y <= b_max.y && a_max.y >= b_min.y && a_min.z <= b_max.z && a_max.z >= b_min.z;
+}
+
+static bool ray_hits(const AABB& aabb, const glm::vec3& origin, const glm::vec3& direction, float max_distance)
+{
+    const glm::vec3 box_min = aabb.center - aabb.half_size;
+    const glm::vec3 box_max = aabb.center + aabb.half_size;
+
+    float t_enter = -std::numeric_limits<float>::max();
+    float t_exit = std::numeric_limits<float>::max();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < box_min[axis] || origin[axis] > box_max[axis]) {
+                return false;
+            }
+
+            continue;
+        }
+
+        const float inv_direction = 1.0f / direction[axis];
+        const float t1 = (box_min[axis] - origin[axis]) * inv_direction;
+        const float t2 = (box_max[axis] - origin[axis]) * inv_direction;
+
+        t_enter = std::max(t_enter, std::min(t1, t2));
+        t_exit = std::min(t_exit, std::max(t1, t2));
+    }
+
+    return t_exit >= 0.0f && t_enter <= t_exit && t_enter <= max_distance;
+}
+
+static std::vector<uint32_t> sorted(std::vector<uint32_t> ids)
+{
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+static void check_queries(const AABBTree& tree, const std::vector<sItem>& items, std::mt19937& random, bool exact)
+{
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+    auto check_sets = [&](const std::vector<uint32_t>& reported, const std::vector<uint32_t>& expected) {
+        if (exact) {
+            CHECK(reported == expected);
+        } else {
+            CHECK(std::includes(reported.begin(), reported.end(), expected.begin(), expected.end()));
+        }
+
+        // Each leaf is reported once
+        CHECK(std::adjacent_find(reported.begin(), reported.end()) == reported.end());
+    };
+
+    for (uint32_t query = 0; query < 20; ++query) {
+        const AABB box = { glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)) };
+
+        std::vector<uint32_t> reported, expected;
+
+        tree.query_aabb(box, [&](uint32_t id) { reported.push_back(id); });
+
+        for (uint32_t id = 0; id < items.size(); ++id) {
+            if (items[id].alive && overlaps(items[id].aabb, box)) {
+                expected.push_back(id);
+            }
+        }
+
+        check_sets(sorted(reported), expected);
+    }
+
+    // Rays on integer coordinates run along the faces of the boxes, with zero direction components
+    const glm::vec3 directions[] = {
+        { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f },
+        { 1.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 1.0f }, { 0.3f, -0.5f, 0.8f }, { -0.0f, 0.0f, 1.0f }
+    };
+
+    std::uniform_int_distribution<int> grid(-40, 40);
+
+    for (const glm::vec3& direction : directions) {
+        for (uint32_t query = 0; query < 20; ++query) {
+            const glm::vec3 origin = { static_cast<float>(grid(random)), static_cast<float>(grid(random)), static_cast<float>(grid(random)) };
+            const float max_distance = query % 2 ? 1000.0f : 30.0f;
+
+            std::vector<uint32_t> reported, expected;
+
+            tree.query_ray(origin, direction, max_distance, [&](uint32_t id, float&) { reported.push_back(id); });
+
+            for (uint32_t id = 0; id < items.size(); ++id) {
+                if (items[id].alive && ray_hits(items[id].aabb, origin, direction, max_distance)) {
+                    expected.push_back(id);
+                }
+            }
+
+            check_sets(sorted(reported), expected);
+        }
+    }
+
+    Frustum frustum;
+    frustum.set_view_projection(glm::perspective(glm::radians(70.0f), 1.5f, 0.1f, 60.0f) *
+        glm::lookAt(glm::vec3(0.0f, 10.0f, 45.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<uint32_t> reported, expected;
+    bool inside_flags_valid = true;
+
+    tree.query_frustum(frustum, [&](uint32_t id, bool fully_inside) {
+        reported.push_back(id);
+
+        if (fully_inside) {
+            inside_flags_valid &= frustum.classify_box(items[id].aabb.center, items[id].aabb.half_size) == FRUSTUM_INSIDE;
+        }
+    });
+
+    for (uint32_t id = 0; id < items.size(); ++id) {
+        if (items[id].alive && frustum.classify_box(items[id].aabb.center, items[id].aabb.half_size) != FRUSTUM_OUTSIDE) {
+            expected.push_back(id);
+        }
+    }
+
+    check_sets(sorted(reported), expected);
+    CHECK(inside_flags_valid);
+}
+
+static void test_tree(float margin, bool exact)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> grid(-40, 40);
+    std::uniform_int_distribution<int> half_size(1, 4);
+    std::uniform_int_distribution<int> offset(-3, 3);
+
+    AABBTree tree(margin);
+    std::vector<sItem> items(300);
+
+    // Integer bounds, so the axis parallel rays can run exactly along their faces
+    auto random_box = [&]() {
+        return AABB{ glm::vec3(grid(random), grid(random), grid(random)), glm::vec3(half_size(random), half_size(random), half_size(random)) };
+    };
+
+    for (uint32_t id = 0; id < 200; ++id) {
+        items[id].aabb = random_box();
+        items[id].leaf = tree.insert(items[id].aabb, id);
+        items[id].alive = true;
+    }
+
+    CHECK(tree.get_leaf_count() == 200);
+    check_queries(tree, items, random, exact);
+
+    for (uint32_t step = 0; step < 2000; ++step) {
+        const uint32_t id = random() % items.size();
+        sItem& item = items[id];
+
+        if (!item.alive) {
+            item.aabb = random_box();
+            item.leaf = tree.insert(item.aabb, id);
+            item.alive = true;
+        } else if (step % 5 == 0) {
+            tree.remove(item.leaf);
+            item.alive = false;
+        } else {
+            // Same size, any other position falls out of the old box when there is no margin
+            item.aabb.center += glm::vec3(offset(random), offset(random), offset(random));
+            tree.move(item.leaf, item.aabb);
+        }
+
+        CHECK(tree.get_user_data(item.leaf) == id);
+
+        if (step % 250 == 0) {
+            check_queries(tree, items, random, exact);
+        }
+
+        if (tree.needs_rebuild()) {
+            tree.rebuild();
+        }
+    }
+
+    uint32_t alive_count = 0;
+
+    for (const sItem& item : items) {
+        alive_count += item.alive;
+    }
+
+    CHECK(tree.get_leaf_count() == alive_count);
+    check_queries(tree, items, random, exact);
+
+    // Leaf ids survive a rebuild
+    tree.rebuild();
+
+    for (uint32_t id = 0; id < items.size(); ++id) {
+        if (items[id].alive) {
+            CHECK(tree.get_user_data(items[id].leaf) == id);
+        }
+    }
+
+    check_queries(tree, items, random, exact);
+
+    // Balanced after the rebuild
+    CHECK(!tree.needs_rebuild());
+
+    tree.clear();
+
+    CHECK(tree.get_leaf_count() == 0);
+
+    uint32_t reported = 0;
+    tree.query_aabb({ glm::vec3(0.0f), glm::vec3(100.0f) }, [&](uint32_t) { reported++; });
+    CHECK(reported == 0);
+}
+
+static void test_axis_parallel_rays()
+{
+    AABBTree tree(0.0f);
+
+    // Unit box at the origin, rays along x that graze its faces and edges
+    tree.insert({ glm::vec3(0.0f), glm::vec3(1.0f) }, 0);
+
+    auto hits = [&](const glm::vec3& origin, const glm::vec3& direction) {
+        bool hit = false;
+        tree.query_ray(origin, direction, 100.0f, [&](uint32_t, float&) { hit = true; });
+        return hit;
+    };
+
+    CHECK(hits({ -5.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }));
+    CHECK(hits({ -5.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }));
+    CHECK(hits({ -5.0f, 1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f }));
+    CHECK(hits({ -5.0f, -1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }));
+    CHECK(!hits({ -5.0f, 1.001f, 0.0f }, { 1.0f, 0.0f, 0.0f }));
+    CHECK(!hits({ -5.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }));
+    CHECK(hits({ 0.0f, 1.0f, 5.0f }, { 0.0f, 0.0f, -1.0f }));
+    CHECK(hits({ 0.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }));
+    CHECK(!hits({ 2.0f, 0.0f, 5.0f }, { 0.0f, 0.0f, -1.0f }));
+}
+
+int main()
+{
+    test_tree(0.0f, true);
+    test_tree(0.5f, false);
+    test_axis_parallel_rays();
+
+    return TEST_RESULT();
+}
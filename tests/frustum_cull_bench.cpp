@@ -0,0 +1,90 @@
+#include "framework/math/aabb.h"
+#include "framework/math/frustum_cull.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Times the per surface path (transform the local bounds, then Frustum::is_box_visible) against
+// Frustum::test_boxes over world bounds kept as structure of arrays, and counts the boxes where they disagree.
+// Usage: frustum_cull_bench [box count] [iterations]
+int main(int argc, char** argv)
+{
+    const uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 10000u;
+    const uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100u;
+
+    if (count == 0 || iterations == 0) {
+        std::fprintf(stderr, "Usage: frustum_cull_bench [box count] [iterations]\n");
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    Frustum frustum;
+    frustum.set_view_projection(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f) *
+        glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<AABB> local_aabbs(count);
+    std::vector<glm::mat4x4> matrices(count);
+
+    std::vector<float> center_x(count), center_y(count), center_z(count);
+    std::vector<float> extent_x(count), extent_y(count), extent_z(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        local_aabbs[i] = { glm::vec3(0.0f), glm::vec3(size(random), size(random), size(random)) };
+
+        matrices[i] = glm::rotate(glm::translate(glm::mat4x4(1.0f), glm::vec3(position(random), position(random), position(random))),
+            angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        AABB world_aabb = local_aabbs[i].transform(matrices[i]);
+
+        center_x[i] = world_aabb.center.x; center_y[i] = world_aabb.center.y; center_z[i] = world_aabb.center.z;
+        extent_x[i] = world_aabb.half_size.x; extent_y[i] = world_aabb.half_size.y; extent_z[i] = world_aabb.half_size.z;
+    }
+
+    std::vector<uint8_t> scalar_visible(count);
+    std::vector<uint32_t> visibility_mask((count + 31) / 32);
+
+    auto scalar_begin = std::chrono::steady_clock::now();
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        for (uint32_t i = 0; i < count; ++i) {
+            AABB world_aabb = local_aabbs[i].transform(matrices[i]);
+            scalar_visible[i] = frustum.is_box_visible(world_aabb.center - world_aabb.half_size, world_aabb.center + world_aabb.half_size);
+        }
+    }
+
+    auto scalar_end = std::chrono::steady_clock::now();
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        frustum.test_boxes(center_x.data(), center_y.data(), center_z.data(), extent_x.data(), extent_y.data(), extent_z.data(),
+            count, visibility_mask.data());
+    }
+
+    auto batch_end = std::chrono::steady_clock::now();
+
+    uint32_t visible = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        bool batch_visible = (visibility_mask[i / 32] >> (i % 32)) & 1u;
+        visible += batch_visible;
+        mismatches += batch_visible != static_cast<bool>(scalar_visible[i]);
+    }
+
+    double box_tests = static_cast<double>(count) * iterations;
+    double scalar_ns = std::chrono::duration<double, std::nano>(scalar_end - scalar_begin).count() / box_tests;
+    double batch_ns = std::chrono::duration<double, std::nano>(batch_end - scalar_end).count() / box_tests;
+
+    std::printf("%u boxes (%u visible) x %u iterations: per surface %.2f ns/box, batched %.2f ns/box (%.1fx), %u mismatches\n",
+        count, visible, iterations, scalar_ns, batch_ns, batch_ns > 0.0 ? scalar_ns / batch_ns : 0.0, mismatches);
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
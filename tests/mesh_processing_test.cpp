@@ -0,0 +1,380 @@
+#include "framework/math/mesh_processing.h"
+
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Bumpy grid of size x size quads. With split_seam the middle column of vertices is duplicated,
+// like an attribute seam, so the grid is two open patches sharing positions
+static void build_grid(uint32_t size, bool split_seam, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    positions.clear();
+    indices.clear();
+
+    const uint32_t row_size = size + 1;
+
+    for (uint32_t y = 0; y <= size; ++y) {
+        for (uint32_t x = 0; x <= size; ++x) {
+            const float height = 0.05f * std::sin(x * 0.7f) * std::cos(y * 0.5f);
+            positions.push_back({ static_cast<float>(x) / size, height, static_cast<float>(y) / size });
+        }
+    }
+
+    const uint32_t seam_x = size / 2;
+    const uint32_t seam_first = static_cast<uint32_t>(positions.size());
+
+    if (split_seam) {
+        for (uint32_t y = 0; y <= size; ++y) {
+            positions.push_back(positions[y * row_size + seam_x]);
+        }
+    }
+
+    auto get_vertex = [&](uint32_t x, uint32_t y, bool right_patch) {
+        return split_seam && right_patch && x == seam_x ? seam_first + y : y * row_size + x;
+    };
+
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            const bool right_patch = x >= seam_x;
+
+            const uint32_t v00 = get_vertex(x, y, right_patch);
+            const uint32_t v10 = get_vertex(x + 1, y, right_patch);
+            const uint32_t v01 = get_vertex(x, y + 1, right_patch);
+            const uint32_t v11 = get_vertex(x + 1, y + 1, right_patch);
+
+            indices.insert(indices.end(), { v00, v01, v11, v00, v11, v10 });
+        }
+    }
+}
+
+// Vertices of the edges used by a single triangle
+static std::vector<bool> get_border_vertices(const std::vector<uint32_t>& indices, uint32_t vertex_count)
+{
+    std::vector<uint64_t> edges;
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            const uint32_t a = indices[i + k];
+            const uint32_t b = indices[i + (k + 1) % 3];
+            edges.push_back((static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b));
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<bool> border(vertex_count, false);
+
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const bool shared = (i > 0 && edges[i - 1] == edges[i]) || (i + 1 < edges.size() && edges[i + 1] == edges[i]);
+
+        if (!shared) {
+            border[edges[i] >> 32] = true;
+            border[edges[i] & 0xFFFFFFFF] = true;
+        }
+    }
+
+    return border;
+}
+
+// Triangles rotated to start at their smallest index, then sorted. Equal for the same triangles in any order
+static std::vector<std::vector<uint32_t>> get_sorted_triangles(std::vector<uint32_t> indices)
+{
+    std::vector<std::vector<uint32_t>> triangles;
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        std::rotate(indices.begin() + i, std::min_element(indices.begin() + i, indices.begin() + i + 3), indices.begin() + i + 3);
+        triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+
+    return triangles;
+}
+
+static void test_simplify(bool split_seam)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    build_grid(32, split_seam, positions, indices);
+
+    const uint32_t vertex_count = static_cast<uint32_t>(positions.size());
+    const uint32_t target_index_count = static_cast<uint32_t>(indices.size() / 4) / 3 * 3;
+
+    float error = 0.0f;
+    const std::vector<uint32_t> simplified = simplify_indices(indices, positions.data(), vertex_count, target_index_count, 1.0f, &error);
+
+    // Same input, same output
+    for (uint32_t i = 0; i < 3; ++i) {
+        float repeated_error = 0.0f;
+        CHECK(simplify_indices(indices, positions.data(), vertex_count, target_index_count, 1.0f, &repeated_error) == simplified);
+        CHECK(repeated_error == error);
+    }
+
+    CHECK(!simplified.empty());
+    CHECK(simplified.size() % 3 == 0);
+    CHECK(simplified.size() <= target_index_count);
+    CHECK(error >= 0.0f && error <= 1.0f);
+
+    std::vector<bool> used(vertex_count, false);
+
+    for (size_t i = 0; i < simplified.size(); i += 3) {
+        CHECK(simplified[i] < vertex_count && simplified[i + 1] < vertex_count && simplified[i + 2] < vertex_count);
+        CHECK(simplified[i] != simplified[i + 1] && simplified[i + 1] != simplified[i + 2] && simplified[i] != simplified[i + 2]);
+
+        used[simplified[i]] = used[simplified[i + 1]] = used[simplified[i + 2]] = true;
+    }
+
+    // Border and seam vertices are never collapsed, they are all still used and still on the border
+    const std::vector<bool> border = get_border_vertices(indices, vertex_count);
+    const std::vector<bool> simplified_border = get_border_vertices(simplified, vertex_count);
+
+    uint32_t border_count = 0;
+
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        if (border[v]) {
+            CHECK(used[v]);
+            CHECK(simplified_border[v]);
+            border_count++;
+        }
+    }
+
+    // The seam adds its two columns, the original one shares its ends with the outer border
+    CHECK(border_count == (split_seam ? 4 * 32 + 31 + 33 : 4 * 32));
+}
+
+static void test_simplify_error_limit()
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    build_grid(16, false, positions, indices);
+
+    const uint32_t vertex_count = static_cast<uint32_t>(positions.size());
+
+    // The grid is bumpy, a tiny error limit stops early
+    float error = 0.0f;
+    const std::vector<uint32_t> simplified = simplify_indices(indices, positions.data(), vertex_count, 0, 1e-4f, &error);
+
+    CHECK(simplified.size() > indices.size() / 2);
+    CHECK(error <= 1e-4f);
+
+    // Nothing to do under the target
+    CHECK(simplify_indices(indices, positions.data(), vertex_count, static_cast<uint32_t>(indices.size()), 1.0f) == indices);
+}
+
+static void test_weld()
+{
+    // Two quads sharing an edge, unindexed: 12 vertices, 6 unique positions. One of the shared
+    // vertices has a different uv, so it stays split
+    const std::vector<glm::vec3> positions = {
+        { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 1, 0, 0 },
+        { 1, 0, 0 }, { 1, 1, 0 }, { 2, 1, 0 }, { 1, 0, 0 }, { 2, 1, 0 }, { 2, 0, 0 }
+    };
+
+    std::vector<float> uvs(positions.size(), 0.0f);
+    uvs[7] = 1.0f;
+
+    const sVertexStream streams[] = { { positions.data(), sizeof(glm::vec3) }, { uvs.data(), sizeof(float) } };
+
+    std::vector<uint32_t> remap;
+    const uint32_t unique_count = generate_vertex_remap(streams, 2, static_cast<uint32_t>(positions.size()), remap);
+
+    CHECK(unique_count == 7);
+    CHECK(remap == std::vector<uint32_t>({ 0, 1, 2, 0, 2, 3, 3, 4, 5, 3, 5, 6 }));
+
+    // Positions only
+    CHECK(generate_vertex_remap(streams, 1, static_cast<uint32_t>(positions.size()), remap) == 6);
+    CHECK(remap[7] == remap[2]);
+}
+
+static void test_vertex_cache()
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    build_grid(32, false, positions, indices);
+
+    const uint32_t vertex_count = static_cast<uint32_t>(positions.size());
+
+    // Scrambled triangle order
+    for (size_t i = 0; i < indices.size() / 3; ++i) {
+        const size_t j = (i * 7919) % (indices.size() / 3);
+        std::swap_ranges(indices.begin() + i * 3, indices.begin() + i * 3 + 3, indices.begin() + j * 3);
+    }
+
+    std::vector<uint32_t> sorted_triangles = indices;
+    const sVertexCacheStats before = analyze_vertex_cache(indices.data(), static_cast<uint32_t>(indices.size()), vertex_count);
+
+    std::vector<uint32_t> optimized = indices;
+    optimize_vertex_cache(optimized, vertex_count);
+    optimize_overdraw(optimized, positions.data(), vertex_count);
+
+    std::vector<uint32_t> repeated = indices;
+    optimize_vertex_cache(repeated, vertex_count);
+    optimize_overdraw(repeated, positions.data(), vertex_count);
+    CHECK(repeated == optimized);
+
+    const sVertexCacheStats after = analyze_vertex_cache(optimized.data(), static_cast<uint32_t>(optimized.size()), vertex_count);
+    CHECK(after.acmr < before.acmr);
+    CHECK(after.acmr < 1.0f);
+
+    CHECK(get_sorted_triangles(optimized) == get_sorted_triangles(sorted_triangles));
+
+    // Fetch remap: first use order, every vertex kept
+    std::vector<uint32_t> remap;
+    CHECK(optimize_vertex_fetch_remap(optimized, vertex_count, remap) == vertex_count);
+
+    uint32_t next_vertex = 0;
+    for (uint32_t index : optimized) {
+        CHECK(index <= next_vertex);
+        next_vertex = std::max(next_vertex, index + 1);
+    }
+}
+
+static void build_sphere(uint32_t rings, uint32_t sectors, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    positions.clear();
+    indices.clear();
+
+    for (uint32_t r = 0; r <= rings; ++r) {
+        const float phi = 3.14159265f * r / rings;
+
+        for (uint32_t s = 0; s <= sectors; ++s) {
+            const float theta = 6.28318531f * s / sectors;
+            positions.push_back({ std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) });
+        }
+    }
+
+    for (uint32_t r = 0; r < rings; ++r) {
+        for (uint32_t s = 0; s < sectors; ++s) {
+            const uint32_t v00 = r * (sectors + 1) + s;
+            const uint32_t v01 = v00 + sectors + 1;
+
+            // The pole rows would be degenerate
+            if (r > 0) {
+                indices.insert(indices.end(), { v00, v00 + 1, v01 });
+            }
+
+            if (r + 1 < rings) {
+                indices.insert(indices.end(), { v00 + 1, v01 + 1, v01 });
+            }
+        }
+    }
+}
+
+static void check_meshlets(const std::vector<uint32_t>& input_indices, const std::vector<glm::vec3>& positions, uint32_t max_vertices, uint32_t max_triangles)
+{
+    const uint32_t vertex_count = static_cast<uint32_t>(positions.size());
+
+    std::vector<uint32_t> indices = input_indices;
+    const std::vector<sMeshlet> meshlets = build_meshlets(indices, positions.data(), vertex_count, max_vertices, max_triangles);
+
+    // Same input, same output
+    std::vector<uint32_t> repeated_indices = input_indices;
+    const std::vector<sMeshlet> repeated = build_meshlets(repeated_indices, positions.data(), vertex_count, max_vertices, max_triangles);
+
+    CHECK(repeated_indices == indices);
+    CHECK(repeated.size() == meshlets.size());
+
+    for (size_t i = 0; i < std::min(repeated.size(), meshlets.size()); ++i) {
+        CHECK(std::memcmp(&repeated[i], &meshlets[i], sizeof(sMeshlet)) == 0);
+    }
+
+    // Every input triangle is in exactly one meshlet: the reordered list has the same triangles
+    // and the meshlets split it in consecutive ranges
+    CHECK(get_sorted_triangles(indices) == get_sorted_triangles(input_indices));
+    CHECK(!meshlets.empty());
+
+    uint32_t next_index = 0;
+
+    for (const sMeshlet& meshlet : meshlets) {
+        CHECK(meshlet.first_index == next_index);
+        CHECK(meshlet.index_count > 0 && meshlet.index_count % 3 == 0);
+        CHECK(meshlet.index_count / 3 <= max_triangles);
+
+        next_index = meshlet.first_index + meshlet.index_count;
+
+        if (next_index > indices.size()) {
+            break;
+        }
+
+        std::vector<uint32_t> meshlet_vertices(indices.begin() + meshlet.first_index, indices.begin() + next_index);
+        std::sort(meshlet_vertices.begin(), meshlet_vertices.end());
+        meshlet_vertices.erase(std::unique(meshlet_vertices.begin(), meshlet_vertices.end()), meshlet_vertices.end());
+
+        CHECK(meshlet_vertices.size() <= max_vertices);
+
+        for (uint32_t v : meshlet_vertices) {
+            CHECK(glm::length(positions[v] - meshlet.center) <= meshlet.radius * 1.0001f + 1e-6f);
+        }
+
+        // Sine of the cone half angle, or 1 when the cone is disabled
+        CHECK(meshlet.cone_cutoff >= -1.0f && meshlet.cone_cutoff <= 1.0f);
+
+        if (meshlet.cone_cutoff >= 1.0f) {
+            continue;
+        }
+
+        CHECK(std::abs(glm::length(meshlet.cone_axis) - 1.0f) < 1e-4f);
+
+        // Every triangle normal is inside the cone
+        const float min_dot = std::sqrt(1.0f - meshlet.cone_cutoff * meshlet.cone_cutoff);
+
+        for (uint32_t i = meshlet.first_index; i < next_index; i += 3) {
+            const glm::vec3& p0 = positions[indices[i]];
+            const glm::vec3 normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+            const float normal_length = glm::length(normal);
+
+            if (normal_length > 0.0f) {
+                CHECK(glm::dot(normal / normal_length, meshlet.cone_axis) >= min_dot - 1e-4f);
+            }
+        }
+    }
+
+    CHECK(next_index == indices.size());
+}
+
+static void test_meshlets()
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    build_grid(32, true, positions, indices);
+    check_meshlets(indices, positions, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    check_meshlets(indices, positions, 16, 8);
+
+    // Closed, the meshlet normals point everywhere
+    build_sphere(24, 48, positions, indices);
+    check_meshlets(indices, positions, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    check_meshlets(indices, positions, 3, 1);
+
+    // After the import passes, as the surfaces build them
+    optimize_vertex_cache(indices, static_cast<uint32_t>(positions.size()));
+    check_meshlets(indices, positions, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    // Degenerate triangles face nowhere
+    positions = { { 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 0, 1, 0 } };
+    indices = { 0, 1, 2, 0, 1, 3 };
+    check_meshlets(indices, positions, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    // Double sided quad, its normals cancel out and the cone is disabled
+    positions = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    indices = { 0, 1, 2, 0, 2, 3, 0, 2, 1, 0, 3, 2 };
+    check_meshlets(indices, positions, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    const std::vector<sMeshlet> meshlets = build_meshlets(indices, positions.data(), static_cast<uint32_t>(positions.size()));
+    CHECK(meshlets.size() == 1 && meshlets[0].cone_cutoff == 1.0f);
+}
+
+int main()
+{
+    test_simplify(false);
+    test_simplify(true);
+    test_simplify_error_limit();
+    test_weld();
+    test_vertex_cache();
+    test_meshlets();
+
+    return TEST_RESULT();
+}
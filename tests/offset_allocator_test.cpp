@@ -0,0 +1,167 @@
+#include "framework/utils/offset_allocator.h"
+
+#include "test_utils.h"
+
+#include <random>
+#include <vector>
+
+static void test_coalescing()
+{
+    OffsetAllocator allocator(100);
+
+    const uint32_t a = allocator.allocate(10);
+    const uint32_t b = allocator.allocate(20);
+    const uint32_t c = allocator.allocate(30);
+
+    CHECK(a == 0 && b == 10 && c == 30);
+    CHECK(allocator.get_allocation_size(b) == 20);
+
+    // b alone, then merged with a on its left, then with c and the tail on its right
+    allocator.release(b);
+
+    OffsetAllocator::sStats stats = allocator.get_stats();
+    CHECK(stats.free_range_count == 2);
+    CHECK(stats.largest_free_range == 40);
+
+    allocator.release(a);
+
+    stats = allocator.get_stats();
+    CHECK(stats.free_range_count == 2);
+    CHECK(stats.largest_free_range == 40);
+
+    allocator.release(c);
+
+    stats = allocator.get_stats();
+    CHECK(stats.free_range_count == 1);
+    CHECK(stats.largest_free_range == 100);
+    CHECK(stats.used == 0 && stats.allocation_count == 0);
+    CHECK(stats.fragmentation == 0.0f);
+
+    CHECK(allocator.allocate(100) == 0);
+}
+
+static void test_reuse()
+{
+    OffsetAllocator allocator(100);
+
+    const uint32_t a = allocator.allocate(10);
+    const uint32_t b = allocator.allocate(25);
+    allocator.allocate(10);
+    const uint32_t d = allocator.allocate(40);
+    allocator.allocate(15);
+
+    CHECK(allocator.allocate(1) == OffsetAllocator::INVALID_OFFSET);
+    CHECK(allocator.allocate(0) == OffsetAllocator::INVALID_OFFSET);
+
+    allocator.release(a);
+    allocator.release(b);
+    allocator.release(d);
+
+    // Best fit: 30 goes to the 35 range at 0, not to the 40 one, and the rest of it is used next
+    CHECK(allocator.allocate(30) == 0);
+    CHECK(allocator.allocate(5) == 30);
+    CHECK(allocator.allocate(40) == d);
+    CHECK(allocator.allocate(1) == OffsetAllocator::INVALID_OFFSET);
+
+    // Growing adds the new space at the end, existing offsets are kept
+    allocator.grow(150);
+    CHECK(allocator.get_capacity() == 150);
+    CHECK(allocator.get_allocation_size(d) == 40);
+    CHECK(allocator.allocate(50) == 100);
+}
+
+static void test_stats()
+{
+    OffsetAllocator allocator(64);
+
+    std::vector<uint32_t> offsets;
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        offsets.push_back(allocator.allocate(8));
+    }
+
+    // Every other range free: 4 ranges of 8
+    for (uint32_t i = 0; i < 8; i += 2) {
+        allocator.release(offsets[i]);
+    }
+
+    OffsetAllocator::sStats stats = allocator.get_stats();
+    CHECK(stats.capacity == 64);
+    CHECK(stats.used == 32);
+    CHECK(stats.allocation_count == 4);
+    CHECK(stats.free_range_count == 4);
+    CHECK(stats.largest_free_range == 8);
+    CHECK(stats.fragmentation == 0.75f);
+
+    CHECK(allocator.allocate(9) == OffsetAllocator::INVALID_OFFSET);
+}
+
+// Random allocations and releases checked against a map of the used units
+static void test_random()
+{
+    const uint32_t capacity = 1024;
+
+    OffsetAllocator allocator(capacity);
+
+    std::vector<uint8_t> used(capacity, 0);
+    std::vector<uint32_t> offsets;
+
+    std::mt19937 random(7);
+
+    for (uint32_t i = 0; i < 5000; ++i) {
+        if (offsets.empty() || random() % 3 != 0) {
+            const uint32_t size = 1 + random() % 64;
+            const uint32_t offset = allocator.allocate(size);
+
+            if (offset == OffsetAllocator::INVALID_OFFSET) {
+                CHECK(allocator.get_stats().largest_free_range < size);
+                continue;
+            }
+
+            CHECK(offset + size <= capacity);
+
+            for (uint32_t u = offset; u < offset + size && u < capacity; ++u) {
+                CHECK(!used[u]);
+                used[u] = 1;
+            }
+
+            offsets.push_back(offset);
+        } else {
+            const size_t index = random() % offsets.size();
+            const uint32_t offset = offsets[index];
+
+            for (uint32_t u = offset; u < offset + allocator.get_allocation_size(offset); ++u) {
+                used[u] = 0;
+            }
+
+            allocator.release(offset);
+
+            offsets[index] = offsets.back();
+            offsets.pop_back();
+        }
+
+        uint32_t used_count = 0;
+        uint32_t free_range_count = 0;
+
+        for (uint32_t u = 0; u < capacity; ++u) {
+            used_count += used[u];
+            free_range_count += !used[u] && (u == 0 || used[u - 1]);
+        }
+
+        // Neighbouring free ranges are always merged
+        const OffsetAllocator::sStats stats = allocator.get_stats();
+        CHECK(stats.used == used_count);
+        CHECK(stats.allocation_count == offsets.size());
+        CHECK(stats.free_range_count == free_range_count);
+    }
+}
+
+int main()
+{
+    test_coalescing();
+    test_reuse();
+    test_stats();
+    test_random();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,13 @@
+// Second build of the culler with the scalar path, renamed so it can live next to the SSE one
+
+#define SOFTWARE_OCCLUSION_NO_SIMD
+#define SoftwareOcclusionCuller ScalarSoftwareOcclusionCuller
+
+#include "framework/math/software_occlusion.cpp"
+
+#include "software_occlusion_scenes.h"
+
+void run_scalar_occlusion_scene(std::vector<uint8_t>& visibility, std::vector<float>& depth)
+{
+    run_random_occlusion_scene<ScalarSoftwareOcclusionCuller>(visibility, depth);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "framework/math/aabb.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Scenes shared by the SSE and the scalar builds of the culler, see software_occlusion_scalar.cpp
+
+// Reverse-Z, near and far swapped: depth 1 at the near plane and 0 at the far one
+inline glm::mat4x4 get_occlusion_test_view_projection()
+{
+    return glm::perspective(glm::radians(60.0f), 2.0f, 1000.0f, 0.1f) *
+        glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Quad facing the camera at view depth z, two triangles
+inline void get_occluder_quad(float half_width, float half_height, float z, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices)
+{
+    vertices = {
+        { -half_width, -half_height, z }, { half_width, -half_height, z },
+        { half_width, half_height, z }, { -half_width, half_height, z }
+    };
+
+    indices = { 0, 1, 2, 0, 2, 3 };
+}
+
+// Visibility of boxes scattered around a few occluders, and the depth buffer they were tested against
+template<typename Culler>
+void run_random_occlusion_scene(std::vector<uint8_t>& visibility, std::vector<float>& depth)
+{
+    Culler culler(256, 128);
+    culler.clear(get_occlusion_test_view_projection());
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> distance(-60.0f, -2.0f);
+    std::uniform_real_distribution<float> size(0.1f, 6.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    for (uint32_t i = 0; i < 12; ++i) {
+        get_occluder_quad(size(random), size(random), 0.0f, vertices, indices);
+
+        glm::mat4x4 model = glm::translate(glm::mat4x4(1.0f), glm::vec3(position(random), position(random) * 0.5f, distance(random)));
+        model = glm::rotate(model, angle(random), glm::vec3(0.3f, 1.0f, 0.1f));
+
+        culler.rasterize(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), model);
+    }
+
+    visibility.clear();
+
+    for (uint32_t i = 0; i < 2000; ++i) {
+        const AABB box = { glm::vec3(position(random), position(random) * 0.5f, distance(random) - 5.0f), glm::vec3(size(random) * 0.3f) };
+        visibility.push_back(culler.is_visible(box));
+    }
+
+    depth.assign(culler.get_depth(), culler.get_depth() + culler.get_width() * culler.get_height());
+}
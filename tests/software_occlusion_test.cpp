@@ -0,0 +1,125 @@
+#include "framework/math/software_occlusion.h"
+
+#include "software_occlusion_scenes.h"
+#include "test_utils.h"
+
+void run_scalar_occlusion_scene(std::vector<uint8_t>& visibility, std::vector<float>& depth);
+
+static bool is_visible_behind_quad(float quad_half_size, const AABB& box)
+{
+    SoftwareOcclusionCuller culler(256, 128);
+    culler.clear(get_occlusion_test_view_projection());
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    get_occluder_quad(quad_half_size, quad_half_size, -10.0f, vertices, indices);
+
+    culler.rasterize(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), glm::mat4x4(1.0f));
+
+    CHECK(culler.has_occluders());
+
+    return culler.is_visible(box);
+}
+
+static void test_single_occluder()
+{
+    // Screen filling quad at depth 10
+    CHECK(!is_visible_behind_quad(100.0f, { glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f) }));
+    CHECK(!is_visible_behind_quad(100.0f, { glm::vec3(8.0f, 3.0f, -50.0f), glm::vec3(2.0f) }));
+
+    // In front of it
+    CHECK(is_visible_behind_quad(100.0f, { glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f) }));
+
+    // Crossing it
+    CHECK(is_visible_behind_quad(100.0f, { glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f) }));
+
+    // Crossing the near plane, with its back part hidden
+    CHECK(is_visible_behind_quad(100.0f, { glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f, 1.0f, 10.0f) }));
+
+    // Behind a 4x4 quad: fully inside its silhouette, partly out of it, and fully out of it
+    CHECK(!is_visible_behind_quad(2.0f, { glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f) }));
+    CHECK(is_visible_behind_quad(2.0f, { glm::vec3(3.5f, 0.0f, -20.0f), glm::vec3(1.0f) }));
+    CHECK(is_visible_behind_quad(2.0f, { glm::vec3(0.0f, 10.0f, -20.0f), glm::vec3(1.0f) }));
+
+}
+
+static void test_grid_occluder()
+{
+    SoftwareOcclusionCuller culler(256, 128);
+    culler.clear(get_occlusion_test_view_projection());
+
+    // Tilted 8x8 grid, the triangles only fill the screen together
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    for (uint32_t y = 0; y <= 8; ++y) {
+        for (uint32_t x = 0; x <= 8; ++x) {
+            vertices.push_back({ x * 50.0f - 200.0f, y * 25.0f - 100.0f, 0.0f });
+        }
+    }
+
+    for (uint32_t y = 0; y < 8; ++y) {
+        for (uint32_t x = 0; x < 8; ++x) {
+            const uint32_t i = y * 9 + x;
+            indices.insert(indices.end(), { i, i + 1, i + 10, i, i + 10, i + 9 });
+        }
+    }
+
+    glm::mat4x4 model = glm::translate(glm::mat4x4(1.0f), glm::vec3(0.0f, 0.0f, -60.0f));
+    model = glm::rotate(model, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+    culler.rasterize(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), model);
+
+    CHECK(!culler.is_visible({ glm::vec3(0.0f, 0.0f, -150.0f), glm::vec3(10.0f, 5.0f, 1.0f) }));
+    CHECK(culler.is_visible({ glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f) }));
+}
+
+static void test_no_occluders()
+{
+    SoftwareOcclusionCuller culler(256, 128);
+    culler.clear(get_occlusion_test_view_projection());
+
+    CHECK(!culler.has_occluders());
+    CHECK(culler.is_visible({ glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f) }));
+
+    // Triangles crossing the near plane are not rasterized
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    get_occluder_quad(100.0f, 100.0f, 0.0f, vertices, indices);
+
+    glm::mat4x4 model = glm::rotate(glm::mat4x4(1.0f), glm::radians(80.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    culler.rasterize(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), model);
+
+    CHECK(!culler.has_occluders());
+}
+
+static void test_scalar_matches_simd()
+{
+    std::vector<uint8_t> visibility, scalar_visibility;
+    std::vector<float> depth, scalar_depth;
+
+    run_random_occlusion_scene<SoftwareOcclusionCuller>(visibility, depth);
+    run_scalar_occlusion_scene(scalar_visibility, scalar_depth);
+
+    CHECK(visibility == scalar_visibility);
+    CHECK(depth == scalar_depth);
+
+    // The scene has both outcomes
+    uint32_t visible_count = 0;
+
+    for (uint8_t visible : visibility) {
+        visible_count += visible;
+    }
+
+    CHECK(visible_count > 0 && visible_count < visibility.size());
+}
+
+int main()
+{
+    test_single_occluder();
+    test_grid_occluder();
+    test_no_occluders();
+    test_scalar_matches_simd();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,112 @@
+#include "framework/utils/radix_sort.h"
+#include "framework/utils/sort_key.h"
+
+#include "test_utils.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+static const uint32_t LIST_OPAQUE = 0;
+static const uint32_t LIST_TRANSPARENT = 1;
+
+static void test_opaque_keys()
+{
+    // Field significance: list, priority, pipeline, material, surface
+    CHECK(pack_sort_key(LIST_OPAQUE, 0, 0xFFF, 0x1FFFFF, 0xFFFFF) < pack_sort_key(LIST_TRANSPARENT, 255, 0, 0, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 20, 0xFFF, 0x1FFFFF, 0xFFFFF) < pack_sort_key(LIST_OPAQUE, 10, 0, 0, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 1, 0x1FFFFF, 0xFFFFF) < pack_sort_key(LIST_OPAQUE, 10, 2, 0, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 1, 1, 0xFFFFF) < pack_sort_key(LIST_OPAQUE, 10, 1, 2, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 1, 1, 1) < pack_sort_key(LIST_OPAQUE, 10, 1, 1, 2));
+
+    // Ids wrap inside their own field
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 0x1000, 0, 0) == pack_sort_key(LIST_OPAQUE, 10, 0, 0, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 0, 0x200000, 0) == pack_sort_key(LIST_OPAQUE, 10, 0, 0, 0));
+    CHECK(pack_sort_key(LIST_OPAQUE, 10, 0, 0, 0x100000) == pack_sort_key(LIST_OPAQUE, 10, 0, 0, 0));
+}
+
+static void test_transparent_keys()
+{
+    // Back to front
+    const float depths[] = { 1000.0f, 100.0f, 10.0f, 2.0f, 1.0f, 0.5f, 0.01f, 0.0f };
+
+    for (uint32_t i = 0; i + 1 < std::size(depths); ++i) {
+        CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, depths[i], 0xFFF, 0x1FFFF) < pack_transparent_sort_key(LIST_TRANSPARENT, 10, depths[i + 1], 0, 0));
+    }
+
+    // Behind the eye sorts as depth 0
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, -5.0f, 3, 4) == pack_transparent_sort_key(LIST_TRANSPARENT, 10, 0.0f, 3, 4));
+
+    // Priority before depth, the depth never reaches the priority bits
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 20, 0.0f, 0xFFF, 0x1FFFF) < pack_transparent_sort_key(LIST_TRANSPARENT, 10, 1e30f, 0, 0));
+
+    // Same depth: pipeline, then material
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 1, 0x1FFFF) < pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 2, 0));
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 1, 1) < pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 1, 2));
+
+    // The material is masked to 17 bits and never reaches the pipeline field
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 1, 0x20000) == pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 1, 0));
+    CHECK(pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 0x1000, 0) == pack_transparent_sort_key(LIST_TRANSPARENT, 10, 5.0f, 0, 0));
+}
+
+static void test_radix_sort()
+{
+    std::mt19937_64 random(1234);
+
+    std::vector<sRadixSortEntry> entries;
+    std::vector<sRadixSortEntry> scratch;
+
+    // Few distinct keys spread over all the bytes, most entries share their key with others
+    const uint64_t distinct_keys[] = { 0, 1, 0xFF00, 0x00FF000000000000ull, 0xFFFFFFFFFFFFFFFFull, 0x8000000000000001ull, 0x123456789ABCDEFull };
+
+    for (uint32_t count : { 0u, 1u, 2u, 3u, 100u, 5000u }) {
+        entries.resize(count);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            entries[i] = { distinct_keys[random() % std::size(distinct_keys)], i };
+        }
+
+        std::vector<sRadixSortEntry> expected = entries;
+        std::stable_sort(expected.begin(), expected.end(), [](const sRadixSortEntry& a, const sRadixSortEntry& b) { return a.key < b.key; });
+
+        radix_sort(entries, scratch);
+
+        bool same = entries.size() == expected.size();
+
+        for (uint32_t i = 0; same && i < count; ++i) {
+            same = entries[i].key == expected[i].key && entries[i].index == expected[i].index;
+        }
+
+        CHECK(same);
+    }
+
+    // Random keys
+    entries.resize(10000);
+
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+        entries[i] = { random(), i };
+    }
+
+    std::vector<sRadixSortEntry> expected = entries;
+    std::stable_sort(expected.begin(), expected.end(), [](const sRadixSortEntry& a, const sRadixSortEntry& b) { return a.key < b.key; });
+
+    radix_sort(entries, scratch);
+
+    bool same = true;
+
+    for (uint32_t i = 0; same && i < entries.size(); ++i) {
+        same = entries[i].key == expected[i].key && entries[i].index == expected[i].index;
+    }
+
+    CHECK(same);
+}
+
+int main()
+{
+    test_opaque_keys();
+    test_transparent_keys();
+    test_radix_sort();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the headless tests, failed checks are reported and make the test exit with a failure
+
+inline int& get_failed_checks()
+{
+    static int failed_checks = 0;
+    return failed_checks;
+}
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            get_failed_checks()++;                                                              \
+        }                                                                                       \
+    } while (0)
+
+#define TEST_RESULT() (get_failed_checks() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)